@@ -0,0 +1,715 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  Software CMSIS-DAP responder for the OpenOCD cmsis-dap "tcp" backend.
+
+  It emulates an SWD-only CMSIS-DAP probe connected to a single ADIv5 DP
+  with one MEM-AP (AP #0) in front of a block of RAM. This is enough to run
+  a "mem_ap" target and to measure the driver's queueing, pending FIFO and
+  transfer throughput without hardware.
+
+  To compile run:
+  gcc -Wall -O2 -std=gnu99 -o cmsis_dap_sim cmsis_dap_sim.c
+
+  Usage example:
+  ./cmsis_dap_sim -p 4441 -m 1024 -l 100
+  openocd -f cmsis_dap_sim.cfg -c "cmsis_dap_tcp port 4441"
+
+  Options:
+  -p port      listen on TCP port (default 4441)
+  -u path      listen on a unix socket instead of TCP
+  -b address   base address of the emulated RAM (default 0x20000000)
+  -m size_kib  size of the emulated RAM in KiB (default 256)
+  -s size      CMSIS-DAP packet size reported to the host (default 1024)
+  -c count     CMSIS-DAP packet count reported to the host (default 4)
+  -l usec      latency added before each response, to model USB round trips
+
+  Frames exchanged on the socket are an 8 byte little-endian header
+  ("DAP\0" signature, u16 payload length, u8 type, u8 reserved) followed
+  by a plain CMSIS-DAP command or response.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define FRAME_SIGNATURE		0x00504144
+#define FRAME_HEADER_SIZE	8
+#define FRAME_TYPE_REQUEST	0x01
+#define FRAME_TYPE_RESPONSE	0x02
+
+#define MAX_PACKET_SIZE		65535
+
+/* CMSIS-DAP commands */
+#define CMD_DAP_INFO		0x00
+#define CMD_DAP_LED		0x01
+#define CMD_DAP_CONNECT		0x02
+#define CMD_DAP_DISCONNECT	0x03
+#define CMD_DAP_TFER_CONFIGURE	0x04
+#define CMD_DAP_TFER		0x05
+#define CMD_DAP_TFER_BLOCK	0x06
+#define CMD_DAP_TFER_ABORT	0x07
+#define CMD_DAP_WRITE_ABORT	0x08
+#define CMD_DAP_DELAY		0x09
+#define CMD_DAP_RESET_TARGET	0x0A
+#define CMD_DAP_SWJ_PINS	0x10
+#define CMD_DAP_SWJ_CLOCK	0x11
+#define CMD_DAP_SWJ_SEQ		0x12
+#define CMD_DAP_SWD_CONFIGURE	0x13
+#define CMD_DAP_SWD_SEQUENCE	0x1D
+
+#define DAP_OK			0x00
+#define DAP_ERROR		0xFF
+
+#define INFO_ID_VENDOR		0x01
+#define INFO_ID_PRODUCT		0x02
+#define INFO_ID_SERNUM		0x03
+#define INFO_ID_FW_VER		0x04
+#define INFO_ID_CAPS		0xf0
+#define INFO_ID_SWO_BUF_SZ	0xfd
+#define INFO_ID_PKT_CNT		0xfe
+#define INFO_ID_PKT_SZ		0xff
+
+#define INFO_CAPS_SWD		0x01
+
+/* transfer request bits */
+#define TFER_APNDP		0x01
+#define TFER_RNW		0x02
+#define TFER_A32		0x0C
+#define TFER_MATCH_VALUE	0x10
+#define TFER_MATCH_MASK		0x20
+
+#define ACK_OK			0x01
+#define ACK_FAULT		0x04
+#define ACK_MISMATCH		0x10
+
+/* DP registers (A[3:2] << 2) */
+#define DP_DPIDR		0x0
+#define DP_CTRL_STAT		0x4
+#define DP_SELECT		0x8
+#define DP_RDBUFF		0xC
+
+#define DPIDR_VALUE		0x2BA01477
+#define CDBGPWRUPREQ		(1u << 28)
+#define CDBGPWRUPACK		(1u << 29)
+#define CSYSPWRUPREQ		(1u << 30)
+#define CSYSPWRUPACK		(1u << 31)
+#define STICKYERR		(1u << 5)
+
+/* MEM-AP registers */
+#define MEM_AP_CSW		0x00
+#define MEM_AP_TAR		0x04
+#define MEM_AP_DRW		0x0C
+#define MEM_AP_BD0		0x10
+#define MEM_AP_CFG		0xF4
+#define MEM_AP_BASE		0xF8
+#define MEM_AP_IDR		0xFC
+
+#define AHB3_AP_IDR		0x24770011
+#define CSW_SIZE_MASK		0x07
+#define CSW_ADDRINC_MASK	0x30
+#define CSW_ADDRINC_SINGLE	0x10
+#define CSW_DEVICEEN		0x40
+
+struct sim_stats {
+	unsigned long requests;
+	unsigned long transfers;
+	unsigned long bytes_read;
+	unsigned long bytes_written;
+};
+
+static uint32_t ram_base = 0x20000000;
+static uint32_t ram_size = 256 * 1024;
+static uint8_t *ram;
+static unsigned int packet_size = 1024;
+static unsigned int packet_count = 4;
+static unsigned int latency_us;
+
+static uint32_t dp_ctrl_stat;
+static uint32_t dp_select;
+static uint32_t dp_rdbuff;
+static uint32_t ap_csw = 0x23000002;
+static uint32_t ap_tar;
+static uint32_t match_mask = 0xFFFFFFFF;
+static struct sim_stats stats;
+
+static void h_u16_to_le(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val & 0xff;
+	buf[1] = val >> 8;
+}
+
+static void h_u32_to_le(uint8_t *buf, uint32_t val)
+{
+	for (int i = 0; i < 4; i++)
+		buf[i] = (val >> (8 * i)) & 0xff;
+}
+
+static uint16_t le_to_h_u16(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t le_to_h_u32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static unsigned int csw_size_bytes(void)
+{
+	return 1u << (ap_csw & CSW_SIZE_MASK);
+}
+
+static void tar_increment(void)
+{
+	if ((ap_csw & CSW_ADDRINC_MASK) != CSW_ADDRINC_SINGLE)
+		return;
+
+	/* auto-increment only applies within a 1 KiB block */
+	ap_tar = (ap_tar & ~0x3FFu) | ((ap_tar + csw_size_bytes()) & 0x3FFu);
+}
+
+static uint32_t mem_read(void)
+{
+	unsigned int size = csw_size_bytes();
+	uint32_t lane = ap_tar & 3;
+	uint32_t word = 0;
+
+	for (unsigned int i = 0; i < size && lane + i < 4; i++) {
+		uint32_t addr = ap_tar + i;
+		if (addr >= ram_base && addr - ram_base < ram_size)
+			word |= (uint32_t)ram[addr - ram_base] << (8 * (lane + i));
+	}
+
+	stats.bytes_read += size;
+	tar_increment();
+	return word;
+}
+
+static void mem_write(uint32_t word)
+{
+	unsigned int size = csw_size_bytes();
+	uint32_t lane = ap_tar & 3;
+
+	for (unsigned int i = 0; i < size && lane + i < 4; i++) {
+		uint32_t addr = ap_tar + i;
+		if (addr >= ram_base && addr - ram_base < ram_size)
+			ram[addr - ram_base] = word >> (8 * (lane + i));
+	}
+
+	stats.bytes_written += size;
+	tar_increment();
+}
+
+static uint32_t ap_reg_addr(uint8_t req)
+{
+	return (dp_select & 0xF0) | (req & TFER_A32);
+}
+
+static bool ap_selected(void)
+{
+	return (dp_select >> 24) == 0;
+}
+
+static uint32_t reg_read(uint8_t req)
+{
+	uint32_t value = 0;
+
+	if (!(req & TFER_APNDP)) {
+		switch (req & TFER_A32) {
+		case DP_DPIDR:
+			value = DPIDR_VALUE;
+			break;
+		case DP_CTRL_STAT:
+			value = dp_ctrl_stat;
+			break;
+		case DP_SELECT:
+			value = dp_select;
+			break;
+		case DP_RDBUFF:
+			value = dp_rdbuff;
+			break;
+		}
+		return value;
+	}
+
+	if (!ap_selected())
+		return 0;
+
+	switch (ap_reg_addr(req)) {
+	case MEM_AP_CSW:
+		value = ap_csw | CSW_DEVICEEN;
+		break;
+	case MEM_AP_TAR:
+		value = ap_tar;
+		break;
+	case MEM_AP_DRW:
+		value = mem_read();
+		break;
+	case MEM_AP_BD0:
+	case MEM_AP_BD0 + 4:
+	case MEM_AP_BD0 + 8:
+	case MEM_AP_BD0 + 12: {
+		uint32_t saved = ap_tar;
+		uint32_t saved_csw = ap_csw;
+		ap_tar = (ap_tar & ~0xFu) | (ap_reg_addr(req) & 0xC);
+		ap_csw = (ap_csw & ~(CSW_SIZE_MASK | CSW_ADDRINC_MASK)) | 2;
+		value = mem_read();
+		ap_tar = saved;
+		ap_csw = saved_csw;
+		break;
+	}
+	case MEM_AP_CFG:
+		value = 0;
+		break;
+	case MEM_AP_BASE:
+		/* legacy format, no debug entries present */
+		value = 0xFFFFFFFF;
+		break;
+	case MEM_AP_IDR:
+		value = AHB3_AP_IDR;
+		break;
+	}
+
+	dp_rdbuff = value;
+	return value;
+}
+
+static void reg_write(uint8_t req, uint32_t value)
+{
+	if (!(req & TFER_APNDP)) {
+		switch (req & TFER_A32) {
+		case DP_CTRL_STAT:
+			/* power-up requests are acknowledged immediately */
+			dp_ctrl_stat = value & (CDBGPWRUPREQ | CSYSPWRUPREQ);
+			if (value & CDBGPWRUPREQ)
+				dp_ctrl_stat |= CDBGPWRUPACK;
+			if (value & CSYSPWRUPREQ)
+				dp_ctrl_stat |= CSYSPWRUPACK;
+			break;
+		case DP_SELECT:
+			dp_select = value;
+			break;
+		}
+		return;
+	}
+
+	if (!ap_selected())
+		return;
+
+	switch (ap_reg_addr(req)) {
+	case MEM_AP_CSW:
+		/* packed transfers are not modelled, report single increment */
+		ap_csw = value & ~CSW_DEVICEEN;
+		if ((ap_csw & CSW_ADDRINC_MASK) != CSW_ADDRINC_SINGLE)
+			ap_csw &= ~CSW_ADDRINC_MASK;
+		break;
+	case MEM_AP_TAR:
+		ap_tar = value;
+		break;
+	case MEM_AP_DRW:
+		mem_write(value);
+		break;
+	case MEM_AP_BD0:
+	case MEM_AP_BD0 + 4:
+	case MEM_AP_BD0 + 8:
+	case MEM_AP_BD0 + 12: {
+		uint32_t saved = ap_tar;
+		uint32_t saved_csw = ap_csw;
+		ap_tar = (ap_tar & ~0xFu) | (ap_reg_addr(req) & 0xC);
+		ap_csw = (ap_csw & ~(CSW_SIZE_MASK | CSW_ADDRINC_MASK)) | 2;
+		mem_write(value);
+		ap_tar = saved;
+		ap_csw = saved_csw;
+		break;
+	}
+	}
+}
+
+static unsigned int info_string(uint8_t *resp, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	resp[1] = len;
+	memcpy(&resp[2], str, len);
+	return 2 + len;
+}
+
+static unsigned int handle_info(const uint8_t *cmd, uint8_t *resp)
+{
+	switch (cmd[1]) {
+	case INFO_ID_VENDOR:
+		return info_string(resp, "OpenOCD");
+	case INFO_ID_PRODUCT:
+		return info_string(resp, "CMSIS-DAP simulator");
+	case INFO_ID_SERNUM:
+		return info_string(resp, "0001");
+	case INFO_ID_FW_VER:
+		return info_string(resp, "2.0.0");
+	case INFO_ID_CAPS:
+		resp[1] = 1;
+		resp[2] = INFO_CAPS_SWD;
+		return 3;
+	case INFO_ID_PKT_CNT:
+		resp[1] = 1;
+		resp[2] = packet_count;
+		return 3;
+	case INFO_ID_PKT_SZ:
+		resp[1] = 2;
+		h_u16_to_le(&resp[2], packet_size);
+		return 4;
+	default:
+		resp[1] = 0;
+		return 2;
+	}
+}
+
+static unsigned int handle_transfer(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	unsigned int count = cmd[2];
+	unsigned int idx = 3;
+	unsigned int out = 3;
+	unsigned int done = 0;
+	uint8_t ack = ACK_OK;
+
+	for (; done < count; done++) {
+		if (idx >= len) {
+			ack = ACK_FAULT;
+			break;
+		}
+
+		uint8_t req = cmd[idx++];
+		stats.transfers++;
+
+		if (req & TFER_RNW) {
+			if (out + 4 > packet_size) {
+				ack = ACK_FAULT;
+				break;
+			}
+			if (req & TFER_MATCH_VALUE) {
+				uint32_t expected = le_to_h_u32(&cmd[idx]);
+				idx += 4;
+				if ((reg_read(req) & match_mask) != expected) {
+					ack = ACK_OK | ACK_MISMATCH;
+					break;
+				}
+				continue;
+			}
+			h_u32_to_le(&resp[out], reg_read(req));
+			out += 4;
+		} else {
+			uint32_t value = le_to_h_u32(&cmd[idx]);
+			idx += 4;
+			if (req & TFER_MATCH_MASK)
+				match_mask = value;
+			else
+				reg_write(req, value);
+		}
+	}
+
+	resp[1] = done;
+	resp[2] = ack;
+	return out;
+}
+
+static unsigned int handle_transfer_block(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	unsigned int count = le_to_h_u16(&cmd[2]);
+	uint8_t req = cmd[4];
+	unsigned int idx = 5;
+	unsigned int out = 4;
+	unsigned int done;
+
+	for (done = 0; done < count; done++) {
+		stats.transfers++;
+		if (req & TFER_RNW) {
+			if (out + 4 > packet_size)
+				break;
+			h_u32_to_le(&resp[out], reg_read(req));
+			out += 4;
+		} else {
+			if (idx + 4 > len)
+				break;
+			reg_write(req, le_to_h_u32(&cmd[idx]));
+			idx += 4;
+		}
+	}
+
+	h_u16_to_le(&resp[1], done);
+	resp[3] = done == count ? ACK_OK : ACK_FAULT;
+	return out;
+}
+
+static unsigned int handle_swd_sequence(const uint8_t *cmd, uint8_t *resp)
+{
+	unsigned int count = cmd[1];
+	unsigned int idx = 2;
+	unsigned int out = 2;
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int info = cmd[idx++];
+		unsigned int bits = info & 0x3F;
+		if (bits == 0)
+			bits = 64;
+		unsigned int bytes = (bits + 7) / 8;
+
+		if (info & 0x80) {
+			memset(&resp[out], 0, bytes);
+			out += bytes;
+		} else {
+			idx += bytes;
+		}
+	}
+
+	resp[1] = DAP_OK;
+	return out;
+}
+
+/* Process one command, returns the response length */
+static unsigned int handle_command(const uint8_t *cmd, unsigned int len, uint8_t *resp)
+{
+	resp[0] = cmd[0];
+	resp[1] = DAP_OK;
+
+	switch (cmd[0]) {
+	case CMD_DAP_INFO:
+		return handle_info(cmd, resp);
+	case CMD_DAP_CONNECT:
+		/* SWD is the only (and thus default) port */
+		resp[1] = (cmd[1] == 0 || cmd[1] == 1) ? 1 : 0;
+		return 2;
+	case CMD_DAP_LED:
+	case CMD_DAP_DISCONNECT:
+	case CMD_DAP_TFER_CONFIGURE:
+	case CMD_DAP_TFER_ABORT:
+	case CMD_DAP_DELAY:
+	case CMD_DAP_SWJ_CLOCK:
+	case CMD_DAP_SWJ_SEQ:
+	case CMD_DAP_SWD_CONFIGURE:
+		return 2;
+	case CMD_DAP_WRITE_ABORT:
+		dp_ctrl_stat &= ~STICKYERR;
+		return 2;
+	case CMD_DAP_RESET_TARGET:
+		resp[2] = 0;
+		return 3;
+	case CMD_DAP_SWJ_PINS:
+		resp[1] = 0xFF;
+		return 2;
+	case CMD_DAP_TFER:
+		return handle_transfer(cmd, len, resp);
+	case CMD_DAP_TFER_BLOCK:
+		return handle_transfer_block(cmd, len, resp);
+	case CMD_DAP_SWD_SEQUENCE:
+		return handle_swd_sequence(cmd, resp);
+	default:
+		resp[0] = DAP_ERROR;
+		return 1;
+	}
+}
+
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = read(fd, buf + done, len - done);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	return 0;
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = write(fd, buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	return 0;
+}
+
+static void serve_client(int fd)
+{
+	static uint8_t cmd[MAX_PACKET_SIZE];
+	static uint8_t frame[FRAME_HEADER_SIZE + MAX_PACKET_SIZE];
+	uint8_t header[FRAME_HEADER_SIZE];
+	struct timeval start, end;
+
+	memset(&stats, 0, sizeof(stats));
+	gettimeofday(&start, NULL);
+
+	while (recv_all(fd, header, sizeof(header)) == 0) {
+		unsigned int len = le_to_h_u16(&header[4]);
+		if (le_to_h_u32(header) != FRAME_SIGNATURE || header[6] != FRAME_TYPE_REQUEST) {
+			fprintf(stderr, "invalid frame header, dropping client\n");
+			break;
+		}
+		if (recv_all(fd, cmd, len) != 0)
+			break;
+
+		stats.requests++;
+		memset(frame + FRAME_HEADER_SIZE, 0, packet_size);
+		unsigned int rlen = handle_command(cmd, len, frame + FRAME_HEADER_SIZE);
+
+		if (latency_us)
+			usleep(latency_us);
+
+		h_u32_to_le(&frame[0], FRAME_SIGNATURE);
+		h_u16_to_le(&frame[4], rlen);
+		frame[6] = FRAME_TYPE_RESPONSE;
+		frame[7] = 0;
+		if (send_all(fd, frame, FRAME_HEADER_SIZE + rlen) != 0)
+			break;
+	}
+
+	gettimeofday(&end, NULL);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	printf("client done: %lu requests, %lu transfers, %lu bytes read, %lu bytes written in %.3f s\n",
+		stats.requests, stats.transfers, stats.bytes_read, stats.bytes_written, secs);
+	if (secs > 0)
+		printf("  %.1f requests/s, %.1f KiB/s read, %.1f KiB/s written\n",
+			stats.requests / secs, stats.bytes_read / secs / 1024,
+			stats.bytes_written / secs / 1024);
+	fflush(stdout);
+}
+
+static int listen_socket(int port, const char *unix_path)
+{
+	int fd;
+
+	if (unix_path) {
+		struct sockaddr_un addr = { .sun_family = AF_UNIX };
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		strncpy(addr.sun_path, unix_path, sizeof(addr.sun_path) - 1);
+		unlink(unix_path);
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+			return -1;
+	} else {
+		struct sockaddr_in addr = {
+			.sin_family = AF_INET,
+			.sin_port = htons(port),
+			.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+		};
+		int one = 1;
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+			return -1;
+	}
+
+	if (listen(fd, 1) < 0)
+		return -1;
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	int port = 4441;
+	const char *unix_path = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:u:b:m:s:c:l:")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'u':
+			unix_path = optarg;
+			break;
+		case 'b':
+			ram_base = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			ram_size = strtoul(optarg, NULL, 0) * 1024;
+			break;
+		case 's':
+			packet_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			packet_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port | -u path] [-b base] [-m KiB] "
+				"[-s packet_size] [-c packet_count] [-l latency_us]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (packet_size < 64 || packet_size > MAX_PACKET_SIZE) {
+		fprintf(stderr, "packet size must be within 64..%d\n", MAX_PACKET_SIZE);
+		return 1;
+	}
+
+	ram = calloc(1, ram_size);
+	if (!ram) {
+		fprintf(stderr, "unable to allocate %u bytes of RAM\n", ram_size);
+		return 1;
+	}
+
+	int server = listen_socket(port, unix_path);
+	if (server < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	if (unix_path)
+		printf("listening on %s\n", unix_path);
+	else
+		printf("listening on port %d\n", port);
+	printf("RAM at 0x%08x, %u KiB, packet size %u, latency %u us\n",
+		ram_base, ram_size / 1024, packet_size, latency_us);
+	fflush(stdout);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+
+		if (!unix_path) {
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		}
+
+		serve_client(fd);
+		close(fd);
+	}
+
+	return 0;
+}
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  Reference server for the OpenOCD jtag_dpi driver.
+
+  It speaks both the text protocol of the driver and the binary, batched
+  protocol, and drives a loopback TAP model: TDO returns what was shifted
+  in on TDI. To bridge to a simulation, replace tap_reset(), tap_shift()
+  and tap_idle_clocks() with calls to the tasks exported by the DPI side
+  of the testbench; everything else can stay as it is.
+
+  To compile run:
+  gcc -Wall -O2 -std=gnu99 -o jtag_dpi_server jtag_dpi_server.c
+
+  Usage example:
+  ./jtag_dpi_server -p 5555
+  openocd -f interface/jtag_dpi.cfg -c "jtag_dpi mode binary"
+
+  Options:
+  -p port      listen on TCP port (default 5555)
+  -l usec      latency added before each reply
+  -t           text protocol only, don't answer version queries
+
+  Text protocol, one command per line:
+    "reset"                 reset the TAP, no reply
+    "ib <bits>", "db <bits>" followed by the TDI bytes of an IR or DR scan,
+                            answered with as many TDO bytes
+    "version"               answered with "version 2 <max batch bytes>"
+
+  Binary protocol:
+    "bb <length> <records>" followed by <length> bytes of records, each an
+                            op byte, a flags byte, 2 reserved bytes, the
+                            number of bits as u32 little-endian and for
+                            scans the TDI bytes; answered with the number
+                            of TDO bytes as u32 little-endian, then the TDO
+                            bytes of the records with flag 0x01, in order.
+    ops: 0 reset, 1 IR scan, 2 DR scan, 3 idle clocks (count in bits)
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define PROTOCOL_VERSION	2
+#define MAX_BATCH_SIZE		(1024 * 1024)
+
+#define OP_RESET		0
+#define OP_IR_SCAN		1
+#define OP_DR_SCAN		2
+#define OP_IDLE_CLOCKS		3
+
+#define RECORD_CAPTURE		0x01
+#define RECORD_HEADER_SIZE	8
+
+static unsigned int latency_us;
+static bool text_only;
+
+struct server_stats {
+	unsigned long long commands;
+	unsigned long long batches;
+	unsigned long long scans;
+	unsigned long long bits;
+	unsigned long long idle_clocks;
+};
+
+static struct server_stats stats;
+
+/* TAP model, loopback */
+
+static void tap_reset(void)
+{
+}
+
+static void tap_shift(bool ir, const uint8_t *tdi, uint8_t *tdo, uint32_t bits)
+{
+	(void)ir;
+	memcpy(tdo, tdi, (bits + 7) / 8);
+	stats.scans++;
+	stats.bits += bits;
+}
+
+static void tap_idle_clocks(uint32_t cycles)
+{
+	stats.idle_clocks += cycles;
+}
+
+/* Socket handling */
+
+static uint32_t le_to_h_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void h_u32_to_le(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = read(fd, buf + done, len - done);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	return 0;
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	if (latency_us)
+		usleep(latency_us);
+
+	while (done < len) {
+		ssize_t n = write(fd, buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	return 0;
+}
+
+static int recv_line(int fd, char *line, size_t size)
+{
+	size_t len = 0;
+
+	while (len < size - 1) {
+		if (recv_all(fd, (uint8_t *)line + len, 1) < 0)
+			return -1;
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = 0;
+
+	return 0;
+}
+
+/* Protocol */
+
+static int serve_scan(int fd, bool ir, unsigned int bits)
+{
+	size_t bytes = (bits + 7) / 8;
+	uint8_t *tdi = malloc(bytes), *tdo = malloc(bytes);
+	int retval = -1;
+
+	if (tdi && tdo && recv_all(fd, tdi, bytes) == 0) {
+		tap_shift(ir, tdi, tdo, bits);
+		retval = send_all(fd, tdo, bytes);
+	}
+
+	free(tdi);
+	free(tdo);
+	return retval;
+}
+
+static int serve_batch(int fd, size_t len, uint32_t records)
+{
+	static uint8_t *msg, *reply;
+	static size_t size;
+	size_t pos = 0, out = 4;
+
+	/* a single scan may be larger than the size announced */
+	if (len > size) {
+		free(msg);
+		free(reply);
+		msg = malloc(len);
+		reply = malloc(4 + len);
+		size = len;
+		if (!msg || !reply) {
+			fprintf(stderr, "unable to allocate %zu bytes\n", len);
+			size = 0;
+			return -1;
+		}
+	}
+
+	if (recv_all(fd, msg, len) < 0)
+		return -1;
+
+	for (uint32_t i = 0; i < records; i++) {
+		if (pos + RECORD_HEADER_SIZE > len)
+			return -1;
+
+		uint8_t op = msg[pos];
+		uint8_t flags = msg[pos + 1];
+		uint32_t bits = le_to_h_u32(msg + pos + 4);
+		pos += RECORD_HEADER_SIZE;
+
+		switch (op) {
+		case OP_RESET:
+			tap_reset();
+			break;
+		case OP_IR_SCAN:
+		case OP_DR_SCAN: {
+			size_t bytes = (bits + 7) / 8;
+			if (pos + bytes > len)
+				return -1;
+			tap_shift(op == OP_IR_SCAN, msg + pos, reply + out, bits);
+			if (flags & RECORD_CAPTURE)
+				out += bytes;
+			pos += bytes;
+			break;
+		}
+		case OP_IDLE_CLOCKS:
+			tap_idle_clocks(bits);
+			break;
+		default:
+			fprintf(stderr, "unknown batch op %u\n", op);
+			return -1;
+		}
+		stats.commands++;
+	}
+
+	stats.batches++;
+	h_u32_to_le(reply, out - 4);
+	return send_all(fd, reply, out);
+}
+
+static void serve_client(int fd)
+{
+	char line[80];
+
+	while (recv_line(fd, line, sizeof(line)) == 0) {
+		unsigned int bits;
+		size_t len;
+		uint32_t records;
+		int retval = 0;
+
+		if (!strcmp(line, "reset")) {
+			tap_reset();
+			stats.commands++;
+		} else if (sscanf(line, "ib %u", &bits) == 1) {
+			retval = serve_scan(fd, true, bits);
+			stats.commands++;
+		} else if (sscanf(line, "db %u", &bits) == 1) {
+			retval = serve_scan(fd, false, bits);
+			stats.commands++;
+		} else if (!text_only && !strcmp(line, "version")) {
+			snprintf(line, sizeof(line), "version %d %d\n", PROTOCOL_VERSION, MAX_BATCH_SIZE);
+			retval = send_all(fd, (uint8_t *)line, strlen(line));
+		} else if (!text_only && sscanf(line, "bb %zu %u", &len, &records) == 2) {
+			retval = serve_batch(fd, len, records);
+		} else {
+			fprintf(stderr, "ignoring unknown command '%s'\n", line);
+		}
+
+		if (retval < 0)
+			break;
+	}
+}
+
+static int listen_socket(int port)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int one = 1;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	if (listen(fd, 1) < 0)
+		return -1;
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	int port = 5555;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:l:t")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			text_only = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-l latency_us] [-t]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	int server = listen_socket(port);
+	if (server < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	printf("listening on port %d, %s protocol, latency %u us\n", port,
+		text_only ? "text" : "text and binary", latency_us);
+	fflush(stdout);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		memset(&stats, 0, sizeof(stats));
+		serve_client(fd);
+		close(fd);
+
+		printf("connection closed: %llu commands, %llu batches, %llu scans of %llu bits, "
+			"%llu idle clocks\n", stats.commands, stats.batches, stats.scans,
+			stats.bits, stats.idle_clocks);
+		fflush(stdout);
+	}
+
+	return 0;
+}
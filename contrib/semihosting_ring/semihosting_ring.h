@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Target side of the OpenOCD semihosting ring, see the command
+ * 'arm semihosting_ring' in the OpenOCD manual.
+ *
+ * Requests are the classic semihosting operation numbers and parameter
+ * blocks; the parameter block and the buffers it points to must stay
+ * valid until the request is serviced.
+ */
+
+#ifndef SEMIHOSTING_RING_H
+#define SEMIHOSTING_RING_H
+
+#include <stdint.h>
+
+#ifndef SH_RING_ENTRIES
+#define SH_RING_ENTRIES 16
+#endif
+
+struct sh_ring_entry {
+	uint32_t op;
+	int32_t err;
+	uint64_t param;
+	int64_t result;
+	uint64_t reserved;
+};
+
+struct sh_ring {
+	char id[16];
+	uint32_t num_entries;
+	uint32_t word_size;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	struct sh_ring_entry entries[SH_RING_ENTRIES];
+};
+
+/*
+ * The identifier is also in the initialized data image in flash: make
+ * OpenOCD search RAM only.
+ */
+#define SH_RING_INIT { \
+	.id = "SEMIHOST RING", \
+	.num_entries = SH_RING_ENTRIES, \
+	.word_size = sizeof(void *), \
+}
+
+/* Queue a request, waiting for a free entry. Returns its sequence number. */
+static inline uint32_t sh_ring_submit(struct sh_ring *ring, uint32_t op, const void *param)
+{
+	uint32_t head = ring->head;
+
+	while (head - ring->tail >= ring->num_entries)
+		;
+
+	struct sh_ring_entry *entry = &ring->entries[head % ring->num_entries];
+	entry->op = op;
+	entry->param = (uintptr_t)param;
+	__sync_synchronize();
+	ring->head = head + 1;
+
+	return head;
+}
+
+/*
+ * Wait for request @seq and return its result. Must be called before
+ * num_entries more requests are queued, as its entry is then reused.
+ */
+static inline int64_t sh_ring_wait(struct sh_ring *ring, uint32_t seq, int *err)
+{
+	while ((int32_t)(ring->tail - seq) <= 0)
+		;
+	__sync_synchronize();
+
+	const struct sh_ring_entry *entry = &ring->entries[seq % ring->num_entries];
+	if (err)
+		*err = entry->err;
+	return entry->result;
+}
+
+/* Same as a classic semihosting call, without halting the core. */
+static inline int64_t sh_ring_call(struct sh_ring *ring, uint32_t op, const void *param)
+{
+	return sh_ring_wait(ring, sh_ring_submit(ring, op, param), 0);
+}
+
+#endif /* SEMIHOSTING_RING_H */
@@ -0,0 +1,521 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  Mock of ST's stlink-server, for the OpenOCD ST-Link "tcp" backend.
+
+  It answers the stlink-server protocol for a single ST-Link/V2 (firmware
+  V2J37) connected to a Cortex-M4 with a block of RAM, so that OpenOCD can
+  attach a "hla_stlink" cortex_m target and move memory without hardware.
+  This is enough to measure the round trips of the TCP backend and the
+  effect of its pipeline depth.
+
+  To compile run:
+  gcc -Wall -O2 -std=gnu99 -o stlink_server_mock stlink_server_mock.c
+
+  Usage example:
+  ./stlink_server_mock -p 7184 -l 200
+  openocd -c "set PIPELINE 8" -f stlink_server_mock.cfg \
+          -c "init; mock_benchmark 65536; shutdown"
+
+  Options:
+  -p port      listen on TCP port (default 7184)
+  -b address   base address of the emulated RAM (default 0x20000000)
+  -m size_kib  size of the emulated RAM in KiB (default 256)
+  -l usec      latency added before each burst of responses, to model the
+               round trip to the server
+  -u usec      time spent by the probe on each USB command
+
+  Requests received together are answered together, after a single
+  latency: pipelined requests pay the round trip once.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* stlink-server commands */
+#define TCP_CMD_REFRESH_DEVICE_LIST	0x00
+#define TCP_CMD_GET_NB_DEV		0x01
+#define TCP_CMD_GET_DEV_INFO		0x02
+#define TCP_CMD_OPEN_DEV		0x03
+#define TCP_CMD_CLOSE_DEV		0x04
+#define TCP_CMD_SEND_USB_CMD		0x05
+#define TCP_CMD_GET_SERVER_VERSION	0x06
+
+#define TCP_REQUEST_WRITE		0
+#define TCP_USB_CMD_SIZE		32
+#define TCP_SS_OK			0x00000001
+#define TCP_SS_BAD_PARAMETER		0x00001002
+
+#define DEVICE_ID			0x1234
+#define CONNECT_ID			0x5678
+
+/* ST-Link commands */
+#define STLINK_GET_VERSION		0xf1
+#define STLINK_DEBUG_COMMAND		0xf2
+#define STLINK_GET_CURRENT_MODE		0xf5
+#define STLINK_GET_TARGET_VOLTAGE	0xf7
+
+#define STLINK_DEV_MASS_MODE		0x01
+#define STLINK_DEBUG_ERR_OK		0x80
+
+#define DEBUG_READMEM_32BIT		0x07
+#define DEBUG_WRITEMEM_32BIT		0x08
+#define DEBUG_READMEM_8BIT		0x0c
+#define DEBUG_WRITEMEM_8BIT		0x0d
+#define DEBUG_APIV2_READ_IDCODES	0x31
+#define DEBUG_APIV2_WRITEDEBUGREG	0x35
+#define DEBUG_APIV2_READDEBUGREG	0x36
+#define DEBUG_APIV2_READMEM_16BIT	0x47
+#define DEBUG_APIV2_WRITEMEM_16BIT	0x48
+#define DEBUG_WRITEMEM_32BIT_NO_ADDR_INC	0x50
+#define DEBUG_READMEM_32BIT_NO_ADDR_INC		0x54
+
+#define SWD_IDCODE			0x2ba01477
+
+/* Cortex-M system registers */
+#define SCS_BASE			0xe000e000
+#define SCS_SIZE			0x2000
+#define CPUID				0xe000ed00
+#define CPUID_CORTEX_M4			0x410fc241
+#define DHCSR				0xe000edf0
+#define DHCSR_C_HALT			(1 << 1)
+#define DHCSR_S_REGRDY			(1 << 16)
+#define DHCSR_S_HALT			(1 << 17)
+
+#define MAX_REQUEST_SIZE		(TCP_USB_CMD_SIZE + 65536)
+
+struct mock_stats {
+	unsigned long requests;
+	unsigned long usb_cmds;
+	unsigned long bursts;
+	unsigned long bytes_read;
+	unsigned long bytes_written;
+};
+
+static uint32_t ram_base = 0x20000000;
+static uint32_t ram_size = 256 * 1024;
+static unsigned int latency_us;
+static unsigned int usb_us;
+
+static uint8_t *ram;
+static uint8_t scs[SCS_SIZE];
+static struct mock_stats stats;
+
+static uint32_t le_to_h_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static uint16_t le_to_h_u16(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8;
+}
+
+static void h_u32_to_le(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static void h_u16_to_le(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+}
+
+/* Target memory: RAM and the system control space, the rest reads zero */
+
+static uint8_t *mem_ptr(uint32_t addr)
+{
+	if (addr - ram_base < ram_size)
+		return ram + (addr - ram_base);
+	if (addr - SCS_BASE < SCS_SIZE)
+		return scs + (addr - SCS_BASE);
+	return NULL;
+}
+
+static void mem_read(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		uint8_t *p = mem_ptr(addr + i);
+		buf[i] = p ? *p : 0;
+	}
+	stats.bytes_read += len;
+}
+
+static void mem_write(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++) {
+		uint8_t *p = mem_ptr(addr + i);
+		if (p)
+			*p = buf[i];
+	}
+	stats.bytes_written += len;
+
+	/* the core halts as soon as asked to, registers are always ready */
+	if (addr <= DHCSR && DHCSR - addr < len) {
+		uint32_t dhcsr = le_to_h_u32(mem_ptr(DHCSR)) & 0xffff;
+		dhcsr |= DHCSR_S_REGRDY;
+		if (dhcsr & DHCSR_C_HALT)
+			dhcsr |= DHCSR_S_HALT;
+		h_u32_to_le(mem_ptr(DHCSR), dhcsr);
+	}
+}
+
+static void mem_reset(void)
+{
+	memset(scs, 0, sizeof(scs));
+	h_u32_to_le(mem_ptr(CPUID), CPUID_CORTEX_M4);
+	h_u32_to_le(mem_ptr(DHCSR), DHCSR_S_REGRDY);
+}
+
+/* ST-Link commands, answered in reply[0..size-1] */
+
+static void usb_cmd(const uint8_t *cmd, bool write, const uint8_t *data, uint32_t size, uint8_t *reply)
+{
+	uint32_t addr = le_to_h_u32(cmd + 2);
+	uint16_t len = le_to_h_u16(cmd + 6);
+
+	stats.usb_cmds++;
+	if (usb_us)
+		usleep(usb_us);
+
+	if (!write)
+		memset(reply, 0, size);
+
+	switch (cmd[0]) {
+	case STLINK_GET_VERSION:
+		/* V2J37S0, ST-Link/V2 */
+		reply[0] = (2 << 4) | (37 >> 2);
+		reply[1] = (37 << 6) & 0xc0;
+		h_u16_to_le(reply + 2, 0x0483);
+		h_u16_to_le(reply + 4, 0x3748);
+		return;
+	case STLINK_GET_CURRENT_MODE:
+		reply[0] = STLINK_DEV_MASS_MODE;
+		return;
+	case STLINK_GET_TARGET_VOLTAGE:
+		/* 3.3V */
+		h_u32_to_le(reply, 1200);
+		h_u32_to_le(reply + 4, 1650);
+		return;
+	case STLINK_DEBUG_COMMAND:
+		break;
+	default:
+		return;
+	}
+
+	switch (cmd[1]) {
+	case DEBUG_READMEM_8BIT:
+	case DEBUG_READMEM_32BIT:
+	case DEBUG_APIV2_READMEM_16BIT:
+		mem_read(addr, reply, len < size ? len : size);
+		return;
+	case DEBUG_READMEM_32BIT_NO_ADDR_INC:
+		for (uint32_t i = 0; i + 4 <= len && i + 4 <= size; i += 4)
+			mem_read(addr, reply + i, 4);
+		return;
+	case DEBUG_WRITEMEM_8BIT:
+	case DEBUG_WRITEMEM_32BIT:
+	case DEBUG_APIV2_WRITEMEM_16BIT:
+		mem_write(addr, data, len < size ? len : size);
+		return;
+	case DEBUG_WRITEMEM_32BIT_NO_ADDR_INC:
+		for (uint32_t i = 0; i + 4 <= len && i + 4 <= size; i += 4)
+			mem_write(addr, data + i, 4);
+		return;
+	case DEBUG_APIV2_READDEBUGREG:
+		if (size >= 8)
+			mem_read(addr, reply + 4, 4);
+		break;
+	case DEBUG_APIV2_WRITEDEBUGREG:
+		mem_write(addr, cmd + 6, 4);
+		break;
+	case DEBUG_APIV2_READ_IDCODES:
+		if (size >= 8)
+			h_u32_to_le(reply + 4, SWD_IDCODE);
+		break;
+	default:
+		/* enter, exit, speed, status of the last access and the
+		 * like just succeed, register values read zero */
+		break;
+	}
+
+	if (!write && size)
+		reply[0] = STLINK_DEBUG_ERR_OK;
+}
+
+/* stlink-server requests, returns the size of the request at buf, 0 if
+ * not complete yet and -1 if invalid; the response is appended at out */
+
+static ssize_t serve_request(const uint8_t *buf, size_t len, uint8_t *out, size_t *out_len)
+{
+	uint8_t *reply = out + *out_len;
+	size_t req_size, reply_size;
+
+	if (len < 1)
+		return 0;
+
+	switch (buf[0]) {
+	case TCP_CMD_REFRESH_DEVICE_LIST:
+		req_size = 2;
+		reply_size = 4;
+		break;
+	case TCP_CMD_GET_NB_DEV:
+		req_size = 1;
+		reply_size = 4;
+		break;
+	case TCP_CMD_GET_SERVER_VERSION:
+		req_size = 4;
+		reply_size = 16;
+		break;
+	case TCP_CMD_GET_DEV_INFO:
+		req_size = 8;
+		reply_size = 45;
+		break;
+	case TCP_CMD_OPEN_DEV:
+		req_size = 8;
+		reply_size = 8;
+		break;
+	case TCP_CMD_CLOSE_DEV:
+		req_size = 8;
+		reply_size = 4;
+		break;
+	case TCP_CMD_SEND_USB_CMD:
+		if (len < TCP_USB_CMD_SIZE)
+			return 0;
+		req_size = TCP_USB_CMD_SIZE;
+		reply_size = 4;
+		if (le_to_h_u32(buf + 28) > MAX_REQUEST_SIZE - TCP_USB_CMD_SIZE)
+			return -1;
+		if (buf[24] == TCP_REQUEST_WRITE)
+			req_size += le_to_h_u32(buf + 28);
+		else
+			reply_size += le_to_h_u32(buf + 28);
+		break;
+	default:
+		fprintf(stderr, "unknown request 0x%02x\n", buf[0]);
+		return -1;
+	}
+
+	if (len < req_size)
+		return 0;
+
+	memset(reply, 0, reply_size);
+	h_u32_to_le(reply, TCP_SS_OK);
+
+	switch (buf[0]) {
+	case TCP_CMD_GET_NB_DEV:
+		h_u32_to_le(reply, 1);
+		break;
+	case TCP_CMD_GET_SERVER_VERSION:
+		h_u32_to_le(reply, 2);
+		h_u32_to_le(reply + 4, 2);
+		h_u32_to_le(reply + 8, 1);
+		h_u32_to_le(reply + 12, 0);
+		break;
+	case TCP_CMD_GET_DEV_INFO:
+		h_u32_to_le(reply + 4, DEVICE_ID);
+		memcpy(reply + 8, "MOCK0000000000000000000000000001", 32);
+		h_u16_to_le(reply + 40, 0x0483);
+		h_u16_to_le(reply + 42, 0x3748);
+		reply[44] = 0;
+		break;
+	case TCP_CMD_OPEN_DEV:
+		if (le_to_h_u32(buf + 4) != DEVICE_ID) {
+			h_u32_to_le(reply, TCP_SS_BAD_PARAMETER);
+			break;
+		}
+		mem_reset();
+		h_u32_to_le(reply + 4, CONNECT_ID);
+		break;
+	case TCP_CMD_SEND_USB_CMD:
+		if (le_to_h_u32(buf + 4) != CONNECT_ID) {
+			h_u32_to_le(reply, TCP_SS_BAD_PARAMETER);
+			memset(reply + 4, 0, reply_size - 4);
+			break;
+		}
+		usb_cmd(buf + 8, buf[24] == TCP_REQUEST_WRITE, buf + TCP_USB_CMD_SIZE,
+				le_to_h_u32(buf + 28), reply + 4);
+		break;
+	default:
+		break;
+	}
+
+	stats.requests++;
+	*out_len += reply_size;
+	return req_size;
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = write(fd, buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	return 0;
+}
+
+static void serve_client(int fd)
+{
+	/* room for a burst of requests, and of their responses */
+	size_t in_size = 4 * MAX_REQUEST_SIZE, out_size = 8 * MAX_REQUEST_SIZE;
+	uint8_t *in = malloc(in_size), *out = malloc(out_size);
+	size_t in_len = 0;
+	struct timeval start, end;
+
+	if (!in || !out) {
+		fprintf(stderr, "out of memory\n");
+		goto done;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	gettimeofday(&start, NULL);
+
+	for (;;) {
+		ssize_t n = read(fd, in + in_len, in_size - in_len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		in_len += n;
+
+		/* answer all the complete requests, at once */
+		size_t pos = 0, out_len = 0;
+		while (out_len + MAX_REQUEST_SIZE + 16 <= out_size) {
+			ssize_t used = serve_request(in + pos, in_len - pos, out, &out_len);
+			if (used < 0)
+				goto done;
+			if (used == 0)
+				break;
+			pos += used;
+		}
+		memmove(in, in + pos, in_len - pos);
+		in_len -= pos;
+
+		if (out_len) {
+			stats.bursts++;
+			if (latency_us)
+				usleep(latency_us);
+			if (send_all(fd, out, out_len) < 0)
+				break;
+		}
+	}
+
+done:
+	gettimeofday(&end, NULL);
+	double secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	printf("client done: %lu requests, %lu USB commands in %lu bursts, "
+		"%lu bytes read, %lu bytes written in %.3f s\n", stats.requests,
+		stats.usb_cmds, stats.bursts, stats.bytes_read, stats.bytes_written, secs);
+	fflush(stdout);
+
+	free(in);
+	free(out);
+}
+
+static int listen_socket(int port)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int one = 1;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	if (listen(fd, 1) < 0)
+		return -1;
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	int port = 7184;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:b:m:l:u:")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'b':
+			ram_base = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			ram_size = strtoul(optarg, NULL, 0) * 1024;
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			usb_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-b base] [-m KiB] "
+				"[-l latency_us] [-u usb_us]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	ram = calloc(1, ram_size);
+	if (!ram) {
+		fprintf(stderr, "unable to allocate %u bytes of RAM\n", ram_size);
+		return 1;
+	}
+
+	int server = listen_socket(port);
+	if (server < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	printf("listening on port %d, RAM at 0x%08x, %u KiB, latency %u us, USB %u us\n",
+		port, ram_base, ram_size / 1024, latency_us, usb_us);
+	fflush(stdout);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		serve_client(fd);
+		close(fd);
+	}
+
+	return 0;
+}
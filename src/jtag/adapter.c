@@ -12,6 +12,7 @@
 #endif
 
 #include "adapter.h"
+#include "benchmark.h"
 #include "jtag.h"
 #include "minidriver.h"
 #include "interface.h"
@@ -1177,6 +1178,9 @@ static const struct command_registration adapter_command_handlers[] = {
 			"[-pull-none|-pull-up|-pull-down]"
 			"[-init-inactive|-init-active|-init-input] ]",
 	},
+	{
+		.chain = adapter_benchmark_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Synthetic workloads to measure how fast OpenOCD builds and flushes
+ * the adapter queue, independently of any target. Each workload queues
+ * operations in batches and times the queuing apart from the flush, so
+ * the overhead of the JTAG core can be told from the adapter round trips.
+ *
+ * The JTAG workloads use plain scans, which do not depend on the TAPs
+ * declared; the data scanned out is discarded. Against a loopback
+ * simulator (testing/benchmark) they measure the whole path, against
+ * the dummy driver mostly the core.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/command.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <transport/transport.h>
+
+#include "adapter.h"
+#include "benchmark.h"
+#include "jtag.h"
+#include "commands.h"
+#include "interface.h"
+#include "swd.h"
+
+/* JTAG-DP instruction and DP registers used by the DAP workload */
+#define BENCH_JTAG_DP_APACC	0x0b
+#define BENCH_JTAG_DP_IR_LEN	4
+#define BENCH_JTAG_DP_DR_LEN	35
+#define BENCH_DP_SELECT		0x08
+#define BENCH_DP_RDBUFF		0x0c
+
+extern struct adapter_driver *adapter_driver;
+
+enum bench_workload {
+	BENCH_SCAN_STORM,
+	BENCH_LONG_DR,
+	BENCH_DAP_BURST,
+	BENCH_FLASH_STREAM,
+};
+
+struct bench_workload_desc {
+	const char *name;
+	/* defaults: operations queued, bits per operation, operations per flush */
+	uint32_t count;
+	uint32_t size;
+	uint32_t batch;
+	bool swd;
+};
+
+static const struct bench_workload_desc bench_workloads[] = {
+	/* an IR scan followed by a short DR scan, like register accesses */
+	[BENCH_SCAN_STORM] = { "scan_storm", 10000, 32, 100, false },
+	/* few very long DR scans, like boundary scan or bulk shifts */
+	[BENCH_LONG_DR] = { "long_dr", 16, 65536, 1, false },
+	/* JTAG-DP APACC scans, or SWD DP register accesses */
+	[BENCH_DAP_BURST] = { "dap_burst", 10000, BENCH_JTAG_DP_DR_LEN, 256, true },
+	/* a stream of output only words with an idle cycle in between, like
+	 * a flash loader fed through a data register */
+	[BENCH_FLASH_STREAM] = { "flash_stream", 16384, 32, 1024, false },
+};
+
+struct bench_result {
+	uint32_t operations;
+	uint32_t flushes;
+	uint64_t bits;
+	double queue_s;
+	double flush_s;
+	struct cmd_queue_alloc_stats allocs;
+	int status;
+};
+
+static int bench_flush(struct bench_result *result)
+{
+	struct duration flush;
+	int retval;
+
+	duration_start(&flush);
+	if (transport_is_swd())
+		retval = adapter_driver->swd_ops->run();
+	else
+		retval = jtag_execute_queue();
+	duration_measure(&flush);
+
+	result->flush_s += duration_elapsed(&flush);
+	result->flushes++;
+	if (retval != ERROR_OK && result->status == ERROR_OK)
+		result->status = retval;
+	return retval;
+}
+
+static void bench_queue_one(enum bench_workload workload, uint32_t i, uint32_t size,
+		uint8_t *out, uint8_t *in, struct bench_result *result)
+{
+	static const uint8_t apacc[] = { BENCH_JTAG_DP_APACC };
+	const struct swd_driver *swd;
+
+	switch (workload) {
+	case BENCH_SCAN_STORM:
+		jtag_add_plain_ir_scan(BENCH_JTAG_DP_IR_LEN, apacc, NULL, TAP_IDLE);
+		jtag_add_plain_dr_scan(size, out, in, TAP_IDLE);
+		result->bits += BENCH_JTAG_DP_IR_LEN + size;
+		break;
+	case BENCH_LONG_DR:
+		jtag_add_plain_dr_scan(size, out, in, TAP_IDLE);
+		result->bits += size;
+		break;
+	case BENCH_DAP_BURST:
+		if (transport_is_swd()) {
+			/* alternate writes and reads without side effects */
+			swd = adapter_driver->swd_ops;
+			if (i % 2)
+				swd->read_reg(swd_cmd(true, false, BENCH_DP_RDBUFF), (uint32_t *)in, 0);
+			else
+				swd->write_reg(swd_cmd(false, false, BENCH_DP_SELECT), 0, 0);
+			result->bits += 46;
+		} else {
+			if (i == 0)
+				jtag_add_plain_ir_scan(BENCH_JTAG_DP_IR_LEN, apacc, NULL, TAP_IDLE);
+			jtag_add_plain_dr_scan(BENCH_JTAG_DP_DR_LEN, out, in, TAP_IDLE);
+			result->bits += BENCH_JTAG_DP_DR_LEN;
+		}
+		break;
+	case BENCH_FLASH_STREAM:
+		jtag_add_plain_dr_scan(size, out, NULL, TAP_IDLE);
+		jtag_add_runtest(1, TAP_IDLE);
+		result->bits += size + 1;
+		break;
+	}
+	result->operations++;
+}
+
+static int bench_run(enum bench_workload workload, uint32_t count, uint32_t size,
+		uint32_t batch, struct bench_result *result)
+{
+	struct cmd_queue_alloc_stats before, after;
+	struct duration queue;
+	uint8_t *out, *in;
+	int retval = ERROR_OK;
+
+	memset(result, 0, sizeof(*result));
+	out = malloc(DIV_ROUND_UP(size, 8) + 4);
+	/* the swd workload reads 32 bit words */
+	in = malloc(MAX(DIV_ROUND_UP(size, 8), 4));
+	if (!out || !in) {
+		LOG_ERROR("Out of memory");
+		free(out);
+		free(in);
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < DIV_ROUND_UP(size, 8); i++)
+		out[i] = 0xa5 ^ i;
+
+	cmd_queue_get_alloc_stats(&before);
+
+	for (uint32_t done = 0; done < count && retval == ERROR_OK; ) {
+		uint32_t n = MIN(batch, count - done);
+
+		duration_start(&queue);
+		for (uint32_t i = 0; i < n; i++)
+			bench_queue_one(workload, done + i, size, out, in, result);
+		duration_measure(&queue);
+		result->queue_s += duration_elapsed(&queue);
+		done += n;
+
+		retval = bench_flush(result);
+		keep_alive();
+	}
+
+	cmd_queue_get_alloc_stats(&after);
+	result->allocs.allocs = after.allocs - before.allocs;
+	result->allocs.bytes = after.bytes - before.bytes;
+	result->allocs.pages = after.pages - before.pages;
+
+	free(out);
+	free(in);
+	return retval;
+}
+
+static void bench_print(struct command_invocation *cmd, const char *name,
+		const struct bench_result *result)
+{
+	double total_s = result->queue_s + result->flush_s;
+	double bytes_per_sec = total_s > 0 ? result->bits / 8.0 / total_s : 0;
+	double ops_per_sec = total_s > 0 ? result->operations / total_s : 0;
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "workload           %s", name);
+	command_print(CMD, "adapter            %s", adapter_driver->name);
+	command_print(CMD, "transport          %s", get_current_transport()->name);
+	command_print(CMD, "speed_khz          %u", adapter_get_speed_khz());
+	command_print(CMD, "operations         %" PRIu32, result->operations);
+	command_print(CMD, "flushes            %" PRIu32, result->flushes);
+	command_print(CMD, "bits               %" PRIu64, result->bits);
+	command_print(CMD, "queue_ms           %.3f", result->queue_s * 1000.0);
+	command_print(CMD, "flush_ms           %.3f", result->flush_s * 1000.0);
+	command_print(CMD, "bytes_per_sec      %.0f", bytes_per_sec);
+	command_print(CMD, "ops_per_sec        %.0f", ops_per_sec);
+	command_print(CMD, "queue_allocs       %" PRIu64, result->allocs.allocs);
+	command_print(CMD, "queue_alloc_bytes  %" PRIu64, result->allocs.bytes);
+	command_print(CMD, "queue_pages        %" PRIu64, result->allocs.pages);
+	command_print(CMD, "status             %d", result->status);
+}
+
+COMMAND_HANDLER(handle_adapter_benchmark_command)
+{
+	const struct bench_workload_desc *desc = NULL;
+	enum bench_workload workload = 0;
+
+	if (CMD_ARGC == 0) {
+		for (unsigned int i = 0; i < ARRAY_SIZE(bench_workloads); i++)
+			command_print(CMD, "%-14s count %-6" PRIu32 " size %-6" PRIu32
+					" batch %-5" PRIu32 "%s", bench_workloads[i].name,
+					bench_workloads[i].count, bench_workloads[i].size,
+					bench_workloads[i].batch, bench_workloads[i].swd ? " (jtag, swd)" : " (jtag)");
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(bench_workloads); i++) {
+		if (!strcmp(CMD_ARGV[0], bench_workloads[i].name)) {
+			desc = &bench_workloads[i];
+			workload = i;
+		}
+	}
+	if (!desc) {
+		command_print(CMD, "unknown workload '%s'", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	uint32_t count = desc->count;
+	uint32_t size = desc->size;
+	uint32_t batch = desc->batch;
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], count);
+	if (CMD_ARGC > 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], size);
+	if (CMD_ARGC > 3)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], batch);
+	if (size == 0 || size > 1024 * 1024 || batch == 0) {
+		command_print(CMD, "size must be 1 to 1048576 bits, batch at least 1");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!is_adapter_initialized()) {
+		command_print(CMD, "adapter is not initialized");
+		return ERROR_FAIL;
+	}
+	if (transport_is_swd()) {
+		if (!desc->swd) {
+			command_print(CMD, "workload '%s' needs the jtag transport", desc->name);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	} else if (!transport_is_jtag()) {
+		command_print(CMD, "benchmarks need the jtag or swd transport");
+		return ERROR_FAIL;
+	}
+
+	struct bench_result result;
+	int retval = bench_run(workload, count, size, batch, &result);
+	if (retval != ERROR_OK && result.operations == 0)
+		return retval;
+
+	/* a failing adapter still reports how far it went */
+	bench_print(CMD, desc->name, &result);
+	return ERROR_OK;
+}
+
+const struct command_registration adapter_benchmark_command_handlers[] = {
+	{
+		.name = "benchmark",
+		.handler = handle_adapter_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.help = "Run a synthetic workload on the adapter and report "
+			"queue build time, flush time, throughput and allocations. "
+			"Without argument, list the workloads.",
+		.usage = "[workload [count [size [batch]]]]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
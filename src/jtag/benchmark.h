@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_JTAG_BENCHMARK_H
+#define OPENOCD_JTAG_BENCHMARK_H
+
+#include <helper/command.h>
+
+extern const struct command_registration adapter_benchmark_command_handlers[];
+
+#endif /* OPENOCD_JTAG_BENCHMARK_H */
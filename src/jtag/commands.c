@@ -32,6 +32,7 @@ struct cmd_queue_page {
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
 static struct cmd_queue_page *cmd_queue_pages;
 static struct cmd_queue_page *cmd_queue_pages_tail;
+static struct cmd_queue_alloc_stats cmd_queue_alloc_stats;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -101,6 +102,9 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
+	cmd_queue_alloc_stats.allocs++;
+	cmd_queue_alloc_stats.bytes += size;
+
 	if (*p_page) {
 		p_page = &cmd_queue_pages_tail;
 		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
@@ -115,6 +119,7 @@ void *cmd_queue_alloc(size_t size)
 		(*p_page)->address = malloc(alloc_size);
 		(*p_page)->next = NULL;
 		cmd_queue_pages_tail = *p_page;
+		cmd_queue_alloc_stats.pages++;
 	}
 
 	offset = (*p_page)->used;
@@ -124,6 +129,11 @@ void *cmd_queue_alloc(size_t size)
 	return t + offset;
 }
 
+void cmd_queue_get_alloc_stats(struct cmd_queue_alloc_stats *stats)
+{
+	*stats = cmd_queue_alloc_stats;
+}
+
 static void cmd_queue_free(void)
 {
 	struct cmd_queue_page *page = cmd_queue_pages;
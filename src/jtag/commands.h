@@ -152,7 +152,18 @@ struct jtag_command {
 /** The current queue of jtag_command_s structures. */
 extern struct jtag_command *jtag_command_queue;
 
+/** Allocations made for the command queue since startup. */
+struct cmd_queue_alloc_stats {
+	/* cmd_queue_alloc() calls and the bytes they returned */
+	uint64_t allocs;
+	uint64_t bytes;
+	/* pages taken from the heap, each one malloc() for the page and one
+	 * for its storage */
+	uint64_t pages;
+};
+
 void *cmd_queue_alloc(size_t size);
+void cmd_queue_get_alloc_stats(struct cmd_queue_alloc_stats *stats);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
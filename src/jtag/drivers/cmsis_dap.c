@@ -37,7 +37,11 @@
 #include <target/cortex_m.h>
 
 #include "cmsis_dap.h"
+#if BUILD_CMSIS_DAP_USB == 1
 #include "libusb_helper.h"
+#else
+#define LIBUSB_TIMEOUT_MS	(6000)
+#endif
 
 static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
 #if BUILD_CMSIS_DAP_USB == 1
@@ -47,6 +51,10 @@ static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
 #if BUILD_CMSIS_DAP_HID == 1
 	&cmsis_dap_hid_backend,
 #endif
+
+#if BUILD_CMSIS_DAP_TCP == 1
+	&cmsis_dap_tcp_backend,
+#endif
 };
 
 /* USB Config */
@@ -1217,6 +1225,7 @@ static int cmsis_dap_init(void)
 			pending_queue_len = (pkt_sz - 4) / 5;
 
 			free(cmsis_dap_handle->packet_buffer);
+			cmsis_dap_handle->packet_buffer = NULL;
 			retval = cmsis_dap_handle->backend->packet_buffer_alloc(cmsis_dap_handle, pkt_sz);
 			if (retval != ERROR_OK)
 				goto init_err;
@@ -2103,8 +2112,8 @@ static const struct command_registration cmsis_dap_command_handlers[] = {
 		.name = "cmsis_dap_backend",
 		.handler = &cmsis_dap_handle_backend_command,
 		.mode = COMMAND_CONFIG,
-		.help = "set the communication backend to use (USB bulk or HID).",
-		.usage = "(auto | usb_bulk | hid)",
+		.help = "set the communication backend to use (USB bulk, HID or TCP).",
+		.usage = "(auto | usb_bulk | hid | tcp)",
 	},
 #if BUILD_CMSIS_DAP_USB
 	{
@@ -2114,6 +2123,15 @@ static const struct command_registration cmsis_dap_command_handlers[] = {
 		.help = "USB bulk backend-specific commands",
 		.usage = "<cmd>",
 	},
+#endif
+#if BUILD_CMSIS_DAP_TCP
+	{
+		.name = "cmsis_dap_tcp",
+		.chain = cmsis_dap_tcp_subcommand_handlers,
+		.mode = COMMAND_ANY,
+		.help = "TCP backend-specific commands",
+		.usage = "<cmd>",
+	},
 #endif
 	COMMAND_REGISTRATION_DONE
 };
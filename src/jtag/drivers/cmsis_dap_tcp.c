@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   CMSIS-DAP backend talking to a software DAP over a TCP/Unix socket.   *
+ *                                                                         *
+ *   Intended for offline testing and benchmarking of the cmsis_dap        *
+ *   driver against a responder such as contrib/cmsis_dap_sim.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#endif
+#include <string.h>
+#include "helper/system.h"
+#include "helper/replacements.h"
+#include <helper/command.h>
+#include <helper/log.h>
+#include <helper/types.h>
+
+#include "cmsis_dap.h"
+
+/*
+ * Each CMSIS-DAP packet is carried in a frame made of this 8 byte
+ * little-endian header followed by the packet payload:
+ *  - 4 bytes signature "DAP\0"
+ *  - 2 bytes payload length
+ *  - 1 byte  frame type (request or response)
+ *  - 1 byte  reserved, must be zero
+ */
+#define CMSIS_DAP_TCP_SIGNATURE		0x00504144
+#define CMSIS_DAP_TCP_HEADER_SIZE	8
+#define CMSIS_DAP_TCP_TYPE_REQUEST	0x01
+#define CMSIS_DAP_TCP_TYPE_RESPONSE	0x02
+
+/* packet size used until the responder reports its own one */
+#define CMSIS_DAP_TCP_DEFAULT_PACKET_SIZE	1024
+
+static char *cmsis_dap_tcp_host;
+static char *cmsis_dap_tcp_port;
+
+struct cmsis_dap_backend_data {
+	int fd;
+	/* header + request, sent with a single syscall */
+	uint8_t *tx_frame;
+};
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap);
+
+static int cmsis_dap_tcp_connect_tcp(void)
+{
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *result, *rp;
+	int fd = -1;
+
+	LOG_INFO("CMSIS-DAP: connecting to %s:%s",
+			cmsis_dap_tcp_host ? cmsis_dap_tcp_host : "localhost",
+			cmsis_dap_tcp_port);
+
+	int s = getaddrinfo(cmsis_dap_tcp_host, cmsis_dap_tcp_port, &hints, &result);
+	if (s != 0) {
+		LOG_ERROR("getaddrinfo: %s", gai_strerror(s));
+		return ERROR_FAIL;
+	}
+
+	for (rp = result; rp; rp = rp->ai_next) {
+		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (fd == -1)
+			continue;
+
+		if (connect(fd, rp->ai_addr, rp->ai_addrlen) != -1)
+			break;
+
+		close_socket(fd);
+	}
+
+	freeaddrinfo(result);
+
+	if (!rp) {
+		log_socket_error("CMSIS-DAP: failed to connect");
+		return ERROR_FAIL;
+	}
+
+	/* every packet is a complete request, get it on the wire at once */
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+
+	return fd;
+}
+
+static int cmsis_dap_tcp_connect_unix(void)
+{
+#ifdef _WIN32
+	LOG_ERROR("CMSIS-DAP: unix sockets are not supported on this host");
+	return ERROR_FAIL;
+#else
+	if (!cmsis_dap_tcp_host) {
+		LOG_ERROR("CMSIS-DAP: host/socket not specified");
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("CMSIS-DAP: connecting to unix socket %s", cmsis_dap_tcp_host);
+	int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		log_socket_error("socket");
+		return ERROR_FAIL;
+	}
+
+	struct sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, cmsis_dap_tcp_host, sizeof(addr.sun_path));
+	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
+		log_socket_error("connect");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+
+	return fd;
+#endif
+}
+
+static int cmsis_dap_tcp_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial)
+{
+	/* the responder is selected by host/port, USB ids and serial do not apply */
+	if (!cmsis_dap_tcp_host && !cmsis_dap_tcp_port) {
+		LOG_ERROR("CMSIS-DAP: no responder for the tcp backend, set 'cmsis_dap_tcp port' "
+				"(TCP, host defaults to localhost) or 'cmsis_dap_tcp host' (unix socket)");
+		return ERROR_FAIL;
+	}
+
+	int fd;
+	if (cmsis_dap_tcp_port)
+		fd = cmsis_dap_tcp_connect_tcp();
+	else
+		fd = cmsis_dap_tcp_connect_unix();
+
+	if (fd < 0)
+		return ERROR_FAIL;
+
+	socket_block(fd);
+
+	dap->bdata = malloc(sizeof(struct cmsis_dap_backend_data));
+	if (!dap->bdata) {
+		LOG_ERROR("unable to allocate memory");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+	dap->bdata->fd = fd;
+	dap->bdata->tx_frame = NULL;
+
+	int retval = cmsis_dap_tcp_alloc(dap, CMSIS_DAP_TCP_DEFAULT_PACKET_SIZE);
+	if (retval != ERROR_OK) {
+		cmsis_dap_tcp_close(dap);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap)
+{
+	if (close_socket(dap->bdata->fd) != 0)
+		log_socket_error("close_socket");
+	free(dap->bdata->tx_frame);
+	free(dap->bdata);
+	dap->bdata = NULL;
+	free(dap->packet_buffer);
+	dap->packet_buffer = NULL;
+}
+
+/**
+ * Wait until the socket becomes readable.
+ * @returns ERROR_OK, ERROR_TIMEOUT_REACHED or ERROR_FAIL
+ */
+static int cmsis_dap_tcp_wait_readable(int fd, int timeout_ms)
+{
+	fd_set rfds;
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = (timeout_ms % 1000) * 1000,
+	};
+
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+
+	int retval = socket_select(fd + 1, &rfds, NULL, NULL, &tv);
+	if (retval == 0)
+		return ERROR_TIMEOUT_REACHED;
+	if (retval < 0) {
+		log_socket_error("select");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_recv_all(int fd, uint8_t *buf, unsigned int len)
+{
+	unsigned int done = 0;
+
+	while (done < len) {
+		int count = read_socket(fd, buf + done, len - done);
+		if (count == 0) {
+			LOG_ERROR("CMSIS-DAP: connection closed by peer");
+			return ERROR_FAIL;
+		}
+		if (count < 0) {
+			log_socket_error("CMSIS-DAP read");
+			return ERROR_FAIL;
+		}
+		done += count;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_read(struct cmsis_dap *dap, int timeout_ms)
+{
+	int fd = dap->bdata->fd;
+	uint8_t header[CMSIS_DAP_TCP_HEADER_SIZE];
+
+	int retval = cmsis_dap_tcp_wait_readable(fd, timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* once a frame has started the rest of it follows right away */
+	retval = cmsis_dap_tcp_recv_all(fd, header, sizeof(header));
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t signature = le_to_h_u32(&header[0]);
+	unsigned int len = le_to_h_u16(&header[4]);
+	if (signature != CMSIS_DAP_TCP_SIGNATURE || header[6] != CMSIS_DAP_TCP_TYPE_RESPONSE) {
+		LOG_ERROR("CMSIS-DAP: invalid frame header received");
+		return ERROR_FAIL;
+	}
+
+	if (len > dap->packet_buffer_size) {
+		LOG_ERROR("CMSIS-DAP: response of %u bytes exceeds packet size %" PRIu16,
+			len, dap->packet_buffer_size);
+		return ERROR_FAIL;
+	}
+
+	retval = cmsis_dap_tcp_recv_all(fd, dap->packet_buffer, len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* CMSIS-DAP response parsers may look past short replies */
+	memset(dap->packet_buffer + len, 0, dap->packet_buffer_size - len);
+
+	return len;
+}
+
+static int cmsis_dap_tcp_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+{
+	(void) timeout_ms;
+
+	uint8_t *frame = dap->bdata->tx_frame;
+	h_u32_to_le(&frame[0], CMSIS_DAP_TCP_SIGNATURE);
+	h_u16_to_le(&frame[4], txlen);
+	frame[6] = CMSIS_DAP_TCP_TYPE_REQUEST;
+	frame[7] = 0;
+	memcpy(frame + CMSIS_DAP_TCP_HEADER_SIZE, dap->command, txlen);
+
+	unsigned int len = txlen + CMSIS_DAP_TCP_HEADER_SIZE;
+	unsigned int done = 0;
+	while (done < len) {
+		int count = write_socket(dap->bdata->fd, frame + done, len - done);
+		if (count <= 0) {
+			log_socket_error("CMSIS-DAP write");
+			return ERROR_FAIL;
+		}
+		done += count;
+	}
+
+	return txlen;
+}
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
+{
+	uint8_t *frame = realloc(dap->bdata->tx_frame, pkt_sz + CMSIS_DAP_TCP_HEADER_SIZE);
+	if (!frame) {
+		LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+		return ERROR_FAIL;
+	}
+	/* the old frame is gone, keep the new one for cmsis_dap_tcp_close() */
+	dap->bdata->tx_frame = frame;
+
+	uint8_t *buf = malloc(pkt_sz);
+	if (!buf) {
+		LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+		return ERROR_FAIL;
+	}
+
+	dap->packet_buffer = buf;
+	dap->packet_size = pkt_sz;
+	dap->packet_buffer_size = pkt_sz;
+
+	dap->command = dap->packet_buffer;
+	dap->response = dap->packet_buffer;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_port_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint16_t port;
+	COMMAND_PARSE_NUMBER(u16, CMD_ARGV[0], port);
+	free(cmsis_dap_tcp_port);
+	cmsis_dap_tcp_port = port == 0 ? NULL : strdup(CMD_ARGV[0]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_host_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(cmsis_dap_tcp_host);
+	cmsis_dap_tcp_host = strdup(CMD_ARGV[0]);
+
+	return ERROR_OK;
+}
+
+const struct command_registration cmsis_dap_tcp_subcommand_handlers[] = {
+	{
+		.name = "port",
+		.handler = &cmsis_dap_handle_tcp_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the TCP port of the CMSIS-DAP responder.\n"
+			"  if 0 or unset, host is the path of a unix socket.",
+		.usage = "port_number",
+	},
+	{
+		.name = "host",
+		.handler = &cmsis_dap_handle_tcp_host_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the host name (or unix socket path) of the CMSIS-DAP responder",
+		.usage = "host_name",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp",
+	.open = cmsis_dap_tcp_open,
+	.close = cmsis_dap_tcp_close,
+	.read = cmsis_dap_tcp_read,
+	.write = cmsis_dap_tcp_write,
+	.packet_buffer_alloc = cmsis_dap_tcp_alloc,
+};
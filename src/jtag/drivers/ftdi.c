@@ -81,6 +81,7 @@
 static char *ftdi_device_desc;
 static uint8_t ftdi_channel;
 static uint8_t ftdi_jtag_mode = JTAG_MODE;
+static unsigned int ftdi_pipeline_depth = 1;
 
 static bool swd_mode;
 
@@ -668,6 +669,9 @@ static int ftdi_initialize(void)
 	if (!mpsse_ctx)
 		return ERROR_JTAG_INIT_FAILED;
 
+	if (mpsse_set_pipeline_depth(mpsse_ctx, ftdi_pipeline_depth) != ERROR_OK)
+		return ERROR_JTAG_INIT_FAILED;
+
 	output = jtag_output_init;
 	direction = jtag_direction_init;
 
@@ -922,6 +926,69 @@ COMMAND_HANDLER(ftdi_handle_tdo_sample_edge_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(ftdi_handle_pipeline_depth_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int depth;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], depth);
+		if (depth < 1 || depth > 8) {
+			command_print(CMD, "pipeline depth must be from 1 to 8");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		if (mpsse_ctx) {
+			int retval = mpsse_set_pipeline_depth(mpsse_ctx, depth);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		ftdi_pipeline_depth = depth;
+	}
+
+	command_print(CMD, "ftdi pipeline depth %u", ftdi_pipeline_depth);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(ftdi_handle_stats_command)
+{
+	struct mpsse_stats stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!mpsse_ctx) {
+		command_print(CMD, "ftdi device is not open");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		mpsse_reset_stats(mpsse_ctx);
+		return ERROR_OK;
+	}
+
+	mpsse_get_stats(mpsse_ctx, &stats);
+	double fill = stats.buffers ?
+		100.0 * stats.bytes_written / stats.buffers / stats.buffer_size : 0;
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "pipeline_depth     %u", mpsse_get_pipeline_depth(mpsse_ctx));
+	command_print(CMD, "buffer_size        %u", stats.buffer_size);
+	command_print(CMD, "buffers            %" PRIu64, stats.buffers);
+	command_print(CMD, "bytes_written      %" PRIu64, stats.bytes_written);
+	command_print(CMD, "bytes_read         %" PRIu64, stats.bytes_read);
+	command_print(CMD, "avg_fill_percent   %.1f", fill);
+	command_print(CMD, "round_trips        %" PRIu64, stats.round_trips);
+	command_print(CMD, "stalls             %" PRIu64, stats.stalls);
+	command_print(CMD, "stall_ms           %.3f", stats.stall_s * 1000.0);
+	command_print(CMD, "max_in_flight      %u", stats.max_in_flight);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration ftdi_subcommand_handlers[] = {
 	{
 		.name = "device_desc",
@@ -983,6 +1050,21 @@ static const struct command_registration ftdi_subcommand_handlers[] = {
 			"allow signalling speed increase)",
 		.usage = "(rising|falling)",
 	},
+	{
+		.name = "pipeline_depth",
+		.handler = &ftdi_handle_pipeline_depth_command,
+		.mode = COMMAND_ANY,
+		.help = "set how many command buffers may be on the USB bus at once, "
+			"1 waits for each buffer before filling the next one",
+		.usage = "[(1-8)]",
+	},
+	{
+		.name = "stats",
+		.handler = &ftdi_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset USB transfer statistics",
+		.usage = "['reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -27,6 +27,29 @@
 #define SERVER_ADDRESS	"127.0.0.1"
 #define SERVER_PORT	5555
 
+/*
+ * Binary mode, selected by answering "version\n" with "version 2 <max>\n",
+ * where max is the largest batch the server accepts in bytes.
+ *
+ * A batch is announced by the line "bb <length> <records>\n", followed by
+ * the records: op, flags, two reserved bytes, number of bits as u32
+ * little-endian and, for scans, the TDI bytes. The reply is the length of
+ * the TDO data as u32 little-endian, then the TDO bytes of the records with
+ * DPI_RECORD_CAPTURE, in order.
+ */
+#define DPI_MODE_TEXT		1
+#define DPI_MODE_BINARY		2
+
+#define DPI_OP_RESET		0
+#define DPI_OP_IR_SCAN		1
+#define DPI_OP_DR_SCAN		2
+/* clock TCK in Run-Test/Idle, number of cycles in the bits field */
+#define DPI_OP_IDLE_CLOCKS	3
+
+#define DPI_RECORD_CAPTURE	0x01
+#define DPI_RECORD_HEADER_SIZE	8
+#define DPI_BATCH_MAX_SIZE	(1024 * 1024)
+
 static uint16_t server_port = SERVER_PORT;
 static char *server_address;
 
@@ -34,8 +57,31 @@ static int sockfd;
 static struct sockaddr_in serv_addr;
 
 static uint8_t *last_ir_buf;
+static int last_ir_buf_size;
 static int last_ir_num_bits;
 
+static int mode_setting = DPI_MODE_TEXT;
+static int mode = DPI_MODE_TEXT;
+
+/* scan to complete once the batch it is in has been answered */
+struct dpi_batch_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct {
+	uint8_t *buf;
+	size_t len;
+	size_t size;
+	size_t max;
+	uint32_t records;
+	size_t read_bytes;
+
+	struct dpi_batch_scan *scans;
+	unsigned int num_scans;
+	unsigned int scans_size;
+} batch;
+
 static int write_sock(char *buf, size_t len)
 {
 	if (!buf) {
@@ -66,6 +112,229 @@ static int read_sock(char *buf, size_t len)
 	return ERROR_OK;
 }
 
+static int write_sock_all(const uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = write(sockfd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			LOG_ERROR("%s: %s", __func__, n < 0 ? strerror(errno) : "connection closed");
+			return ERROR_FAIL;
+		}
+		buf += n;
+		len -= n;
+	}
+	return ERROR_OK;
+}
+
+static int read_sock_all(uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = read(sockfd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			LOG_ERROR("%s: %s", __func__, n < 0 ? strerror(errno) : "connection closed");
+			return ERROR_FAIL;
+		}
+		buf += n;
+		len -= n;
+	}
+	return ERROR_OK;
+}
+
+static void jtag_dpi_batch_discard(void)
+{
+	for (unsigned int i = 0; i < batch.num_scans; i++)
+		free(batch.scans[i].buf);
+
+	batch.len = 0;
+	batch.records = 0;
+	batch.read_bytes = 0;
+	batch.num_scans = 0;
+}
+
+/**
+ * jtag_dpi_batch_flush - send the batched commands and complete their scans
+ */
+static int jtag_dpi_batch_flush(void)
+{
+	char header[40];
+	uint8_t length[4];
+	int ret;
+
+	if (batch.records == 0)
+		return ERROR_OK;
+
+	LOG_DEBUG_IO("sending DPI batch: %" PRIu32 " commands, %zu bytes, expecting %zu",
+			batch.records, batch.len, batch.read_bytes);
+
+	snprintf(header, sizeof(header), "bb %zu %" PRIu32 "\n", batch.len, batch.records);
+	ret = write_sock_all((uint8_t *)header, strlen(header));
+	if (ret == ERROR_OK)
+		ret = write_sock_all(batch.buf, batch.len);
+	if (ret == ERROR_OK)
+		ret = read_sock_all(length, sizeof(length));
+	if (ret == ERROR_OK && le_to_h_u32(length) != batch.read_bytes) {
+		LOG_ERROR("DPI batch reply of %" PRIu32 " bytes, expected %zu",
+				le_to_h_u32(length), batch.read_bytes);
+		ret = ERROR_FAIL;
+	}
+
+	/* TDO data comes in the order of the scans, each as long as its buffer */
+	for (unsigned int i = 0; i < batch.num_scans && ret == ERROR_OK; i++) {
+		struct dpi_batch_scan *scan = &batch.scans[i];
+		ret = read_sock_all(scan->buf, DIV_ROUND_UP(jtag_scan_size(scan->cmd), 8));
+		if (ret == ERROR_OK)
+			ret = jtag_read_buffer(scan->buf, scan->cmd);
+	}
+
+	jtag_dpi_batch_discard();
+	return ret;
+}
+
+/**
+ * jtag_dpi_batch_add - append a command to the batch
+ * @param op one of DPI_OP_xxx
+ * @param bits TDI bits of a scan, NULL for other commands
+ * @param nb_bits number of bits, or of clock cycles
+ * @param capture whether the TDO data of the scan is expected
+ */
+static int jtag_dpi_batch_add(uint8_t op, const uint8_t *bits, uint32_t nb_bits, bool capture)
+{
+	size_t nb_bytes = bits ? DIV_ROUND_UP(nb_bits, 8) : 0;
+	size_t need = DPI_RECORD_HEADER_SIZE + nb_bytes;
+
+	/* jtag_dpi_scan() sends the scans that don't fit in a batch alone */
+	assert(need <= batch.max);
+
+	if (batch.len + need > batch.max) {
+		int ret = jtag_dpi_batch_flush();
+		if (ret != ERROR_OK)
+			return ret;
+	}
+
+	if (batch.len + need > batch.size) {
+		size_t size = MAX(batch.size * 2, batch.len + need);
+		uint8_t *buf = realloc(batch.buf, size);
+		if (!buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		batch.buf = buf;
+		batch.size = size;
+	}
+
+	uint8_t *record = batch.buf + batch.len;
+	record[0] = op;
+	record[1] = capture ? DPI_RECORD_CAPTURE : 0;
+	record[2] = 0;
+	record[3] = 0;
+	h_u32_to_le(record + 4, nb_bits);
+	if (nb_bytes)
+		memcpy(record + DPI_RECORD_HEADER_SIZE, bits, nb_bytes);
+
+	batch.len += need;
+	batch.records++;
+	if (capture)
+		batch.read_bytes += nb_bytes;
+
+	return ERROR_OK;
+}
+
+/* Queue a scan in the batch; takes ownership of @a buf */
+static int jtag_dpi_batch_scan(struct scan_command *cmd, uint8_t *buf, int num_bits)
+{
+	if (batch.num_scans == batch.scans_size) {
+		unsigned int n = MAX(batch.scans_size * 2, 16);
+		struct dpi_batch_scan *scans = realloc(batch.scans, n * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Out of memory");
+			free(buf);
+			return ERROR_FAIL;
+		}
+		batch.scans = scans;
+		batch.scans_size = n;
+	}
+
+	int ret = jtag_dpi_batch_add(cmd->ir_scan ? DPI_OP_IR_SCAN : DPI_OP_DR_SCAN,
+			buf, num_bits, true);
+	if (ret != ERROR_OK) {
+		free(buf);
+		return ret;
+	}
+
+	batch.scans[batch.num_scans].cmd = cmd;
+	batch.scans[batch.num_scans].buf = buf;
+	batch.num_scans++;
+
+	return ERROR_OK;
+}
+
+/* Read a line of at most @a size - 1 characters */
+static int read_line(char *line, size_t size)
+{
+	size_t len = 0;
+
+	while (len < size - 1) {
+		if (read_sock_all((uint8_t *)line + len, 1) != ERROR_OK)
+			return ERROR_FAIL;
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = 0;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_dpi_negotiate - select the text or binary protocol
+ *
+ * Servers that only know the text protocol don't answer the version query,
+ * so it is only sent when the binary protocol has been selected.
+ */
+static int jtag_dpi_negotiate(void)
+{
+	const char *query = "version\n";
+	char line[64];
+	unsigned int version, max;
+
+	mode = DPI_MODE_TEXT;
+	if (mode_setting == DPI_MODE_TEXT)
+		return ERROR_OK;
+
+	int ret = write_sock_all((const uint8_t *)query, strlen(query));
+	if (ret != ERROR_OK)
+		return ret;
+
+	ret = read_line(line, sizeof(line));
+	if (ret != ERROR_OK)
+		return ret;
+
+	if (sscanf(line, "version %u %u", &version, &max) != 2) {
+		LOG_ERROR("unexpected answer '%s' to the DPI version query", line);
+		return ERROR_FAIL;
+	}
+
+	if (version < DPI_MODE_BINARY) {
+		LOG_ERROR("DPI server does not support the binary protocol");
+		return ERROR_FAIL;
+	}
+
+	mode = DPI_MODE_BINARY;
+	batch.max = max ? MIN(max, DPI_BATCH_MAX_SIZE) : DPI_BATCH_MAX_SIZE;
+	if (batch.max < DPI_RECORD_HEADER_SIZE) {
+		LOG_ERROR("DPI server batch size %zu is too small", batch.max);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("DPI server protocol version %u, using the %s protocol", version,
+			mode == DPI_MODE_BINARY ? "binary" : "text");
+	return ERROR_OK;
+}
+
 /**
  * jtag_dpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -78,7 +347,9 @@ static int jtag_dpi_reset(int trst, int srst)
 
 	LOG_DEBUG_IO("JTAG DRIVER DEBUG: reset trst: %i srst %i", trst, srst);
 
-	if (trst == 1) {
+	if (trst == 1 && mode == DPI_MODE_BINARY) {
+		ret = jtag_dpi_batch_add(DPI_OP_RESET, NULL, 0, false);
+	} else if (trst == 1) {
 		/* reset the JTAG TAP controller */
 		ret = write_sock(buf, strlen(buf));
 		if (ret != ERROR_OK) {
@@ -119,14 +390,28 @@ static int jtag_dpi_scan(struct scan_command *cmd)
 	}
 
 	bytes = DIV_ROUND_UP(num_bits, 8);
-	if (cmd->ir_scan) {
-		free(last_ir_buf);
-		last_ir_buf = (uint8_t *)malloc(bytes * sizeof(uint8_t));
-		if (!last_ir_buf) {
-			LOG_ERROR("%s: malloc fail, file %s, line %d",
-				__func__, __FILE__, __LINE__);
-			ret = ERROR_FAIL;
+	if (mode == DPI_MODE_BINARY) {
+		if (DPI_RECORD_HEADER_SIZE + (size_t)bytes <= batch.max)
+			return jtag_dpi_batch_scan(cmd, data_buf, num_bits);
+
+		/* too large for a batch: send it alone after the commands before */
+		ret = jtag_dpi_batch_flush();
+		if (ret != ERROR_OK)
 			goto out;
+	}
+
+	if (cmd->ir_scan) {
+		/* kept for runtest; the buffer only grows */
+		if (bytes > last_ir_buf_size) {
+			uint8_t *ir_buf = realloc(last_ir_buf, bytes);
+			if (!ir_buf) {
+				LOG_ERROR("%s: malloc fail, file %s, line %d",
+					__func__, __FILE__, __LINE__);
+				ret = ERROR_FAIL;
+				goto out;
+			}
+			last_ir_buf = ir_buf;
+			last_ir_buf_size = bytes;
 		}
 		memcpy(last_ir_buf, data_buf, bytes);
 		last_ir_num_bits = num_bits;
@@ -138,13 +423,13 @@ static int jtag_dpi_scan(struct scan_command *cmd)
 			__FILE__, __LINE__);
 		goto out;
 	}
-	ret = write_sock((char *)data_buf, bytes);
+	ret = write_sock_all(data_buf, bytes);
 	if (ret != ERROR_OK) {
 		LOG_ERROR("write_sock() fail, file %s, line %d",
 			__FILE__, __LINE__);
 		goto out;
 	}
-	ret = read_sock((char *)data_buf, bytes);
+	ret = read_sock_all(data_buf, bytes);
 	if (ret != ERROR_OK) {
 		LOG_ERROR("read_sock() fail, file %s, line %d",
 			__FILE__, __LINE__);
@@ -170,6 +455,9 @@ static int jtag_dpi_runtest(int cycles)
 	int num_bits = last_ir_num_bits, bytes;
 	int ret = ERROR_OK;
 
+	if (mode == DPI_MODE_BINARY)
+		return jtag_dpi_batch_add(DPI_OP_IDLE_CLOCKS, NULL, cycles, false);
+
 	if (!data_buf) {
 		LOG_ERROR("%s: NULL 'data_buf' argument, file %s, line %d",
 			__func__, __FILE__, __LINE__);
@@ -217,6 +505,15 @@ out:
 	return ret;
 }
 
+/* reset outside of the queue, done at once */
+static int jtag_dpi_adapter_reset(int trst, int srst)
+{
+	int ret = jtag_dpi_reset(trst, srst);
+	if (ret == ERROR_OK)
+		ret = jtag_dpi_batch_flush();
+	return ret;
+}
+
 static int jtag_dpi_stableclocks(int cycles)
 {
 	return jtag_dpi_runtest(cycles);
@@ -248,6 +545,8 @@ static int jtag_dpi_execute_queue(void)
 			/* unsupported */
 			break;
 		case JTAG_SLEEP:
+			/* sleep after the commands before have run */
+			ret = jtag_dpi_batch_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -261,6 +560,11 @@ static int jtag_dpi_execute_queue(void)
 		}
 	}
 
+	if (ret == ERROR_OK)
+		ret = jtag_dpi_batch_flush();
+	else
+		jtag_dpi_batch_discard();
+
 	return ret;
 }
 
@@ -309,7 +613,7 @@ static int jtag_dpi_init(void)
 
 	LOG_INFO("Connection to %s : %" PRIu16 " succeed", server_address, server_port);
 
-	return ERROR_OK;
+	return jtag_dpi_negotiate();
 }
 
 static int jtag_dpi_quit(void)
@@ -317,6 +621,14 @@ static int jtag_dpi_quit(void)
 	free(server_address);
 	server_address = NULL;
 
+	jtag_dpi_batch_discard();
+	free(batch.buf);
+	free(batch.scans);
+	memset(&batch, 0, sizeof(batch));
+	free(last_ir_buf);
+	last_ir_buf = NULL;
+	last_ir_buf_size = 0;
+
 	return close(sockfd);
 }
 
@@ -362,6 +674,30 @@ COMMAND_HANDLER(jtag_dpi_set_address)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_dpi_set_mode)
+{
+	static const char * const names[] = {
+		[DPI_MODE_TEXT] = "text",
+		[DPI_MODE_BINARY] = "binary",
+	};
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int i;
+		for (i = DPI_MODE_TEXT; i < ARRAY_SIZE(names); i++)
+			if (!strcmp(CMD_ARGV[0], names[i]))
+				break;
+		if (i == ARRAY_SIZE(names))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		mode_setting = i;
+	}
+
+	command_print(CMD, "jtag_dpi mode %s", names[mode_setting]);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_dpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -377,6 +713,14 @@ static const struct command_registration jtag_dpi_subcommand_handlers[] = {
 		.help = "set the address of the DPI server",
 		.usage = "[address]",
 	},
+	{
+		.name = "mode",
+		.handler = &jtag_dpi_set_mode,
+		.mode = COMMAND_CONFIG,
+		.help = "select the text protocol (default) or the binary "
+			"protocol that sends the commands of a JTAG queue in batches",
+		.usage = "[text|binary]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -402,6 +746,6 @@ struct adapter_driver jtag_dpi_adapter_driver = {
 	.commands = jtag_dpi_command_handlers,
 	.init = jtag_dpi_init,
 	.quit = jtag_dpi_quit,
-	.reset = jtag_dpi_reset,
+	.reset = jtag_dpi_adapter_reset,
 	.jtag_ops = &jtag_dpi_interface,
 };
@@ -37,6 +37,28 @@
 #define CMD_SCAN_CHAIN		2
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
+#define CMD_GET_VERSION		5
+#define CMD_BATCH		6
+
+/*
+ * Protocol version 2 adds CMD_GET_VERSION, answered with a vpi_cmd holding
+ * the version in length and the largest batch accepted in nb_bits, and
+ * CMD_BATCH. A batch is a variable length message: a header of cmd, length
+ * of the records that follow and number of records, all u32 little-endian,
+ * then the records. Each record is an op (CMD_RESET, CMD_TMS_SEQ,
+ * CMD_SCAN_CHAIN or CMD_SCAN_CHAIN_FLIP_TMS), a flags byte, two reserved
+ * bytes, the number of bits as u32 and the TDI or TMS bytes. The reply is
+ * a header of cmd and length, followed by the TDO bytes of the records with
+ * VPI_RECORD_CAPTURE, in order.
+ */
+#define VPI_PROTOCOL_LEGACY	1
+#define VPI_PROTOCOL_BATCH	2
+
+#define VPI_BATCH_MAX_SIZE	(1024 * 1024)
+#define VPI_BATCH_HEADER_SIZE	12
+#define VPI_REPLY_HEADER_SIZE	8
+#define VPI_RECORD_HEADER_SIZE	8
+#define VPI_RECORD_CAPTURE	0x01
 
 /* jtag_vpi server port and address to connect to */
 static int server_port = DEFAULT_SERVER_PORT;
@@ -45,6 +67,39 @@ static char *server_address;
 /* Send CMD_STOP_SIMU to server when OpenOCD exits? */
 static bool stop_sim_on_exit;
 
+static int protocol_version_setting = VPI_PROTOCOL_LEGACY;
+static int protocol_version = VPI_PROTOCOL_LEGACY;
+
+/* TDO data of a batch record, to be copied where the scan wants it */
+struct vpi_batch_read {
+	uint8_t *dest;
+	uint32_t bytes;
+};
+
+/* scan to complete once the batch it is in has been answered */
+struct vpi_batch_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct {
+	uint8_t *buf;
+	size_t len;
+	size_t size;
+	/* largest message the server accepts */
+	size_t max;
+	uint32_t records;
+
+	struct vpi_batch_read *reads;
+	unsigned int num_reads;
+	unsigned int reads_size;
+	size_t read_bytes;
+
+	struct vpi_batch_scan *scans;
+	unsigned int num_scans;
+	unsigned int scans_size;
+} batch;
+
 static int sockfd;
 static struct sockaddr_in serv_addr;
 
@@ -79,6 +134,10 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 		return "CMD_SCAN_CHAIN_FLIP_TMS";
 	case CMD_STOP_SIMU:
 		return "CMD_STOP_SIMU";
+	case CMD_GET_VERSION:
+		return "CMD_GET_VERSION";
+	case CMD_BATCH:
+		return "CMD_BATCH";
 	default:
 		return "<unknown>";
 	}
@@ -195,6 +254,249 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+static int jtag_vpi_write_buf(const uint8_t *buf, size_t len)
+{
+	while (len) {
+		int retval = write_socket(sockfd, buf, len);
+		if (retval < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			log_socket_error("jtag_vpi xmit");
+			return ERROR_FAIL;
+		}
+		buf += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+/* Read @a len bytes, blocking until all of them arrived. */
+static int jtag_vpi_read_buf(uint8_t *buf, size_t len)
+{
+	while (len) {
+		int retval = read_socket(sockfd, buf, len);
+		if (retval < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			log_socket_error("jtag_vpi recv");
+			return ERROR_FAIL;
+		} else if (retval == 0) {
+			LOG_ERROR("Connection prematurely closed by jtag_vpi server.");
+			return ERROR_FAIL;
+		}
+		buf += retval;
+		len -= retval;
+	}
+
+	return ERROR_OK;
+}
+
+static void jtag_vpi_batch_discard(void)
+{
+	for (unsigned int i = 0; i < batch.num_scans; i++)
+		free(batch.scans[i].buf);
+
+	batch.len = VPI_BATCH_HEADER_SIZE;
+	batch.records = 0;
+	batch.num_reads = 0;
+	batch.read_bytes = 0;
+	batch.num_scans = 0;
+}
+
+/**
+ * jtag_vpi_batch_flush - send the commands batched so far
+ *
+ * Sends the batch as one message, reads the TDO data of all of its scans
+ * from the reply and completes the scans.
+ */
+static int jtag_vpi_batch_flush(void)
+{
+	uint8_t header[VPI_REPLY_HEADER_SIZE];
+	int retval;
+
+	if (batch.records == 0)
+		return ERROR_OK;
+
+	h_u32_to_le(batch.buf, CMD_BATCH);
+	h_u32_to_le(batch.buf + 4, batch.len - VPI_BATCH_HEADER_SIZE);
+	h_u32_to_le(batch.buf + 8, batch.records);
+
+	LOG_DEBUG_IO("sending JTAG VPI batch: %" PRIu32 " commands, %zu bytes, expecting %zu",
+			batch.records, batch.len, batch.read_bytes);
+
+	retval = jtag_vpi_write_buf(batch.buf, batch.len);
+	if (retval == ERROR_OK)
+		retval = jtag_vpi_read_buf(header, sizeof(header));
+	if (retval == ERROR_OK && (le_to_h_u32(header) != CMD_BATCH ||
+			le_to_h_u32(header + 4) != batch.read_bytes)) {
+		LOG_ERROR("jtag_vpi: unexpected batch reply, cmd %" PRIu32 " length %" PRIu32,
+				le_to_h_u32(header), le_to_h_u32(header + 4));
+		retval = ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < batch.num_reads && retval == ERROR_OK; i++)
+		retval = jtag_vpi_read_buf(batch.reads[i].dest, batch.reads[i].bytes);
+
+	for (unsigned int i = 0; i < batch.num_scans && retval == ERROR_OK; i++)
+		retval = jtag_read_buffer(batch.scans[i].buf, batch.scans[i].cmd);
+
+	jtag_vpi_batch_discard();
+	return retval;
+}
+
+/**
+ * jtag_vpi_batch_add - append a command to the batch
+ * @param op command, as in the fixed size protocol
+ * @param bits TDI or TMS bits, NULL to send ones
+ * @param nb_bits number of bits
+ * @param capture where to store the TDO bits, or NULL
+ *
+ * The batch is sent first if there is no room left for the command.
+ */
+static int jtag_vpi_batch_add(uint32_t op, const uint8_t *bits, uint32_t nb_bits, uint8_t *capture)
+{
+	size_t nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+	size_t need = VPI_RECORD_HEADER_SIZE + nb_bytes;
+
+	if (batch.len + need > batch.max) {
+		int retval = jtag_vpi_batch_flush();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (batch.len + need > batch.size) {
+		size_t size = MAX(batch.size * 2, batch.len + need);
+		uint8_t *buf = realloc(batch.buf, size);
+		if (!buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		batch.buf = buf;
+		batch.size = size;
+	}
+
+	if (capture && batch.num_reads == batch.reads_size) {
+		unsigned int n = MAX(batch.reads_size * 2, 64);
+		struct vpi_batch_read *reads = realloc(batch.reads, n * sizeof(*reads));
+		if (!reads) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		batch.reads = reads;
+		batch.reads_size = n;
+	}
+
+	uint8_t *record = batch.buf + batch.len;
+	record[0] = op;
+	record[1] = capture ? VPI_RECORD_CAPTURE : 0;
+	record[2] = 0;
+	record[3] = 0;
+	h_u32_to_le(record + 4, nb_bits);
+	if (bits)
+		memcpy(record + VPI_RECORD_HEADER_SIZE, bits, nb_bytes);
+	else
+		memset(record + VPI_RECORD_HEADER_SIZE, 0xff, nb_bytes);
+
+	batch.len += need;
+	batch.records++;
+
+	if (capture) {
+		batch.reads[batch.num_reads].dest = capture;
+		batch.reads[batch.num_reads].bytes = nb_bytes;
+		batch.num_reads++;
+		batch.read_bytes += nb_bytes;
+	}
+
+	return ERROR_OK;
+}
+
+/* Complete @a cmd when its batch has been answered; takes ownership of @a buf */
+static int jtag_vpi_batch_defer_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (batch.num_scans == batch.scans_size) {
+		unsigned int n = MAX(batch.scans_size * 2, 16);
+		struct vpi_batch_scan *scans = realloc(batch.scans, n * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Out of memory");
+			free(buf);
+			return ERROR_FAIL;
+		}
+		batch.scans = scans;
+		batch.scans_size = n;
+	}
+
+	batch.scans[batch.num_scans].cmd = cmd;
+	batch.scans[batch.num_scans].buf = buf;
+	batch.num_scans++;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_negotiate - select the protocol version
+ *
+ * Servers that only know the fixed size commands may not survive
+ * CMD_GET_VERSION, so it is only sent when version 2 has been selected.
+ */
+static int jtag_vpi_negotiate(void)
+{
+	struct vpi_cmd vpi;
+	int retval;
+
+	protocol_version = VPI_PROTOCOL_LEGACY;
+	if (protocol_version_setting == VPI_PROTOCOL_LEGACY)
+		return ERROR_OK;
+
+	memset(&vpi, 0, sizeof(struct vpi_cmd));
+	vpi.cmd = CMD_GET_VERSION;
+	vpi.length = VPI_PROTOCOL_BATCH;
+	retval = jtag_vpi_send_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = jtag_vpi_read_buf((uint8_t *)&vpi, sizeof(struct vpi_cmd));
+	if (retval != ERROR_OK)
+		return retval;
+
+	vpi.cmd = le_to_h_u32(vpi.cmd_buf);
+	vpi.length = le_to_h_u32(vpi.length_buf);
+	vpi.nb_bits = le_to_h_u32(vpi.nb_bits_buf);
+	if (vpi.cmd != CMD_GET_VERSION) {
+		LOG_ERROR("jtag_vpi: unexpected answer %s to the version query",
+				jtag_vpi_cmd_to_str(vpi.cmd));
+		return ERROR_FAIL;
+	}
+
+	if (vpi.length < VPI_PROTOCOL_BATCH) {
+		LOG_ERROR("jtag_vpi: server only supports protocol version %" PRIu32, vpi.length);
+		return ERROR_FAIL;
+	}
+
+	protocol_version = VPI_PROTOCOL_BATCH;
+	batch.max = VPI_BATCH_MAX_SIZE;
+	if (vpi.nb_bits)
+		batch.max = MIN(batch.max, vpi.nb_bits);
+	if (batch.max < VPI_BATCH_HEADER_SIZE + VPI_RECORD_HEADER_SIZE + XFERT_MAX_SIZE) {
+		LOG_ERROR("jtag_vpi: batch size %zu is too small", batch.max);
+		return ERROR_FAIL;
+	}
+	batch.len = VPI_BATCH_HEADER_SIZE;
+
+	LOG_INFO("jtag_vpi: using protocol version %d", protocol_version);
+	return ERROR_OK;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -203,6 +505,10 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 static int jtag_vpi_reset(int trst, int srst)
 {
 	struct vpi_cmd vpi;
+
+	if (protocol_version == VPI_PROTOCOL_BATCH)
+		return jtag_vpi_batch_add(CMD_RESET, NULL, 0, NULL);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
 	vpi.cmd = CMD_RESET;
@@ -226,6 +532,9 @@ static int jtag_vpi_tms_seq(const uint8_t *bits, int nb_bits)
 	struct vpi_cmd vpi;
 	int nb_bytes;
 
+	if (protocol_version == VPI_PROTOCOL_BATCH)
+		return jtag_vpi_batch_add(CMD_TMS_SEQ, bits, nb_bits, NULL);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 	nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
@@ -294,6 +603,10 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	struct vpi_cmd vpi;
 	int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
+	if (protocol_version == VPI_PROTOCOL_BATCH)
+		return jtag_vpi_batch_add(tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN,
+				bits, nb_bits, bits);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
 	vpi.cmd = tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN;
@@ -337,7 +650,12 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
  */
 static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift)
 {
-	int nb_xfer = DIV_ROUND_UP(nb_bits, XFERT_MAX_SIZE * 8);
+	/* a batch record can be as large as the whole batch */
+	int xfer_max = XFERT_MAX_SIZE;
+	if (protocol_version == VPI_PROTOCOL_BATCH)
+		xfer_max = batch.max - VPI_BATCH_HEADER_SIZE - VPI_RECORD_HEADER_SIZE;
+
+	int nb_xfer = DIV_ROUND_UP(nb_bits, xfer_max * 8);
 	int retval;
 
 	while (nb_xfer) {
@@ -346,12 +664,12 @@ static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift)
 			if (retval != ERROR_OK)
 				return retval;
 		} else {
-			retval = jtag_vpi_queue_tdi_xfer(bits, XFERT_MAX_SIZE * 8, NO_TAP_SHIFT);
+			retval = jtag_vpi_queue_tdi_xfer(bits, xfer_max * 8, NO_TAP_SHIFT);
 			if (retval != ERROR_OK)
 				return retval;
-			nb_bits -= XFERT_MAX_SIZE * 8;
+			nb_bits -= xfer_max * 8;
 			if (bits)
-				bits += XFERT_MAX_SIZE;
+				bits += xfer_max;
 		}
 
 		nb_xfer--;
@@ -425,11 +743,17 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
+	if (protocol_version == VPI_PROTOCOL_BATCH) {
+		retval = jtag_vpi_batch_defer_scan(cmd, buf);
+		if (retval != ERROR_OK)
+			return retval;
+	} else {
+		retval = jtag_read_buffer(buf, cmd);
+		if (retval != ERROR_OK)
+			return retval;
 
-	free(buf);
+		free(buf);
+	}
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -508,6 +832,8 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			/* sleep after the commands before have run */
+			retval = jtag_vpi_batch_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -521,6 +847,11 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	if (retval == ERROR_OK)
+		retval = jtag_vpi_batch_flush();
+	else
+		jtag_vpi_batch_discard();
+
 	return retval;
 }
 
@@ -564,7 +895,7 @@ static int jtag_vpi_init(void)
 
 	LOG_INFO("jtag_vpi: Connection to %s : %u successful", server_address, server_port);
 
-	return ERROR_OK;
+	return jtag_vpi_negotiate();
 }
 
 static int jtag_vpi_stop_simulation(void)
@@ -588,6 +919,11 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	jtag_vpi_batch_discard();
+	free(batch.buf);
+	free(batch.reads);
+	free(batch.scans);
+	memset(&batch, 0, sizeof(batch));
 	return ERROR_OK;
 }
 
@@ -630,6 +966,25 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_protocol_version_handler)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "1"))
+			protocol_version_setting = VPI_PROTOCOL_LEGACY;
+		else if (!strcmp(CMD_ARGV[0], "2"))
+			protocol_version_setting = VPI_PROTOCOL_BATCH;
+		else
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	command_print(CMD, "jtag_vpi protocol version %d", protocol_version_setting);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -653,6 +1008,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "protocol_version",
+		.handler = &jtag_vpi_protocol_version_handler,
+		.mode = COMMAND_CONFIG,
+		.help = "Select the protocol version, 2 sends the commands of a "
+			"JTAG queue in batches (default: 1)",
+		.usage = "<1|2>",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -51,6 +51,23 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+#define MPSSE_MAX_PIPELINE_DEPTH 8
+
+struct mpsse_ctx;
+
+/* A command buffer on the bus while the next one is being filled */
+struct mpsse_pending {
+	struct mpsse_ctx *ctx;
+	uint8_t *write_buffer;
+	unsigned write_count;
+	uint8_t *read_buffer;
+	unsigned read_count;
+	struct bit_copy_queue read_queue;
+	struct libusb_transfer *transfer;
+	unsigned received;
+	bool write_done;
+};
+
 struct mpsse_ctx {
 	struct libusb_context *usb_ctx;
 	struct libusb_device_handle *usb_dev;
@@ -72,8 +89,23 @@ struct mpsse_ctx {
 	unsigned read_chunk_size;
 	struct bit_copy_queue read_queue;
 	int retval;
+
+	/* Pipelined mode: up to pipeline_depth - 1 buffers in flight, in the
+	 * ring pending[], and a single read transfer that hands the data out
+	 * to them in order. */
+	unsigned pipeline_depth;
+	struct mpsse_pending *pending;
+	unsigned pending_first;
+	unsigned pending_count;
+	struct libusb_transfer *read_transfer;
+	bool read_busy;
+	bool pipe_error;
+
+	struct mpsse_stats stats;
 };
 
+static int buffer_flush(struct mpsse_ctx *ctx);
+
 /* Returns true if the string descriptor indexed by str_index in device matches string */
 static bool string_descriptor_equal(struct libusb_device_handle *device, uint8_t str_index,
 	const char *string)
@@ -332,6 +364,7 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
 		goto error;
 
+	ctx->pipeline_depth = 1;
 	ctx->interface = channel;
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
@@ -387,8 +420,11 @@ error:
 	return 0;
 }
 
+static void pipe_free(struct mpsse_ctx *ctx);
+
 void mpsse_close(struct mpsse_ctx *ctx)
 {
+	pipe_free(ctx);
 	if (ctx->usb_dev)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
@@ -413,6 +449,7 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 	ctx->write_count = 0;
 	ctx->read_count = 0;
 	ctx->retval = ERROR_OK;
+	ctx->pipe_error = false;
 	bit_copy_discard(&ctx->read_queue);
 	err = libusb_control_transfer(ctx->usb_dev, FTDI_DEVICE_OUT_REQTYPE, SIO_RESET_REQUEST,
 			SIO_RESET_PURGE_RX, ctx->index, NULL, 0, ctx->usb_write_timeout);
@@ -501,7 +538,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
 				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = buffer_flush(ctx);
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -575,7 +612,7 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = buffer_flush(ctx);
 
 		/* Byte transfer */
 		unsigned this_bits = length;
@@ -618,7 +655,7 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -635,7 +672,7 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -652,7 +689,7 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -668,7 +705,7 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -683,7 +720,7 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -704,7 +741,7 @@ void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -830,7 +867,7 @@ static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 	}
 }
 
-int mpsse_flush(struct mpsse_ctx *ctx)
+static int mpsse_flush_sync(struct mpsse_ctx *ctx)
 {
 	int retval = ctx->retval;
 
@@ -848,6 +885,11 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 	if (ctx->write_count == 0)
 		return retval;
 
+	ctx->stats.buffers++;
+	ctx->stats.round_trips++;
+	ctx->stats.bytes_written += ctx->write_count;
+	ctx->stats.bytes_read += ctx->read_count;
+
 	struct libusb_transfer *read_transfer = 0;
 	struct transfer_result read_result = { .ctx = ctx, .done = true };
 	if (ctx->read_count) {
@@ -943,3 +985,393 @@ error_check:
 
 	return retval;
 }
+
+static struct mpsse_pending *pending_at(struct mpsse_ctx *ctx, unsigned i)
+{
+	return &ctx->pending[(ctx->pending_first + i) % (ctx->pipeline_depth - 1)];
+}
+
+static bool pending_done(struct mpsse_ctx *ctx, const struct mpsse_pending *p)
+{
+	return p->write_done && (ctx->pipe_error || p->received == p->read_count);
+}
+
+static LIBUSB_CALL void pipe_write_cb(struct libusb_transfer *transfer)
+{
+	struct mpsse_pending *p = transfer->user_data;
+
+	LOG_DEBUG_IO("transferred %d of %d", transfer->actual_length, p->write_count);
+
+	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
+
+	p->write_done = true;
+	/* A partial write can't be resumed, later buffers are already queued */
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+			(unsigned)transfer->actual_length != p->write_count) {
+		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
+			transfer->actual_length, p->write_count);
+		p->ctx->pipe_error = true;
+	}
+}
+
+static void pipe_read_submit(struct mpsse_ctx *ctx);
+
+static LIBUSB_CALL void pipe_read_cb(struct libusb_transfer *transfer)
+{
+	struct mpsse_ctx *ctx = transfer->user_data;
+	unsigned packet_size = ctx->max_packet_size;
+	unsigned next = 0;
+
+	ctx->read_busy = false;
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
+		if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+			LOG_ERROR("ftdi device read failed with status %d", transfer->status);
+		ctx->pipe_error = true;
+		return;
+	}
+
+	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
+
+	/* Strip the two status bytes sent at the beginning of each USB packet,
+	 * the rest is the data of the buffers in flight, in order */
+	unsigned num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
+	unsigned chunk_remains = transfer->actual_length;
+	for (unsigned i = 0; i < num_packets && chunk_remains > 2; i++) {
+		unsigned this_size = MIN(packet_size, chunk_remains) - 2;
+		const uint8_t *data = ctx->read_chunk + packet_size * i + 2;
+		chunk_remains -= this_size + 2;
+
+		while (this_size > 0) {
+			struct mpsse_pending *p = NULL;
+			for (; next < ctx->pending_count; next++) {
+				p = pending_at(ctx, next);
+				if (p->received < p->read_count)
+					break;
+			}
+			if (next == ctx->pending_count) {
+				LOG_ERROR("ftdi device returned %u unexpected bytes", this_size);
+				ctx->pipe_error = true;
+				return;
+			}
+
+			unsigned n = MIN(this_size, p->read_count - p->received);
+			memcpy(p->read_buffer + p->received, data, n);
+			p->received += n;
+			data += n;
+			this_size -= n;
+		}
+	}
+
+	pipe_read_submit(ctx);
+}
+
+/* Keep the read transfer going while some buffer waits for its data */
+static void pipe_read_submit(struct mpsse_ctx *ctx)
+{
+	if (ctx->read_busy || ctx->pipe_error)
+		return;
+
+	unsigned i;
+	for (i = 0; i < ctx->pending_count; i++) {
+		struct mpsse_pending *p = pending_at(ctx, i);
+		if (p->received < p->read_count)
+			break;
+	}
+	if (i == ctx->pending_count)
+		return;
+
+	libusb_fill_bulk_transfer(ctx->read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
+		ctx->read_chunk_size, pipe_read_cb, ctx, ctx->usb_read_timeout);
+	if (libusb_submit_transfer(ctx->read_transfer) != LIBUSB_SUCCESS) {
+		LOG_ERROR("unable to submit ftdi read transfer");
+		ctx->pipe_error = true;
+		return;
+	}
+	ctx->read_busy = true;
+}
+
+/* Cancel the transfers in flight and wait for their completion. */
+static void pipe_cancel(struct mpsse_ctx *ctx)
+{
+	ctx->pipe_error = true;
+
+	for (unsigned i = 0; i < ctx->pending_count; i++) {
+		struct mpsse_pending *p = pending_at(ctx, i);
+		if (!p->write_done)
+			libusb_cancel_transfer(p->transfer);
+	}
+	if (ctx->read_busy)
+		libusb_cancel_transfer(ctx->read_transfer);
+
+	for (;;) {
+		bool busy = ctx->read_busy;
+		for (unsigned i = 0; i < ctx->pending_count; i++)
+			busy |= !pending_at(ctx, i)->write_done;
+		if (!busy)
+			break;
+
+		struct timeval timeout_usb = { .tv_sec = 1, .tv_usec = 0 };
+		if (libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL)
+				!= LIBUSB_SUCCESS)
+			break;
+	}
+}
+
+/* Handle USB events until the oldest buffer in flight, or all of them, are done. */
+static int pipe_wait(struct mpsse_ctx *ctx, bool all)
+{
+	int64_t start = timeval_ms();
+	int64_t warn_after = 2000;
+
+	while (ctx->pending_count) {
+		unsigned i;
+		for (i = 0; i < (all ? ctx->pending_count : 1); i++)
+			if (!pending_done(ctx, pending_at(ctx, i)))
+				break;
+		if (i == (all ? ctx->pending_count : 1))
+			break;
+
+		struct timeval timeout_usb = { .tv_sec = 1, .tv_usec = 0 };
+		int retval = libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL);
+		keep_alive();
+		if (retval != LIBUSB_SUCCESS && retval != LIBUSB_ERROR_INTERRUPTED) {
+			LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
+			pipe_cancel(ctx);
+			return ERROR_FAIL;
+		}
+
+		int64_t now = timeval_ms();
+		if (now - start > warn_after) {
+			LOG_WARNING("Haven't made progress in mpsse_flush() for %" PRId64
+					"ms.", now - start);
+			warn_after *= 2;
+		}
+	}
+
+	return ctx->pipe_error ? ERROR_FAIL : ERROR_OK;
+}
+
+/* Deliver the read data of the buffers done, oldest first */
+static void pipe_retire(struct mpsse_ctx *ctx)
+{
+	while (ctx->pending_count) {
+		struct mpsse_pending *p = pending_at(ctx, 0);
+		if (!pending_done(ctx, p))
+			break;
+
+		if (ctx->pipe_error)
+			bit_copy_discard(&p->read_queue);
+		else
+			bit_copy_execute(&p->read_queue);
+
+		ctx->pending_first = (ctx->pending_first + 1) % (ctx->pipeline_depth - 1);
+		ctx->pending_count--;
+	}
+}
+
+static void buffer_discard(struct mpsse_ctx *ctx)
+{
+	ctx->write_count = 0;
+	ctx->read_count = 0;
+	bit_copy_discard(&ctx->read_queue);
+}
+
+/* Put the command buffer on the bus and go on with an empty one */
+static int pipe_submit(struct mpsse_ctx *ctx)
+{
+	if (ctx->retval != ERROR_OK) {
+		buffer_discard(ctx);
+		return ctx->retval;
+	}
+
+	if (ctx->write_count == 0)
+		return ERROR_OK;
+
+	if (ctx->read_count)
+		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
+
+	pipe_retire(ctx);
+	if (ctx->pending_count == ctx->pipeline_depth - 1) {
+		struct duration stall;
+		duration_start(&stall);
+		int retval = pipe_wait(ctx, false);
+		duration_measure(&stall);
+		ctx->stats.stalls++;
+		ctx->stats.round_trips++;
+		ctx->stats.stall_s += duration_elapsed(&stall);
+		pipe_retire(ctx);
+		if (retval != ERROR_OK) {
+			buffer_discard(ctx);
+			return retval;
+		}
+	}
+
+	struct mpsse_pending *p = pending_at(ctx, ctx->pending_count);
+
+	/* Swap buffers rather than copy; the read queue refers to the read
+	 * buffer, which goes along with it */
+	uint8_t *write_buffer = p->write_buffer;
+	p->write_buffer = ctx->write_buffer;
+	ctx->write_buffer = write_buffer;
+	uint8_t *read_buffer = p->read_buffer;
+	p->read_buffer = ctx->read_buffer;
+	ctx->read_buffer = read_buffer;
+	list_splice_init(&ctx->read_queue.list, &p->read_queue.list);
+
+	p->write_count = ctx->write_count;
+	p->read_count = ctx->read_count;
+	p->received = 0;
+	p->write_done = false;
+	ctx->write_count = 0;
+	ctx->read_count = 0;
+
+	ctx->stats.buffers++;
+	ctx->stats.bytes_written += p->write_count;
+	ctx->stats.bytes_read += p->read_count;
+
+	libusb_fill_bulk_transfer(p->transfer, ctx->usb_dev, ctx->out_ep, p->write_buffer,
+		p->write_count, pipe_write_cb, p, ctx->usb_write_timeout);
+	ctx->pending_count++;
+	if (libusb_submit_transfer(p->transfer) != LIBUSB_SUCCESS) {
+		LOG_ERROR("unable to submit ftdi write transfer");
+		p->write_done = true;
+		ctx->pipe_error = true;
+		return ERROR_FAIL;
+	}
+
+	if (ctx->pending_count > ctx->stats.max_in_flight)
+		ctx->stats.max_in_flight = ctx->pending_count;
+
+	pipe_read_submit(ctx);
+	return ctx->pipe_error ? ERROR_FAIL : ERROR_OK;
+}
+
+static int pipe_flush(struct mpsse_ctx *ctx)
+{
+	int retval = pipe_submit(ctx);
+
+	if (ctx->pending_count)
+		ctx->stats.round_trips++;
+
+	if (pipe_wait(ctx, true) != ERROR_OK || ctx->pipe_error) {
+		pipe_cancel(ctx);
+		retval = ERROR_FAIL;
+	}
+	pipe_retire(ctx);
+
+	ctx->retval = ERROR_OK;
+	if (retval != ERROR_OK)
+		mpsse_purge(ctx);
+
+	return retval;
+}
+
+/* Make room in the command buffer while commands are queued */
+static int buffer_flush(struct mpsse_ctx *ctx)
+{
+	if (ctx->pipeline_depth > 1)
+		return pipe_submit(ctx);
+	return mpsse_flush_sync(ctx);
+}
+
+int mpsse_flush(struct mpsse_ctx *ctx)
+{
+	if (ctx->pipeline_depth > 1)
+		return pipe_flush(ctx);
+	return mpsse_flush_sync(ctx);
+}
+
+static void pipe_free(struct mpsse_ctx *ctx)
+{
+	if (!ctx->pending)
+		return;
+
+	pipe_cancel(ctx);
+	for (unsigned i = 0; i < ctx->pipeline_depth - 1; i++) {
+		struct mpsse_pending *p = &ctx->pending[i];
+		bit_copy_discard(&p->read_queue);
+		if (p->transfer)
+			libusb_free_transfer(p->transfer);
+		free(p->write_buffer);
+		free(p->read_buffer);
+	}
+	free(ctx->pending);
+	ctx->pending = NULL;
+	ctx->pending_first = 0;
+	ctx->pending_count = 0;
+
+	if (ctx->read_transfer)
+		libusb_free_transfer(ctx->read_transfer);
+	ctx->read_transfer = NULL;
+	ctx->pipeline_depth = 1;
+	ctx->pipe_error = false;
+}
+
+/**
+ * Set the number of command buffers that can be on the bus at once. With
+ * more than one, a command buffer that fills up while commands are queued
+ * is sent without waiting for the adapter, and queuing goes on in the next
+ * one; mpsse_flush() then waits for all of them.
+ */
+int mpsse_set_pipeline_depth(struct mpsse_ctx *ctx, unsigned depth)
+{
+	if (depth < 1 || depth > MPSSE_MAX_PIPELINE_DEPTH)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	int retval = mpsse_flush(ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
+	pipe_free(ctx);
+	if (depth == 1)
+		return ERROR_OK;
+
+	ctx->pending = calloc(depth - 1, sizeof(*ctx->pending));
+	ctx->read_transfer = libusb_alloc_transfer(0);
+	if (!ctx->pending || !ctx->read_transfer)
+		goto error;
+	ctx->pipeline_depth = depth;
+
+	for (unsigned i = 0; i < depth - 1; i++) {
+		struct mpsse_pending *p = &ctx->pending[i];
+		p->ctx = ctx;
+		bit_copy_queue_init(&p->read_queue);
+		/* calloc for the same reason as in mpsse_open() */
+		p->write_buffer = calloc(1, ctx->write_size);
+		p->read_buffer = malloc(ctx->read_size);
+		p->transfer = libusb_alloc_transfer(0);
+		if (!p->write_buffer || !p->read_buffer || !p->transfer)
+			goto error;
+	}
+
+	return ERROR_OK;
+
+error:
+	LOG_ERROR("Out of memory");
+	if (!ctx->pending) {
+		if (ctx->read_transfer)
+			libusb_free_transfer(ctx->read_transfer);
+		ctx->read_transfer = NULL;
+	} else {
+		ctx->pipeline_depth = depth;
+		pipe_free(ctx);
+	}
+	return ERROR_FAIL;
+}
+
+unsigned mpsse_get_pipeline_depth(struct mpsse_ctx *ctx)
+{
+	return ctx->pipeline_depth;
+}
+
+void mpsse_get_stats(struct mpsse_ctx *ctx, struct mpsse_stats *stats)
+{
+	*stats = ctx->stats;
+	stats->buffer_size = ctx->write_size;
+}
+
+void mpsse_reset_stats(struct mpsse_ctx *ctx)
+{
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+}
@@ -28,6 +28,21 @@ enum ftdi_chip_type {
 
 struct mpsse_ctx;
 
+struct mpsse_stats {
+	/* size of a command buffer */
+	unsigned buffer_size;
+	/* command buffers sent, and the bytes written and read with them */
+	uint64_t buffers;
+	uint64_t bytes_written;
+	uint64_t bytes_read;
+	/* waits for the adapter to complete USB transfers */
+	uint64_t round_trips;
+	/* waits for a free command buffer while queuing, pipelined mode only */
+	uint64_t stalls;
+	double stall_s;
+	unsigned max_in_flight;
+};
+
 /* Device handling */
 struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const char *description,
 	const char *serial, const char *location, int channel);
@@ -63,5 +78,9 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency);
 /* Queue handling */
 int mpsse_flush(struct mpsse_ctx *ctx);
 void mpsse_purge(struct mpsse_ctx *ctx);
+int mpsse_set_pipeline_depth(struct mpsse_ctx *ctx, unsigned depth);
+unsigned mpsse_get_pipeline_depth(struct mpsse_ctx *ctx);
+void mpsse_get_stats(struct mpsse_ctx *ctx, struct mpsse_stats *stats);
+void mpsse_reset_stats(struct mpsse_ctx *ctx);
 
 #endif /* OPENOCD_JTAG_DRIVERS_MPSSE_H */
@@ -442,6 +442,63 @@ static int nulink_usb_read_reg(void *handle, unsigned int regsel, uint32_t *val)
 	return res;
 }
 
+static int nulink_usb_run_queue(void *handle, struct hl_queued_op *ops, unsigned int count,
+		unsigned int *executed)
+{
+	struct nulink_usb_handle_s *h = handle;
+	unsigned int n = 0;
+
+	assert(handle);
+
+	*executed = 0;
+
+	/* read up to three registers per command, as the memory accesses do */
+	while (n < count && n < 3 && ops[n].type == HL_OP_READ_REG)
+		n++;
+
+	if (n < 2)
+		return ERROR_OK;
+
+	nulink_usb_init_buffer(handle, 8 + 12 * n);
+	/* set command ID */
+	h_u32_to_le(h->cmdbuf + h->cmdidx, CMD_WRITE_REG);
+	h->cmdidx += 4;
+	/* Count of registers */
+	h->cmdbuf[h->cmdidx] = n;
+	h->cmdidx += 1;
+	/* Array of bool value (u8ReadOld) */
+	h->cmdbuf[h->cmdidx] = 0xFF;
+	h->cmdidx += 1;
+	/* Array of bool value (u8Verify) */
+	h->cmdbuf[h->cmdidx] = 0x00;
+	h->cmdidx += 1;
+	/* ignore */
+	h->cmdbuf[h->cmdidx] = 0;
+	h->cmdidx += 1;
+
+	for (unsigned int i = 0; i < n; i++) {
+		/* u32Addr */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, ops[i].addr);
+		h->cmdidx += 4;
+		/* u32Data */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, 0);
+		h->cmdidx += 4;
+		/* u32Mask */
+		h_u32_to_le(h->cmdbuf + h->cmdidx, 0xFFFFFFFFUL);
+		h->cmdidx += 4;
+	}
+
+	int res = nulink_usb_xfer(handle, h->databuf, 4 * n * 2);
+	if (res != ERROR_OK)
+		return res;
+
+	for (unsigned int i = 0; i < n; i++)
+		*ops[i].val = le_to_h_u32(h->databuf + 4 * (2 * i + 1));
+
+	*executed = n;
+	return ERROR_OK;
+}
+
 static int nulink_usb_write_reg(void *handle, unsigned int regsel, uint32_t val)
 {
 	struct nulink_usb_handle_s *h = handle;
@@ -1171,4 +1228,5 @@ struct hl_layout_api_s nulink_usb_layout_api = {
 	.write_debug_reg = nulink_usb_write_debug_reg,
 	.override_target = nulink_usb_override_target,
 	.speed = nulink_speed,
+	.run_queue = nulink_usb_run_queue,
 };
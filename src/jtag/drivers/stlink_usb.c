@@ -167,6 +167,12 @@ struct stlink_tcp_priv_s {
 	uint8_t *recv_buf;
 	/** */
 	struct stlink_tcp_version version;
+	/** max number of memory chunks in flight, see stlink_tcp_rw_mem() */
+	unsigned int pipeline_depth;
+	/** requests of the memory chunks in flight */
+	uint8_t *pipeline_send_buf;
+	/** responses of the memory chunks in flight */
+	uint8_t *pipeline_recv_buf;
 };
 
 struct stlink_backend_s {
@@ -482,6 +488,9 @@ static inline int stlink_usb_xfer_noerrcheck(void *handle, const uint8_t *buf, i
 #define STLINK_TCP_SERIAL_SIZE               32
 #define STLINK_TCP_SEND_BUFFER_SIZE          10240
 #define STLINK_TCP_RECV_BUFFER_SIZE          10240
+#define STLINK_TCP_PIPELINE_MAX_DEPTH        32
+/* request of a memory chunk and of its status, larger than the responses */
+#define STLINK_TCP_PIPELINE_CHUNK_SIZE       (2 * STLINK_TCP_USB_CMD_SIZE + STLINK_MAX_RW16_32)
 
 /* STLINK TCP command status */
 #define STLINK_TCP_SS_OK                     0x00000001
@@ -561,6 +570,7 @@ static void stlink_dump_speed_map(const struct speed_map *map, unsigned int map_
 static int stlink_get_com_freq(void *handle, bool is_jtag, struct speed_map *map);
 static int stlink_speed(void *handle, int khz, bool query);
 static int stlink_usb_open_ap(void *handle, unsigned short apsel);
+static struct stlink_backend_s stlink_tcp_backend;
 
 /** */
 static unsigned int stlink_usb_block(void *handle)
@@ -911,14 +921,9 @@ static int stlink_usb_usb_xfer_noerrcheck(void *handle, const uint8_t *buf, int
 }
 
 
-static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool check_tcp_status)
+static int stlink_tcp_send(struct stlink_usb_handle_s *h, const uint8_t *buf, int send_size)
 {
-	struct stlink_usb_handle_s *h = handle;
-
-	assert(handle);
-
-	/* send the TCP command */
-	int sent_size = send(h->tcp_backend_priv.fd, (void *)h->tcp_backend_priv.send_buf, send_size, 0);
+	int sent_size = send(h->tcp_backend_priv.fd, (const void *)buf, send_size, 0);
 	if (sent_size != send_size) {
 		LOG_ERROR("failed to send USB CMD");
 		if (sent_size == -1)
@@ -928,10 +933,13 @@ static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool
 		return ERROR_FAIL;
 	}
 
-	/* read the TCP response */
+	return ERROR_OK;
+}
+
+static int stlink_tcp_recv(struct stlink_usb_handle_s *h, uint8_t *recv_buf, int recv_size)
+{
 	int retval = ERROR_OK;
 	int remaining_bytes = recv_size;
-	uint8_t *recv_buf = h->tcp_backend_priv.recv_buf;
 	const int64_t timeout = timeval_ms() + 1000; /* 1 second */
 
 	while (remaining_bytes > 0) {
@@ -954,27 +962,65 @@ static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool
 		remaining_bytes -= received;
 	}
 
-	if (retval != ERROR_OK) {
+	if (retval != ERROR_OK)
 		LOG_ERROR("failed to receive USB CMD response");
-		return retval;
-	}
 
-	if (check_tcp_status) {
-		uint32_t tcp_ss = le_to_h_u32(h->tcp_backend_priv.recv_buf);
-		if (tcp_ss != STLINK_TCP_SS_OK) {
-			if (tcp_ss == STLINK_TCP_SS_TCP_BUSY) {
-				LOG_DEBUG("TCP busy");
-				return ERROR_WAIT;
-			}
+	return retval;
+}
 
-			LOG_ERROR("TCP error status 0x%X", tcp_ss);
-			return ERROR_FAIL;
+/* Check the stlink-server status at the start of a response */
+static int stlink_tcp_check_status(const uint8_t *response)
+{
+	uint32_t tcp_ss = le_to_h_u32(response);
+
+	if (tcp_ss != STLINK_TCP_SS_OK) {
+		if (tcp_ss == STLINK_TCP_SS_TCP_BUSY) {
+			LOG_DEBUG("TCP busy");
+			return ERROR_WAIT;
 		}
+
+		LOG_ERROR("TCP error status 0x%X", tcp_ss);
+		return ERROR_FAIL;
 	}
 
 	return ERROR_OK;
 }
 
+static int stlink_tcp_send_cmd(void *handle, int send_size, int recv_size, bool check_tcp_status)
+{
+	struct stlink_usb_handle_s *h = handle;
+
+	assert(handle);
+
+	/* send the TCP command */
+	int retval = stlink_tcp_send(h, h->tcp_backend_priv.send_buf, send_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* read the TCP response */
+	retval = stlink_tcp_recv(h, h->tcp_backend_priv.recv_buf, recv_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (check_tcp_status)
+		return stlink_tcp_check_status(h->tcp_backend_priv.recv_buf);
+
+	return ERROR_OK;
+}
+
+/* Fill in the header of a STLINK_TCP_CMD_SEND_USB_CMD request, the stlink
+ * command itself goes to req[8..23] */
+static void stlink_tcp_init_usb_cmd(struct stlink_usb_handle_s *h, uint8_t *req,
+		uint8_t direction, uint32_t size)
+{
+	req[0] = STLINK_TCP_CMD_SEND_USB_CMD;
+	memset(&req[1], 0, 3); /* reserved for alignment and future use, must be zero */
+	h_u32_to_le(&req[4], h->tcp_backend_priv.connect_id);
+	req[24] = direction;
+	memset(&req[25], 0, 3);  /* reserved for alignment and future use, must be zero */
+	h_u32_to_le(&req[28], size);
+}
+
 /** */
 static int stlink_tcp_xfer_noerrcheck(void *handle, const uint8_t *buf, int size)
 {
@@ -986,14 +1032,8 @@ static int stlink_tcp_xfer_noerrcheck(void *handle, const uint8_t *buf, int size
 	assert(handle);
 
 	/* prepare the TCP command */
-	h->tcp_backend_priv.send_buf[0] = STLINK_TCP_CMD_SEND_USB_CMD;
-	memset(&h->tcp_backend_priv.send_buf[1], 0, 3); /* reserved for alignment and future use, must be zero */
-	h_u32_to_le(&h->tcp_backend_priv.send_buf[4], h->tcp_backend_priv.connect_id);
 	/* tcp_backend_priv.send_buf[8..23] already contains the constructed stlink command */
-	h->tcp_backend_priv.send_buf[24] = h->direction;
-	memset(&h->tcp_backend_priv.send_buf[25], 0, 3);  /* reserved for alignment and future use, must be zero */
-
-	h_u32_to_le(&h->tcp_backend_priv.send_buf[28], size);
+	stlink_tcp_init_usb_cmd(h, h->tcp_backend_priv.send_buf, h->direction, size);
 
 	/*
 	 * if the xfer is a write request (tx_ep)
@@ -2396,6 +2436,37 @@ static int stlink_usb_read_reg(void *handle, unsigned int regsel, uint32_t *val)
 	}
 }
 
+/** */
+static int stlink_usb_run_queue(void *handle, struct hl_queued_op *ops, unsigned int count,
+		unsigned int *executed)
+{
+	struct stlink_usb_handle_s *h = handle;
+	unsigned int n = 0;
+
+	assert(handle);
+
+	*executed = 0;
+
+	/* READALLREGS returns R0 to PSP in the order of their REGSEL, so
+	 * a run of reads among them costs a single transfer */
+	while (n < count && ops[n].type == HL_OP_READ_REG && ops[n].addr <= ARMV7M_REGSEL_PSP)
+		n++;
+
+	if (n < 2)
+		return ERROR_OK;
+
+	int res = stlink_usb_read_regs(handle);
+	if (res != ERROR_OK)
+		return res;
+
+	const uint8_t *regs = h->databuf + (h->version.jtag_api == STLINK_JTAG_API_V1 ? 0 : 4);
+	for (unsigned int i = 0; i < n; i++)
+		*ops[i].val = le_to_h_u32(regs + 4 * ops[i].addr);
+
+	*executed = n;
+	return ERROR_OK;
+}
+
 /** */
 static int stlink_usb_write_reg(void *handle, unsigned int regsel, uint32_t val)
 {
@@ -2802,6 +2873,156 @@ static uint32_t stlink_max_block_size(uint32_t tar_autoincr_block, uint32_t addr
 	return max_tar_block;
 }
 
+/* Memory accesses stlink_tcp_rw_mem() can take over */
+static bool stlink_tcp_can_pipeline(struct stlink_usb_handle_s *h, uint8_t ap_num, uint32_t csw,
+		uint32_t addr, uint32_t size, uint32_t count)
+{
+	if (h->backend != &stlink_tcp_backend || h->tcp_backend_priv.pipeline_depth < 2)
+		return false;
+
+	if (h->version.jtag_api == STLINK_JTAG_API_V1)
+		return false;
+
+	if ((ap_num != 0 || csw != 0) && !(h->version.flags & STLINK_F_HAS_CSW))
+		return false;
+
+	/* unaligned heads and tails go through the usual path */
+	return addr % size == 0 && count % size == 0;
+}
+
+/*
+ * Transfer memory through stlink-server with several chunks in flight.
+ * The requests of up to pipeline_depth chunks, each followed by the
+ * request of its status, are sent at once and the responses are read back
+ * in order, so that a window costs a single round trip to the server
+ * instead of two per chunk. A chunk answered with a wait status is sent
+ * again, and so are the chunks after it, already executed by the probe.
+ * Count is in bytes, a multiple of size, and addr is aligned on size.
+ */
+static int stlink_tcp_rw_mem(struct stlink_usb_handle_s *h, uint8_t ap_num, uint32_t csw,
+		uint32_t addr, uint32_t size, uint32_t count, const uint8_t *out, uint8_t *in)
+{
+	struct stlink_tcp_priv_s *tcp = &h->tcp_backend_priv;
+	struct {
+		uint32_t addr;
+		uint32_t offset;
+		uint32_t len;
+	} chunk[STLINK_TCP_PIPELINE_MAX_DEPTH];
+	uint32_t offset = 0;
+	uint8_t mem_cmd, status_cmd;
+	unsigned int status_size;
+	int retries = 0;
+	int retval;
+
+	switch (size) {
+	case 1:
+		mem_cmd = out ? STLINK_DEBUG_WRITEMEM_8BIT : STLINK_DEBUG_READMEM_8BIT;
+		break;
+	case 2:
+		mem_cmd = out ? STLINK_DEBUG_APIV2_WRITEMEM_16BIT : STLINK_DEBUG_APIV2_READMEM_16BIT;
+		break;
+	default:
+		mem_cmd = out ? STLINK_DEBUG_WRITEMEM_32BIT : STLINK_DEBUG_READMEM_32BIT;
+		break;
+	}
+
+	if (h->version.flags & STLINK_F_HAS_GETLASTRWSTATUS2) {
+		status_cmd = STLINK_DEBUG_APIV2_GETLASTRWSTATUS2;
+		status_size = 12;
+	} else {
+		status_cmd = STLINK_DEBUG_APIV2_GETLASTRWSTATUS;
+		status_size = 2;
+	}
+
+	while (count) {
+		uint8_t *req = tcp->pipeline_send_buf;
+		unsigned int recv_size = 0;
+		unsigned int n;
+
+		for (n = 0; n < tcp->pipeline_depth && count; n++) {
+			uint32_t len = (size != 1) ?
+					stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
+			if (count < len)
+				len = count;
+
+			/* single bytes are read as two */
+			uint32_t xfer_len = (!out && len == 1) ? 2 : len;
+
+			chunk[n].addr = addr;
+			chunk[n].offset = offset;
+			chunk[n].len = len;
+
+			memset(req, 0, STLINK_TCP_USB_CMD_SIZE);
+			stlink_tcp_init_usb_cmd(h, req, out ? h->tx_ep : h->rx_ep, xfer_len);
+			req[8] = STLINK_DEBUG_COMMAND;
+			req[9] = mem_cmd;
+			h_u32_to_le(&req[10], addr);
+			h_u16_to_le(&req[14], len);
+			req[16] = ap_num;
+			h_u24_to_le(&req[17], csw >> 8);
+			req += STLINK_TCP_USB_CMD_SIZE;
+			if (out) {
+				memcpy(req, out + offset, len);
+				req += len;
+				recv_size += STLINK_TCP_SS_SIZE;
+			} else {
+				recv_size += STLINK_TCP_SS_SIZE + xfer_len;
+			}
+
+			memset(req, 0, STLINK_TCP_USB_CMD_SIZE);
+			stlink_tcp_init_usb_cmd(h, req, h->rx_ep, status_size);
+			req[8] = STLINK_DEBUG_COMMAND;
+			req[9] = status_cmd;
+			req += STLINK_TCP_USB_CMD_SIZE;
+			recv_size += STLINK_TCP_SS_SIZE + status_size;
+
+			addr += len;
+			offset += len;
+			count -= len;
+		}
+
+		retval = stlink_tcp_send(h, tcp->pipeline_send_buf, req - tcp->pipeline_send_buf);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = stlink_tcp_recv(h, tcp->pipeline_recv_buf, recv_size);
+		if (retval != ERROR_OK)
+			return retval;
+
+		const uint8_t *response = tcp->pipeline_recv_buf;
+		for (unsigned int i = 0; i < n; i++) {
+			retval = stlink_tcp_check_status(response);
+			response += STLINK_TCP_SS_SIZE;
+			if (!out) {
+				memcpy(in + chunk[i].offset, response, chunk[i].len);
+				response += (chunk[i].len == 1) ? 2 : chunk[i].len;
+			}
+
+			int status = stlink_tcp_check_status(response);
+			memcpy(h->databuf, response + STLINK_TCP_SS_SIZE, status_size);
+			response += STLINK_TCP_SS_SIZE + status_size;
+			if (status == ERROR_OK)
+				status = stlink_usb_error_check(h);
+			if (retval == ERROR_OK)
+				retval = status;
+
+			if (retval == ERROR_WAIT && retries < MAX_WAIT_RETRIES) {
+				usleep((1 << retries++) * 1000);
+				/* start over from this chunk */
+				addr = chunk[i].addr;
+				offset = chunk[i].offset;
+				for (unsigned int j = i; j < n; j++)
+					count += chunk[j].len;
+				break;
+			}
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int stlink_usb_read_ap_mem(void *handle, uint8_t ap_num, uint32_t csw,
 		uint32_t addr, uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -2817,6 +3038,9 @@ static int stlink_usb_read_ap_mem(void *handle, uint8_t ap_num, uint32_t csw,
 	if (size == 2 && !(h->version.flags & STLINK_F_HAS_MEM_16BIT))
 		size = 1;
 
+	if (stlink_tcp_can_pipeline(h, ap_num, csw, addr, size, count))
+		return stlink_tcp_rw_mem(h, ap_num, csw, addr, size, count, NULL, buffer);
+
 	while (count) {
 		bytes_remaining = (size != 1) ?
 				stlink_max_block_size(h->max_mem_packet, addr) : stlink_usb_block(h);
@@ -2902,6 +3126,9 @@ static int stlink_usb_write_ap_mem(void *handle, uint8_t ap_num, uint32_t csw,
 	if (size == 2 && !(h->version.flags & STLINK_F_HAS_MEM_16BIT))
 		size = 1;
 
+	if (stlink_tcp_can_pipeline(h, ap_num, csw, addr, size, count))
+		return stlink_tcp_rw_mem(h, ap_num, csw, addr, size, count, buffer, NULL);
+
 	while (count) {
 
 		bytes_remaining = (size != 1) ?
@@ -3250,6 +3477,8 @@ static int stlink_tcp_close(void *handle)
 
 	free(h->tcp_backend_priv.send_buf);
 	free(h->tcp_backend_priv.recv_buf);
+	free(h->tcp_backend_priv.pipeline_send_buf);
+	free(h->tcp_backend_priv.pipeline_recv_buf);
 
 	return ret;
 }
@@ -3474,6 +3703,19 @@ static int stlink_tcp_open(void *handle, struct hl_interface_param_s *param)
 	if (!h->tcp_backend_priv.send_buf || !h->tcp_backend_priv.recv_buf)
 		return ERROR_FAIL;
 
+	/* the memory chunks in flight are sent, and answered, at once */
+	h->tcp_backend_priv.pipeline_depth = MIN(param->stlink_tcp_pipeline, STLINK_TCP_PIPELINE_MAX_DEPTH);
+	int pipeline_size = h->tcp_backend_priv.pipeline_depth * STLINK_TCP_PIPELINE_CHUNK_SIZE;
+	if (h->tcp_backend_priv.pipeline_depth > 1) {
+		h->tcp_backend_priv.pipeline_send_buf = malloc(pipeline_size);
+		h->tcp_backend_priv.pipeline_recv_buf = malloc(pipeline_size);
+
+		if (!h->tcp_backend_priv.pipeline_send_buf || !h->tcp_backend_priv.pipeline_recv_buf)
+			return ERROR_FAIL;
+
+		LOG_DEBUG("up to %u memory chunks in flight", h->tcp_backend_priv.pipeline_depth);
+	}
+
 	h->cmdbuf = &h->tcp_backend_priv.send_buf[8];
 	h->databuf = &h->tcp_backend_priv.recv_buf[4];
 
@@ -3506,13 +3748,13 @@ static int stlink_tcp_open(void *handle, struct hl_interface_param_s *param)
 		return ERROR_FAIL;
 	}
 
-	optval = STLINK_TCP_RECV_BUFFER_SIZE;
+	optval = MAX(STLINK_TCP_RECV_BUFFER_SIZE, pipeline_size);
 	if (setsockopt(h->tcp_backend_priv.fd, SOL_SOCKET, SO_RCVBUF, (const void *)&optval, sizeof(int)) == -1) {
 		LOG_ERROR("cannot set sock option 'SO_RCVBUF', errno: %s", strerror(errno));
 		return ERROR_FAIL;
 	}
 
-	optval = STLINK_TCP_SEND_BUFFER_SIZE;
+	optval = MAX(STLINK_TCP_SEND_BUFFER_SIZE, pipeline_size);
 	if (setsockopt(h->tcp_backend_priv.fd, SOL_SOCKET, SO_SNDBUF, (const void *)&optval, sizeof(int)) == -1) {
 		LOG_ERROR("cannot set sock option 'SO_SNDBUF', errno: %s", strerror(errno));
 		return ERROR_FAIL;
@@ -4033,6 +4275,8 @@ struct hl_layout_api_s stlink_usb_layout_api = {
 	.config_trace = stlink_config_trace,
 	/** */
 	.poll_trace = stlink_usb_trace_read,
+	/** */
+	.run_queue = stlink_usb_run_queue,
 };
 
 /*****************************************************************************
@@ -4976,8 +5220,9 @@ COMMAND_HANDLER(stlink_dap_backend_command)
 	/* default values */
 	bool use_stlink_tcp = false;
 	uint16_t stlink_tcp_port = 7184;
+	unsigned int stlink_tcp_pipeline = 0;
 
-	if (CMD_ARGC == 0 || CMD_ARGC > 2)
+	if (CMD_ARGC == 0 || CMD_ARGC > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	else if (strcmp(CMD_ARGV[0], "usb") == 0) {
 		if (CMD_ARGC > 1)
@@ -4985,13 +5230,16 @@ COMMAND_HANDLER(stlink_dap_backend_command)
 		/* else use_stlink_tcp = false (already the case ) */
 	} else if (strcmp(CMD_ARGV[0], "tcp") == 0) {
 		use_stlink_tcp = true;
-		if (CMD_ARGC == 2)
+		if (CMD_ARGC >= 2)
 			COMMAND_PARSE_NUMBER(u16, CMD_ARGV[1], stlink_tcp_port);
+		if (CMD_ARGC == 3)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], stlink_tcp_pipeline);
 	} else
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	stlink_dap_param.use_stlink_tcp = use_stlink_tcp;
 	stlink_dap_param.stlink_tcp_port = stlink_tcp_port;
+	stlink_dap_param.stlink_tcp_pipeline = stlink_tcp_pipeline;
 
 	return ERROR_OK;
 }
@@ -5047,7 +5295,7 @@ static const struct command_registration stlink_dap_subcommand_handlers[] = {
 		.handler = &stlink_dap_backend_command,
 		.mode = COMMAND_CONFIG,
 		.help = "select which ST-Link backend to use",
-		.usage = "usb | tcp [port]",
+		.usage = "usb | tcp [port [pipeline_depth]]",
 	},
 	{
 		.name = "cmd",
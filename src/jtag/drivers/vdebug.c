@@ -9,6 +9,8 @@
  * and the simulated, emulated core. The openOCD client connects via TCP sockets
  * with vdebug server and over DPI-based transactor with the emulation or simulation
  * The vdebug debug driver supports JTAG and DAP-level transports
+ * When the vdebug server runs on the same host, the messages can instead be
+ * exchanged through a POSIX shared memory region holding a struct vd_shm
  *
 */
 
@@ -32,6 +34,16 @@
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_SHM_OPEN)
+#define VD_SHM_SUPPORT 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #endif
 #include <stdio.h>
 #ifdef HAVE_STDINT_H
@@ -57,6 +69,8 @@
 #define VD_BUFFER_LEN 4024
 #define VD_CHEADER_LEN 24
 #define VD_SHEADER_LEN 16
+#define VD_SHM_SPIN 2000
+#define VD_SHM_TIMEOUT 30000
 
 #define VD_MAX_MEMORIES 20
 #define VD_POLL_INTERVAL 500
@@ -173,8 +187,8 @@ struct vd_shm {
 		uint8_t duttime[8];      /* fd8; */
 	};
 	uint8_t rd8[VD_BUFFER_LEN];  /* fe0: */
-	uint8_t state[4];            /* 1f98; connection state */
-	uint8_t count[4];            /* 1f9c; */
+	uint8_t state[4];            /* 1f98; connection state, shm: last request done */
+	uint8_t count[4];            /* 1f9c; shm: last request posted */
 	uint8_t dummy[96];           /* 1fa0; 48+40B+8B; */
 } __attribute__((packed));
 
@@ -204,7 +218,13 @@ struct vd_client {
 	uint32_t poll_max;
 	uint32_t targ_time;
 	int hsocket;
+	struct vd_shm *shm;
+	int shm_fd;
+	uint32_t shm_seq;
+	uint32_t shm_timeout;
+	bool shm_lost;
 	char server_name[32];
+	char shm_path[128];
 	char bfm_path[128];
 	char mem_path[VD_MAX_MEMORIES][128];
 	struct vd_rdata rdataq;
@@ -324,8 +344,142 @@ static int vdebug_socket_send(int hsock, struct vd_shm *pmem)
 	return rc;
 }
 
+#ifdef VD_SHM_SUPPORT
+/* The shared memory region is created by the vdebug server and holds a
+ * single struct vd_shm. The client posts a request by writing the header
+ * and data, then the request number in count; the server answers in the
+ * read half and stores the same number in state. Both words are in host
+ * byte order, and waiters sleep on them with futex where available. */
+static struct vd_shm *vdebug_shm_open(const char *path)
+{
+	struct stat st;
+	void *map = MAP_FAILED;
+
+	int fd = shm_open(path, O_RDWR, 0);
+	if (fd < 0) {
+		LOG_ERROR("shm_open: cannot open %s, error %d", path, errno);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct vd_shm))
+		LOG_ERROR("shm_open: %s is smaller than %zu bytes", path, sizeof(struct vd_shm));
+	else
+		map = mmap(NULL, sizeof(struct vd_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		LOG_ERROR("shm_open: cannot map %s, error %d", path, errno);
+		close(fd);
+		return NULL;
+	}
+
+	/* kept open to tell whether the server removed the region */
+	vdc.shm_fd = fd;
+	vdc.shm_lost = false;
+
+	return map;
+}
+
+static void vdebug_shm_close(struct vd_shm *pm)
+{
+	munmap(pm, sizeof(struct vd_shm));
+	close(vdc.shm_fd);
+}
+
+/* The server unlinks the region when it exits. */
+static bool vdebug_shm_server_gone(void)
+{
+	struct stat st;
+
+	return fstat(vdc.shm_fd, &st) < 0 || st.st_nlink == 0;
+}
+
+static void vdebug_shm_wake(uint32_t *word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+}
+
+static void vdebug_shm_sleep(uint32_t *word, uint32_t old)
+{
+#ifdef __linux__
+	struct timespec ts = { .tv_sec = 1 };
+	syscall(SYS_futex, word, FUTEX_WAIT, old, &ts, NULL, 0);
+#else
+	usleep(10);
+#endif
+}
+
+static int vdebug_shm_exchange(struct vd_shm *pm)
+{
+	uint32_t *count = (void *)pm->count;
+	uint32_t *state = (void *)pm->state;
+	unsigned int spin = 0;
+	int64_t start = timeval_ms();
+	int64_t ts = start;
+
+	/* a late answer would overwrite the next request, don't post any */
+	if (vdc.shm_lost)
+		return ERROR_FAIL;
+
+	uint32_t seq = ++vdc.shm_seq;
+	__atomic_store_n(count, seq, __ATOMIC_RELEASE);
+	vdebug_shm_wake(count);
+
+	/* the answer to short requests usually comes before a sleep would */
+	for (uint32_t done; (done = __atomic_load_n(state, __ATOMIC_ACQUIRE)) != seq; ) {
+		if (spin < VD_SHM_SPIN) {
+			spin++;
+			continue;
+		}
+		vdebug_shm_sleep(state, done);
+		if (timeval_ms() - ts > 1000) {
+			keep_alive();
+			ts = timeval_ms();
+			if (vdebug_shm_server_gone()) {
+				LOG_ERROR("shm_exchange: vdebug server removed %s", vdc.shm_path);
+				vdc.shm_lost = true;
+				return ERROR_FAIL;
+			}
+			if (ts - start > vdc.shm_timeout) {
+				LOG_ERROR("shm_exchange: no answer from the vdebug server in %" PRIu32 " ms",
+						  vdc.shm_timeout);
+				vdc.shm_lost = true;
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	return VD_SHEADER_LEN + le_to_h_u16(pm->rbytes);
+}
+#else
+static struct vd_shm *vdebug_shm_open(const char *path)
+{
+	LOG_ERROR("shared memory is not supported on this host");
+	return NULL;
+}
+
+static void vdebug_shm_close(struct vd_shm *pm)
+{
+}
+
+static int vdebug_shm_exchange(struct vd_shm *pm)
+{
+	return 0;
+}
+#endif
+
 static uint32_t vdebug_wait_server(int hsock, struct vd_shm *pmem)
 {
+	if (vdc.shm) {
+		int rd = vdebug_shm_exchange(pmem);
+		if (rd <= 0)
+			return VD_ERR_SHM_OPEN;
+		int rc = le_to_h_u32(pmem->status);
+		LOG_DEBUG_IO("wait_server: cmd %02" PRIx8 " done, shm, rcvd %d, status %d",
+					 pmem->cmd, rd, rc);
+		return rc;
+	}
+
 	if (!hsock)
 		return VD_ERR_SOC_OPEN;
 
@@ -344,12 +498,25 @@ static uint32_t vdebug_wait_server(int hsock, struct vd_shm *pmem)
 	return rc;
 }
 
+static void vdebug_log_flush(const char *queue, struct vd_shm *pm, unsigned int count,
+							 struct duration *flush)
+{
+	unsigned int bytes = VD_CHEADER_LEN + le_to_h_u16(pm->wbytes) +
+						 VD_SHEADER_LEN + le_to_h_u16(pm->rbytes);
+	float elapsed = duration_elapsed(flush);
+
+	LOG_DEBUG("%s queue: %u requests, %u bytes in %.3f ms, %.0f kB/s, over %s",
+			  queue, count, bytes, elapsed * 1000.0f,
+			  elapsed > 0 ? bytes / elapsed / 1024.0f : 0.0f, vdc.shm ? "shm" : "socket");
+}
+
 int vdebug_run_jtag_queue(int hsock, struct vd_shm *pm, unsigned int count)
 {
 	uint8_t  num_pre, num_post, tdi, tms;
 	unsigned int num, anum, bytes, hwords, words;
 	unsigned int req, waddr, rwords;
 	int64_t ts, te;
+	struct duration flush;
 	uint8_t *tdo;
 	int rc;
 	uint64_t jhdr;
@@ -361,7 +528,9 @@ int vdebug_run_jtag_queue(int hsock, struct vd_shm *pm, unsigned int count)
 	h_u16_to_le(pm->wbytes, le_to_h_u16(pm->wwords) * vdc.buf_width);
 	h_u16_to_le(pm->rbytes, le_to_h_u16(pm->rwords) * vdc.buf_width);
 	ts = timeval_ms();
+	duration_start(&flush);
 	rc = vdebug_wait_server(hsock, pm);
+	duration_measure(&flush);
 	while (!rc && (req < count)) {      /* loop over requests to read data and print out */
 		jhdr = le_to_h_u64(&pm->wd8[waddr * 4]);
 		words = jhdr >> 48;
@@ -409,6 +578,7 @@ int vdebug_run_jtag_queue(int hsock, struct vd_shm *pm, unsigned int count)
 		rc = ERROR_FAIL;
 	}
 
+	vdebug_log_flush("jtag", pm, count, &flush);
 	te = timeval_ms();
 	vdc.targ_time += (uint32_t)(te - ts);
 	h_u16_to_le(pm->offseth, 0);      /* reset buffer write address */
@@ -427,6 +597,7 @@ int vdebug_run_reg_queue(int hsock, struct vd_shm *pm, unsigned int count)
 	uint8_t aspace;
 	uint32_t addr;
 	int64_t ts, te;
+	struct duration flush;
 	uint8_t *data;
 	int rc;
 	uint64_t rhdr;
@@ -438,7 +609,9 @@ int vdebug_run_reg_queue(int hsock, struct vd_shm *pm, unsigned int count)
 	h_u16_to_le(pm->wbytes, le_to_h_u16(pm->wwords) * vdc.buf_width);
 	h_u16_to_le(pm->rbytes, le_to_h_u16(pm->rwords) * vdc.buf_width);
 	ts = timeval_ms();
+	duration_start(&flush);
 	rc = vdebug_wait_server(hsock, pm);
+	duration_measure(&flush);
 	while (!rc && (req < count)) {      /* loop over requests to read data and print out */
 		rhdr = le_to_h_u64(&pm->wd8[waddr * 4]);
 		addr = rhdr >> 32;              /* reconstruct data for a single request */
@@ -481,6 +654,7 @@ int vdebug_run_reg_queue(int hsock, struct vd_shm *pm, unsigned int count)
 		rc = ERROR_FAIL;
 	}
 
+	vdebug_log_flush("reg", pm, count, &flush);
 	te = timeval_ms();
 	vdc.targ_time += (uint32_t)(te - ts);
 	h_u16_to_le(pm->offseth, 0);      /* reset buffer write address */
@@ -833,22 +1007,60 @@ static void vdebug_mem_close(int hsock, struct vd_shm *pm, uint8_t ndx)
 }
 
 
-static int vdebug_init(void)
+static void vdebug_disconnect(void)
 {
-	vdc.hsocket = vdebug_socket_open(vdc.server_name, vdc.server_port);
-	pbuf = calloc(1, sizeof(struct vd_shm));
-	if (!pbuf) {
-		close_socket(vdc.hsocket);
-		vdc.hsocket = 0;
-		LOG_ERROR("cannot allocate %zu bytes", sizeof(struct vd_shm));
-		return ERROR_FAIL;
-	}
-	if (vdc.hsocket <= 0) {
-		free(pbuf);
+	if (vdc.shm) {
+		vdebug_shm_close(vdc.shm);
+		vdc.shm = NULL;
 		pbuf = NULL;
-		LOG_ERROR("cannot connect to vdebug server %s:%" PRIu16,
-			vdc.server_name, vdc.server_port);
-		return ERROR_FAIL;
+		return;
+	}
+	if (vdc.hsocket)
+		close_socket(vdc.hsocket);
+	vdc.hsocket = 0;
+	free(pbuf);
+	pbuf = NULL;
+}
+
+static const char *vdebug_server_desc(void)
+{
+	static char desc[sizeof(vdc.shm_path) + 8];
+
+	if (vdc.shm)
+		snprintf(desc, sizeof(desc), "shm %s", vdc.shm_path);
+	else
+		snprintf(desc, sizeof(desc), "%s:%" PRIu16, vdc.server_name, vdc.server_port);
+
+	return desc;
+}
+
+static int vdebug_init(void)
+{
+	if (vdc.shm_path[0]) {
+		vdc.shm = vdebug_shm_open(vdc.shm_path);
+		if (!vdc.shm) {
+			LOG_ERROR("cannot connect to vdebug server through shm %s", vdc.shm_path);
+			return ERROR_FAIL;
+		}
+		/* pick up the request numbering where a previous client left it */
+		vdc.shm_seq = __atomic_load_n((uint32_t *)(void *)vdc.shm->state, __ATOMIC_ACQUIRE);
+		pbuf = vdc.shm;
+	} else {
+		vdc.hsocket = vdebug_socket_open(vdc.server_name, vdc.server_port);
+		pbuf = calloc(1, sizeof(struct vd_shm));
+		if (!pbuf) {
+			close_socket(vdc.hsocket);
+			vdc.hsocket = 0;
+			LOG_ERROR("cannot allocate %zu bytes", sizeof(struct vd_shm));
+			return ERROR_FAIL;
+		}
+		if (vdc.hsocket <= 0) {
+			free(pbuf);
+			pbuf = NULL;
+			LOG_ERROR("cannot connect to vdebug server %s:%" PRIu16,
+				vdc.server_name, vdc.server_port);
+			return ERROR_FAIL;
+		}
 	}
 	vdc.trans_first = 1;
 	vdc.poll_cycles = vdc.poll_max;
@@ -859,10 +1071,7 @@ static int vdebug_init(void)
 	int rc = vdebug_open(vdc.hsocket, pbuf, vdc.bfm_path, vdc.bfm_type, vdc.bfm_period, sig_mask);
 	if (rc != 0) {
 		LOG_ERROR("0x%x cannot connect to %s", rc, vdc.bfm_path);
-		close_socket(vdc.hsocket);
-		vdc.hsocket = 0;
-		free(pbuf);
-		pbuf = NULL;
+		vdebug_disconnect();
 	} else {
 		for (uint8_t i = 0; i < vdc.mem_ndx; i++) {
 			rc = vdebug_mem_open(vdc.hsocket, pbuf, vdc.mem_path[i], i);
@@ -870,8 +1079,8 @@ static int vdebug_init(void)
 				LOG_ERROR("0x%x cannot connect to %s", rc, vdc.mem_path[i]);
 		}
 
-		LOG_INFO("vdebug %d connected to %s through %s:%" PRIu16,
-				 VD_VERSION, vdc.bfm_path, vdc.server_name, vdc.server_port);
+		LOG_INFO("vdebug %d connected to %s through %s",
+				 VD_VERSION, vdc.bfm_path, vdebug_server_desc());
 	}
 
 	return rc;
@@ -883,12 +1092,9 @@ static int vdebug_quit(void)
 		if (vdc.mem_width[i])
 			vdebug_mem_close(vdc.hsocket, pbuf, i);
 	int rc = vdebug_close(vdc.hsocket, pbuf, vdc.bfm_type);
-	LOG_INFO("vdebug %d disconnected from %s through %s:%" PRIu16 " rc:%d", VD_VERSION,
-		vdc.bfm_path, vdc.server_name, vdc.server_port, rc);
-	if (vdc.hsocket)
-		close_socket(vdc.hsocket);
-	free(pbuf);
-	pbuf = NULL;
+	LOG_INFO("vdebug %d disconnected from %s through %s rc:%d", VD_VERSION,
+		vdc.bfm_path, vdebug_server_desc(), rc);
+	vdebug_disconnect();
 
 	return ERROR_OK;
 }
@@ -1150,6 +1356,25 @@ COMMAND_HANDLER(vdebug_set_server)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(vdebug_set_shm)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+#ifndef VD_SHM_SUPPORT
+	LOG_ERROR("shared memory is not supported on this host");
+	return ERROR_FAIL;
+#else
+	strncpy(vdc.shm_path, CMD_ARGV[0], sizeof(vdc.shm_path) - 1);
+	vdc.shm_timeout = VD_SHM_TIMEOUT;
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], vdc.shm_timeout);
+	LOG_DEBUG("shm_path: %s timeout %" PRIu32 " ms", vdc.shm_path, vdc.shm_timeout);
+
+	return ERROR_OK;
+#endif
+}
+
 COMMAND_HANDLER(vdebug_set_bfm)
 {
 	char prefix;
@@ -1236,6 +1461,13 @@ static const struct command_registration vdebug_command_handlers[] = {
 		.help = "set the vdebug server name or address",
 		.usage = "<host:port>",
 	},
+	{
+		.name = "shm_path",
+		.handler = &vdebug_set_shm,
+		.mode = COMMAND_CONFIG,
+		.help = "exchange messages with the vdebug server through a shared memory region",
+		.usage = "<name> [timeout_ms]",
+	},
 	{
 		.name = "bfm_path",
 		.handler = &vdebug_set_bfm,
@@ -212,6 +212,107 @@ static int hl_interface_poll_trace(uint8_t *buf, size_t *size)
 	return ERROR_FAIL;
 }
 
+static struct hl_queued_op *hl_interface_queue_op(struct hl_interface_s *adapter,
+		enum hl_op_type type, int *retval)
+{
+	*retval = ERROR_OK;
+	if (adapter->queue_len == HLA_MAX_QUEUED_OPS) {
+		*retval = hl_interface_run_queue(adapter);
+		if (*retval != ERROR_OK)
+			return NULL;
+	}
+
+	struct hl_queued_op *op = &adapter->queue[adapter->queue_len++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	return op;
+}
+
+int hl_interface_queue_read_reg(struct hl_interface_s *adapter, unsigned int regsel,
+		uint32_t *val)
+{
+	int retval;
+	struct hl_queued_op *op = hl_interface_queue_op(adapter, HL_OP_READ_REG, &retval);
+
+	if (op) {
+		op->addr = regsel;
+		op->val = val;
+	}
+	return retval;
+}
+
+int hl_interface_queue_read_mem(struct hl_interface_s *adapter, uint32_t addr,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	int retval;
+	struct hl_queued_op *op = hl_interface_queue_op(adapter, HL_OP_READ_MEM, &retval);
+
+	if (op) {
+		op->addr = addr;
+		op->size = size;
+		op->count = count;
+		op->buffer = buffer;
+	}
+	return retval;
+}
+
+int hl_interface_queue_write_debug_reg(struct hl_interface_s *adapter, uint32_t addr,
+		uint32_t val)
+{
+	int retval;
+	struct hl_queued_op *op = hl_interface_queue_op(adapter, HL_OP_WRITE_DEBUG_REG, &retval);
+
+	if (op) {
+		op->addr = addr;
+		op->value = val;
+	}
+	return retval;
+}
+
+static int hl_interface_run_op(struct hl_interface_s *adapter, struct hl_queued_op *op)
+{
+	const struct hl_layout_api_s *api = adapter->layout->api;
+
+	switch (op->type) {
+	case HL_OP_READ_REG:
+		return api->read_reg(adapter->handle, op->addr, op->val);
+	case HL_OP_READ_MEM:
+		return api->read_mem(adapter->handle, op->addr, op->size, op->count, op->buffer);
+	case HL_OP_WRITE_DEBUG_REG:
+		return api->write_debug_reg(adapter->handle, op->addr, op->value);
+	}
+
+	return ERROR_FAIL;
+}
+
+int hl_interface_run_queue(struct hl_interface_s *adapter)
+{
+	const struct hl_layout_api_s *api = adapter->layout->api;
+	unsigned int i = 0;
+	int retval = ERROR_OK;
+
+	while (i < adapter->queue_len && retval == ERROR_OK) {
+		unsigned int executed = 0;
+
+		if (api->run_queue)
+			retval = api->run_queue(adapter->handle, &adapter->queue[i],
+					adapter->queue_len - i, &executed);
+
+		if (retval == ERROR_OK && executed == 0) {
+			retval = hl_interface_run_op(adapter, &adapter->queue[i]);
+			executed = 1;
+		}
+
+		adapter->stats.transactions++;
+		adapter->stats.queued_ops += executed;
+		i += executed;
+	}
+
+	adapter->queue_len = 0;
+
+	return retval;
+}
+
 COMMAND_HANDLER(hl_interface_handle_device_desc_command)
 {
 	LOG_DEBUG("hl_interface_handle_device_desc_command");
@@ -285,8 +386,9 @@ COMMAND_HANDLER(hl_interface_handle_stlink_backend_command)
 	/* default values */
 	bool use_stlink_tcp = false;
 	uint16_t stlink_tcp_port = 7184;
+	unsigned int stlink_tcp_pipeline = 0;
 
-	if (CMD_ARGC == 0 || CMD_ARGC > 2)
+	if (CMD_ARGC == 0 || CMD_ARGC > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	else if (strcmp(CMD_ARGV[0], "usb") == 0) {
 		if (CMD_ARGC > 1)
@@ -294,13 +396,16 @@ COMMAND_HANDLER(hl_interface_handle_stlink_backend_command)
 		/* else use_stlink_tcp = false (already the case ) */
 	} else if (strcmp(CMD_ARGV[0], "tcp") == 0) {
 		use_stlink_tcp = true;
-		if (CMD_ARGC == 2)
+		if (CMD_ARGC >= 2)
 			COMMAND_PARSE_NUMBER(u16, CMD_ARGV[1], stlink_tcp_port);
+		if (CMD_ARGC == 3)
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], stlink_tcp_pipeline);
 	} else
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	hl_if.param.use_stlink_tcp = use_stlink_tcp;
 	hl_if.param.stlink_tcp_port = stlink_tcp_port;
+	hl_if.param.stlink_tcp_pipeline = stlink_tcp_pipeline;
 
 	return ERROR_OK;
 }
@@ -320,6 +425,30 @@ COMMAND_HANDLER(interface_handle_hla_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(hl_interface_handle_stats_command)
+{
+	struct hl_interface_stats *stats = &hl_if.stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "queued_ops             %" PRIu64, stats->queued_ops);
+	command_print(CMD, "transactions           %" PRIu64, stats->transactions);
+	command_print(CMD, "halts                  %" PRIu64, stats->halts);
+	command_print(CMD, "transactions_per_halt  %.1f", stats->halts ?
+		(double)stats->halt_transactions / stats->halts : 0.0);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration hl_interface_command_handlers[] = {
 	{
 	 .name = "hla_device_desc",
@@ -347,7 +476,7 @@ static const struct command_registration hl_interface_command_handlers[] = {
 	 .handler = &hl_interface_handle_stlink_backend_command,
 	 .mode = COMMAND_CONFIG,
 	 .help = "select which ST-Link backend to use",
-	 .usage = "usb | tcp [port]",
+	 .usage = "usb | tcp [port [pipeline_depth]]",
 	},
 	 {
 	 .name = "hla_command",
@@ -356,6 +485,14 @@ static const struct command_registration hl_interface_command_handlers[] = {
 	 .help = "execute a custom adapter-specific command",
 	 .usage = "<command>",
 	 },
+	{
+	 .name = "hla_stats",
+	 .handler = &hl_interface_handle_stats_command,
+	 .mode = COMMAND_EXEC,
+	 .help = "show or reset the counters of queued adapter operations "
+		"and of the transactions taken by each halt",
+	 .usage = "['reset']",
+	 },
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -20,6 +20,9 @@ extern const char *hl_transports[];
 
 #define HLA_MAX_USB_IDS 16
 
+/** max number of operations waiting in the queue of an adapter */
+#define HLA_MAX_QUEUED_OPS 96
+
 struct hl_interface_param_s {
 	/** */
 	const char *device_desc;
@@ -37,6 +40,42 @@ struct hl_interface_param_s {
 	bool use_stlink_tcp;
 	/** */
 	uint16_t stlink_tcp_port;
+	/** max number of memory chunks in flight to stlink-server, 0 or 1 to wait for each */
+	unsigned int stlink_tcp_pipeline;
+};
+
+/** Kind of operation queued to an adapter */
+enum hl_op_type {
+	HL_OP_READ_REG,
+	HL_OP_READ_MEM,
+	HL_OP_WRITE_DEBUG_REG,
+};
+
+/** One operation queued to an adapter, see hl_interface_run_queue() */
+struct hl_queued_op {
+	/** */
+	enum hl_op_type type;
+	/** register selection for HL_OP_READ_REG, address otherwise */
+	uint32_t addr;
+	/** access size and count for HL_OP_READ_MEM */
+	uint32_t size;
+	uint32_t count;
+	/** value for HL_OP_WRITE_DEBUG_REG */
+	uint32_t value;
+	/** where HL_OP_READ_REG stores the register */
+	uint32_t *val;
+	/** where HL_OP_READ_MEM stores the data */
+	uint8_t *buffer;
+};
+
+struct hl_interface_stats {
+	/** operations run through the queue */
+	uint64_t queued_ops;
+	/** calls into the layout needed to run them */
+	uint64_t transactions;
+	/** debug entries of the targets, and the calls they needed */
+	uint64_t halts;
+	uint64_t halt_transactions;
 };
 
 struct hl_interface_s {
@@ -46,6 +85,11 @@ struct hl_interface_s {
 	const struct hl_layout *layout;
 	/** */
 	void *handle;
+	/** operations waiting for hl_interface_run_queue() */
+	struct hl_queued_op queue[HLA_MAX_QUEUED_OPS];
+	unsigned int queue_len;
+	/** */
+	struct hl_interface_stats stats;
 };
 
 /** */
@@ -56,4 +100,23 @@ int hl_interface_init_target(struct target *t);
 int hl_interface_init_reset(void);
 int hl_interface_override_target(const char **targetname);
 
+/**
+ * Queue operations to the adapter. They run in order, at the latest
+ * on hl_interface_run_queue(); the results are only valid after it.
+ * A full queue is run first, and its error returned.
+ */
+int hl_interface_queue_read_reg(struct hl_interface_s *adapter, unsigned int regsel,
+		uint32_t *val);
+int hl_interface_queue_read_mem(struct hl_interface_s *adapter, uint32_t addr,
+		uint32_t size, uint32_t count, uint8_t *buffer);
+int hl_interface_queue_write_debug_reg(struct hl_interface_s *adapter, uint32_t addr,
+		uint32_t val);
+/**
+ * Run the queued operations, batched by the layout when it can,
+ * one by one otherwise. The queue is empty afterwards, even on error.
+ *
+ * @returns ERROR_OK on success, or the error of the first failing operation.
+ */
+int hl_interface_run_queue(struct hl_interface_s *adapter);
+
 #endif /* OPENOCD_JTAG_HLA_HLA_INTERFACE_H */
@@ -17,6 +17,8 @@
 /** */
 struct hl_interface_s;
 struct hl_interface_param_s;
+/** */
+struct hl_queued_op;
 
 /** */
 extern struct hl_layout_api_s stlink_usb_layout_api;
@@ -114,6 +116,22 @@ struct hl_layout_api_s {
 	int (*poll_trace)(void *handle, uint8_t *buf, size_t *size);
 	/** */
 	enum target_state (*state)(void *fd);
+	/**
+	 * Run queued operations in a single exchange with the adapter, optional
+	 *
+	 * The layout starts at ops[0] and takes as many following operations
+	 * as it can combine with it. Operations it does not take are run one
+	 * by one through the other callbacks.
+	 *
+	 * @param handle A pointer to the device-specific handle
+	 * @param ops The queued operations, in order
+	 * @param count Number of operations in ops
+	 * @param executed Storage for the number of operations run, 0 if
+	 * ops[0] can't be batched
+	 * @returns ERROR_OK on success, or an error code on failure.
+	 */
+	int (*run_queue)(void *handle, struct hl_queued_op *ops, unsigned int count,
+			unsigned int *executed);
 };
 
 /** */
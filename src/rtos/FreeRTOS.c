@@ -167,7 +167,7 @@ static int freertos_update_threads(struct rtos *rtos)
 	}
 
 	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 			rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
 			&thread_list_size);
 	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
@@ -184,7 +184,7 @@ static int freertos_update_threads(struct rtos *rtos)
 
 	/* read the current thread */
 	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
 			&pointer_casts_are_bad);
 	if (retval != ERROR_OK) {
@@ -198,7 +198,7 @@ static int freertos_update_threads(struct rtos *rtos)
 
 	/* read scheduler running */
 	uint32_t scheduler_running;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
 			&scheduler_running);
 	if (retval != ERROR_OK) {
@@ -226,6 +226,7 @@ static int freertos_update_threads(struct rtos *rtos)
 		rtos->thread_details->threadid = rtos->current_thread;
 		rtos->thread_details->exists = true;
 		rtos->thread_details->extra_info_str = NULL;
+		rtos->thread_details->tcb_state = 0;
 		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
 		strcpy(rtos->thread_details->thread_name_str, tmp_str);
 
@@ -249,7 +250,7 @@ static int freertos_update_threads(struct rtos *rtos)
 		return ERROR_FAIL;
 	}
 	uint32_t top_used_priority = 0;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
 			&top_used_priority);
 	if (retval != ERROR_OK)
@@ -288,13 +289,20 @@ static int freertos_update_threads(struct rtos *rtos)
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
 	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
 
+	/* Bring all the ready lists in at once, they are walked from the snapshot. */
+	rtos_snapshot_prefetch(rtos, rtos->symbols[FREERTOS_VAL_PX_READY_TASKS_LISTS].address,
+			config_max_priorities * param->list_width);
+
 	for (unsigned int i = 0; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
 
+		/* the count and the first item in a single transfer */
+		rtos_snapshot_prefetch(rtos, list_of_lists[i], param->list_width);
+
 		/* Read the number of threads in this list */
 		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 				list_of_lists[i],
 				&list_thread_count);
 		if (retval != ERROR_OK) {
@@ -311,7 +319,7 @@ static int freertos_update_threads(struct rtos *rtos)
 		/* Read the location of first list item */
 		uint32_t prev_list_elem_ptr = -1;
 		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 				list_of_lists[i] + param->list_next_offset,
 				&list_elem_ptr);
 		if (retval != ERROR_OK) {
@@ -327,7 +335,7 @@ static int freertos_update_threads(struct rtos *rtos)
 				(tasks_found < thread_list_size)) {
 			/* Get the location of the thread structure. */
 			rtos->thread_details[tasks_found].threadid = 0;
-			retval = target_read_u32(rtos->target,
+			retval = rtos_snapshot_read_u32(rtos,
 					list_elem_ptr + param->list_elem_content_offset,
 					&pointer_casts_are_bad);
 			if (retval != ERROR_OK) {
@@ -340,32 +348,59 @@ static int freertos_update_threads(struct rtos *rtos)
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
-			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
-
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
+			/* Bring the TCB in at once, up to the first bytes of the name: its
+			 * list item, pxStack and the stack pointer read for 'g'. */
+			rtos_snapshot_prefetch(rtos, rtos->thread_details[tasks_found].threadid,
+					param->thread_name_offset + 8);
+
+			/* pxStack, stored right before the name, is set when the task
+			 * is created: along with the start of the name it tells
+			 * whether the TCB still holds the task of the last update. */
+			uint8_t tcb_head[8];
+			retval = rtos_snapshot_read_buffer(rtos,
+					rtos->thread_details[tasks_found].threadid + param->thread_name_offset -
+					param->pointer_width, sizeof(tcb_head), tcb_head);
 			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
+				LOG_ERROR("Error reading thread stack and name in FreeRTOS thread list");
 				free(list_of_lists);
 				return retval;
 			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+			uint64_t tcb_state = (uint64_t)target_buffer_get_u32(rtos->target, tcb_head) << 32 |
+				target_buffer_get_u32(rtos->target, tcb_head + 4);
+			rtos->thread_details[tasks_found].tcb_state = tcb_state;
+
+			char *name = rtos_thread_unchanged(rtos,
+					rtos->thread_details[tasks_found].threadid, tcb_state);
+			if (name) {
+				rtos->thread_details[tasks_found].thread_name_str = name;
+			} else {
+				/* get thread name */
+
+				#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+				char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+
+				/* Read the thread name */
+				retval = rtos_snapshot_read_buffer(rtos,
+						rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
+						FREERTOS_THREAD_NAME_STR_SIZE,
+						(uint8_t *)&tmp_str);
+				if (retval != ERROR_OK) {
+					LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
+					free(list_of_lists);
+					return retval;
+				}
+				tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
+				LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
+											rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
+											tmp_str);
+
+				if (tmp_str[0] == '\x00')
+					strcpy(tmp_str, "No Name");
+
+				rtos->thread_details[tasks_found].thread_name_str =
+					malloc(strlen(tmp_str)+1);
+				strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
+			}
 			rtos->thread_details[tasks_found].exists = true;
 
 			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
@@ -382,7 +417,7 @@ static int freertos_update_threads(struct rtos *rtos)
 
 			prev_list_elem_ptr = list_elem_ptr;
 			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
+			retval = rtos_snapshot_read_u32(rtos,
 					prev_list_elem_ptr + param->list_elem_next_offset,
 					&list_elem_ptr);
 			if (retval != ERROR_OK) {
@@ -421,7 +456,7 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 
 	/* Read the stack pointer */
 	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 			thread_id + param->thread_stack_offset,
 			&pointer_casts_are_bad);
 	if (retval != ERROR_OK) {
@@ -457,9 +492,12 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	}
 
 	if (cm4_fpu_enabled == 1) {
+		/* the LR and the frame without FPU context in a single transfer */
+		rtos_snapshot_prefetch(rtos, stack_ptr, param->stacking_info_cm4f->stack_registers_size);
+
 		/* Read the LR to decide between stacking with or without FPU */
 		uint32_t lr_svc = 0;
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 				stack_ptr + 0x20,
 				&lr_svc);
 		if (retval != ERROR_OK) {
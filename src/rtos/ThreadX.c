@@ -18,8 +18,8 @@
 #include "helper/types.h"
 #include "rtos_standard_stackings.h"
 
-static const struct rtos_register_stacking *get_stacking_info(const struct rtos *rtos, int64_t stack_ptr);
-static const struct rtos_register_stacking *get_stacking_info_arm926ejs(const struct rtos *rtos, int64_t stack_ptr);
+static const struct rtos_register_stacking *get_stacking_info(struct rtos *rtos, int64_t stack_ptr);
+static const struct rtos_register_stacking *get_stacking_info_arm926ejs(struct rtos *rtos, int64_t stack_ptr);
 
 static int is_thread_id_valid(const struct rtos *rtos, int64_t thread_id);
 static int is_thread_id_valid_arm926ejs(const struct rtos *rtos, int64_t thread_id);
@@ -123,7 +123,7 @@ struct threadx_params {
 	unsigned char thread_next_offset;
 	const struct rtos_register_stacking *stacking_info;
 	size_t stacking_info_nb;
-	const struct rtos_register_stacking* (*fn_get_stacking_info)(const struct rtos *rtos, int64_t stack_ptr);
+	const struct rtos_register_stacking* (*fn_get_stacking_info)(struct rtos *rtos, int64_t stack_ptr);
 	int (*fn_is_thread_id_valid)(const struct rtos *rtos, int64_t thread_id);
 };
 
@@ -201,7 +201,7 @@ const struct rtos_type threadx_rtos = {
 	.get_symbol_list_to_lookup = threadx_get_symbol_list_to_lookup,
 };
 
-static const struct rtos_register_stacking *get_stacking_info(const struct rtos *rtos, int64_t stack_ptr)
+static const struct rtos_register_stacking *get_stacking_info(struct rtos *rtos, int64_t stack_ptr)
 {
 	const struct threadx_params *param = (const struct threadx_params *) rtos->rtos_specific_params;
 
@@ -226,13 +226,16 @@ static int is_thread_id_valid(const struct rtos *rtos, int64_t thread_id)
 	return (thread_id != 0);
 }
 
-static const struct rtos_register_stacking *get_stacking_info_arm926ejs(const struct rtos *rtos, int64_t stack_ptr)
+static const struct rtos_register_stacking *get_stacking_info_arm926ejs(struct rtos *rtos, int64_t stack_ptr)
 {
 	const struct threadx_params *param = (const struct threadx_params *) rtos->rtos_specific_params;
 	int	retval;
 	uint32_t flag;
 
-	retval = target_read_buffer(rtos->target,
+	/* the flag and the larger of the two frames in a single transfer */
+	rtos_snapshot_prefetch(rtos, stack_ptr, ARM926EJS_REGISTERS_SIZE_INTERRUPT);
+
+	retval = rtos_snapshot_read_buffer(rtos,
 			stack_ptr,
 			sizeof(flag),
 			(uint8_t *)&flag);
@@ -255,6 +258,16 @@ static int is_thread_id_valid_arm926ejs(const struct rtos *rtos, int64_t thread_
 	return (thread_id != 0 && thread_id != 1);
 }
 
+/* Size of the part of a TCB read by this driver */
+static uint32_t threadx_tcb_size(const struct threadx_params *param)
+{
+	uint32_t size = param->thread_stack_offset + param->pointer_width;
+
+	size = MAX(size, (uint32_t)param->thread_name_offset + param->pointer_width);
+	size = MAX(size, (uint32_t)param->thread_state_offset + 4);
+	return MAX(size, (uint32_t)param->thread_next_offset + param->pointer_width);
+}
+
 static int threadx_update_threads(struct rtos *rtos)
 {
 	int retval;
@@ -281,7 +294,7 @@ static int threadx_update_threads(struct rtos *rtos)
 	}
 
 	/* read the number of threads */
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			rtos->symbols[THREADX_VAL_TX_THREAD_CREATED_COUNT].address,
 			4,
 			(uint8_t *)&thread_list_size);
@@ -295,7 +308,7 @@ static int threadx_update_threads(struct rtos *rtos)
 	rtos_free_threadlist(rtos);
 
 	/* read the current thread id */
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			rtos->symbols[THREADX_VAL_TX_THREAD_CURRENT_PTR].address,
 			4,
 			(uint8_t *)&rtos->current_thread);
@@ -338,7 +351,7 @@ static int threadx_update_threads(struct rtos *rtos)
 
 	/* Read the pointer to the first thread */
 	int64_t thread_ptr = 0;
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			rtos->symbols[THREADX_VAL_TX_THREAD_CREATED_PTR].address,
 			param->pointer_width,
 			(uint8_t *)&thread_ptr);
@@ -359,8 +372,11 @@ static int threadx_update_threads(struct rtos *rtos)
 		/* Save the thread pointer */
 		rtos->thread_details[tasks_found].threadid = thread_ptr;
 
+		/* all the fields read below, and the stack pointer for 'g', at once */
+		rtos_snapshot_prefetch(rtos, thread_ptr, threadx_tcb_size(param));
+
 		/* read the name pointer */
-		retval = target_read_buffer(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_ptr + param->thread_name_offset,
 				param->pointer_width,
 				(uint8_t *)&name_ptr);
@@ -375,7 +391,7 @@ static int threadx_update_threads(struct rtos *rtos)
 		/* Check if thread has a valid name */
 		if (name_ptr != 0) {
 			retval =
-				target_read_buffer(rtos->target,
+				rtos_snapshot_read_buffer(rtos,
 					name_ptr,
 					THREADX_THREAD_NAME_STR_SIZE,
 					(uint8_t *)&tmp_str);
@@ -395,7 +411,7 @@ static int threadx_update_threads(struct rtos *rtos)
 
 		/* Read the thread status */
 		int64_t thread_status = 0;
-		retval = target_read_buffer(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_ptr + param->thread_state_offset,
 				4,
 				(uint8_t *)&thread_status);
@@ -426,7 +442,7 @@ static int threadx_update_threads(struct rtos *rtos)
 
 		/* Get the location of the next thread structure. */
 		thread_ptr = 0;
-		retval = target_read_buffer(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				prev_thread_ptr + param->thread_next_offset,
 				param->pointer_width,
 				(uint8_t *) &thread_ptr);
@@ -460,7 +476,7 @@ static int threadx_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 
 	/* Read the stack pointer */
 	int64_t stack_ptr = 0;
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			thread_id + param->thread_stack_offset,
 			param->pointer_width,
 			(uint8_t *)&stack_ptr);
@@ -548,7 +564,7 @@ static int threadx_get_thread_detail(struct rtos *rtos,
 
 	int64_t name_ptr = 0;
 	/* read the name pointer */
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			thread_id + param->thread_name_offset,
 			param->pointer_width,
 			(uint8_t *)&name_ptr);
@@ -558,7 +574,7 @@ static int threadx_get_thread_detail(struct rtos *rtos,
 	}
 
 	/* Read the thread name */
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			name_ptr,
 			THREADX_THREAD_NAME_STR_SIZE,
 			(uint8_t *)&tmp_str);
@@ -576,7 +592,7 @@ static int threadx_get_thread_detail(struct rtos *rtos,
 	/* Read the thread status */
 	int64_t thread_status = 0;
 	retval =
-		target_read_buffer(rtos->target,
+		rtos_snapshot_read_buffer(rtos,
 			thread_id + param->thread_state_offset,
 			4,
 			(uint8_t *)&thread_status);
@@ -147,7 +147,7 @@ static int chibios_update_memory_signature(struct rtos *rtos)
 		return -1;
 	}
 
-	retval = target_read_buffer(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 								rtos->symbols[CHIBIOS_VAL_CH_DEBUG].address,
 								sizeof(*signature),
 								(uint8_t *) signature);
@@ -302,7 +302,7 @@ static int chibios_update_threads(struct rtos *rtos)
 	current = rlist;
 	previous = rlist;
 	while (1) {
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 								 current + signature->cf_off_newer, &current);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not read next ChibiOS thread");
@@ -316,8 +316,11 @@ static int chibios_update_threads(struct rtos *rtos)
 			rtos_valid = 0;
 			break;
 		}
+		/* The whole thread structure at once: the list walk below and 'g'
+		 * are served from the snapshot. */
+		rtos_snapshot_prefetch(rtos, current, signature->ch_threadsize);
 		/* Fetch previous thread in the list as a integrity check. */
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 								 current + signature->cf_off_older, &older);
 		if ((retval != ERROR_OK) || (older == 0) || (older != previous)) {
 			LOG_ERROR("ChibiOS registry integrity check failed, "
@@ -372,7 +375,7 @@ static int chibios_update_threads(struct rtos *rtos)
 		uint32_t name_ptr = 0;
 		char tmp_str[CHIBIOS_THREAD_NAME_STR_SIZE];
 
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 								 current + signature->cf_off_newer, &current);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not read next ChibiOS thread");
@@ -387,7 +390,7 @@ static int chibios_update_threads(struct rtos *rtos)
 		curr_thrd_details->threadid = current;
 
 		/* read the name pointer */
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 								 current + signature->cf_off_name, &name_ptr);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not read ChibiOS thread name pointer from target");
@@ -395,7 +398,7 @@ static int chibios_update_threads(struct rtos *rtos)
 		}
 
 		/* Read the thread name */
-		retval = target_read_buffer(rtos->target, name_ptr,
+		retval = rtos_snapshot_read_buffer(rtos, name_ptr,
 									CHIBIOS_THREAD_NAME_STR_SIZE,
 									(uint8_t *)&tmp_str);
 		if (retval != ERROR_OK) {
@@ -415,7 +418,7 @@ static int chibios_update_threads(struct rtos *rtos)
 		uint8_t thread_state;
 		const char *state_desc;
 
-		retval = target_read_u8(rtos->target,
+		retval = rtos_snapshot_read_u8(rtos,
 								current + signature->cf_off_state, &thread_state);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Error reading thread state from ChibiOS target");
@@ -439,7 +442,7 @@ static int chibios_update_threads(struct rtos *rtos)
 
 	uint32_t current_thrd;
 	/* NOTE: By design, cf_off_name equals readylist_current_offset */
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 							 rlist + signature->cf_off_name,
 							 &current_thrd);
 	if (retval != ERROR_OK) {
@@ -475,7 +478,7 @@ static int chibios_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	}
 
 	/* Read the stack pointer */
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 							 thread_id + param->signature->cf_off_ctx, &stack_ptr);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Error reading stack frame from ChibiOS thread");
@@ -13,7 +13,9 @@
 #include "target/target.h"
 #include "helper/log.h"
 #include "helper/binarybuffer.h"
+#include "helper/time_support.h"
 #include "server/gdb_server.h"
+#include "target/smp.h"
 
 /* RTOSs */
 extern struct rtos_type freertos_rtos;
@@ -48,7 +50,27 @@ static struct rtos_type *rtos_types[] = {
 	NULL
 };
 
+/* Target memory read for a snapshot is kept in aligned blocks of this size.
+ * Only the bytes the RTOS support asked for are read, never the rest of a
+ * block, which may be a peripheral or not mapped at all. */
+#define RTOS_SNAPSHOT_BLOCK_SIZE	256
+/* Upper bound of the target memory held by a snapshot. */
+#define RTOS_SNAPSHOT_MAX_BLOCKS	256
+
+struct rtos_snapshot_block {
+	target_addr_t address;
+	/* Bytes start to end - 1 of data hold target memory. */
+	uint16_t start;
+	uint16_t end;
+	uint8_t data[RTOS_SNAPSHOT_BLOCK_SIZE];
+};
+
 static int rtos_try_next(struct target *target);
+static int rtos_snapshot_event(struct target *target, enum target_event event, void *priv);
+static void rtos_threads_free(struct rtos *rtos);
+static int rtos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
+		struct rtos_reg **reg_list, int *num_regs);
+static bool rtos_thread_regs_cached(struct rtos *rtos, int64_t thread_id);
 
 int rtos_thread_packet(struct connection *connection, const char *packet, int packet_size);
 
@@ -85,6 +107,8 @@ static int os_alloc(struct target *target, struct rtos_type *ostype)
 	os->gdb_thread_packet = rtos_thread_packet;
 	os->gdb_target_for_threadid = rtos_target_for_threadid;
 
+	target_register_event_callback(rtos_snapshot_event, os);
+
 	return JIM_OK;
 }
 
@@ -93,6 +117,9 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	target_unregister_event_callback(rtos_snapshot_event, target->rtos);
+	free(target->rtos->snapshot.blocks);
+	rtos_threads_free(target->rtos);
 	free(target->rtos->symbols);
 	free(target->rtos);
 	target->rtos = NULL;
@@ -408,7 +435,8 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 				target->rtos_auto_detect = false;
 				target->rtos->type->create(target);
 			}
-			target->rtos->type->update_threads(target->rtos);
+			rtos_snapshot_invalidate(target->rtos);
+			rtos_update_threads(target);
 		}
 		return ERROR_OK;
 	} else if (strncmp(packet, "qfThreadInfo", 12) == 0) {
@@ -533,7 +561,8 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										target->rtos->current_thread);
 
 		int retval;
-		if (target->rtos->type->get_thread_reg) {
+		if (target->rtos->type->get_thread_reg &&
+				!rtos_thread_regs_cached(target->rtos, current_threadid)) {
 			reg_list = calloc(1, sizeof(*reg_list));
 			num_regs = 1;
 			retval = target->rtos->type->get_thread_reg(target->rtos,
@@ -543,7 +572,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
+			retval = rtos_get_thread_reg_list(target->rtos,
 					current_threadid,
 					&reg_list,
 					&num_regs);
@@ -583,7 +612,7 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		int retval = rtos_get_thread_reg_list(target->rtos,
 				current_threadid,
 				&reg_list,
 				&num_regs);
@@ -609,6 +638,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_snapshot_invalidate(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -632,7 +662,11 @@ int rtos_generic_stack_read(struct target *target,
 
 	if (stacking->stack_growth_direction == 1)
 		address -= stacking->stack_registers_size;
-	retval = target_read_buffer(target, address, stacking->stack_registers_size, stack_data);
+	if (target->rtos)
+		retval = rtos_snapshot_read_buffer(target->rtos, address,
+				stacking->stack_registers_size, stack_data);
+	else
+		retval = target_read_buffer(target, address, stacking->stack_registers_size, stack_data);
 	if (retval != ERROR_OK) {
 		free(stack_data);
 		LOG_ERROR("Error reading stack frame from thread");
@@ -697,10 +731,271 @@ static int rtos_try_next(struct target *target)
 	return 1;
 }
 
+static bool rtos_name_interned(const struct rtos *rtos, const char *name)
+{
+	for (unsigned int i = 0; i < rtos->num_names; i++)
+		if (rtos->names[i] == name)
+			return true;
+
+	return false;
+}
+
+/**
+ * Take ownership of a thread name read by the RTOS driver. Returns the
+ * stored copy of an equal name, freeing @a name, or stores @a name.
+ */
+static char *rtos_intern_name(struct rtos *rtos, char *name)
+{
+	for (unsigned int i = 0; i < rtos->num_names; i++) {
+		if (rtos->names[i] == name)
+			return name;
+		if (!strcmp(rtos->names[i], name)) {
+			free(name);
+			return rtos->names[i];
+		}
+	}
+
+	char **names = realloc(rtos->names, (rtos->num_names + 1) * sizeof(*names));
+	if (!names)
+		return name;
+	rtos->names = names;
+	rtos->names[rtos->num_names++] = name;
+
+	return name;
+}
+
+/* Free the names no thread uses any more. */
+static void rtos_prune_names(struct rtos *rtos)
+{
+	unsigned int kept = 0;
+
+	for (unsigned int i = 0; i < rtos->num_names; i++) {
+		bool used = false;
+		for (unsigned int j = 0; j < rtos->num_threads && !used; j++)
+			used = rtos->threads[j].name == rtos->names[i];
+
+		if (used)
+			rtos->names[kept++] = rtos->names[i];
+		else
+			free(rtos->names[i]);
+	}
+	rtos->num_names = kept;
+}
+
+static int rtos_thread_cmp(const void *a, const void *b)
+{
+	const struct rtos_thread *ta = a;
+	const struct rtos_thread *tb = b;
+
+	if (ta->threadid < tb->threadid)
+		return -1;
+	return ta->threadid > tb->threadid;
+}
+
+static struct rtos_thread *rtos_find_thread(const struct rtos *rtos, threadid_t threadid)
+{
+	struct rtos_thread key = { .threadid = threadid };
+
+	if (!rtos->threads)
+		return NULL;
+
+	return bsearch(&key, rtos->threads, rtos->num_threads, sizeof(key), rtos_thread_cmp);
+}
+
+static bool rtos_str_equal(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a == b;
+	return !strcmp(a, b);
+}
+
+static void rtos_thread_drop_regs(struct rtos_thread *thread)
+{
+	free(thread->reg_list);
+	thread->reg_list = NULL;
+	thread->num_regs = 0;
+}
+
+static void rtos_threads_free(struct rtos *rtos)
+{
+	for (unsigned int i = 0; i < rtos->num_threads; i++) {
+		free(rtos->threads[i].extra_info);
+		rtos_thread_drop_regs(&rtos->threads[i]);
+	}
+	free(rtos->threads);
+	rtos->threads = NULL;
+	rtos->num_threads = 0;
+
+	for (unsigned int i = 0; i < rtos->num_names; i++)
+		free(rtos->names[i]);
+	free(rtos->names);
+	rtos->names = NULL;
+	rtos->num_names = 0;
+}
+
+/**
+ * Merge the thread list just read by the RTOS driver into the persistent
+ * thread table. Threads are matched by id; the names are interned, so the
+ * strings of known threads are shared instead of kept once per stop.
+ */
+static void rtos_threads_update(struct rtos *rtos)
+{
+	unsigned int count = rtos->thread_count > 0 ? rtos->thread_count : 0;
+	struct rtos_thread *threads = calloc(count ? count : 1, sizeof(*threads));
+	if (!threads) {
+		LOG_ERROR("Out of memory");
+		return;
+	}
+
+	unsigned int added = 0, changed = 0, kept = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+		struct rtos_thread *thread = &threads[i];
+
+		if (detail->thread_name_str)
+			detail->thread_name_str = rtos_intern_name(rtos, detail->thread_name_str);
+
+		thread->threadid = detail->threadid;
+		thread->name = detail->thread_name_str;
+		thread->tcb_state = detail->tcb_state;
+
+		struct rtos_thread *old = rtos_find_thread(rtos, detail->threadid);
+		bool same_state = old && rtos_str_equal(old->extra_info, detail->extra_info_str);
+		if (same_state) {
+			/* Keep the copy of the unchanged state. */
+			thread->extra_info = old->extra_info;
+			old->extra_info = NULL;
+		} else if (detail->extra_info_str) {
+			thread->extra_info = strdup(detail->extra_info_str);
+		}
+
+		if (!old) {
+			added++;
+		} else {
+			kept++;
+			if (!same_state || old->name != thread->name)
+				changed++;
+		}
+	}
+
+	unsigned int removed = rtos->num_threads - MIN(kept, rtos->num_threads);
+
+	for (unsigned int i = 0; i < rtos->num_threads; i++) {
+		free(rtos->threads[i].extra_info);
+		rtos_thread_drop_regs(&rtos->threads[i]);
+	}
+	free(rtos->threads);
+
+	qsort(threads, count, sizeof(*threads), rtos_thread_cmp);
+	rtos->threads = threads;
+	rtos->num_threads = count;
+	rtos_prune_names(rtos);
+
+	LOG_DEBUG("RTOS: %u threads, %u new, %u changed, %u gone", count, added, changed, removed);
+}
+
+/**
+ * Let an RTOS driver skip reading a control block again, e.g. its name,
+ * while it builds a new thread list. @a tcb_state is a fingerprint the
+ * driver reads cheaply from the block, such as a field fixed when the
+ * thread is created, and records in thread_detail::tcb_state.
+ *
+ * Returns the name of thread @a threadid from the previous list if it was
+ * recorded there with the same @a tcb_state, else NULL. The name belongs to
+ * the RTOS support and goes into thread_detail::thread_name_str as is.
+ */
+char *rtos_thread_unchanged(struct rtos *rtos, threadid_t threadid, uint64_t tcb_state)
+{
+	const struct rtos_thread *thread = rtos_find_thread(rtos, threadid);
+
+	if (!thread || !thread->name || thread->tcb_state != tcb_state)
+		return NULL;
+
+	rtos->stop_stats.tcbs_unchanged++;
+	return (char *)thread->name;
+}
+
+static bool rtos_thread_regs_cached(struct rtos *rtos, int64_t thread_id)
+{
+	const struct rtos_thread *thread = rtos_find_thread(rtos, thread_id);
+
+	return thread && thread->reg_list;
+}
+
+/**
+ * Registers of a thread, fetched by the RTOS driver the first time GDB asks
+ * for them at a stop and from the thread table afterwards. The caller frees
+ * the list.
+ */
+static int rtos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
+		struct rtos_reg **reg_list, int *num_regs)
+{
+	struct rtos_thread *thread = rtos_find_thread(rtos, thread_id);
+	struct rtos_stop_stats *stats = &rtos->stop_stats;
+
+	if (thread && thread->reg_list) {
+		*reg_list = malloc(thread->num_regs * sizeof(**reg_list));
+		if (!*reg_list)
+			return ERROR_FAIL;
+		memcpy(*reg_list, thread->reg_list, thread->num_regs * sizeof(**reg_list));
+		*num_regs = thread->num_regs;
+		stats->reg_hits++;
+		return ERROR_OK;
+	}
+
+	int64_t start = timeval_ms();
+	int retval = rtos->type->get_thread_reg_list(rtos, thread_id, reg_list, num_regs);
+	stats->regs_ms += timeval_ms() - start;
+	stats->reg_fetches++;
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Keep them while the snapshot they were read from is valid. */
+	if (thread && rtos->snapshot.valid && !rtos->target->smp && *num_regs > 0) {
+		thread->reg_list = malloc(*num_regs * sizeof(**reg_list));
+		if (thread->reg_list) {
+			memcpy(thread->reg_list, *reg_list, *num_regs * sizeof(**reg_list));
+			thread->num_regs = *num_regs;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos) && (target->rtos->type))
-		target->rtos->type->update_threads(target->rtos);
+	struct rtos *rtos = target->rtos;
+
+	if (!rtos || !rtos->type)
+		return ERROR_OK;
+
+	/* The thread list only changes while the target runs. With SMP the
+	 * other cores are not tracked, so always walk the list again. */
+	if (rtos->snapshot.valid && !target->smp && target->state == TARGET_HALTED) {
+		LOG_DEBUG("RTOS: reusing thread list of %s", target_name(target));
+		return ERROR_OK;
+	}
+
+	struct rtos_stop_stats *stats = &rtos->stop_stats;
+	if (stats->threads_ms || stats->reg_fetches)
+		LOG_DEBUG("RTOS: previous stop of %s cost %" PRId64 " ms: thread list %" PRId64
+				" ms, %u register fetches %" PRId64 " ms, %u from cache",
+				target_name(target), stats->threads_ms + stats->regs_ms,
+				stats->threads_ms, stats->reg_fetches, stats->regs_ms, stats->reg_hits);
+	memset(stats, 0, sizeof(*stats));
+
+	int64_t start = timeval_ms();
+
+	rtos_snapshot_invalidate(rtos);
+	int retval = rtos->type->update_threads(rtos);
+	rtos->snapshot.valid = retval == ERROR_OK && target->state == TARGET_HALTED;
+	if (retval == ERROR_OK)
+		rtos_threads_update(rtos);
+
+	stats->threads_ms = timeval_ms() - start;
+	LOG_DEBUG("RTOS: read %d threads of %s in %" PRId64 " ms, %u transfers, %" PRIu64 " bytes, "
+			"%u unchanged", rtos->thread_count, target_name(target), stats->threads_ms,
+			rtos->snapshot.transfers, rtos->snapshot.bytes, stats->tcbs_unchanged);
 	return ERROR_OK;
 }
 
@@ -711,7 +1006,8 @@ void rtos_free_threadlist(struct rtos *rtos)
 
 		for (j = 0; j < rtos->thread_count; j++) {
 			struct thread_detail *current_thread = &rtos->thread_details[j];
-			free(current_thread->thread_name_str);
+			if (!rtos_name_interned(rtos, current_thread->thread_name_str))
+				free(current_thread->thread_name_str);
 			free(current_thread->extra_info_str);
 		}
 		free(rtos->thread_details);
@@ -737,3 +1033,245 @@ int rtos_write_buffer(struct target *target, target_addr_t address,
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
 	return ERROR_NOT_IMPLEMENTED;
 }
+
+/**
+ * Drop the snapshot of target memory. The next rtos_update_threads() walks
+ * the kernel data structures again.
+ */
+void rtos_snapshot_invalidate(struct rtos *rtos)
+{
+	struct rtos_snapshot *snapshot = &rtos->snapshot;
+
+	snapshot->valid = false;
+	snapshot->num_blocks = 0;
+	for (unsigned int i = 0; i < rtos->num_threads; i++)
+		rtos_thread_drop_regs(&rtos->threads[i]);
+	snapshot->transfers = 0;
+	snapshot->bytes = 0;
+	snapshot->hits = 0;
+}
+
+static int rtos_snapshot_event(struct target *target, enum target_event event, void *priv)
+{
+	struct rtos *rtos = priv;
+
+	if (rtos->target != target)
+		return ERROR_OK;
+
+	switch (event) {
+	case TARGET_EVENT_RESUME_START:
+	case TARGET_EVENT_RESUMED:
+	case TARGET_EVENT_HALTED:
+	case TARGET_EVENT_DEBUG_RESUMED:
+	case TARGET_EVENT_DEBUG_HALTED:
+	case TARGET_EVENT_RESET_ASSERT:
+	case TARGET_EVENT_GDB_ATTACH:
+		rtos_snapshot_invalidate(rtos);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Called for every write to the memory of @a target, e.g. by mww, load_image
+ * or a flash driver: the kernel data in the snapshot may be stale.
+ */
+void rtos_snapshot_memory_written(struct target *target)
+{
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets) {
+			struct rtos *rtos = head->target->rtos;
+			if (rtos && (rtos->snapshot.valid || rtos->snapshot.num_blocks))
+				rtos_snapshot_invalidate(rtos);
+		}
+	} else if (target->rtos) {
+		struct rtos *rtos = target->rtos;
+		if (rtos->snapshot.valid || rtos->snapshot.num_blocks)
+			rtos_snapshot_invalidate(rtos);
+	}
+}
+
+static struct rtos_snapshot_block *rtos_snapshot_find(struct rtos_snapshot *snapshot,
+		target_addr_t address)
+{
+	for (unsigned int i = 0; i < snapshot->num_blocks; i++)
+		if (snapshot->blocks[i].address == address)
+			return &snapshot->blocks[i];
+
+	return NULL;
+}
+
+/**
+ * Read @a size bytes at @a address into the snapshot, in a single transfer.
+ * Blocks already holding adjacent or overlapping bytes are extended.
+ */
+static int rtos_snapshot_fetch(struct rtos *rtos, target_addr_t address, uint32_t size)
+{
+	struct rtos_snapshot *snapshot = &rtos->snapshot;
+	target_addr_t first = address & ~(target_addr_t)(RTOS_SNAPSHOT_BLOCK_SIZE - 1);
+	target_addr_t last = address + size - 1;
+	unsigned int count = (last - first) / RTOS_SNAPSHOT_BLOCK_SIZE + 1;
+
+	if (count > RTOS_SNAPSHOT_MAX_BLOCKS)
+		return ERROR_FAIL;
+
+	if (!snapshot->blocks) {
+		snapshot->blocks = calloc(RTOS_SNAPSHOT_MAX_BLOCKS, sizeof(*snapshot->blocks));
+		if (!snapshot->blocks) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = target_read_buffer(rtos->target, address, size, data);
+	if (retval != ERROR_OK) {
+		free(data);
+		return retval;
+	}
+	snapshot->transfers++;
+	snapshot->bytes += size;
+
+	/* Full: start over rather than tracking the use of every block. */
+	if (snapshot->num_blocks + count > RTOS_SNAPSHOT_MAX_BLOCKS)
+		snapshot->num_blocks = 0;
+
+	const uint8_t *src = data;
+	while (size > 0) {
+		target_addr_t block_address = address & ~(target_addr_t)(RTOS_SNAPSHOT_BLOCK_SIZE - 1);
+		uint16_t start = address - block_address;
+		uint16_t end = start + MIN(size, RTOS_SNAPSHOT_BLOCK_SIZE - start);
+
+		struct rtos_snapshot_block *block = rtos_snapshot_find(snapshot, block_address);
+		if (!block) {
+			block = &snapshot->blocks[snapshot->num_blocks++];
+			block->address = block_address;
+			block->start = start;
+			block->end = end;
+		} else if (start <= block->end && block->start <= end) {
+			block->start = MIN(block->start, start);
+			block->end = MAX(block->end, end);
+		} else {
+			/* keep a single range per block, the newest */
+			block->start = start;
+			block->end = end;
+		}
+		memcpy(block->data + start, src, end - start);
+
+		src += end - start;
+		address += end - start;
+		size -= end - start;
+	}
+
+	free(data);
+	return ERROR_OK;
+}
+
+/* Copy target memory through the snapshot; @a buffer may be NULL to only
+ * fill the snapshot. */
+static int rtos_snapshot_copy(struct rtos *rtos, target_addr_t address,
+		uint32_t size, uint8_t *buffer)
+{
+	struct rtos_snapshot *snapshot = &rtos->snapshot;
+
+	while (size > 0) {
+		target_addr_t block_address = address & ~(target_addr_t)(RTOS_SNAPSHOT_BLOCK_SIZE - 1);
+		uint32_t offset = address - block_address;
+		uint32_t count = MIN(size, RTOS_SNAPSHOT_BLOCK_SIZE - offset);
+
+		struct rtos_snapshot_block *block = rtos_snapshot_find(snapshot, block_address);
+		if (block && block->start <= offset && offset + count <= block->end) {
+			snapshot->hits++;
+		} else {
+			/* read the rest of the request at once */
+			int retval = rtos_snapshot_fetch(rtos, address, size);
+			if (retval != ERROR_OK)
+				return retval;
+			block = rtos_snapshot_find(snapshot, block_address);
+		}
+
+		if (buffer) {
+			memcpy(buffer, block->data + offset, count);
+			buffer += count;
+		}
+		address += count;
+		size -= count;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Read target memory for the RTOS support, through the snapshot of the
+ * current stop. Kernel objects and stack frames are read once and served
+ * from host memory for as long as the target stays halted: walking the
+ * thread lists and answering qThreadExtraInfo or 'g' for other threads then
+ * takes a few transfers instead of repeating the same small ones.
+ */
+int rtos_snapshot_read_buffer(struct rtos *rtos, target_addr_t address,
+		uint32_t size, uint8_t *buffer)
+{
+	struct target *target = rtos->target;
+
+	/* The memory of a running target can't be kept. */
+	if (target->state != TARGET_HALTED || size == 0)
+		return target_read_buffer(target, address, size, buffer);
+
+	int retval = rtos_snapshot_copy(rtos, address, size, buffer);
+	if (retval != ERROR_OK) {
+		/* Too large for the snapshot, or not readable at all. */
+		LOG_DEBUG("RTOS: no snapshot of 0x%" TARGET_PRIxADDR ", reading it directly",
+				address);
+		retval = target_read_buffer(target, address, size, buffer);
+	}
+
+	return retval;
+}
+
+/**
+ * Bring a region of kernel data, e.g. an array of lists, a thread control
+ * block or a stack frame, into the snapshot with as few transfers as
+ * possible. The RTOS drivers prefetch what they walk field by field, the
+ * fields outside such regions are read alone.
+ */
+int rtos_snapshot_prefetch(struct rtos *rtos, target_addr_t address, uint32_t size)
+{
+	if (rtos->target->state != TARGET_HALTED || size == 0)
+		return ERROR_OK;
+
+	return rtos_snapshot_copy(rtos, address, size, NULL);
+}
+
+int rtos_snapshot_read_u32(struct rtos *rtos, target_addr_t address, uint32_t *value)
+{
+	uint8_t buf[4];
+
+	int retval = rtos_snapshot_read_buffer(rtos, address, sizeof(buf), buf);
+	if (retval == ERROR_OK)
+		*value = target_buffer_get_u32(rtos->target, buf);
+	return retval;
+}
+
+int rtos_snapshot_read_u16(struct rtos *rtos, target_addr_t address, uint16_t *value)
+{
+	uint8_t buf[2];
+
+	int retval = rtos_snapshot_read_buffer(rtos, address, sizeof(buf), buf);
+	if (retval == ERROR_OK)
+		*value = target_buffer_get_u16(rtos->target, buf);
+	return retval;
+}
+
+int rtos_snapshot_read_u8(struct rtos *rtos, target_addr_t address, uint8_t *value)
+{
+	return rtos_snapshot_read_buffer(rtos, address, 1, value);
+}
@@ -31,6 +31,51 @@ struct thread_detail {
 	bool exists;
 	char *thread_name_str;
 	char *extra_info_str;
+	/* Cheap fingerprint of the control block, see rtos_thread_unchanged(). */
+	uint64_t tcb_state;
+};
+
+struct rtos_snapshot_block;
+
+/**
+ * Target memory read while walking the kernel data structures at a stop.
+ * The thread list and the stacked registers of all threads are served from
+ * it until the target resumes, see rtos_snapshot_read_buffer().
+ */
+struct rtos_snapshot {
+	/* The thread list reflects the current stop. */
+	bool valid;
+	struct rtos_snapshot_block *blocks;
+	unsigned int num_blocks;
+	/* Statistics of the current stop. */
+	unsigned int transfers;
+	uint64_t bytes;
+	uint64_t hits;
+};
+
+/**
+ * Persistent record of a thread, keyed by its id (usually the address of
+ * its control block), kept across stops of the target.
+ */
+struct rtos_thread {
+	threadid_t threadid;
+	/* Interned, shared with thread_details. */
+	const char *name;
+	char *extra_info;
+	uint64_t tcb_state;
+	/* Registers fetched for GDB at the current stop, or NULL. */
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
+/* Cost of the RTOS support for one stop of the target. */
+struct rtos_stop_stats {
+	int64_t threads_ms;
+	int64_t regs_ms;
+	unsigned int reg_fetches;
+	unsigned int reg_hits;
+	/* Control blocks the driver found unchanged. */
+	unsigned int tcbs_unchanged;
 };
 
 struct rtos {
@@ -48,6 +93,14 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	struct rtos_snapshot snapshot;
+	/* Threads of the last thread list, sorted by id. */
+	struct rtos_thread *threads;
+	unsigned int num_threads;
+	/* Thread names, each stored once. */
+	char **names;
+	unsigned int num_names;
+	struct rtos_stop_stats stop_stats;
 };
 
 struct rtos_reg {
@@ -120,6 +173,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num);
 int rtos_get_gdb_reg_list(struct connection *connection);
 int rtos_update_threads(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
+char *rtos_thread_unchanged(struct rtos *rtos, threadid_t threadid, uint64_t tcb_state);
 int rtos_smp_init(struct target *target);
 /*  function for handling symbol access */
 int rtos_qsymbol(struct connection *connection, char const *packet, int packet_size);
@@ -127,5 +181,13 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 		uint32_t size, uint8_t *buffer);
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer);
+int rtos_snapshot_read_buffer(struct rtos *rtos, target_addr_t address,
+		uint32_t size, uint8_t *buffer);
+int rtos_snapshot_prefetch(struct rtos *rtos, target_addr_t address, uint32_t size);
+int rtos_snapshot_read_u32(struct rtos *rtos, target_addr_t address, uint32_t *value);
+int rtos_snapshot_read_u16(struct rtos *rtos, target_addr_t address, uint16_t *value);
+int rtos_snapshot_read_u8(struct rtos *rtos, target_addr_t address, uint8_t *value);
+void rtos_snapshot_invalidate(struct rtos *rtos);
+void rtos_snapshot_memory_written(struct target *target);
 
 #endif /* OPENOCD_RTOS_RTOS_H */
@@ -153,6 +153,18 @@ static int ucos_iii_find_thread_address(struct rtos *rtos, threadid_t threadid,
 	return ERROR_OK;
 }
 
+/* Size of the part of a TCB read by this driver */
+static uint32_t ucos_iii_tcb_size(const struct ucos_iii_params *params)
+{
+	symbol_address_t size = params->thread_state_offset + 1;
+
+	size = MAX(size, params->thread_priority_offset + 1);
+	size = MAX(size, params->thread_stack_offset + params->pointer_width);
+	size = MAX(size, params->thread_name_offset + params->pointer_width);
+	size = MAX(size, params->thread_prev_offset + params->pointer_width);
+	return MAX(size, params->thread_next_offset + params->pointer_width);
+}
+
 static int ucos_iii_find_last_thread_address(struct rtos *rtos, symbol_address_t *thread_address)
 {
 	struct ucos_iii_params *params = rtos->rtos_specific_params;
@@ -161,10 +173,9 @@ static int ucos_iii_find_last_thread_address(struct rtos *rtos, symbol_address_t
 	/* read the thread list head */
 	symbol_address_t thread_list_address = 0;
 
-	retval = target_read_memory(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			rtos->symbols[UCOS_III_VAL_OS_TASK_DBG_LIST_PTR].address,
 			params->pointer_width,
-			1,
 			(void *)&thread_list_address);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("uCOS-III: failed to read thread list address");
@@ -175,10 +186,12 @@ static int ucos_iii_find_last_thread_address(struct rtos *rtos, symbol_address_t
 	do {
 		*thread_address = thread_list_address;
 
-		retval = target_read_memory(rtos->target,
+		/* the whole TCB at once, the threads are listed from the snapshot */
+		rtos_snapshot_prefetch(rtos, thread_list_address, ucos_iii_tcb_size(params));
+
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_list_address + params->thread_next_offset,
 				params->pointer_width,
-				1,
 				(void *)&thread_list_address);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("uCOS-III: failed to read next thread address");
@@ -300,7 +313,7 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 	/* verify RTOS is running */
 	uint8_t rtos_running;
 
-	retval = target_read_u8(rtos->target,
+	retval = rtos_snapshot_read_u8(rtos,
 			rtos->symbols[UCOS_III_VAL_OS_RUNNING].address,
 			&rtos_running);
 	if (retval != ERROR_OK) {
@@ -338,10 +351,9 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 	/* read current thread address */
 	symbol_address_t current_thread_address = 0;
 
-	retval = target_read_memory(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			rtos->symbols[UCOS_III_VAL_OS_TCB_CUR_PTR].address,
 			params->pointer_width,
-			1,
 			(void *)&current_thread_address);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("uCOS-III: failed to read current thread address");
@@ -349,7 +361,7 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 	}
 
 	/* read number of tasks */
-	retval = target_read_u16(rtos->target,
+	retval = rtos_snapshot_read_u16(rtos,
 			rtos->symbols[UCOS_III_VAL_OS_TASK_QTY].address,
 			(void *)&rtos->thread_count);
 	if (retval != ERROR_OK) {
@@ -394,17 +406,16 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 		/* read thread name */
 		symbol_address_t thread_name_address = 0;
 
-		retval = target_read_memory(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_address + params->thread_name_offset,
 				params->pointer_width,
-				1,
 				(void *)&thread_name_address);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("uCOS-III: failed to name address");
 			return retval;
 		}
 
-		retval = target_read_buffer(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_name_address,
 				sizeof(thread_str_buffer),
 				(void *)thread_str_buffer);
@@ -420,7 +431,7 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 		uint8_t thread_state;
 		uint8_t thread_priority;
 
-		retval = target_read_u8(rtos->target,
+		retval = rtos_snapshot_read_u8(rtos,
 				thread_address + params->thread_state_offset,
 				&thread_state);
 		if (retval != ERROR_OK) {
@@ -428,7 +439,7 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 			return retval;
 		}
 
-		retval = target_read_u8(rtos->target,
+		retval = rtos_snapshot_read_u8(rtos,
 				thread_address + params->thread_priority_offset,
 				&thread_priority);
 		if (retval != ERROR_OK) {
@@ -448,10 +459,9 @@ static int ucos_iii_update_threads(struct rtos *rtos)
 		thread_detail->extra_info_str = strdup(thread_str_buffer);
 
 		/* read previous thread address */
-		retval = target_read_memory(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 				thread_address + params->thread_prev_offset,
 				params->pointer_width,
-				1,
 				(void *)&thread_address);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("uCOS-III: failed to read previous thread address");
@@ -480,10 +490,9 @@ static int ucos_iii_get_thread_reg_list(struct rtos *rtos, threadid_t threadid,
 	/* read thread stack address */
 	symbol_address_t stack_address = 0;
 
-	retval = target_read_memory(rtos->target,
+	retval = rtos_snapshot_read_buffer(rtos,
 			thread_address + params->thread_stack_offset,
 			params->pointer_width,
-			1,
 			(void *)&stack_address);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("uCOS-III: failed to read stack address");
@@ -235,10 +235,16 @@ static int zephyr_get_arc_state(struct rtos *rtos, target_addr_t *addr,
 	const struct rtos_register_stacking *stacking;
 
 	/* Getting real stack address from Kernel thread struct */
-	retval = target_read_u32(rtos->target, *addr, &real_stack_addr);
+	retval = rtos_snapshot_read_u32(rtos, *addr, &real_stack_addr);
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* the callee and the cpu saved registers follow each other, read
+	 * them in a single transfer */
+	rtos_snapshot_prefetch(rtos, real_stack_addr,
+			params->callee_saved_stacking->stack_registers_size +
+			params->cpu_saved_nofp_stacking->stack_registers_size);
+
 	/* Getting callee registers */
 	retval = rtos_generic_stack_read(rtos->target,
 			params->callee_saved_stacking,
@@ -503,7 +509,25 @@ static uint32_t zephyr_kptr(const struct rtos *rtos, enum zephyr_offsets off)
 	return rtos->symbols[ZEPHYR_VAL__KERNEL].address + params->offsets[off];
 }
 
-static int zephyr_fetch_thread(const struct rtos *rtos,
+/* Size of the part of a thread struct read by this driver, up to the
+ * callee saved registers */
+static uint32_t zephyr_thread_size(const struct zephyr_params *param)
+{
+	uint32_t size = param->offsets[OFFSET_T_STACK_POINTER]
+		- param->callee_saved_stacking->register_offsets[0].offset
+		+ param->callee_saved_stacking->stack_registers_size;
+
+	size = MAX(size, param->offsets[OFFSET_T_ENTRY] + 4);
+	size = MAX(size, param->offsets[OFFSET_T_NEXT_THREAD] + 4);
+	size = MAX(size, param->offsets[OFFSET_T_STATE] + 1);
+	size = MAX(size, param->offsets[OFFSET_T_USER_OPTIONS] + 1);
+	size = MAX(size, param->offsets[OFFSET_T_PRIO] + 1);
+	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED)
+		size = MAX(size, param->offsets[OFFSET_T_NAME] + sizeof(((struct zephyr_thread *)0)->name) - 1);
+	return size;
+}
+
+static int zephyr_fetch_thread(struct rtos *rtos,
 				struct zephyr_thread *thread, uint32_t ptr)
 {
 	const struct zephyr_params *param = rtos->rtos_specific_params;
@@ -511,36 +535,39 @@ static int zephyr_fetch_thread(const struct rtos *rtos,
 
 	thread->ptr = ptr;
 
-	retval = target_read_u32(rtos->target, ptr + param->offsets[OFFSET_T_ENTRY],
+	/* all the fields below and the registers saved in the struct at once */
+	rtos_snapshot_prefetch(rtos, ptr, zephyr_thread_size(param));
+
+	retval = rtos_snapshot_read_u32(rtos, ptr + param->offsets[OFFSET_T_ENTRY],
 				 &thread->entry);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 				 ptr + param->offsets[OFFSET_T_NEXT_THREAD],
 				 &thread->next_ptr);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 				 ptr + param->offsets[OFFSET_T_STACK_POINTER],
 				 &thread->stack_pointer);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_read_u8(rtos->target, ptr + param->offsets[OFFSET_T_STATE],
+	retval = rtos_snapshot_read_u8(rtos, ptr + param->offsets[OFFSET_T_STATE],
 				&thread->state);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_read_u8(rtos->target,
+	retval = rtos_snapshot_read_u8(rtos,
 				ptr + param->offsets[OFFSET_T_USER_OPTIONS],
 				&thread->user_options);
 	if (retval != ERROR_OK)
 		return retval;
 
 	uint8_t prio;
-	retval = target_read_u8(rtos->target,
+	retval = rtos_snapshot_read_u8(rtos,
 				ptr + param->offsets[OFFSET_T_PRIO], &prio);
 	if (retval != ERROR_OK)
 		return retval;
@@ -548,7 +575,7 @@ static int zephyr_fetch_thread(const struct rtos *rtos,
 
 	thread->name[0] = '\0';
 	if (param->offsets[OFFSET_T_NAME] != UNIMPLEMENTED) {
-		retval = target_read_buffer(rtos->target,
+		retval = rtos_snapshot_read_buffer(rtos,
 					ptr + param->offsets[OFFSET_T_NAME],
 					sizeof(thread->name) - 1, (uint8_t *)thread->name);
 		if (retval != ERROR_OK)
@@ -573,7 +600,7 @@ static int zephyr_fetch_thread_list(struct rtos *rtos, uint32_t current_thread)
 	uint32_t curr;
 	int retval;
 
-	retval = target_read_u32(rtos->target, zephyr_kptr(rtos, OFFSET_K_THREADS),
+	retval = rtos_snapshot_read_u32(rtos, zephyr_kptr(rtos, OFFSET_K_THREADS),
 		&curr);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not fetch current thread pointer");
@@ -657,7 +684,7 @@ static int zephyr_update_threads(struct rtos *rtos)
 		return ERROR_FAIL;
 	}
 
-	retval = target_read_u8(rtos->target,
+	retval = rtos_snapshot_read_u8(rtos,
 		rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_SIZE_T_SIZE].address,
 		&param->size_width);
 	if (retval != ERROR_OK) {
@@ -671,7 +698,7 @@ static int zephyr_update_threads(struct rtos *rtos)
 	}
 
 	if (rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_NUM_OFFSETS].address) {
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 				rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_NUM_OFFSETS].address,
 				&param->num_offsets);
 		if (retval != ERROR_OK) {
@@ -684,7 +711,7 @@ static int zephyr_update_threads(struct rtos *rtos)
 			return ERROR_FAIL;
 		}
 	} else {
-		retval = target_read_u32(rtos->target,
+		retval = rtos_snapshot_read_u32(rtos,
 				rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_OFFSETS].address,
 				&param->offsets[OFFSET_VERSION]);
 		if (retval != ERROR_OK) {
@@ -710,13 +737,15 @@ static int zephyr_update_threads(struct rtos *rtos)
 	 * to grow only */
 	uint32_t address;
 	address  = rtos->symbols[ZEPHYR_VAL__KERNEL_OPENOCD_OFFSETS].address;
+	rtos_snapshot_prefetch(rtos, address,
+			MIN(param->num_offsets, OFFSET_MAX) * param->size_width);
 	for (size_t i = 0; i < OFFSET_MAX; i++, address += param->size_width) {
 		if (i >= param->num_offsets) {
 			param->offsets[i] = UNIMPLEMENTED;
 			continue;
 		}
 
-		retval = target_read_u32(rtos->target, address, &param->offsets[i]);
+		retval = rtos_snapshot_read_u32(rtos, address, &param->offsets[i]);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Could not fetch offsets from Zephyr");
 			return ERROR_FAIL;
@@ -727,7 +756,7 @@ static int zephyr_update_threads(struct rtos *rtos)
 			  param->offsets[OFFSET_VERSION]);
 
 	uint32_t current_thread;
-	retval = target_read_u32(rtos->target,
+	retval = rtos_snapshot_read_u32(rtos,
 		zephyr_kptr(rtos, OFFSET_K_CURR_THREAD), &current_thread);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not obtain current thread ID");
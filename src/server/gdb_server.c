@@ -40,6 +40,7 @@
 #include <jtag/jtag.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
+#include <helper/time_support.h>
 
 /**
  * @file
@@ -1599,8 +1600,10 @@ static int gdb_write_memory_packet(struct connection *connection,
 		LOG_ERROR("unable to decode memory packet");
 
 	retval = ERROR_NOT_IMPLEMENTED;
-	if (target->rtos)
+	if (target->rtos) {
+		rtos_snapshot_invalidate(target->rtos);
 		retval = rtos_write_buffer(target, addr, len, buffer);
+	}
 	if (retval == ERROR_NOT_IMPLEMENTED)
 		retval = target_write_buffer(target, addr, len, buffer);
 
@@ -1672,8 +1675,10 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 		LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
 		retval = ERROR_NOT_IMPLEMENTED;
-		if (target->rtos)
+		if (target->rtos) {
+			rtos_snapshot_invalidate(target->rtos);
 			retval = rtos_write_buffer(target, addr, len, (uint8_t *)separator);
+		}
 		if (retval == ERROR_NOT_IMPLEMENTED)
 			retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
 
@@ -2542,6 +2547,191 @@ error:
 	return retval;
 }
 
+/* Generated target descriptions, keyed on a hash of the register layout they
+ * describe. Reconnecting gdb, or attaching it to another core with the same
+ * registers, reuses the XML instead of generating it again. A changed
+ * register list hashes differently, so stale entries are never returned;
+ * they just age out of the cache. */
+#define GDB_TDESC_CACHE_SIZE	8
+
+struct gdb_tdesc_cache_entry {
+	uint64_t hash;
+	char *tdesc;
+	uint32_t tdesc_length;
+	uint64_t last_used;
+};
+
+static struct gdb_tdesc_cache_entry gdb_tdesc_cache[GDB_TDESC_CACHE_SIZE];
+static uint64_t gdb_tdesc_cache_clock;
+
+/* 64-bit FNV-1a */
+static uint64_t gdb_tdesc_hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t gdb_tdesc_hash_str(uint64_t hash, const char *str)
+{
+	if (!str)
+		str = "";
+	return gdb_tdesc_hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static uint64_t gdb_tdesc_hash_type(uint64_t hash, const struct reg_data_type *type)
+{
+	hash = gdb_tdesc_hash_bytes(hash, &type->type, sizeof(type->type));
+	hash = gdb_tdesc_hash_str(hash, type->id);
+	if (type->type != REG_TYPE_ARCH_DEFINED)
+		return hash;
+
+	/* The same id may be built differently per target, e.g. vectors whose
+	 * shape depends on the vector length, so hash the definition too. */
+	hash = gdb_tdesc_hash_bytes(hash, &type->type_class, sizeof(type->type_class));
+	switch (type->type_class) {
+	case REG_TYPE_CLASS_VECTOR:
+		hash = gdb_tdesc_hash_bytes(hash, &type->reg_type_vector->count,
+				sizeof(type->reg_type_vector->count));
+		hash = gdb_tdesc_hash_type(hash, type->reg_type_vector->type);
+		break;
+	case REG_TYPE_CLASS_UNION:
+		for (const struct reg_data_type_union_field *field = type->reg_type_union->fields;
+				field; field = field->next) {
+			hash = gdb_tdesc_hash_str(hash, field->name);
+			hash = gdb_tdesc_hash_type(hash, field->type);
+		}
+		break;
+	case REG_TYPE_CLASS_STRUCT:
+		hash = gdb_tdesc_hash_bytes(hash, &type->reg_type_struct->size,
+				sizeof(type->reg_type_struct->size));
+		for (const struct reg_data_type_struct_field *field = type->reg_type_struct->fields;
+				field; field = field->next) {
+			hash = gdb_tdesc_hash_str(hash, field->name);
+			if (field->use_bitfields)
+				hash = gdb_tdesc_hash_bytes(hash, field->bitfield, sizeof(*field->bitfield));
+			else
+				hash = gdb_tdesc_hash_type(hash, field->type);
+		}
+		break;
+	case REG_TYPE_CLASS_FLAGS:
+		hash = gdb_tdesc_hash_bytes(hash, &type->reg_type_flags->size,
+				sizeof(type->reg_type_flags->size));
+		for (const struct reg_data_type_flags_field *field = type->reg_type_flags->fields;
+				field; field = field->next) {
+			hash = gdb_tdesc_hash_str(hash, field->name);
+			hash = gdb_tdesc_hash_bytes(hash, field->bitfield, sizeof(*field->bitfield));
+		}
+		break;
+	}
+	return hash;
+}
+
+/* Hash everything gdb_generate_target_description() puts in the XML. */
+static int gdb_target_description_hash(struct target *target, uint64_t *hash_out)
+{
+	struct reg **reg_list;
+	int reg_list_size;
+
+	int retval = smp_reg_list_noread(target, &reg_list, &reg_list_size,
+			REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = gdb_tdesc_hash_str(hash, target_get_gdb_arch(target));
+	hash = gdb_tdesc_hash_bytes(hash, &reg_list_size, sizeof(reg_list_size));
+	for (int i = 0; i < reg_list_size; i++) {
+		const struct reg *reg = reg_list[i];
+		uint8_t flags = reg->exist | reg->hidden << 1 | reg->caller_save << 2;
+
+		hash = gdb_tdesc_hash_str(hash, reg->name);
+		hash = gdb_tdesc_hash_bytes(hash, &flags, sizeof(flags));
+		hash = gdb_tdesc_hash_bytes(hash, &reg->size, sizeof(reg->size));
+		hash = gdb_tdesc_hash_bytes(hash, &reg->number, sizeof(reg->number));
+		hash = gdb_tdesc_hash_str(hash, reg->group);
+		hash = gdb_tdesc_hash_str(hash, reg->feature ? reg->feature->name : NULL);
+		if (reg->reg_data_type)
+			hash = gdb_tdesc_hash_type(hash, reg->reg_data_type);
+	}
+
+	free(reg_list);
+	*hash_out = hash;
+	return ERROR_OK;
+}
+
+/**
+ * Get the target description of @a target from the cache, generating it
+ * if necessary. The returned string belongs to the cache and stays valid
+ * until the next call.
+ */
+static int gdb_get_cached_target_description(struct target *target,
+		const char **tdesc_out, uint32_t *tdesc_length_out)
+{
+	int64_t start = timeval_ms();
+	uint64_t hash;
+
+	int retval = gdb_target_description_hash(target, &hash);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("get register list failed");
+		return retval;
+	}
+
+	struct gdb_tdesc_cache_entry *entry = NULL;
+	for (unsigned int i = 0; i < GDB_TDESC_CACHE_SIZE; i++) {
+		if (gdb_tdesc_cache[i].tdesc && gdb_tdesc_cache[i].hash == hash) {
+			entry = &gdb_tdesc_cache[i];
+			LOG_DEBUG("Reusing target description for %s (%" PRIu32 " bytes, "
+					"layout hash 0x%016" PRIx64 ")",
+					target_name(target), entry->tdesc_length, hash);
+			break;
+		}
+	}
+
+	if (!entry) {
+		char *tdesc;
+		retval = gdb_generate_target_description(target, &tdesc);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Take a free slot, or the least recently used one. */
+		entry = &gdb_tdesc_cache[0];
+		for (unsigned int i = 0; i < GDB_TDESC_CACHE_SIZE; i++) {
+			if (!gdb_tdesc_cache[i].tdesc) {
+				entry = &gdb_tdesc_cache[i];
+				break;
+			}
+			if (gdb_tdesc_cache[i].last_used < entry->last_used)
+				entry = &gdb_tdesc_cache[i];
+		}
+		free(entry->tdesc);
+		entry->hash = hash;
+		entry->tdesc = tdesc;
+		entry->tdesc_length = strlen(tdesc);
+
+		LOG_DEBUG("Generated target description for %s in %" PRId64 " ms "
+				"(%" PRIu32 " bytes, layout hash 0x%016" PRIx64 ")",
+				target_name(target), timeval_ms() - start,
+				entry->tdesc_length, hash);
+	}
+
+	entry->last_used = ++gdb_tdesc_cache_clock;
+	*tdesc_out = entry->tdesc;
+	*tdesc_length_out = entry->tdesc_length;
+	return ERROR_OK;
+}
+
+static void gdb_free_target_description_cache(void)
+{
+	for (unsigned int i = 0; i < GDB_TDESC_CACHE_SIZE; i++) {
+		free(gdb_tdesc_cache[i].tdesc);
+		gdb_tdesc_cache[i].tdesc = NULL;
+	}
+}
+
 static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
 		char **chunk, int32_t offset, uint32_t length)
 {
@@ -2554,13 +2744,19 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	uint32_t tdesc_length = target_desc->tdesc_length;
 
 	if (!tdesc) {
-		int retval = gdb_generate_target_description(target, &tdesc);
+		const char *cached;
+		int retval = gdb_get_cached_target_description(target, &cached, &tdesc_length);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Target Description");
 			return ERROR_FAIL;
 		}
 
-		tdesc_length = strlen(tdesc);
+		/* The cache may evict the entry before the last chunk is sent. */
+		tdesc = strdup(cached);
+		if (!tdesc) {
+			LOG_ERROR("Unable to allocate memory");
+			return ERROR_FAIL;
+		}
 	}
 
 	char transfer_type;
@@ -2782,6 +2978,9 @@ static int gdb_query_packet(struct connection *connection,
 			target_call_timer_callbacks_now();
 			gdb_connection->output_flag = GDB_OUTPUT_NO;
 			free(cmd);
+			/* the monitor command may have changed the target memory */
+			if (target->rtos)
+				rtos_snapshot_invalidate(target->rtos);
 			if (retval == JIM_RETURN)
 				retval = interp->returnCode;
 			int lenmsg;
@@ -3978,18 +4177,16 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
-	char *tdesc;
+	const char *tdesc;
 	uint32_t tdesc_length;
 	struct target *target = get_current_target(CMD_CTX);
 
-	int retval = gdb_generate_target_description(target, &tdesc);
+	int retval = gdb_get_cached_target_description(target, &tdesc, &tdesc_length);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	tdesc_length = strlen(tdesc);
-
 	struct fileio *fileio;
 	size_t size_written;
 
@@ -4015,7 +4212,6 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 
 out:
 	free(tdesc_filename);
-	free(tdesc);
 
 	return retval;
 }
@@ -4107,4 +4303,5 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+	gdb_free_target_description_cache();
 }
@@ -39,7 +39,7 @@ struct aarch64_private_config {
 };
 
 static int aarch64_poll(struct target *target);
-static int aarch64_debug_entry(struct target *target);
+static int aarch64_debug_entry(struct target *target, bool defer_regs);
 static int aarch64_restore_context(struct target *target, bool bpwp);
 static int aarch64_set_breakpoint(struct target *target,
 	struct breakpoint *breakpoint, uint8_t matchmode);
@@ -318,6 +318,59 @@ static int aarch64_wait_halt_one(struct target *target)
 	return retval;
 }
 
+/*
+ * Read PRSR of all examined PEs of the SMP group into their smp_prsr, with
+ * a single queue flush per DAP instead of one round trip per PE.
+ */
+static int aarch64_read_prsr_smp(struct target *target)
+{
+	struct target_list *head, *prev;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct armv8_common *armv8 = target_to_armv8(curr);
+
+		if (!target_was_examined(curr))
+			continue;
+
+		retval = mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_PRSR,
+				&target_to_aarch64(curr)->smp_prsr);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	/* flush every DAP the group uses, but each of them only once */
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct adiv5_dap *dap;
+		bool flushed = false;
+
+		if (!target_was_examined(curr))
+			continue;
+
+		dap = target_to_armv8(curr)->debug_ap->dap;
+		foreach_smp_target(prev, target->smp_targets) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target) &&
+					target_to_armv8(prev->target)->debug_ap->dap == dap) {
+				flushed = true;
+				break;
+			}
+		}
+		if (flushed)
+			continue;
+
+		int run_retval = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = run_retval;
+	}
+
+	return retval;
+}
+
 static int aarch64_prepare_halt_smp(struct target *target, bool exc_target, struct target **p_first)
 {
 	int retval = ERROR_OK;
@@ -395,8 +448,11 @@ static int aarch64_halt_one(struct target *target, enum halt_mode mode)
 static int aarch64_halt_smp(struct target *target, bool exc_target)
 {
 	struct target *next = target;
+	struct duration duration;
 	int retval;
 
+	duration_start(&duration);
+
 	/* prepare halt on all PEs of the group */
 	retval = aarch64_prepare_halt_smp(target, exc_target, &next);
 
@@ -410,23 +466,27 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 	if (retval != ERROR_OK)
 		return retval;
 
+	smp_phase_done(target, SMP_PHASE_HALT_REQUEST, &duration);
+	duration_start(&duration);
+
 	/* wait for all PEs to halt */
 	int64_t then = timeval_ms();
 	for (;;) {
 		bool all_halted = true;
 		struct target_list *head;
-		struct target *curr;
+		struct target *curr = NULL;
 
-		foreach_smp_target(head, target->smp_targets) {
-			int halted;
+		retval = aarch64_read_prsr_smp(target);
+		if (retval != ERROR_OK)
+			break;
 
+		foreach_smp_target(head, target->smp_targets) {
 			curr = head->target;
 
 			if (!target_was_examined(curr))
 				continue;
 
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
+			if (!(target_to_aarch64(curr)->smp_prsr & PRSR_HALT)) {
 				all_halted = false;
 				break;
 			}
@@ -452,20 +512,28 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 			break;
 	}
 
+	if (retval == ERROR_OK)
+		smp_phase_done(target, SMP_PHASE_HALT_WAIT, &duration);
+
 	return retval;
 }
 
+static int aarch64_poll_one(struct target *target, bool defer_regs);
+
 static int update_halt_gdb(struct target *target, enum target_debug_reason debug_reason)
 {
 	struct target *gdb_target = NULL;
 	struct target_list *head;
 	struct target *curr;
+	struct duration duration;
 
 	if (debug_reason == DBG_REASON_NOTHALTED) {
 		LOG_DEBUG("Halting remaining targets in SMP group");
 		aarch64_halt_smp(target, true);
 	}
 
+	duration_start(&duration);
+
 	/* poll all targets in the group, but skip the target that serves GDB */
 	foreach_smp_target(head, target->smp_targets) {
 		curr = head->target;
@@ -484,9 +552,12 @@ static int update_halt_gdb(struct target *target, enum target_debug_reason debug
 		if (curr == gdb_target)
 			continue;
 
-		/* avoid recursion in aarch64_poll() */
+		/*
+		 * avoid recursion in aarch64_poll(); the registers of these PEs
+		 * are only read once something asks for them
+		 */
 		curr->smp = 0;
-		aarch64_poll(curr);
+		aarch64_poll_one(curr, true);
 		curr->smp = 1;
 	}
 
@@ -494,6 +565,8 @@ static int update_halt_gdb(struct target *target, enum target_debug_reason debug
 	if (gdb_target && gdb_target != target)
 		aarch64_poll(gdb_target);
 
+	smp_phase_done(target, SMP_PHASE_DEBUG_ENTRY, &duration);
+
 	return ERROR_OK;
 }
 
@@ -501,8 +574,9 @@ static int update_halt_gdb(struct target *target, enum target_debug_reason debug
  * Aarch64 Run control
  */
 
-static int aarch64_poll(struct target *target)
+static int aarch64_poll_one(struct target *target, bool defer_regs)
 {
+	struct armv8_common *armv8 = target_to_armv8(target);
 	enum target_state prev_target_state;
 	int retval = ERROR_OK;
 	int halted;
@@ -520,14 +594,16 @@ static int aarch64_poll(struct target *target)
 			/* We have a halting debug event */
 			target->state = TARGET_HALTED;
 			LOG_DEBUG("Target %s halted", target_name(target));
-			retval = aarch64_debug_entry(target);
+			retval = aarch64_debug_entry(target, defer_regs);
 			if (retval != ERROR_OK)
 				return retval;
 
 			if (target->smp)
 				update_halt_gdb(target, debug_reason);
 
-			if (arm_semihosting(target, &retval) != 0)
+			/* a PE halted by its group did not halt for semihosting */
+			if (!armv8->debug_entry_deferred &&
+					arm_semihosting(target, &retval) != 0)
 				return retval;
 
 			switch (prev_target_state) {
@@ -543,12 +619,19 @@ static int aarch64_poll(struct target *target)
 				break;
 			}
 		}
-	} else
+	} else {
 		target->state = TARGET_RUNNING;
+		armv8->debug_entry_deferred = false;
+	}
 
 	return retval;
 }
 
+static int aarch64_poll(struct target *target)
+{
+	return aarch64_poll_one(target, false);
+}
+
 static int aarch64_halt(struct target *target)
 {
 	struct armv8_common *armv8 = target_to_armv8(target);
@@ -573,6 +656,22 @@ static int aarch64_restore_one(struct target *target, int current,
 	if (!debug_execution)
 		target_free_all_working_areas(target);
 
+	if (current && armv8->debug_entry_deferred) {
+		/*
+		 * Nothing looked at this PE since it halted along with its SMP
+		 * group, so it can go on without reading and restoring its
+		 * context. Only breakpoints and watchpoints need an update: the
+		 * register cache still holds the previous stop, so neither a
+		 * mode switch nor a register writeback may happen here.
+		 */
+		armv8->debug_entry_deferred = false;
+		return armv8_dpm_update_bpwp(&armv8->dpm, handle_breakpoints);
+	}
+
+	retval = armv8_finish_debug_entry(armv8);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* current = 1: continue on current pc, otherwise continue at <address> */
 	resume_pc = buf_get_u64(arm->pc->value, 0, 64);
 	if (!current)
@@ -763,45 +862,38 @@ static int aarch64_prep_restart_smp(struct target *target, int handle_breakpoint
 }
 
 
-static int aarch64_step_restart_smp(struct target *target)
+/*
+ * wait until all but the current target of the group restarted
+ */
+static int aarch64_wait_restart_smp(struct target *target)
 {
 	int retval = ERROR_OK;
-	struct target_list *head;
-	struct target *first = NULL;
-
-	LOG_DEBUG("%s", target_name(target));
-
-	retval = aarch64_prep_restart_smp(target, 0, &first);
-	if (retval != ERROR_OK)
-		return retval;
-
-	if (first)
-		retval = aarch64_do_restart_one(first, RESTART_LAZY);
-	if (retval != ERROR_OK) {
-		LOG_DEBUG("error restarting target %s", target_name(first));
-		return retval;
-	}
-
 	int64_t then = timeval_ms();
+
 	for (;;) {
 		struct target *curr = target;
+		struct target_list *head;
 		bool all_resumed = true;
 
+		retval = aarch64_read_prsr_smp(target);
+		if (retval != ERROR_OK)
+			break;
+
 		foreach_smp_target(head, target->smp_targets) {
 			uint32_t prsr;
-			int resumed;
 
 			curr = head->target;
-
 			if (curr == target)
 				continue;
-
 			if (!target_was_examined(curr))
 				continue;
 
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
+			/*
+			 * if PRSR.SDR is set now, the target did restart, even
+			 * if it's now already halted again (e.g. due to breakpoint)
+			 */
+			prsr = target_to_aarch64(curr)->smp_prsr;
+			if (!(prsr & PRSR_SDR) && (prsr & PRSR_HALT)) {
 				all_resumed = false;
 				break;
 			}
@@ -817,10 +909,11 @@ static int aarch64_step_restart_smp(struct target *target)
 			break;
 
 		if (timeval_ms() > then + 1000) {
-			LOG_ERROR("%s: timeout waiting for target resume", __func__);
+			LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
 			retval = ERROR_TARGET_TIMEOUT;
 			break;
 		}
+
 		/*
 		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
 		 * and it looks like the CTI's are not connected by a common
@@ -831,8 +924,37 @@ static int aarch64_step_restart_smp(struct target *target)
 		retval = aarch64_do_restart_one(curr, RESTART_LAZY);
 		if (retval != ERROR_OK)
 			break;
+	}
+
+	return retval;
 }
 
+static int aarch64_step_restart_smp(struct target *target)
+{
+	int retval = ERROR_OK;
+	struct target *first = NULL;
+	struct duration duration;
+
+	LOG_DEBUG("%s", target_name(target));
+
+	duration_start(&duration);
+	retval = aarch64_prep_restart_smp(target, 0, &first);
+	if (retval != ERROR_OK)
+		return retval;
+	smp_phase_done(target, SMP_PHASE_RESUME_PREPARE, &duration);
+
+	duration_start(&duration);
+	if (first)
+		retval = aarch64_do_restart_one(first, RESTART_LAZY);
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("error restarting target %s", target_name(first));
+		return retval;
+	}
+
+	retval = aarch64_wait_restart_smp(target);
+	if (retval == ERROR_OK)
+		smp_phase_done(target, SMP_PHASE_RESUME_WAIT, &duration);
+
 	return retval;
 }
 
@@ -841,6 +963,7 @@ static int aarch64_resume(struct target *target, int current,
 {
 	int retval = 0;
 	uint64_t addr = address;
+	struct duration duration;
 
 	struct armv8_common *armv8 = target_to_armv8(target);
 	armv8->last_run_control_op = ARMV8_RUNCONTROL_RESUME;
@@ -855,11 +978,15 @@ static int aarch64_resume(struct target *target, int current,
 	 * resume events from the trigger matrix.
 	 */
 	if (target->smp) {
+		duration_start(&duration);
 		retval = aarch64_prep_restart_smp(target, handle_breakpoints, NULL);
 		if (retval != ERROR_OK)
 			return retval;
+		smp_phase_done(target, SMP_PHASE_RESUME_PREPARE, &duration);
 	}
 
+	duration_start(&duration);
+
 	/* all targets prepared, restore and restart the current target */
 	retval = aarch64_restore_one(target, current, &addr, handle_breakpoints,
 				 debug_execution);
@@ -869,56 +996,9 @@ static int aarch64_resume(struct target *target, int current,
 		return retval;
 
 	if (target->smp) {
-		int64_t then = timeval_ms();
-		for (;;) {
-			struct target *curr = target;
-			struct target_list *head;
-			bool all_resumed = true;
-
-			foreach_smp_target(head, target->smp_targets) {
-				uint32_t prsr;
-				int resumed;
-
-				curr = head->target;
-				if (curr == target)
-					continue;
-				if (!target_was_examined(curr))
-					continue;
-
-				retval = aarch64_check_state_one(curr,
-						PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-				if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-					all_resumed = false;
-					break;
-				}
-
-				if (curr->state != TARGET_RUNNING) {
-					curr->state = TARGET_RUNNING;
-					curr->debug_reason = DBG_REASON_NOTHALTED;
-					target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-				}
-			}
-
-			if (all_resumed)
-				break;
-
-			if (timeval_ms() > then + 1000) {
-				LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
-				retval = ERROR_TARGET_TIMEOUT;
-				break;
-			}
-
-			/*
-			 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-			 * and it looks like the CTI's are not connected by a common
-			 * trigger matrix. It seems that we need to halt one core in each
-			 * cluster explicitly. So if we find that a core has not halted
-			 * yet, we trigger an explicit resume for the second cluster.
-			 */
-			retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-			if (retval != ERROR_OK)
-				break;
-		}
+		retval = aarch64_wait_restart_smp(target);
+		if (retval == ERROR_OK)
+			smp_phase_done(target, SMP_PHASE_RESUME_WAIT, &duration);
 	}
 
 	if (retval != ERROR_OK)
@@ -939,7 +1019,7 @@ static int aarch64_resume(struct target *target, int current,
 	return ERROR_OK;
 }
 
-static int aarch64_debug_entry(struct target *target)
+static int aarch64_debug_entry(struct target *target, bool defer_regs)
 {
 	int retval = ERROR_OK;
 	struct armv8_common *armv8 = target_to_armv8(target);
@@ -1000,6 +1080,25 @@ static int aarch64_debug_entry(struct target *target)
 		armv8->dpm.wp_addr = edwar;
 	}
 
+	/*
+	 * A PE that was only halted along with its SMP group leaves reading
+	 * its registers to the first user of them, which often never comes.
+	 */
+	if (defer_regs && target->debug_reason == DBG_REASON_DBGRQ) {
+		struct smp_stats *stats = smp_group_stats(target);
+
+		/* The register list and the tdesc given to gdb depend on the
+		 * execution state, which DSCR already tells; CPSR refines it
+		 * once the registers are read. */
+		if ((core_state == ARM_STATE_AARCH64) != (armv8->arm.core_state == ARM_STATE_AARCH64))
+			armv8->arm.core_state = core_state;
+
+		armv8->debug_entry_deferred = true;
+		if (stats)
+			stats->regs_deferred++;
+		return ERROR_OK;
+	}
+
 	retval = armv8_dpm_read_current_registers(&armv8->dpm);
 
 	if (retval == ERROR_OK && armv8->post_debug_entry)
@@ -1095,6 +1194,10 @@ static int aarch64_step(struct target *target, int current, target_addr_t addres
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	retval = armv8_finish_debug_entry(armv8);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = mem_ap_read_atomic_u32(armv8->debug_ap,
 			armv8->debug_base + CPUV8_DBG_EDECR, &edecr);
 	/* make sure EDECR.SS is not set when restoring the register */
@@ -1968,6 +2071,7 @@ static int aarch64_assert_reset(struct target *target)
 	}
 
 	/* registers are now invalid */
+	armv8->debug_entry_deferred = false;
 	if (target_was_examined(target)) {
 		register_cache_invalidate(armv8->arm.core_cache);
 		register_cache_invalidate(armv8->arm.core_cache->next);
@@ -2135,6 +2239,10 @@ static int aarch64_write_cpu_memory(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	retval = armv8_finish_debug_entry(armv8);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* Mark register X0 as dirty, as it will be used
 	 * for transferring the data.
 	 * It will be restored automatically when exiting
@@ -2174,11 +2282,19 @@ static int aarch64_write_cpu_memory(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (size == 4 && (address % 4) == 0)
+	enum arm_memaccess_path path = arm_memaccess_select(&armv8->memaccess, true,
+			address, size, count);
+	struct duration duration;
+	duration_start(&duration);
+
+	if (path == ARM_MEMACCESS_PATH_FAST)
 		retval = aarch64_write_cpu_memory_fast(target, count, buffer, &dscr);
 	else
 		retval = aarch64_write_cpu_memory_slow(target, size, count, buffer, &dscr);
 
+	duration_measure(&duration);
+	arm_memaccess_account(&armv8->memaccess, true, path, size * count, &duration);
+
 	if (retval != ERROR_OK) {
 		/* Unset DTR mode */
 		mem_ap_read_atomic_u32(armv8->debug_ap,
@@ -2353,6 +2469,10 @@ static int aarch64_read_cpu_memory(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	retval = armv8_finish_debug_entry(armv8);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* Mark register X0 as dirty, as it will be used
 	 * for transferring the data.
 	 * It will be restored automatically when exiting
@@ -2392,11 +2512,19 @@ static int aarch64_read_cpu_memory(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (size == 4 && (address % 4) == 0)
+	enum arm_memaccess_path path = arm_memaccess_select(&armv8->memaccess, false,
+			address, size, count);
+	struct duration duration;
+	duration_start(&duration);
+
+	if (path == ARM_MEMACCESS_PATH_FAST)
 		retval = aarch64_read_cpu_memory_fast(target, count, buffer, &dscr);
 	else
 		retval = aarch64_read_cpu_memory_slow(target, size, count, buffer, &dscr);
 
+	duration_measure(&duration);
+	arm_memaccess_account(&armv8->memaccess, false, path, size * count, &duration);
+
 	if (dscr & DSCR_MA) {
 		dscr &= ~DSCR_MA;
 		mem_ap_write_atomic_u32(armv8->debug_ap,
@@ -2767,6 +2895,10 @@ static int aarch64_mmu(struct target *target, int *enabled)
 		return ERROR_TARGET_INVALID;
 	}
 
+	int retval = armv8_finish_debug_entry(target_to_armv8(target));
+	if (retval != ERROR_OK)
+		return retval;
+
 	*enabled = target_to_aarch64(target)->armv8_common.armv8_mmu.mmu_enabled;
 	return ERROR_OK;
 }
@@ -2952,6 +3084,14 @@ COMMAND_HANDLER(aarch64_mask_interrupts_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(aarch64_handle_memaccess_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv8_common *armv8 = target_to_armv8(target);
+
+	return CALL_COMMAND_HANDLER(arm_memaccess_handle_command, &armv8->memaccess);
+}
+
 static int jim_mcrmrc(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 {
 	struct command *c = jim_to_command(interp);
@@ -3133,6 +3273,14 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "read coprocessor register",
 		.usage = "cpnum op1 CRn CRm op2",
 	},
+	{
+		.name = "memaccess",
+		.handler = aarch64_handle_memaccess_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or set the memory access path, or benchmark "
+			"both paths on a RAM area to tune the automatic choice",
+		.usage = "['auto'|'fast'|'slow'|'reset'|'benchmark' address [bytes]]",
+	},
 	{
 		.chain = smp_command_handlers,
 	},
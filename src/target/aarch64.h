@@ -58,6 +58,9 @@ struct aarch64_common {
 	struct aarch64_brp *wp_list;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+
+	/* PRSR as read by the last batched poll of the SMP group */
+	uint32_t smp_prsr;
 };
 
 static inline struct aarch64_common *
@@ -323,6 +323,87 @@ static int dpm_write_pc_core_state(struct arm_dpm *dpm, struct reg *r)
 	return dpm->instr_write_data_r0(dpm, ARMV4_5_BX(0), value);
 }
 
+/* Batched transfers failed, stay with one transfer per register. */
+static void dpm_disable_core_regs_batch(struct arm_dpm *dpm, int retval)
+{
+	LOG_WARNING("batched core register transfer failed (%d), "
+			"using single transfers", retval);
+	dpm->instr_read_core_regs = NULL;
+	dpm->instr_write_core_regs = NULL;
+}
+
+/* Load the registers selected by @a mask, batched when possible. */
+static int dpm_write_core_regs(struct arm_dpm *dpm, uint16_t mask,
+		const uint32_t *values, struct reg **regs)
+{
+	int retval = ERROR_FAIL;
+
+	if (dpm->instr_write_core_regs) {
+		retval = dpm->instr_write_core_regs(dpm, mask, values);
+		if (retval != ERROR_OK)
+			dpm_disable_core_regs_batch(dpm, retval);
+	}
+
+	for (unsigned int i = 0; i < 15; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+
+		if (retval != ERROR_OK) {
+			int retval2 = dpm_write_reg(dpm, regs[i], i);
+			if (retval2 != ERROR_OK)
+				return retval2;
+			continue;
+		}
+
+		regs[i]->dirty = false;
+		LOG_DEBUG("WRITE: %s, %8.8x", regs[i]->name, (unsigned) values[i]);
+	}
+
+	return ERROR_OK;
+}
+
+/* Complete arm_dpm_read_current_registers() from a batched read of R0..R14. */
+static int dpm_read_current_registers_batch(struct arm_dpm *dpm, const uint32_t *values)
+{
+	struct arm *arm = dpm->arm;
+	uint32_t cpsr;
+	struct reg *r;
+	int retval;
+
+	for (unsigned int i = 0; i < 2; i++) {
+		r = arm->core_cache->reg_list + i;
+		if (!r->valid) {
+			buf_set_u32(r->value, 0, 32, values[i]);
+			r->valid = true;
+		}
+		r->dirty = true;
+	}
+
+	retval = dpm->instr_read_data_r0(dpm, ARMV4_5_MRS(0, 0), &cpsr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* only now is it known which banked copies R8..R14 are */
+	arm_set_cpsr(arm, cpsr);
+
+	for (unsigned int i = 2; i < 15; i++) {
+		r = arm_reg_current(arm, i);
+		if (r->valid)
+			continue;
+
+		buf_set_u32(r->value, 0, 32, values[i]);
+		r->valid = true;
+		r->dirty = false;
+		LOG_DEBUG("READ: %s, %8.8x", r->name, (unsigned) values[i]);
+	}
+
+	r = arm_reg_current(arm, 15);
+	if (!r->valid)
+		retval = arm_dpm_read_reg(dpm, r, 15);
+
+	return retval;
+}
+
 /**
  * Read basic registers of the current context:  R0 to R15, and CPSR;
  * sets the core mode (such as USR or IRQ) and state (such as ARM or Thumb).
@@ -341,6 +422,18 @@ int arm_dpm_read_current_registers(struct arm_dpm *dpm)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* R0..R14 with a single batch of transfers, when the core can */
+	if (dpm->instr_read_core_regs) {
+		uint32_t values[15];
+
+		retval = dpm->instr_read_core_regs(dpm, 0x7fff, values);
+		if (retval == ERROR_OK) {
+			retval = dpm_read_current_registers_batch(dpm, values);
+			goto fail;
+		}
+		dpm_disable_core_regs_batch(dpm, retval);
+	}
+
 	/* read R0 and R1 first (it's used for scratch), then CPSR */
 	for (unsigned i = 0; i < 2; i++) {
 		r = arm->core_cache->reg_list + i;
@@ -490,6 +583,9 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	 */
 	do {
 		enum arm_mode mode = ARM_MODE_ANY;
+		struct reg *batch_regs[15];
+		uint32_t batch_values[15];
+		uint16_t batch_mask = 0;
 
 		did_write = false;
 
@@ -544,6 +640,14 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 			if (r->mode != mode)
 				continue;
 
+			/* core registers of this mode go out together */
+			if (regnum < 15) {
+				batch_regs[regnum] = &cache->reg_list[i];
+				batch_values[regnum] = buf_get_u32(cache->reg_list[i].value, 0, 32);
+				batch_mask |= 1 << regnum;
+				continue;
+			}
+
 			retval = dpm_write_reg(dpm,
 					       &cache->reg_list[i],
 					       regnum);
@@ -551,6 +655,12 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 				goto done;
 		}
 
+		if (batch_mask) {
+			retval = dpm_write_core_regs(dpm, batch_mask, batch_values, batch_regs);
+			if (retval != ERROR_OK)
+				goto done;
+		}
+
 	} while (did_write);
 
 	/* Restore original CPSR ... assuming either that we changed it,
@@ -581,12 +691,14 @@ int arm_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 	arm->pc->dirty = false;
 
 	/* flush R0 and R1 (our scratch registers) */
-	for (unsigned i = 0; i < 2; i++) {
-		retval = dpm_write_reg(dpm, &cache->reg_list[i], i);
-		if (retval != ERROR_OK)
-			goto done;
-		cache->reg_list[i].dirty = false;
-	}
+	struct reg *scratch_regs[2] = { &cache->reg_list[0], &cache->reg_list[1] };
+	uint32_t scratch_values[2] = {
+		buf_get_u32(cache->reg_list[0].value, 0, 32),
+		buf_get_u32(cache->reg_list[1].value, 0, 32),
+	};
+	retval = dpm_write_core_regs(dpm, 0x3, scratch_values, scratch_regs);
+	if (retval != ERROR_OK)
+		goto done;
 
 	/* (void) */ dpm->finish(dpm);
 done:
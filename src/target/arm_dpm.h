@@ -95,6 +95,20 @@ struct arm_dpm {
 	int (*instr_read_data_r0_64)(struct arm_dpm *dpm,
 			uint32_t opcode, uint64_t *data);
 
+	/* BATCHED CORE REGISTER TRANSFERS (optional) */
+
+	/**
+	 * Reads the core registers R0..R14 selected by @a mask into
+	 * @a data, which is indexed by register number, queueing all the
+	 * transfers before running them.
+	 */
+	int (*instr_read_core_regs)(struct arm_dpm *dpm,
+			uint16_t mask, uint32_t *data);
+
+	/** Loads the core registers R0..R14 selected by @a mask from @a data. */
+	int (*instr_write_core_regs)(struct arm_dpm *dpm,
+			uint16_t mask, const uint32_t *data);
+
 	struct reg *(*arm_reg_current)(struct arm *arm,
 			unsigned regnum);
 
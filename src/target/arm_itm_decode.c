@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Streaming decoder of the ITM/DWT trace protocol, as output by the ITM of
+ * ARMv7-M and ARMv8-M through a TPIU or SWO with the formatter bypassed.
+ *
+ * Input can be fed in chunks of any size, as it comes from the adapter;
+ * a packet split across two chunks is completed with the second one.
+ *
+ * Relevant specifications from ARM include:
+ * ARMv7-M Architecture Reference Manual, Appendix D4     ARM DDI 0403E
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "arm_itm_decode.h"
+
+enum itm_decoder_state {
+	ITM_STATE_HEADER,	/* next byte is a packet header */
+	ITM_STATE_SOURCE,	/* payload of a source packet */
+	ITM_STATE_CONTINUED,	/* continuation bytes of a protocol packet */
+	ITM_STATE_SYNC,		/* zeros of a synchronization packet */
+};
+
+#define ITM_SYNC		0x00
+#define ITM_OVERFLOW		0x70
+#define ITM_GTS1		0x94
+#define ITM_GTS2		0xb4
+
+/* source packet header: discriminator or port in [7:3], hardware in 2 */
+#define ITM_SOURCE_HW		0x04
+
+/* DWT discriminators */
+#define DWT_ID_EVENT		0
+#define DWT_ID_EXCEPTION	1
+#define DWT_ID_PC_SAMPLE	2
+#define DWT_ID_DATA_FIRST	8
+#define DWT_ID_DATA_VALUE	16
+#define DWT_ID_DATA_LAST	23
+
+void itm_decoder_init(struct itm_decoder *dec, itm_packet_handler_t handler, void *priv)
+{
+	*dec = (struct itm_decoder){
+		.state = ITM_STATE_HEADER,
+		.handler = handler,
+		.priv = priv,
+	};
+}
+
+static void itm_emit(struct itm_decoder *dec, struct itm_packet *packet)
+{
+	dec->stats.packets++;
+	if (dec->handler)
+		dec->handler(dec->priv, packet);
+}
+
+static void itm_emit_source(struct itm_decoder *dec)
+{
+	struct itm_packet packet = {
+		.header = dec->header,
+		.id = dec->header >> 3,
+		.size = dec->need,
+		.data = dec->payload,
+	};
+
+	for (unsigned int i = 0; i < dec->need; i++)
+		packet.value |= (uint64_t)dec->payload[i] << (8 * i);
+
+	if (!(dec->header & ITM_SOURCE_HW)) {
+		packet.type = ITM_PACKET_SWIT;
+		packet.id += 32 * dec->page;
+		dec->stats.swit_packets++;
+		itm_emit(dec, &packet);
+		return;
+	}
+
+	dec->stats.dwt_packets++;
+	switch (packet.id) {
+	case DWT_ID_EVENT:
+		packet.type = ITM_PACKET_DWT_EVENT;
+		break;
+	case DWT_ID_EXCEPTION:
+		packet.type = ITM_PACKET_DWT_EXCEPTION;
+		break;
+	case DWT_ID_PC_SAMPLE:
+		packet.type = packet.size == 1 ? ITM_PACKET_DWT_PC_SLEEP : ITM_PACKET_DWT_PC_SAMPLE;
+		break;
+	default:
+		if (packet.id < DWT_ID_DATA_FIRST || packet.id > DWT_ID_DATA_LAST)
+			packet.type = ITM_PACKET_DWT_OTHER;
+		else if (packet.id >= DWT_ID_DATA_VALUE)
+			packet.type = ITM_PACKET_DWT_DATA_VALUE;
+		else if (packet.id & 1)
+			packet.type = ITM_PACKET_DWT_DATA_ADDR;
+		else
+			packet.type = ITM_PACKET_DWT_DATA_PC;
+		break;
+	}
+	itm_emit(dec, &packet);
+}
+
+static void itm_emit_continued(struct itm_decoder *dec)
+{
+	struct itm_packet packet = {
+		.header = dec->header,
+		.size = dec->len,
+		.data = dec->payload,
+	};
+
+	for (unsigned int i = 0; i < dec->len; i++)
+		packet.value |= (uint64_t)(dec->payload[i] & 0x7f) << (7 * i);
+
+	if ((dec->header & 0x0f) == 0) {
+		packet.type = ITM_PACKET_TIMESTAMP;
+		dec->stats.timestamps++;
+		itm_emit(dec, &packet);
+	} else if (dec->header == ITM_GTS1 || dec->header == ITM_GTS2) {
+		packet.type = ITM_PACKET_GLOBAL_TIMESTAMP;
+		dec->stats.timestamps++;
+		itm_emit(dec, &packet);
+	} else if (!(dec->header & ITM_SOURCE_HW)) {
+		/* stimulus port page extension, EX[2:0] then continuation bits */
+		dec->page = ((dec->header >> 4) & 0x7) | (packet.value << 3);
+		if (dec->page >= ITM_NUM_STIM_PORTS / 32) {
+			dec->stats.errors++;
+			dec->page = 0;
+		}
+	}
+}
+
+static void itm_decode_header(struct itm_decoder *dec, uint8_t c)
+{
+	dec->header = c;
+	dec->len = 0;
+
+	/* source packets: size in [1:0] */
+	if (c & 0x03) {
+		dec->need = (c & 0x03) == 3 ? 4 : (c & 0x03);
+		dec->state = ITM_STATE_SOURCE;
+		return;
+	}
+
+	if (c == ITM_SYNC) {
+		dec->zeros = 1;
+		dec->state = ITM_STATE_SYNC;
+		return;
+	}
+
+	if (c == ITM_OVERFLOW) {
+		dec->stats.overflows++;
+		return;
+	}
+
+	/* local timestamp, extension and global timestamp packets */
+	if ((c & 0x0f) == 0 || (c & 0x0b) == 0x08 || c == ITM_GTS1 || c == ITM_GTS2) {
+		if (c & 0x80) {
+			dec->need = c == ITM_GTS2 ? 6 : 4;
+			dec->state = ITM_STATE_CONTINUED;
+		} else if ((c & 0x0f) == 0) {
+			/* single byte local timestamp, value in [6:4] */
+			struct itm_packet packet = {
+				.type = ITM_PACKET_TIMESTAMP,
+				.header = c,
+				.value = (c >> 4) & 0x7,
+			};
+			dec->stats.timestamps++;
+			itm_emit(dec, &packet);
+		} else {
+			itm_emit_continued(dec);
+		}
+		return;
+	}
+
+	/* reserved encoding */
+	dec->stats.errors++;
+}
+
+/**
+ * Decode @a size bytes of trace, calling the handler for every complete
+ * packet. Decoding state is kept across calls.
+ */
+void itm_decoder_feed(struct itm_decoder *dec, const uint8_t *buf, size_t size)
+{
+	dec->stats.bytes += size;
+
+	for (size_t i = 0; i < size; i++) {
+		uint8_t c = buf[i];
+
+		switch (dec->state) {
+		case ITM_STATE_HEADER:
+			itm_decode_header(dec, c);
+			break;
+
+		case ITM_STATE_SOURCE:
+			dec->payload[dec->len++] = c;
+			if (dec->len == dec->need) {
+				dec->state = ITM_STATE_HEADER;
+				itm_emit_source(dec);
+			}
+			break;
+
+		case ITM_STATE_CONTINUED:
+			dec->payload[dec->len++] = c;
+			if (!(c & 0x80) || dec->len == dec->need) {
+				dec->state = ITM_STATE_HEADER;
+				itm_emit_continued(dec);
+			}
+			break;
+
+		case ITM_STATE_SYNC:
+			/* at least 47 zero bits, then a one */
+			if (c == 0) {
+				dec->zeros++;
+				break;
+			}
+			dec->state = ITM_STATE_HEADER;
+			if (c == 0x80 && dec->zeros >= 5) {
+				dec->stats.syncs++;
+				dec->page = 0;
+				break;
+			}
+			/* not a sync packet after all, resume with this byte */
+			dec->stats.errors += dec->zeros;
+			itm_decode_header(dec, c);
+			break;
+		}
+	}
+}
+
+/**
+ * Write a one line text description of a DWT or timestamp packet to
+ * @a out, like itmdump does.
+ * @returns the length of the line, or 0 for packets not described.
+ */
+int itm_packet_format(const struct itm_packet *packet, char *out, size_t size)
+{
+	static const char * const exc_fn[4] = { "?", "entry", "exit", "return" };
+	unsigned int comparator = (packet->id >> 1) & 3;
+	uint32_t value = packet->value;
+	int len;
+
+	switch (packet->type) {
+	case ITM_PACKET_DWT_EVENT:
+		len = snprintf(out, size, "event%s%s%s%s%s%s\n",
+				(value & (1 << 5)) ? " cyc" : "",
+				(value & (1 << 4)) ? " fold" : "",
+				(value & (1 << 3)) ? " lsu" : "",
+				(value & (1 << 2)) ? " slp" : "",
+				(value & (1 << 1)) ? " exc" : "",
+				(value & (1 << 0)) ? " cpi" : "");
+		break;
+	case ITM_PACKET_DWT_EXCEPTION:
+		len = snprintf(out, size, "exception %" PRIu32 " %s\n",
+				value & 0x1ff, exc_fn[(value >> 12) & 3]);
+		break;
+	case ITM_PACKET_DWT_PC_SAMPLE:
+		len = snprintf(out, size, "pc 0x%08" PRIx32 "\n", value);
+		break;
+	case ITM_PACKET_DWT_PC_SLEEP:
+		len = snprintf(out, size, "pc sleep\n");
+		break;
+	case ITM_PACKET_DWT_DATA_PC:
+		len = snprintf(out, size, "data %u pc 0x%08" PRIx32 "\n", comparator, value);
+		break;
+	case ITM_PACKET_DWT_DATA_ADDR:
+		len = snprintf(out, size, "data %u addr 0x%04" PRIx32 "\n", comparator, value);
+		break;
+	case ITM_PACKET_DWT_DATA_VALUE:
+		len = snprintf(out, size, "data %u %s%u 0x%0*" PRIx32 "\n", comparator,
+				(packet->id & 1) ? "write" : "read", packet->size * 8,
+				packet->size * 2, value);
+		break;
+	case ITM_PACKET_DWT_OTHER:
+		len = snprintf(out, size, "dwt %u 0x%" PRIx32 "\n", packet->id, value);
+		break;
+	case ITM_PACKET_TIMESTAMP:
+		len = snprintf(out, size, "timestamp +%" PRIu64 "\n", packet->value);
+		break;
+	case ITM_PACKET_GLOBAL_TIMESTAMP:
+		len = snprintf(out, size, "gts%c 0x%" PRIx64 "\n",
+				packet->header == ITM_GTS1 ? '1' : '2', packet->value);
+		break;
+	default:
+		return 0;
+	}
+
+	if (len < 0 || (size_t)len >= size)
+		return 0;
+	return len;
+}
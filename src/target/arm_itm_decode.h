@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_ITM_DECODE_H
+#define OPENOCD_TARGET_ARM_ITM_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* stimulus ports addressable through the stimulus port page extension */
+#define ITM_NUM_STIM_PORTS	256
+
+enum itm_packet_type {
+	ITM_PACKET_SWIT,		/* instrumentation, data of a stimulus port */
+	ITM_PACKET_DWT_EVENT,		/* event counter wrapping */
+	ITM_PACKET_DWT_EXCEPTION,	/* exception entry, exit or return */
+	ITM_PACKET_DWT_PC_SAMPLE,	/* periodic PC sample */
+	ITM_PACKET_DWT_PC_SLEEP,	/* periodic PC sample while sleeping */
+	ITM_PACKET_DWT_DATA_PC,		/* data trace, PC of the access */
+	ITM_PACKET_DWT_DATA_ADDR,	/* data trace, address offset */
+	ITM_PACKET_DWT_DATA_VALUE,	/* data trace, value read or written */
+	ITM_PACKET_DWT_OTHER,		/* hardware source not known here */
+	ITM_PACKET_TIMESTAMP,		/* local timestamp */
+	ITM_PACKET_GLOBAL_TIMESTAMP,	/* global timestamp, either half */
+};
+
+struct itm_packet {
+	enum itm_packet_type type;
+	uint8_t header;
+	/* stimulus port, or DWT comparator for data trace packets */
+	unsigned int id;
+	/* payload size in bytes, for source packets */
+	unsigned int size;
+	/* payload, little-endian for source packets */
+	const uint8_t *data;
+	uint64_t value;
+};
+
+struct itm_decoder_stats {
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t swit_packets;
+	uint64_t dwt_packets;
+	uint64_t timestamps;
+	uint64_t syncs;
+	/* overflow packets: the ITM lost packets before sending them */
+	uint64_t overflows;
+	/* bytes that do not make a valid packet */
+	uint64_t errors;
+};
+
+typedef void (*itm_packet_handler_t)(void *priv, const struct itm_packet *packet);
+
+struct itm_decoder {
+	unsigned int state;
+	uint8_t header;
+	uint8_t payload[8];
+	unsigned int len;
+	unsigned int need;
+	unsigned int zeros;
+	/* stimulus port page set by the last extension packet */
+	unsigned int page;
+
+	itm_packet_handler_t handler;
+	void *priv;
+
+	struct itm_decoder_stats stats;
+};
+
+void itm_decoder_init(struct itm_decoder *dec, itm_packet_handler_t handler, void *priv);
+void itm_decoder_feed(struct itm_decoder *dec, const uint8_t *buf, size_t size);
+int itm_packet_format(const struct itm_packet *packet, char *out, size_t size);
+
+#endif /* OPENOCD_TARGET_ARM_ITM_DECODE_H */
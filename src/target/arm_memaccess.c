@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/jim-nvp.h>
+#include <helper/log.h>
+#include "arm_memaccess.h"
+
+static const char * const arm_memaccess_dir_name[2] = { "read", "write" };
+static const char * const arm_memaccess_path_name[ARM_MEMACCESS_NUM_PATHS] = {
+	[ARM_MEMACCESS_PATH_FAST] = "fast",
+	[ARM_MEMACCESS_PATH_SLOW] = "slow",
+};
+
+static const struct jim_nvp nvp_arm_memaccess_mode[] = {
+	{ .name = "auto", .value = ARM_MEMACCESS_AUTO },
+	{ .name = "fast", .value = ARM_MEMACCESS_FAST },
+	{ .name = "slow", .value = ARM_MEMACCESS_SLOW },
+	{ .name = NULL, .value = -1 },
+};
+
+/**
+ * Pick the way to transfer @a count elements of @a size bytes at
+ * @a address. Only aligned words can go the fast way; in auto mode they do
+ * so when the transfer is long enough for it to pay off.
+ */
+enum arm_memaccess_path arm_memaccess_select(const struct arm_memaccess *ma,
+		bool write, target_addr_t address, uint32_t size, uint32_t count)
+{
+	if (size != 4 || (address % 4) != 0)
+		return ARM_MEMACCESS_PATH_SLOW;
+
+	switch (ma->mode) {
+	case ARM_MEMACCESS_FAST:
+		return ARM_MEMACCESS_PATH_FAST;
+	case ARM_MEMACCESS_SLOW:
+		return ARM_MEMACCESS_PATH_SLOW;
+	case ARM_MEMACCESS_AUTO:
+	default:
+		break;
+	}
+
+	if (count >= ma->fast_min_words[write ? 1 : 0])
+		return ARM_MEMACCESS_PATH_FAST;
+	return ARM_MEMACCESS_PATH_SLOW;
+}
+
+void arm_memaccess_account(struct arm_memaccess *ma, bool write,
+		enum arm_memaccess_path path, uint32_t bytes,
+		const struct duration *duration)
+{
+	struct arm_memaccess_stats *stats = &ma->stats[write ? 1 : 0][path];
+
+	stats->bytes += bytes;
+	stats->transfers++;
+	stats->seconds += duration_elapsed(duration);
+}
+
+static int arm_memaccess_time(struct target *target, bool write,
+		target_addr_t address, uint32_t words, uint8_t *buffer, float *seconds)
+{
+	struct duration duration;
+	int retval;
+
+	duration_start(&duration);
+	if (write)
+		retval = target_write_memory(target, address, 4, words, buffer);
+	else
+		retval = target_read_memory(target, address, 4, words, buffer);
+	duration_measure(&duration);
+	*seconds = duration_elapsed(&duration);
+
+	return retval;
+}
+
+/*
+ * Time both ways for growing transfer lengths and set the length from which
+ * the fast one is used. Writes store back what was read, so the memory is
+ * left unchanged; it must still be RAM that nothing else uses meanwhile.
+ */
+static int arm_memaccess_benchmark(struct command_invocation *cmd,
+		struct arm_memaccess *ma, target_addr_t address, uint32_t bytes)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct arm_memaccess saved = *ma;
+	uint32_t measured[2];
+	int retval;
+
+	if (target->state != TARGET_HALTED) {
+		command_print(CMD, "target %s is not halted", target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	uint8_t *buffer = malloc(bytes);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	ma->mode = ARM_MEMACCESS_SLOW;
+	retval = target_read_memory(target, address, 4, bytes / 4, buffer);
+
+	for (unsigned int dir = 0; dir < 2 && retval == ERROR_OK; dir++) {
+		bool write = dir == 1;
+		uint32_t fast_min_words = UINT32_MAX;
+
+		for (uint32_t words = 1; words <= bytes / 4; words *= 4) {
+			float seconds[ARM_MEMACCESS_NUM_PATHS];
+
+			ma->mode = ARM_MEMACCESS_FAST;
+			retval = arm_memaccess_time(target, write, address, words, buffer,
+					&seconds[ARM_MEMACCESS_PATH_FAST]);
+			if (retval != ERROR_OK)
+				break;
+
+			ma->mode = ARM_MEMACCESS_SLOW;
+			retval = arm_memaccess_time(target, write, address, words, buffer,
+					&seconds[ARM_MEMACCESS_PATH_SLOW]);
+			if (retval != ERROR_OK)
+				break;
+
+			command_print(CMD, "%-5s %6" PRIu32 " words: fast %8.3f ms, slow %8.3f ms",
+					arm_memaccess_dir_name[dir], words,
+					seconds[ARM_MEMACCESS_PATH_FAST] * 1000.0,
+					seconds[ARM_MEMACCESS_PATH_SLOW] * 1000.0);
+
+			/* The fast way must stay ahead for all longer transfers. */
+			if (seconds[ARM_MEMACCESS_PATH_FAST] <= seconds[ARM_MEMACCESS_PATH_SLOW]) {
+				if (fast_min_words == UINT32_MAX)
+					fast_min_words = words;
+			} else {
+				fast_min_words = UINT32_MAX;
+			}
+		}
+
+		measured[dir] = fast_min_words;
+	}
+
+	free(buffer);
+
+	/* Keep the statistics of regular use apart from the benchmark. */
+	*ma = saved;
+
+	if (retval != ERROR_OK) {
+		command_print(CMD, "memory access benchmark failed at " TARGET_ADDR_FMT, address);
+		return retval;
+	}
+
+	ma->fast_min_words[0] = measured[0];
+	ma->fast_min_words[1] = measured[1];
+	return ERROR_OK;
+}
+
+static void arm_memaccess_print(struct command_invocation *cmd,
+		const struct arm_memaccess *ma)
+{
+	const struct jim_nvp *n = jim_nvp_value2name_simple(nvp_arm_memaccess_mode, ma->mode);
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "mode                        %s", n->name);
+	for (unsigned int dir = 0; dir < 2; dir++) {
+		if (ma->fast_min_words[dir] == UINT32_MAX)
+			command_print(CMD, "%s.fast_min_words         never",
+					arm_memaccess_dir_name[dir]);
+		else
+			command_print(CMD, "%s.fast_min_words         %" PRIu32,
+					arm_memaccess_dir_name[dir], ma->fast_min_words[dir]);
+
+		for (unsigned int path = 0; path < ARM_MEMACCESS_NUM_PATHS; path++) {
+			const struct arm_memaccess_stats *stats = &ma->stats[dir][path];
+			double rate = stats->seconds > 0 ? stats->bytes / stats->seconds : 0;
+
+			command_print(CMD, "%s.%s.transfers         %" PRIu64,
+					arm_memaccess_dir_name[dir], arm_memaccess_path_name[path],
+					stats->transfers);
+			command_print(CMD, "%s.%s.bytes_per_sec     %.0f",
+					arm_memaccess_dir_name[dir], arm_memaccess_path_name[path],
+					rate);
+		}
+	}
+}
+
+COMMAND_HELPER(arm_memaccess_handle_command, struct arm_memaccess *ma)
+{
+	if (CMD_ARGC == 0) {
+		arm_memaccess_print(CMD, ma);
+		return ERROR_OK;
+	}
+
+	if (!strcmp(CMD_ARGV[0], "benchmark")) {
+		target_addr_t address;
+		uint32_t bytes = 4096;
+
+		if (CMD_ARGC < 2 || CMD_ARGC > 3)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
+		if (CMD_ARGC == 3)
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], bytes);
+		if ((address % 4) != 0 || bytes < 4 || (bytes % 4) != 0) {
+			command_print(CMD, "address and size must be word aligned");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+
+		int retval = arm_memaccess_benchmark(CMD, ma, address, bytes);
+		if (retval == ERROR_OK)
+			arm_memaccess_print(CMD, ma);
+		return retval;
+	}
+
+	if (!strcmp(CMD_ARGV[0], "reset")) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(ma->stats, 0, sizeof(ma->stats));
+		memset(ma->fast_min_words, 0, sizeof(ma->fast_min_words));
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	const struct jim_nvp *n = jim_nvp_name2value_simple(nvp_arm_memaccess_mode, CMD_ARGV[0]);
+	if (!n->name)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	ma->mode = n->value;
+
+	return ERROR_OK;
+}
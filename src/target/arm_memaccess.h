@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_MEMACCESS_H
+#define OPENOCD_TARGET_ARM_MEMACCESS_H
+
+#include <helper/command.h>
+#include <helper/time_support.h>
+#include "target.h"
+
+/**
+ * @file
+ * Choice between the ways a core debugged through its DCC (Cortex-A/R,
+ * AArch64) accesses memory. In the "fast" way the core repeats a load or
+ * store while words stream through the DTR; it needs aligned words and has
+ * a higher setup cost. The "slow" way executes one instruction per element
+ * and works for any size and alignment. Both go through the core, so they
+ * see memory as the core does, caches and MMU included.
+ */
+
+enum arm_memaccess_mode {
+	ARM_MEMACCESS_AUTO,
+	ARM_MEMACCESS_FAST,
+	ARM_MEMACCESS_SLOW,
+};
+
+enum arm_memaccess_path {
+	ARM_MEMACCESS_PATH_FAST,
+	ARM_MEMACCESS_PATH_SLOW,
+	ARM_MEMACCESS_NUM_PATHS,
+};
+
+struct arm_memaccess_stats {
+	uint64_t bytes;
+	uint64_t transfers;
+	float seconds;
+};
+
+struct arm_memaccess {
+	enum arm_memaccess_mode mode;
+	/* In auto mode, number of words from which the fast way is used, for
+	 * reads [0] and writes [1]; 0 until measured, meaning always. */
+	uint32_t fast_min_words[2];
+	struct arm_memaccess_stats stats[2][ARM_MEMACCESS_NUM_PATHS];
+};
+
+enum arm_memaccess_path arm_memaccess_select(const struct arm_memaccess *ma,
+		bool write, target_addr_t address, uint32_t size, uint32_t count);
+void arm_memaccess_account(struct arm_memaccess *ma, bool write,
+		enum arm_memaccess_path path, uint32_t bytes,
+		const struct duration *duration);
+
+COMMAND_HELPER(arm_memaccess_handle_command, struct arm_memaccess *ma);
+
+#endif /* OPENOCD_TARGET_ARM_MEMACCESS_H */
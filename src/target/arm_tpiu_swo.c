@@ -22,6 +22,8 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <jim.h>
 
@@ -30,12 +32,15 @@
 #include <helper/jim-nvp.h>
 #include <helper/list.h>
 #include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/time_support.h>
 #include <helper/types.h>
 #include <jtag/interface.h>
 #include <server/server.h>
 #include <target/arm_adi_v5.h>
 #include <target/target.h>
 #include <transport/transport.h>
+#include "arm_itm_decode.h"
 #include "arm_tpiu_swo.h"
 
 /* START_DEPRECATED_TPIU */
@@ -113,6 +118,16 @@ struct arm_tpiu_swo_object {
 	char *out_filename;
 	/** track TCP connections */
 	struct list_head connections;
+	/** trace data as read from the adapter at each poll */
+	uint8_t *trace_buf;
+	/** time of the last flush of the output file */
+	int64_t last_flush_ms;
+	/** decoder of the ITM/DWT packets in the trace */
+	struct itm_decoder itm;
+	/** outputs of decoded stimulus ports and DWT packets */
+	struct list_head itm_outputs;
+	struct arm_tpiu_swo_itm_output *itm_port_output[ITM_NUM_STIM_PORTS];
+	struct arm_tpiu_swo_itm_output *dwt_output;
 	/* START_DEPRECATED_TPIU */
 	bool recheck_ap_cur_target;
 	/* END_DEPRECATED_TPIU */
@@ -123,40 +138,160 @@ struct arm_tpiu_swo_connection {
 	struct connection *connection;
 };
 
+/* Value of stim_port for the output of decoded DWT packets */
+#define ARM_TPIU_SWO_ITM_DWT		UINT_MAX
+
+/*
+ * TCP service for the data of one stimulus port, or for the decoded DWT
+ * packets as text lines. Decoded data is gathered during a poll and sent
+ * once at its end.
+ */
+struct arm_tpiu_swo_itm_output {
+	struct list_head lh;
+	unsigned int stim_port;
+	char *service_port;
+	bool started;
+	struct list_head connections;
+	uint8_t *buf;
+	size_t len;
+	uint64_t bytes_sent;
+	uint64_t bytes_dropped;
+};
+
 struct arm_tpiu_swo_priv_connection {
 	struct arm_tpiu_swo_object *obj;
+	/* NULL for the raw trace stream */
+	struct arm_tpiu_swo_itm_output *output;
 };
 
 static LIST_HEAD(all_tpiu_swo);
 
-#define ARM_TPIU_SWO_TRACE_BUF_SIZE	4096
+#define ARM_TPIU_SWO_TRACE_BUF_SIZE	16384
+/* decoded data kept per output and poll, beyond that it is dropped */
+#define ARM_TPIU_SWO_ITM_BUF_SIZE	16384
+/* the output file is flushed at most this often */
+#define ARM_TPIU_SWO_FLUSH_INTERVAL_MS	100
+
+static bool arm_tpiu_swo_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/*
+ * Send @a size bytes to all the clients in @a connections, without waiting
+ * for slow ones. @returns the number of bytes some client did not get.
+ */
+static uint64_t arm_tpiu_swo_send(struct list_head *connections,
+		const uint8_t *buf, size_t size)
+{
+	struct arm_tpiu_swo_connection *c;
+	uint64_t dropped = 0;
+
+	list_for_each_entry(c, connections, lh) {
+		int written = connection_write(c->connection, buf, size);
+		if (written < 0) {
+			if (!arm_tpiu_swo_would_block())
+				log_socket_error("trace connection");
+			written = 0;
+		}
+		dropped += size - written;
+	}
+
+	return dropped;
+}
+
+static void arm_tpiu_swo_itm_append(struct arm_tpiu_swo_itm_output *output,
+		const void *data, size_t size)
+{
+	if (list_empty(&output->connections))
+		return;
+
+	if (output->len + size > ARM_TPIU_SWO_ITM_BUF_SIZE) {
+		output->bytes_dropped += size;
+		return;
+	}
+
+	memcpy(output->buf + output->len, data, size);
+	output->len += size;
+}
+
+static void arm_tpiu_swo_itm_packet(void *priv, const struct itm_packet *packet)
+{
+	struct arm_tpiu_swo_object *obj = priv;
+
+	if (packet->type == ITM_PACKET_SWIT) {
+		struct arm_tpiu_swo_itm_output *output = obj->itm_port_output[packet->id];
+		if (output)
+			arm_tpiu_swo_itm_append(output, packet->data, packet->size);
+		return;
+	}
+
+	if (obj->dwt_output && !list_empty(&obj->dwt_output->connections)) {
+		char line[64];
+		int len = itm_packet_format(packet, line, sizeof(line));
+		if (len > 0)
+			arm_tpiu_swo_itm_append(obj->dwt_output, line, len);
+	}
+}
 
 static int arm_tpiu_swo_poll_trace(void *priv)
 {
 	struct arm_tpiu_swo_object *obj = priv;
-	uint8_t buf[ARM_TPIU_SWO_TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
-	struct arm_tpiu_swo_connection *c;
+	uint8_t *buf = obj->trace_buf;
+	size_t size = ARM_TPIU_SWO_TRACE_BUF_SIZE;
+	struct arm_tpiu_swo_itm_output *output;
 
 	int retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
+	if (retval != ERROR_OK)
 		return retval;
 
+	/* batch the writes to the file instead of flushing every poll */
+	if (obj->file && timeval_ms() - obj->last_flush_ms >= ARM_TPIU_SWO_FLUSH_INTERVAL_MS) {
+		fflush(obj->file);
+		obj->last_flush_ms = timeval_ms();
+	}
+
+	if (!size)
+		return ERROR_OK;
+
+	/* trace from the targets, one of them may be about to halt */
+	target_poll_activity(NULL);
+
 	target_call_trace_callbacks(/*target*/NULL, size, buf);
 
 	if (obj->file) {
-		if (fwrite(buf, 1, size, obj->file) == size) {
-			fflush(obj->file);
-		} else {
+		if (fwrite(buf, 1, size, obj->file) != size) {
 			LOG_ERROR("Error writing to the SWO trace destination file");
 			return ERROR_FAIL;
 		}
 	}
 
-	if (obj->out_filename && obj->out_filename[0] == ':')
+	if (obj->out_filename && obj->out_filename[0] == ':') {
+		struct arm_tpiu_swo_connection *c;
+
 		list_for_each_entry(c, &obj->connections, lh)
 			if (connection_write(c->connection, buf, size) != (int)size)
 				LOG_ERROR("Error writing to connection"); /* FIXME: which connection? */
+	}
+
+	/* the formatter interleaves other trace sources, ITM can't be decoded */
+	if (obj->en_formatter)
+		return ERROR_OK;
+
+	itm_decoder_feed(&obj->itm, buf, size);
+
+	list_for_each_entry(output, &obj->itm_outputs, lh) {
+		if (!output->len)
+			continue;
+		uint64_t dropped = arm_tpiu_swo_send(&output->connections, output->buf, output->len);
+		output->bytes_dropped += dropped;
+		output->bytes_sent += output->len - dropped;
+		output->len = 0;
+	}
 
 	return ERROR_OK;
 }
@@ -197,12 +332,35 @@ static void arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_
 
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
+	struct arm_tpiu_swo_itm_output *output;
+
 	if (obj->file) {
 		fclose(obj->file);
 		obj->file = NULL;
 	}
 	if (obj->out_filename && obj->out_filename[0] == ':')
 		remove_service(TCP_SERVICE_NAME, &obj->out_filename[1]);
+
+	list_for_each_entry(output, &obj->itm_outputs, lh) {
+		if (output->started)
+			remove_service(TCP_SERVICE_NAME, output->service_port);
+		output->started = false;
+		output->len = 0;
+	}
+}
+
+static void arm_tpiu_swo_free_itm_output(struct arm_tpiu_swo_object *obj,
+		struct arm_tpiu_swo_itm_output *output)
+{
+	if (output->stim_port == ARM_TPIU_SWO_ITM_DWT)
+		obj->dwt_output = NULL;
+	else
+		obj->itm_port_output[output->stim_port] = NULL;
+
+	list_del(&output->lh);
+	free(output->service_port);
+	free(output->buf);
+	free(output);
 }
 
 int arm_tpiu_swo_cleanup_all(void)
@@ -237,6 +395,11 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		struct arm_tpiu_swo_itm_output *output, *output_tmp;
+		list_for_each_entry_safe(output, output_tmp, &obj->itm_outputs, lh)
+			arm_tpiu_swo_free_itm_output(obj, output);
+
+		free(obj->trace_buf);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -245,17 +408,31 @@ int arm_tpiu_swo_cleanup_all(void)
 	return ERROR_OK;
 }
 
-static int arm_tpiu_swo_service_new_connection(struct connection *connection)
+static struct list_head *arm_tpiu_swo_connections(struct connection *connection)
 {
 	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
-	struct arm_tpiu_swo_object *obj = priv->obj;
+
+	if (priv->output)
+		return &priv->output->connections;
+	return &priv->obj->connections;
+}
+
+static int arm_tpiu_swo_service_new_connection(struct connection *connection)
+{
 	struct arm_tpiu_swo_connection *c = malloc(sizeof(*c));
 	if (!c) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
+
+	/* a slow client of a decoded output must not stall the trace poll, it
+	 * loses data instead; the raw stream stays lossless */
+	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
+	if (priv->output)
+		socket_nonblock(connection->fd);
+
 	c->connection = connection;
-	list_add(&c->lh, &obj->connections);
+	list_add(&c->lh, arm_tpiu_swo_connections(connection));
 	return ERROR_OK;
 }
 
@@ -267,7 +444,7 @@ static int arm_tpiu_swo_service_input(struct connection *connection)
 
 	if (bytes_read == 0) {
 		return ERROR_SERVER_REMOTE_CLOSED;
-	} else if (bytes_read == -1) {
+	} else if (bytes_read == -1 && !arm_tpiu_swo_would_block()) {
 		LOG_ERROR("error during read: %s", strerror(errno));
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
@@ -277,11 +454,9 @@ static int arm_tpiu_swo_service_input(struct connection *connection)
 
 static int arm_tpiu_swo_service_connection_closed(struct connection *connection)
 {
-	struct arm_tpiu_swo_priv_connection *priv = connection->service->priv;
-	struct arm_tpiu_swo_object *obj = priv->obj;
 	struct arm_tpiu_swo_connection *c, *tmp;
 
-	list_for_each_entry_safe(c, tmp, &obj->connections, lh)
+	list_for_each_entry_safe(c, tmp, arm_tpiu_swo_connections(connection), lh)
 		if (c->connection == connection) {
 			list_del(&c->lh);
 			free(c);
@@ -595,6 +770,72 @@ static const struct service_driver arm_tpiu_swo_service_driver = {
 	.keep_client_alive_handler = NULL,
 };
 
+/*
+ * Prepare the capture started by enable: trace buffer, buffering of the
+ * output file and, with the formatter bypassed, the ITM decoder and the
+ * services of its outputs.
+ */
+static int arm_tpiu_swo_open_itm_outputs(struct arm_tpiu_swo_object *obj)
+{
+	struct arm_tpiu_swo_itm_output *output;
+
+	if (!obj->trace_buf) {
+		obj->trace_buf = malloc(ARM_TPIU_SWO_TRACE_BUF_SIZE);
+		if (!obj->trace_buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	if (obj->file)
+		setvbuf(obj->file, NULL, _IOFBF, 64 * 1024);
+	obj->last_flush_ms = timeval_ms();
+
+	itm_decoder_init(&obj->itm, arm_tpiu_swo_itm_packet, obj);
+
+	if (list_empty(&obj->itm_outputs))
+		return ERROR_OK;
+
+	if (obj->en_formatter) {
+		LOG_WARNING("%s: formatter enabled, ITM trace will not be decoded", obj->name);
+		return ERROR_OK;
+	}
+
+	list_for_each_entry(output, &obj->itm_outputs, lh) {
+		if (!output->buf) {
+			output->buf = malloc(ARM_TPIU_SWO_ITM_BUF_SIZE);
+			if (!output->buf) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+		}
+
+		struct arm_tpiu_swo_priv_connection *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		priv->obj = obj;
+		priv->output = output;
+
+		if (output->stim_port == ARM_TPIU_SWO_ITM_DWT)
+			LOG_INFO("starting DWT trace server for %s on %s", obj->name,
+					output->service_port);
+		else
+			LOG_INFO("starting ITM port %u server for %s on %s", output->stim_port,
+					obj->name, output->service_port);
+		int retval = add_service(&arm_tpiu_swo_service_driver, output->service_port,
+				CONNECTION_LIMIT_UNLIMITED, priv);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Can't configure trace TCP port %s", output->service_port);
+			return retval;
+		}
+		output->started = true;
+	}
+
+	return ERROR_OK;
+}
+
 static int jim_arm_tpiu_swo_enable(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 {
 	struct command *c = jim_to_command(interp);
@@ -716,6 +957,7 @@ static int jim_arm_tpiu_swo_enable(Jim_Interp *interp, int argc, Jim_Obj *const
 				return JIM_ERR;
 			}
 			priv->obj = obj;
+			priv->output = NULL;
 			LOG_INFO("starting trace server for %s on %s", obj->name, &obj->out_filename[1]);
 			retval = add_service(&arm_tpiu_swo_service_driver, &obj->out_filename[1],
 				CONNECTION_LIMIT_UNLIMITED, priv);
@@ -731,6 +973,12 @@ static int jim_arm_tpiu_swo_enable(Jim_Interp *interp, int argc, Jim_Obj *const
 			}
 		}
 
+		retval = arm_tpiu_swo_open_itm_outputs(obj);
+		if (retval != ERROR_OK) {
+			arm_tpiu_swo_close_output(obj);
+			return JIM_ERR;
+		}
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -861,6 +1109,148 @@ static int jim_arm_tpiu_swo_disable(Jim_Interp *interp, int argc, Jim_Obj *const
 	return JIM_OK;
 }
 
+static int arm_tpiu_swo_set_itm_output(struct command_invocation *cmd,
+		struct arm_tpiu_swo_object *obj, unsigned int stim_port, const char *service_port)
+{
+	struct arm_tpiu_swo_itm_output *output;
+
+	if (obj->en_capture) {
+		command_print(CMD, "%s: disable the trace capture first", obj->name);
+		return ERROR_FAIL;
+	}
+
+	if (stim_port == ARM_TPIU_SWO_ITM_DWT)
+		output = obj->dwt_output;
+	else
+		output = obj->itm_port_output[stim_port];
+
+	if (!strcmp(service_port, "disabled")) {
+		if (output)
+			arm_tpiu_swo_free_itm_output(obj, output);
+		return ERROR_OK;
+	}
+
+	if (!output) {
+		output = calloc(1, sizeof(*output));
+		if (!output) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		output->stim_port = stim_port;
+		INIT_LIST_HEAD(&output->connections);
+		list_add_tail(&output->lh, &obj->itm_outputs);
+
+		if (stim_port == ARM_TPIU_SWO_ITM_DWT)
+			obj->dwt_output = output;
+		else
+			obj->itm_port_output[stim_port] = output;
+	}
+
+	free(output->service_port);
+	output->service_port = strdup(service_port);
+	if (!output->service_port) {
+		LOG_ERROR("Out of memory");
+		arm_tpiu_swo_free_itm_output(obj, output);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_port)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int stim_port;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], stim_port);
+	if (stim_port >= ITM_NUM_STIM_PORTS) {
+		command_print(CMD, "stimulus port must be lower than %u", ITM_NUM_STIM_PORTS);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	return arm_tpiu_swo_set_itm_output(CMD, obj, stim_port, CMD_ARGV[1]);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_dwt)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return arm_tpiu_swo_set_itm_output(CMD, obj, ARM_TPIU_SWO_ITM_DWT, CMD_ARGV[0]);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_itm_stats)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	struct itm_decoder_stats *stats = &obj->itm.stats;
+	struct arm_tpiu_swo_itm_output *output;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		list_for_each_entry(output, &obj->itm_outputs, lh) {
+			output->bytes_sent = 0;
+			output->bytes_dropped = 0;
+		}
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "bytes               %" PRIu64, stats->bytes);
+	command_print(CMD, "packets             %" PRIu64, stats->packets);
+	command_print(CMD, "swit_packets        %" PRIu64, stats->swit_packets);
+	command_print(CMD, "dwt_packets         %" PRIu64, stats->dwt_packets);
+	command_print(CMD, "timestamps          %" PRIu64, stats->timestamps);
+	command_print(CMD, "syncs               %" PRIu64, stats->syncs);
+	command_print(CMD, "overflows           %" PRIu64, stats->overflows);
+	command_print(CMD, "errors              %" PRIu64, stats->errors);
+	list_for_each_entry(output, &obj->itm_outputs, lh) {
+		char name[16];
+		if (output->stim_port == ARM_TPIU_SWO_ITM_DWT)
+			snprintf(name, sizeof(name), "dwt");
+		else
+			snprintf(name, sizeof(name), "port%u", output->stim_port);
+		command_print(CMD, "%s.bytes_sent    %" PRIu64, name, output->bytes_sent);
+		command_print(CMD, "%s.bytes_dropped %" PRIu64, name, output->bytes_dropped);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_swo_itm_command_handlers[] = {
+	{
+		.name = "port",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_port,
+		.help = "Serve the data of an ITM stimulus port on a TCP port",
+		.usage = "stimulus_port (tcp_port|'disabled')",
+	},
+	{
+		.name = "dwt",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_dwt,
+		.help = "Serve the decoded DWT and timestamp packets as text on a TCP port",
+		.usage = "(tcp_port|'disabled')",
+	},
+	{
+		.name = "stats",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_itm_stats,
+		.help = "Display (or reset) the ITM decoder and output counters",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration arm_tpiu_swo_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -897,6 +1287,13 @@ static const struct command_registration arm_tpiu_swo_instance_command_handlers[
 		.usage = "",
 		.help = "Disables the TPIU/SWO output",
 	},
+	{
+		.name = "itm",
+		.mode = COMMAND_ANY,
+		.help = "ITM/DWT trace decoding",
+		.usage = "",
+		.chain = arm_tpiu_swo_itm_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -952,6 +1349,7 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 		return JIM_ERR;
 	}
 	INIT_LIST_HEAD(&obj->connections);
+	INIT_LIST_HEAD(&obj->itm_outputs);
 	adiv5_mem_ap_spot_init(&obj->spot);
 	obj->spot.base = TPIU_SWO_DEFAULT_BASE;
 	obj->port_width = 1;
@@ -1536,19 +1536,16 @@ int arm_checksum_memory(struct target *target,
 
 	assert(sizeof(arm_crc_code_le) % 4 == 0);
 
-	retval = target_alloc_working_area(target,
-			sizeof(arm_crc_code_le), &crc_algorithm);
-	if (retval != ERROR_OK)
-		return retval;
-
 	/* convert code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(arm_crc_code_le) / 4; i++) {
-		retval = target_write_u32(target,
-				crc_algorithm->address + i * sizeof(uint32_t),
+	uint8_t arm_crc_code[sizeof(arm_crc_code_le)];
+	for (i = 0; i < ARRAY_SIZE(arm_crc_code_le) / 4; i++)
+		target_buffer_set_u32(target, &arm_crc_code[i * 4],
 				le_to_h_u32(&arm_crc_code_le[i * 4]));
-		if (retval != ERROR_OK)
-			goto cleanup;
-	}
+
+	retval = target_alloc_resident_working_area(target, arm_crc_code,
+			sizeof(arm_crc_code), &crc_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
 
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
 	arm_algo.core_mode = ARM_MODE_SVC;
@@ -1580,7 +1577,6 @@ int arm_checksum_memory(struct target *target,
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 
-cleanup:
 	target_free_working_area(target, crc_algorithm);
 
 	return retval;
@@ -1615,22 +1611,18 @@ int arm_blank_check_memory(struct target *target,
 		return ERROR_FAIL;
 	}
 
+	/* convert code into a buffer in target endianness */
+	uint8_t check_code[sizeof(check_code_le)];
+	for (i = 0; i < ARRAY_SIZE(check_code_le) / 4; i++)
+		target_buffer_set_u32(target, &check_code[i * 4],
+				le_to_h_u32(&check_code_le[i * 4]));
+
 	/* make sure we have a working area */
-	retval = target_alloc_working_area(target,
-			sizeof(check_code_le), &check_algorithm);
+	retval = target_alloc_resident_working_area(target, check_code,
+			sizeof(check_code), &check_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* convert code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(check_code_le) / 4; i++) {
-		retval = target_write_u32(target,
-				check_algorithm->address
-				+ i * sizeof(uint32_t),
-				le_to_h_u32(&check_code_le[i * 4]));
-		if (retval != ERROR_OK)
-			goto cleanup;
-	}
-
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
 	arm_algo.core_mode = ARM_MODE_SVC;
 	arm_algo.core_state = ARM_STATE_ARM;
@@ -1660,7 +1652,6 @@ int arm_blank_check_memory(struct target *target,
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
-cleanup:
 	target_free_working_area(target, check_algorithm);
 
 	if (retval != ERROR_OK)
@@ -13,6 +13,7 @@
 #include "armv4_5_mmu.h"
 #include "armv4_5_cache.h"
 #include "arm_dpm.h"
+#include "arm_memaccess.h"
 
 enum {
 	ARM_PC  = 15,
@@ -112,6 +113,9 @@ struct armv7a_common {
 	/* cache specific to V7 Memory Management Unit compatible with v4_5*/
 	struct armv7a_mmu_common armv7a_mmu;
 
+	/* choice of the memory access path */
+	struct arm_memaccess memaccess;
+
 	int (*examine_debug_reason)(struct target *target);
 	int (*post_debug_entry)(struct target *target);
 
@@ -888,15 +888,11 @@ int armv7m_checksum_memory(struct target *target,
 #include "../../contrib/loaders/checksum/armv7m_crc.inc"
 	};
 
-	retval = target_alloc_working_area(target, sizeof(cortex_m_crc_code), &crc_algorithm);
+	retval = target_alloc_resident_working_area(target, cortex_m_crc_code,
+			sizeof(cortex_m_crc_code), &crc_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_write_buffer(target, crc_algorithm->address,
-			sizeof(cortex_m_crc_code), (uint8_t *)cortex_m_crc_code);
-	if (retval != ERROR_OK)
-		goto cleanup;
-
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
@@ -920,7 +916,6 @@ int armv7m_checksum_memory(struct target *target,
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 
-cleanup:
 	target_free_working_area(target, crc_algorithm);
 
 	return retval;
@@ -945,14 +940,10 @@ int armv7m_blank_check_memory(struct target *target,
 	const uint32_t code_size = sizeof(erase_check_code);
 
 	/* make sure we have a working area */
-	if (target_alloc_working_area(target, code_size,
-		&erase_check_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
-	retval = target_write_buffer(target, erase_check_algorithm->address,
-			code_size, erase_check_code);
+	retval = target_alloc_resident_working_area(target, erase_check_code,
+			code_size, &erase_check_algorithm);
 	if (retval != ERROR_OK)
-		goto cleanup1;
+		return retval;
 
 	/* prepare blocks array for algo */
 	struct algo_block {
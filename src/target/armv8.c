@@ -28,6 +28,7 @@
 #include "target.h"
 #include "target_type.h"
 #include "semihosting_common.h"
+#include "smp.h"
 
 static const char * const armv8_state_strings[] = {
 	"AArch32", "Thumb", "Jazelle", "ThumbEE", "AArch64",
@@ -1141,6 +1142,33 @@ static int armv8_aarch64_state(struct target *target)
 	return ERROR_OK;
 }
 
+/**
+ * Complete a debug entry whose register cache fill was put off because the
+ * PE only halted along with the rest of its SMP group. Everything that uses
+ * the register cache or executes instructions on the PE calls this first.
+ */
+int armv8_finish_debug_entry(struct armv8_common *armv8)
+{
+	struct target *target = armv8->arm.target;
+	int retval;
+
+	if (!armv8->debug_entry_deferred)
+		return ERROR_OK;
+	armv8->debug_entry_deferred = false;
+
+	LOG_DEBUG("%s: filling deferred register cache", target_name(target));
+
+	retval = armv8_dpm_read_current_registers(&armv8->dpm);
+	if (retval == ERROR_OK && armv8->post_debug_entry)
+		retval = armv8->post_debug_entry(target);
+
+	struct smp_stats *stats = smp_group_stats(target);
+	if (stats)
+		stats->regs_filled++;
+
+	return retval;
+}
+
 int armv8_arch_state(struct target *target)
 {
 	static const char * const state[] = {
@@ -1155,6 +1183,9 @@ int armv8_arch_state(struct target *target)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	if (target->state == TARGET_HALTED)
+		armv8_finish_debug_entry(armv8);
+
 	if (arm->core_state == ARM_STATE_AARCH64)
 		armv8_aarch64_state(target);
 	else
@@ -1497,6 +1528,10 @@ static int armv8_get_core_reg(struct reg *reg)
 	if (target->state != TARGET_HALTED)
 		return ERROR_TARGET_NOT_HALTED;
 
+	int retval = armv8_finish_debug_entry(target_to_armv8(target));
+	if (retval != ERROR_OK || reg->valid)
+		return retval;
+
 	return arm->read_core_reg(target, reg, armv8_reg->num, arm->core_mode);
 }
 
@@ -1547,6 +1582,10 @@ static int armv8_get_core_reg32(struct reg *reg)
 	if (target->state != TARGET_HALTED)
 		return ERROR_TARGET_NOT_HALTED;
 
+	retval = armv8_finish_debug_entry(target_to_armv8(target));
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* get the corresponding Aarch64 register */
 	reg64 = cache->reg_list + armv8_reg->num;
 	if (reg64->valid) {
@@ -1748,6 +1787,8 @@ const struct command_registration armv8_command_handlers[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+/* Only the execution state is used, which is valid even while the debug entry
+ * is deferred; the registers are read when gdb accesses them. */
 const char *armv8_get_gdb_arch(struct target *target)
 {
 	struct arm *arm = target_to_arm(target);
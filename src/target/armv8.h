@@ -13,6 +13,7 @@
 #include "armv4_5_cache.h"
 #include "armv8_dpm.h"
 #include "arm_cti.h"
+#include "arm_memaccess.h"
 
 enum {
 	ARMV8_R0 = 0,
@@ -203,11 +204,18 @@ struct armv8_common {
 
 	struct armv8_mmu_common armv8_mmu;
 
+	/* choice of the memory access path */
+	struct arm_memaccess memaccess;
+
 	struct arm_cti *cti;
 
 	/* last run-control command issued to this target (resume, halt, step) */
 	enum run_control_op last_run_control_op;
 
+	/* register cache fill and post_debug_entry put off at the last debug
+	 * entry, see armv8_finish_debug_entry() */
+	bool debug_entry_deferred;
+
 	/* Direct processor core register read and writes */
 	int (*read_reg_u64)(struct armv8_common *armv8, int num, uint64_t *value);
 	int (*write_reg_u64)(struct armv8_common *armv8, int num, uint64_t value);
@@ -283,6 +291,7 @@ static inline bool is_armv8(struct armv8_common *armv8)
 #define PAGE_SIZE_4KB_TRBBASE_MASK	0xFFFFFFFFF000
 
 int armv8_arch_state(struct target *target);
+int armv8_finish_debug_entry(struct armv8_common *armv8);
 int armv8_read_mpidr(struct armv8_common *armv8);
 int armv8_identify_cache(struct armv8_common *armv8);
 int armv8_init_arch_info(struct target *target, struct armv8_common *armv8);
@@ -156,6 +156,11 @@ static int dpmv8_dpm_prepare(struct arm_dpm *dpm)
 	uint32_t dscr;
 	int retval;
 
+	/* instructions run on the PE may clobber registers not read yet */
+	retval = armv8_finish_debug_entry(armv8);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* set up invariant:  ITE is set after ever DPM operation */
 	long long then = timeval_ms();
 	for (;; ) {
@@ -860,16 +865,11 @@ static int dpmv8_add_breakpoint(struct target *target, struct breakpoint *bp);
  * @param bpwp: true ensures breakpoints and watchpoints are set,
  *	false ensures they are cleared
  */
-int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
+static int dpmv8_update_bpwp(struct arm_dpm *dpm, bool bpwp)
 {
 	struct arm *arm = dpm->arm;
-	struct reg_cache *cache = arm->core_cache;
 	int retval;
 
-	retval = dpm->prepare(dpm);
-	if (retval != ERROR_OK)
-		goto done;
-
 	/* If we're managing hardware breakpoints for this core, enable
 	 * or disable them as requested.
 	 *
@@ -885,7 +885,7 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 			retval = dpmv8_maybe_update_bpwp(dpm, bpwp, &dbp->bpwp,
 					bp ? &bp->is_set : NULL);
 			if (retval != ERROR_OK)
-				goto done;
+				return retval;
 		}
 	}
 
@@ -897,12 +897,41 @@ int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
 		retval = dpmv8_maybe_update_bpwp(dpm, bpwp, &dwp->bpwp,
 				wp ? &wp->is_set : NULL);
 		if (retval != ERROR_OK)
-			goto done;
+			return retval;
 	}
 
 	/* NOTE:  writes to breakpoint and watchpoint registers might
 	 * be queued, and need (efficient/batched) flushing later.
 	 */
+	return ERROR_OK;
+}
+
+/**
+ * Only enable or disable the breakpoints and watchpoints, leaving the core
+ * mode and registers alone; for a PE whose registers were never read.
+ */
+int armv8_dpm_update_bpwp(struct arm_dpm *dpm, bool bpwp)
+{
+	int retval = dpm->prepare(dpm);
+	if (retval == ERROR_OK)
+		retval = dpmv8_update_bpwp(dpm, bpwp);
+	dpm->finish(dpm);
+	return retval;
+}
+
+int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp)
+{
+	struct arm *arm = dpm->arm;
+	struct reg_cache *cache = arm->core_cache;
+	int retval;
+
+	retval = dpm->prepare(dpm);
+	if (retval != ERROR_OK)
+		goto done;
+
+	retval = dpmv8_update_bpwp(dpm, bpwp);
+	if (retval != ERROR_OK)
+		goto done;
 
 	/* Restore original core mode and state */
 	retval = armv8_dpm_modeswitch(dpm, ARM_MODE_ANY);
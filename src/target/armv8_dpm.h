@@ -29,6 +29,7 @@ int armv8_dpm_modeswitch(struct arm_dpm *dpm, enum arm_mode mode);
 
 
 int armv8_dpm_write_dirty_registers(struct arm_dpm *dpm, bool bpwp);
+int armv8_dpm_update_bpwp(struct arm_dpm *dpm, bool bpwp);
 
 /* DSCR bits; see ARMv7a arch spec section C10.3.1.
  * Not all v7 bits are valid in v6.
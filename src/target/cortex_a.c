@@ -67,6 +67,8 @@ static int cortex_a_unset_breakpoint(struct target *target,
 	struct breakpoint *breakpoint);
 static int cortex_a_wait_dscr_bits(struct target *target, uint32_t mask,
 	uint32_t value, uint32_t *dscr);
+static int cortex_a_set_dcc_mode(struct target *target, uint32_t mode,
+	uint32_t *dscr);
 static int cortex_a_mmu(struct target *target, int *enabled);
 static int cortex_a_mmu_modify(struct target *target, int enable);
 static int cortex_a_virt2phys(struct target *target,
@@ -538,6 +540,104 @@ static int cortex_a_instr_read_data_r0(struct arm_dpm *dpm,
 	return cortex_a_instr_read_data_rt_dcc(dpm, 0, data);
 }
 
+/* Leave DCC stall mode after a batch of queued transfers, and check that
+ * every instruction of the batch executed. */
+static int cortex_a_end_core_regs_batch(struct cortex_a_common *a, int retval)
+{
+	struct armv7a_common *armv7a = &a->armv7a_common;
+	struct target *target = armv7a->arm.target;
+	uint32_t dscr;
+
+	int retval2 = mem_ap_read_atomic_u32(armv7a->debug_ap,
+			armv7a->debug_base + CPUDBG_DSCR, &dscr);
+	if (retval2 == ERROR_OK)
+		retval2 = cortex_a_set_dcc_mode(target, DSCR_EXT_DCC_NON_BLOCKING, &dscr);
+	if (retval2 == ERROR_OK)
+		retval2 = cortex_a_wait_instrcmpl(target, &dscr, true);
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+	if (retval == ERROR_OK && (dscr & DSCR_STICKY_UNDEFINED)) {
+		LOG_ERROR("undefined instruction in register transfer, dscr 0x%08" PRIx32, dscr);
+		retval = ERROR_FAIL;
+	}
+
+	return retval;
+}
+
+/* Enter DCC stall mode: ITR writes then wait for the previous instruction,
+ * DTR accesses for the DCC, so a whole batch can be queued at once. */
+static int cortex_a_begin_core_regs_batch(struct cortex_a_common *a)
+{
+	struct armv7a_common *armv7a = &a->armv7a_common;
+	uint32_t dscr;
+
+	int retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
+			armv7a->debug_base + CPUDBG_DSCR, &dscr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cortex_a_set_dcc_mode(armv7a->arm.target, DSCR_EXT_DCC_STALL_MODE, &dscr);
+}
+
+static int cortex_a_instr_read_core_regs(struct arm_dpm *dpm,
+	uint16_t mask, uint32_t *data)
+{
+	struct cortex_a_common *a = dpm_to_a(dpm);
+	struct armv7a_common *armv7a = &a->armv7a_common;
+	int retval;
+
+	retval = cortex_a_begin_core_regs_batch(a);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < 15 && retval == ERROR_OK; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+
+		/* Rn to DCC, "MCR p14, 0, Rn, c0, c5, 0" */
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_ITR, ARMV4_5_MCR(14, 0, i, 0, 5, 0));
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DTRTX, &data[i]);
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(armv7a->debug_ap->dap);
+
+	return cortex_a_end_core_regs_batch(a, retval);
+}
+
+static int cortex_a_instr_write_core_regs(struct arm_dpm *dpm,
+	uint16_t mask, const uint32_t *data)
+{
+	struct cortex_a_common *a = dpm_to_a(dpm);
+	struct armv7a_common *armv7a = &a->armv7a_common;
+	int retval;
+
+	retval = cortex_a_begin_core_regs_batch(a);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < 15 && retval == ERROR_OK; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DTRRX, data[i]);
+		/* DCC to Rn, "MRC p14, 0, Rn, c0, c5, 0" */
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_ITR, ARMV4_5_MRC(14, 0, i, 0, 5, 0));
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(armv7a->debug_ap->dap);
+
+	return cortex_a_end_core_regs_batch(a, retval);
+}
+
 static int cortex_a_bpwp_enable(struct arm_dpm *dpm, unsigned index_t,
 	uint32_t addr, uint32_t control)
 {
@@ -616,6 +716,9 @@ static int cortex_a_dpm_setup(struct cortex_a_common *a, uint32_t didr)
 	dpm->instr_read_data_dcc = cortex_a_instr_read_data_dcc;
 	dpm->instr_read_data_r0 = cortex_a_instr_read_data_r0;
 
+	dpm->instr_read_core_regs = cortex_a_instr_read_core_regs;
+	dpm->instr_write_core_regs = cortex_a_instr_write_core_regs;
+
 	dpm->bpwp_enable = cortex_a_bpwp_enable;
 	dpm->bpwp_disable = cortex_a_bpwp_disable;
 
@@ -636,20 +739,151 @@ static struct target *get_cortex_a(struct target *target, int32_t coreid)
 	}
 	return target;
 }
-static int cortex_a_halt(struct target *target);
+/*
+ * Flush the queue of every DAP used by the SMP group, each only once.
+ */
+static int cortex_a_run_smp(struct target *target)
+{
+	struct target_list *head, *prev;
+	int retval = ERROR_OK;
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct adiv5_dap *dap;
+		bool flushed = false;
+
+		if (!target_was_examined(curr))
+			continue;
+
+		dap = target_to_armv7a(curr)->debug_ap->dap;
+		foreach_smp_target(prev, target->smp_targets) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target) &&
+					target_to_armv7a(prev->target)->debug_ap->dap == dap) {
+				flushed = true;
+				break;
+			}
+		}
+		if (flushed)
+			continue;
+
+		int run_retval = dap_run(dap);
+		if (retval == ERROR_OK)
+			retval = run_retval;
+	}
+
+	return retval;
+}
 
+/*
+ * Wait until DSCR of all examined PEs of the SMP group but @a exclude has
+ * @a mask bits equal to @a value. Each round reads all of them with one
+ * queue flush per DAP.
+ */
+static int cortex_a_wait_dscr_smp(struct target *target, struct target *exclude,
+	uint32_t mask, uint32_t value)
+{
+	int64_t then = timeval_ms();
+	int retval;
+
+	for (;;) {
+		struct target_list *head;
+		bool done = true;
+
+		retval = ERROR_OK;
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+			struct armv7a_common *armv7a = target_to_armv7a(curr);
+
+			if (curr == exclude || !target_was_examined(curr))
+				continue;
+
+			retval = mem_ap_read_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DSCR,
+					&target_to_cortex_a(curr)->cpudbg_dscr);
+			if (retval != ERROR_OK)
+				break;
+		}
+		int run_retval = cortex_a_run_smp(target);
+		if (retval == ERROR_OK)
+			retval = run_retval;
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Could not read DSCR register");
+			return retval;
+		}
+
+		foreach_smp_target(head, target->smp_targets) {
+			struct target *curr = head->target;
+
+			if (curr == exclude || !target_was_examined(curr))
+				continue;
+			if ((target_to_cortex_a(curr)->cpudbg_dscr & mask) != value) {
+				done = false;
+				break;
+			}
+		}
+		if (done)
+			return ERROR_OK;
+
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("timeout waiting for DSCR bit change");
+			return ERROR_FAIL;
+		}
+	}
+}
+
+/*
+ * Halt all other PEs of the SMP group: the requests are queued together and
+ * the PEs are waited for together, rather than one PE after the other.
+ */
 static int cortex_a_halt_smp(struct target *target)
 {
-	int retval = 0;
 	struct target_list *head;
+	struct duration duration;
+	int retval = ERROR_OK;
+
+	duration_start(&duration);
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		struct armv7a_common *armv7a = target_to_armv7a(curr);
+
+		if (curr == target || curr->state == TARGET_HALTED ||
+				!target_was_examined(curr))
+			continue;
+
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DRCR, DRCR_HALT);
+		if (retval != ERROR_OK)
+			break;
+	}
+	int run_retval = cortex_a_run_smp(target);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+	if (retval != ERROR_OK)
+		return retval;
+
+	smp_phase_done(target, SMP_PHASE_HALT_REQUEST, &duration);
+	duration_start(&duration);
+
+	retval = cortex_a_wait_dscr_smp(target, target, DSCR_CORE_HALTED, DSCR_CORE_HALTED);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error waiting for halt");
+		return retval;
+	}
 
 	foreach_smp_target(head, target->smp_targets) {
 		struct target *curr = head->target;
-		if ((curr != target) && (curr->state != TARGET_HALTED)
-			&& target_was_examined(curr))
-			retval += cortex_a_halt(curr);
+
+		if (curr != target && curr->state != TARGET_HALTED &&
+				target_was_examined(curr))
+			curr->debug_reason = DBG_REASON_DBGRQ;
 	}
-	return retval;
+
+	smp_phase_done(target, SMP_PHASE_HALT_WAIT, &duration);
+
+	return ERROR_OK;
 }
 
 static int update_halt_gdb(struct target *target)
@@ -657,6 +891,7 @@ static int update_halt_gdb(struct target *target)
 	struct target *gdb_target = NULL;
 	struct target_list *head;
 	struct target *curr;
+	struct duration duration;
 	int retval = 0;
 
 	if (target->gdb_service && target->gdb_service->core[0] == -1) {
@@ -668,6 +903,8 @@ static int update_halt_gdb(struct target *target)
 	if (target->gdb_service)
 		gdb_target = target->gdb_service->target;
 
+	duration_start(&duration);
+
 	foreach_smp_target(head, target->smp_targets) {
 		curr = head->target;
 		/* skip calling context */
@@ -691,6 +928,9 @@ static int update_halt_gdb(struct target *target)
 	/* after all targets were updated, poll the gdb serving target */
 	if (gdb_target && gdb_target != target)
 		cortex_a_poll(gdb_target);
+
+	smp_phase_done(target, SMP_PHASE_DEBUG_ENTRY, &duration);
+
 	return retval;
 }
 
@@ -881,15 +1121,14 @@ static int cortex_a_internal_restore(struct target *target, int current,
 	return retval;
 }
 
-static int cortex_a_internal_restart(struct target *target)
+static int cortex_a_request_restart(struct target *target)
 {
 	struct armv7a_common *armv7a = target_to_armv7a(target);
-	struct arm *arm = &armv7a->arm;
 	int retval;
 	uint32_t dscr;
 	/*
-	 * * Restart core and wait for it to be started.  Clear ITRen and sticky
-	 * * exception flags: see ARMv7 ARM, C5.9.
+	 * * Restart core, without waiting for it to be started.  Clear ITRen
+	 * * and sticky exception flags: see ARMv7 ARM, C5.9.
 	 *
 	 * REVISIT: for single stepping, we probably want to
 	 * disable IRQs by default, with optional override...
@@ -908,9 +1147,19 @@ static int cortex_a_internal_restart(struct target *target)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = mem_ap_write_atomic_u32(armv7a->debug_ap,
+	return mem_ap_write_atomic_u32(armv7a->debug_ap,
 			armv7a->debug_base + CPUDBG_DRCR, DRCR_RESTART |
 			DRCR_CLEAR_EXCEPTIONS);
+}
+
+static int cortex_a_internal_restart(struct target *target)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct arm *arm = &armv7a->arm;
+	int retval;
+	uint32_t dscr;
+
+	retval = cortex_a_request_restart(target);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -936,6 +1185,9 @@ static int cortex_a_restore_smp(struct target *target, int handle_breakpoints)
 	int retval = 0;
 	struct target_list *head;
 	target_addr_t address;
+	struct duration duration;
+
+	duration_start(&duration);
 
 	foreach_smp_target(head, target->smp_targets) {
 		struct target *curr = head->target;
@@ -944,9 +1196,37 @@ static int cortex_a_restore_smp(struct target *target, int handle_breakpoints)
 			/*  resume current address , not in step mode */
 			retval += cortex_a_internal_restore(curr, 1, &address,
 					handle_breakpoints, 0);
-			retval += cortex_a_internal_restart(curr);
+			retval += cortex_a_request_restart(curr);
 		}
 	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	smp_phase_done(target, SMP_PHASE_RESUME_PREPARE, &duration);
+	duration_start(&duration);
+
+	/* all restarts are requested, now wait for them together */
+	retval = cortex_a_wait_dscr_smp(target, target, DSCR_CORE_RESTARTED,
+			DSCR_CORE_RESTARTED);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error waiting for resume");
+		return retval;
+	}
+
+	foreach_smp_target(head, target->smp_targets) {
+		struct target *curr = head->target;
+		if ((curr != target) && (curr->state != TARGET_RUNNING)
+			&& target_was_examined(curr)) {
+			curr->debug_reason = DBG_REASON_NOTHALTED;
+			curr->state = TARGET_RUNNING;
+
+			/* registers are now invalid */
+			register_cache_invalidate(target_to_arm(curr)->core_cache);
+		}
+	}
+
+	smp_phase_done(target, SMP_PHASE_RESUME_WAIT, &duration);
+
 	return retval;
 }
 
@@ -2265,7 +2545,13 @@ static int cortex_a_write_cpu_memory(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (size == 4 && (address % 4) == 0) {
+	enum arm_memaccess_path path = arm_memaccess_select(&armv7a->memaccess, true,
+			address, size, count);
+	uint32_t bytes = size * count;
+	struct duration duration;
+	duration_start(&duration);
+
+	if (path == ARM_MEMACCESS_PATH_FAST) {
 		/* We are doing a word-aligned transfer, so use fast mode. */
 		retval = cortex_a_write_cpu_memory_fast(target, count, buffer, &dscr);
 	} else {
@@ -2288,6 +2574,9 @@ static int cortex_a_write_cpu_memory(struct target *target,
 		retval = cortex_a_write_cpu_memory_slow(target, size, count, buffer, &dscr);
 	}
 
+	duration_measure(&duration);
+	arm_memaccess_account(&armv7a->memaccess, true, path, bytes, &duration);
+
 	final_retval = retval;
 
 	/* Switch to non-blocking mode if not already in that mode. */
@@ -2582,7 +2871,13 @@ static int cortex_a_read_cpu_memory(struct target *target,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (size == 4 && (address % 4) == 0) {
+	enum arm_memaccess_path path = arm_memaccess_select(&armv7a->memaccess, false,
+			address, size, count);
+	uint32_t bytes = size * count;
+	struct duration duration;
+	duration_start(&duration);
+
+	if (path == ARM_MEMACCESS_PATH_FAST) {
 		/* We are doing a word-aligned transfer, so use fast mode. */
 		retval = cortex_a_read_cpu_memory_fast(target, count, buffer, &dscr);
 	} else {
@@ -2606,6 +2901,9 @@ static int cortex_a_read_cpu_memory(struct target *target,
 		retval = cortex_a_read_cpu_memory_slow(target, size, count, buffer, &dscr);
 	}
 
+	duration_measure(&duration);
+	arm_memaccess_account(&armv7a->memaccess, false, path, bytes, &duration);
+
 	final_retval = retval;
 
 	/* Switch to non-blocking mode if not already in that mode. */
@@ -3295,6 +3593,14 @@ COMMAND_HANDLER(handle_cortex_a_dacrfixup_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cortex_a_handle_memaccess_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+
+	return CALL_COMMAND_HANDLER(arm_memaccess_handle_command, &armv7a->memaccess);
+}
+
 static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.name = "cache_info",
@@ -3325,6 +3631,14 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 			"on memory access",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memaccess",
+		.handler = cortex_a_handle_memaccess_command,
+		.mode = COMMAND_EXEC,
+		.help = "display or set the memory access path, or benchmark "
+			"both paths on a RAM area to tune the automatic choice",
+		.usage = "['auto'|'fast'|'slow'|'reset'|'benchmark' address [bytes]]",
+	},
 	{
 		.chain = armv7a_mmu_command_handlers,
 	},
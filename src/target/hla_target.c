@@ -212,12 +212,50 @@ static int adapter_target_create(struct target *target,
 
 static int adapter_load_context(struct target *target)
 {
+	struct hl_interface_s *adapter = target_to_adapter(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
-	int num_regs = armv7m->arm.core_cache->num_regs;
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	int num_regs = cache->num_regs;
+	uint32_t values[ARMV7M_LAST_REG][2];
+	int retval = ERROR_OK;
+
+	assert(num_regs <= ARMV7M_LAST_REG);
+
+	/* queue all the registers holding a value of their own, so that the
+	 * adapter can fetch them in as few transactions as it is able to */
+	for (int i = 0; i < num_regs && retval == ERROR_OK; i++) {
+		struct reg *r = &cache->reg_list[i];
+		if (!r->exist || r->valid || r->size < 32)
+			continue;
+
+		struct arm_reg *arm_reg = r->arch_info;
+		uint32_t regsel = armv7m_map_id_to_regsel(arm_reg->num);
+
+		retval = hl_interface_queue_read_reg(adapter, regsel, &values[i][0]);
+		if (retval == ERROR_OK && r->size == 64)
+			retval = hl_interface_queue_read_reg(adapter, regsel + 1, &values[i][1]);
+	}
+
+	if (retval == ERROR_OK)
+		retval = hl_interface_run_queue(adapter);
+	if (retval != ERROR_OK)
+		return retval;
 
 	for (int i = 0; i < num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		if (!r->exist || r->valid || r->size < 32)
+			continue;
+
+		buf_set_u32(r->value, 0, 32, values[i][0]);
+		if (r->size == 64)
+			buf_set_u32(r->value + 4, 0, 32, values[i][1]);
+		r->valid = true;
+		r->dirty = false;
+	}
 
-		struct reg *r = &armv7m->arm.core_cache->reg_list[i];
+	/* the remaining ones are packed in the registers read above */
+	for (int i = 0; i < num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
 		if (r->exist && !r->valid)
 			armv7m->arm.read_core_reg(target, r, i, ARM_MODE_ANY);
 	}
@@ -230,23 +268,34 @@ static int adapter_debug_entry(struct target *target)
 	struct hl_interface_s *adapter = target_to_adapter(target);
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	struct arm *arm = &armv7m->arm;
+	uint64_t transactions = adapter->stats.transactions;
+	uint8_t dcrdr[4];
 	struct reg *r;
 	uint32_t xpsr;
 	int retval;
 
-	/* preserve the DCRDR across halts */
-	retval = target_read_u32(target, DCB_DCRDR, &target->SAVED_DCRDR);
+	retval = armv7m->examine_debug_reason(target);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = armv7m->examine_debug_reason(target);
+	/* preserve the DCRDR across halts, it is read along the registers
+	 * but ahead of them, as some adapters access registers through it */
+	retval = hl_interface_queue_read_mem(adapter, DCB_DCRDR, 4, 1, dcrdr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = adapter_load_context(target);
 	if (retval != ERROR_OK)
 		return retval;
 
-	adapter_load_context(target);
+	target->SAVED_DCRDR = target_buffer_get_u32(target, dcrdr);
 
 	/* make sure we clear the vector catch bit */
-	adapter->layout->api->write_debug_reg(adapter->handle, DCB_DEMCR, TRCENA);
+	hl_interface_queue_write_debug_reg(adapter, DCB_DEMCR, TRCENA);
+	hl_interface_run_queue(adapter);
+
+	adapter->stats.halts++;
+	adapter->stats.halt_transactions += adapter->stats.transactions - transactions;
 
 	r = arm->cpsr;
 	xpsr = buf_get_u32(r->value, 0, 32);
@@ -275,10 +324,12 @@ static int adapter_debug_entry(struct target *target)
 		armv7m->exception_number = 0;
 	}
 
-	LOG_DEBUG("entered debug state in core mode: %s at PC 0x%08" PRIx32 ", target->state: %s",
+	LOG_DEBUG("entered debug state in core mode: %s at PC 0x%08" PRIx32 ", target->state: %s, "
+		"%" PRIu64 " transactions",
 		arm_mode_name(arm->core_mode),
 		buf_get_u32(arm->pc->value, 0, 32),
-		target_state_name(target));
+		target_state_name(target),
+		adapter->stats.transactions - transactions);
 
 	return retval;
 }
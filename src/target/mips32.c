@@ -779,10 +779,6 @@ int mips32_checksum_memory(struct target *target, target_addr_t address,
 		MIPS32_SDBBP(isa),
 	};
 
-	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(mips_crc_code), &crc_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
 	pracc_swap16_array(ejtag_info, mips_crc_code, ARRAY_SIZE(mips_crc_code));
 
 	/* convert mips crc code into a buffer in target endianness */
@@ -790,7 +786,9 @@ int mips32_checksum_memory(struct target *target, target_addr_t address,
 	target_buffer_set_u32_array(target, mips_crc_code_8,
 					ARRAY_SIZE(mips_crc_code), mips_crc_code);
 
-	int retval = target_write_buffer(target, crc_algorithm->address, sizeof(mips_crc_code), mips_crc_code_8);
+	/* make sure we have a working area */
+	int retval = target_alloc_resident_working_area(target, mips_crc_code_8,
+			sizeof(mips_crc_code_8), &crc_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -847,10 +845,6 @@ int mips32_blank_check_memory(struct target *target,
 		MIPS32_SDBBP(isa)				/* sdbbp */
 	};
 
-	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(erase_check_code), &erase_check_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
 	pracc_swap16_array(ejtag_info, erase_check_code, ARRAY_SIZE(erase_check_code));
 
 	/* convert erase check code into a buffer in target endianness */
@@ -858,10 +852,11 @@ int mips32_blank_check_memory(struct target *target,
 	target_buffer_set_u32_array(target, erase_check_code_8,
 					ARRAY_SIZE(erase_check_code), erase_check_code);
 
-	int retval = target_write_buffer(target, erase_check_algorithm->address,
-						sizeof(erase_check_code), erase_check_code_8);
+	/* make sure we have a working area */
+	int retval = target_alloc_resident_working_area(target, erase_check_code_8,
+			sizeof(erase_check_code_8), &erase_check_algorithm);
 	if (retval != ERROR_OK)
-		goto cleanup;
+		return retval;
 
 	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
 	mips32_info.isa_mode = isa ? MIPS32_ISA_MMIPS32 : MIPS32_ISA_MIPS32;
@@ -885,7 +880,6 @@ int mips32_blank_check_memory(struct target *target,
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
-cleanup:
 	target_free_working_area(target, erase_check_algorithm);
 
 	if (retval != ERROR_OK)
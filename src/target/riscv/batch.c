@@ -17,14 +17,90 @@
 
 static void dump_field(int idle, const struct scan_field *field);
 
+/* Batches released by riscv_batch_free(), kept for reuse by the next
+ * riscv_batch_alloc() so block transfers don't reallocate their scan buffers
+ * for every burst. */
+#define RISCV_BATCH_POOL_SIZE	4
+static struct riscv_batch *batch_pool[RISCV_BATCH_POOL_SIZE];
+
+static void batch_release(struct riscv_batch *batch)
+{
+	free(batch->data_in);
+	free(batch->data_out);
+	free(batch->fields);
+	free(batch->bscan_ctxt);
+	free(batch->read_keys);
+	free(batch);
+}
+
+/* Take the smallest pooled batch that can hold @a scans scans. */
+static struct riscv_batch *batch_pool_take(size_t scans)
+{
+	int best = -1;
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		struct riscv_batch *batch = batch_pool[i];
+		if (!batch || batch->buffer_scans < scans)
+			continue;
+		if (bscan_tunnel_ir_width != 0 && !batch->bscan_ctxt)
+			continue;
+		if (best < 0 || batch->buffer_scans < batch_pool[best]->buffer_scans)
+			best = i;
+	}
+	if (best < 0)
+		return NULL;
+
+	struct riscv_batch *batch = batch_pool[best];
+	batch_pool[best] = NULL;
+	return batch;
+}
+
+void riscv_batch_pool_free(void)
+{
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		if (batch_pool[i])
+			batch_release(batch_pool[i]);
+		batch_pool[i] = NULL;
+	}
+}
+
+size_t riscv_batch_preferred_scans(struct target *target)
+{
+	RISCV_INFO(r);
+	return r->batch_scans;
+}
+
+void riscv_batch_adapt(struct target *target, bool busy)
+{
+	RISCV_INFO(r);
+	if (busy)
+		r->batch_scans = MAX(r->batch_scans / 2, RISCV_BATCH_MIN_SCANS);
+	else
+		r->batch_scans = MIN(r->batch_scans + r->batch_scans / 4, RISCV_BATCH_MAX_SCANS);
+}
+
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle)
 {
+	RISCV_INFO(r);
 	scans += 4;
-	struct riscv_batch *out = calloc(1, sizeof(*out));
+	struct riscv_batch *out = batch_pool_take(scans);
+	if (out) {
+		r->batch_stats.reused++;
+		out->target = target;
+		out->allocated_scans = scans;
+		out->used_scans = 0;
+		out->idle_count = idle;
+		out->last_scan = RISCV_SCAN_TYPE_INVALID;
+		out->read_keys_used = 0;
+		return out;
+	}
+
+	out = calloc(1, sizeof(*out));
 	if (!out)
 		goto error0;
+	r->batch_stats.allocated++;
 	out->target = target;
 	out->allocated_scans = scans;
+	out->buffer_scans = scans;
 	out->idle_count = idle;
 	out->data_out = malloc(sizeof(*out->data_out) * (scans) * DMI_SCAN_BUF_SIZE);
 	if (!out->data_out) {
@@ -72,12 +148,27 @@ error0:
 
 void riscv_batch_free(struct riscv_batch *batch)
 {
-	free(batch->data_in);
-	free(batch->data_out);
-	free(batch->fields);
-	free(batch->bscan_ctxt);
-	free(batch->read_keys);
-	free(batch);
+	if (!batch)
+		return;
+
+	/* Keep it for reuse, evicting a smaller pooled batch if necessary. */
+	int slot = -1;
+	for (int i = 0; i < RISCV_BATCH_POOL_SIZE; i++) {
+		if (!batch_pool[i]) {
+			slot = i;
+			break;
+		}
+		if (batch_pool[i]->buffer_scans < batch->buffer_scans &&
+				(slot < 0 || batch_pool[i]->buffer_scans < batch_pool[slot]->buffer_scans))
+			slot = i;
+	}
+	if (slot < 0) {
+		batch_release(batch);
+		return;
+	}
+	if (batch_pool[slot])
+		batch_release(batch_pool[slot]);
+	batch_pool[slot] = batch;
 }
 
 bool riscv_batch_full(struct riscv_batch *batch)
@@ -119,8 +210,25 @@ int riscv_batch_run(struct riscv_batch *batch)
 			buffer_shr((batch->fields + i)->in_value, DMI_SCAN_BUF_SIZE, 1);
 	}
 
-	for (size_t i = 0; i < batch->used_scans; ++i)
+	bool busy = false;
+	for (size_t i = 0; i < batch->used_scans; ++i) {
 		dump_field(batch->idle_count, batch->fields + i);
+		if (buf_get_u32(batch->fields[i].in_value, DTM_DMI_OP_OFFSET,
+				DTM_DMI_OP_LENGTH) == DTM_DMI_OP_BUSY)
+			busy = true;
+	}
+
+	struct target *target = batch->target;
+	RISCV_INFO(r);
+	r->batch_stats.runs++;
+	r->batch_stats.scans += batch->used_scans;
+	if (busy)
+		r->batch_stats.busy_runs++;
+
+	/* Shrink after busy, so that fewer scans have to be redone by the
+	 * caller. Grow only on evidence that full size batches go through. */
+	if (busy || batch->used_scans >= r->batch_scans / 2)
+		riscv_batch_adapt(target, busy);
 
 	return ERROR_OK;
 }
@@ -185,6 +293,10 @@ void riscv_batch_add_nop(struct riscv_batch *batch)
 	riscv_fill_dmi_nop_u64(batch->target, (char *)field->in_value);
 	batch->last_scan = RISCV_SCAN_TYPE_NOP;
 	batch->used_scans++;
+
+	struct target *target = batch->target;
+	RISCV_INFO(r);
+	r->batch_stats.nops++;
 }
 
 void dump_field(int idle, const struct scan_field *field)
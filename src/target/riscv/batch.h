@@ -23,6 +23,9 @@ struct riscv_batch {
 
 	size_t allocated_scans;
 	size_t used_scans;
+	/* Number of scans the buffers below have room for. A batch reused from
+	 * the pool may have more room than allocated_scans. */
+	size_t buffer_scans;
 
 	size_t idle_count;
 
@@ -46,12 +49,30 @@ struct riscv_batch {
 	size_t read_keys_used;
 };
 
+/* Bounds and initial value of the adaptive batch size, in scans. */
+#define RISCV_BATCH_MIN_SCANS		8
+#define RISCV_BATCH_DEFAULT_SCANS	32
+#define RISCV_BATCH_MAX_SCANS		256
+
 /* Allocates (or frees) a new scan set.  "scans" is the maximum number of JTAG
  * scans that can be issued to this object, and idle is the number of JTAG idle
- * cycles between every real scan. */
+ * cycles between every real scan.  Freed batches are pooled and handed out
+ * again by later allocations. */
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle);
 void riscv_batch_free(struct riscv_batch *batch);
 
+/* Releases the batches kept for reuse. */
+void riscv_batch_pool_free(void);
+
+/* Number of scans a block transfer should put in a batch for this target.
+ * It starts at RISCV_BATCH_DEFAULT_SCANS, is halved every time a batch runs
+ * into busy and grows back while batches go through cleanly. */
+size_t riscv_batch_preferred_scans(struct target *target);
+
+/* Feeds the outcome of a batch into the preferred size. riscv_batch_run()
+ * does so for DMI busy; callers may report other busy conditions. */
+void riscv_batch_adapt(struct target *target, bool busy);
+
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
 
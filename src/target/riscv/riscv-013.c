@@ -204,6 +204,17 @@ typedef struct {
 
 	yes_no_maybe_t has_aampostincrement;
 
+	/* Bytes moved and time spent by each memory access method (indexed by
+	 * RISCV_MEM_ACCESS_*), reported by `riscv info` and used to order the
+	 * methods with `riscv set_mem_access_auto`. */
+	struct {
+		uint64_t bytes;
+		int64_t ms;
+		/* The last access with this method failed. */
+		bool failed;
+	} mem_read_stats[RISCV_NUM_MEM_ACCESS_METHODS + 1],
+	  mem_write_stats[RISCV_NUM_MEM_ACCESS_METHODS + 1];
+
 	/* When a function returns some error due to a failure indicated by the
 	 * target in cmderr, the caller can look here to see what that error was.
 	 * (Compare with errno.) */
@@ -1873,6 +1884,13 @@ static unsigned riscv013_data_bits(struct target *target)
 	return 32;
 }
 
+static unsigned int mem_access_rate(uint64_t bytes, int64_t ms)
+{
+	/* Transfers faster than the clock resolution count as 1 ms. */
+	uint64_t rate = bytes * 1000 / MAX(ms, 1);
+	return MIN(rate, UINT_MAX);
+}
+
 static COMMAND_HELPER(riscv013_print_info, struct target *target)
 {
 	RISCV013_INFO(info);
@@ -1889,6 +1907,22 @@ static COMMAND_HELPER(riscv013_print_info, struct target *target)
 	riscv_print_info_line(CMD, "target", "memory.read_while_running128", get_field(info->sbcs, DM_SBCS_SBACCESS128));
 	riscv_print_info_line(CMD, "target", "memory.write_while_running128", get_field(info->sbcs, DM_SBCS_SBACCESS128));
 
+	/* Measured throughput of each memory access method, in bytes/s. */
+	static const char * const method_names[] = {
+		[RISCV_MEM_ACCESS_PROGBUF] = "progbuf",
+		[RISCV_MEM_ACCESS_SYSBUS] = "sysbus",
+		[RISCV_MEM_ACCESS_ABSTRACT] = "abstract",
+	};
+	for (int method = RISCV_MEM_ACCESS_PROGBUF; method <= RISCV_MEM_ACCESS_ABSTRACT; method++) {
+		char key[48];
+		snprintf(key, sizeof(key), "memory.%s.read_bytes_per_sec", method_names[method]);
+		riscv_print_info_line(CMD, "target", key,
+				mem_access_rate(info->mem_read_stats[method].bytes, info->mem_read_stats[method].ms));
+		snprintf(key, sizeof(key), "memory.%s.write_bytes_per_sec", method_names[method]);
+		riscv_print_info_line(CMD, "target", key,
+				mem_access_rate(info->mem_write_stats[method].bytes, info->mem_write_stats[method].ms));
+	}
+
 	/* Lower level description. */
 	riscv_print_info_line(CMD, "dm", "abits", info->abits);
 	riscv_print_info_line(CMD, "dm", "progbufsize", info->progbufsize);
@@ -2164,8 +2198,8 @@ static int sample_memory_bus_v1(struct target *target,
 	while (timeval_ms() < until_ms) {
 		/*
 		 * batch_run() adds to the batch, so we can't simply reuse the same
-		 * batch over and over. So we create a new one every time through the
-		 * loop.
+		 * batch over and over. So we take a new one (from the batch pool)
+		 * every time through the loop.
 		 */
 		struct riscv_batch *batch = riscv_batch_alloc(
 			target, 1 + enabled_count * 5 * repeat,
@@ -2813,6 +2847,73 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static void account_mem_access(struct target *target, int method, bool read,
+		bool success, uint64_t bytes, int64_t start_ms)
+{
+	RISCV013_INFO(info);
+	if (method <= RISCV_MEM_ACCESS_UNSPECIFIED || method > RISCV_NUM_MEM_ACCESS_METHODS)
+		return;
+
+	if (read) {
+		info->mem_read_stats[method].failed = !success;
+		if (success) {
+			info->mem_read_stats[method].bytes += bytes;
+			info->mem_read_stats[method].ms += timeval_ms() - start_ms;
+		}
+	} else {
+		info->mem_write_stats[method].failed = !success;
+		if (success) {
+			info->mem_write_stats[method].bytes += bytes;
+			info->mem_write_stats[method].ms += timeval_ms() - start_ms;
+		}
+	}
+}
+
+/* Bytes a method has to move before its throughput is trusted. */
+#define MEM_ACCESS_RATE_MIN_BYTES	4096
+
+/* Rank of a method for `riscv set_mem_access_auto`, higher first. Methods
+ * that have not moved enough data yet come first so that each gets
+ * measured, and methods whose last access failed come last. */
+static uint64_t mem_access_rank(struct target *target, int method, bool read)
+{
+	RISCV013_INFO(info);
+	const uint64_t bytes = read ? info->mem_read_stats[method].bytes : info->mem_write_stats[method].bytes;
+	const int64_t ms = read ? info->mem_read_stats[method].ms : info->mem_write_stats[method].ms;
+	const bool failed = read ? info->mem_read_stats[method].failed : info->mem_write_stats[method].failed;
+
+	if (failed)
+		return 0;
+	if (bytes < MEM_ACCESS_RATE_MIN_BYTES)
+		return UINT64_MAX;
+	return (uint64_t)mem_access_rate(bytes, ms) + 1;
+}
+
+/* The configured memory access methods in the order to try them. */
+static void mem_access_order(struct target *target, bool read, int *methods)
+{
+	RISCV_INFO(r);
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
+		methods[i] = r->mem_access_methods[i];
+		if (methods[i] != RISCV_MEM_ACCESS_UNSPECIFIED)
+			count = i + 1;
+	}
+	if (!r->mem_access_auto)
+		return;
+
+	/* stable, so equal ranks keep the configured order */
+	for (unsigned int i = 1; i < count; i++) {
+		int method = methods[i];
+		uint64_t rank = mem_access_rank(target, method, read);
+		unsigned int j = i;
+		for (; j > 0 && mem_access_rank(target, methods[j - 1], read) < rank; j--)
+			methods[j] = methods[j - 1];
+		methods[j] = method;
+	}
+}
+
 static void log_mem_access_result(struct target *target, bool success, int method, bool read)
 {
 	RISCV_INFO(r);
@@ -2945,6 +3046,228 @@ static bool mem_should_skip_abstract(struct target *target, target_addr_t addres
 	return false;
 }
 
+/*
+ * Wait for the abstract commands queued in a batch to complete. On return
+ * *busy tells whether either the DMI or the abstract command interface
+ * reported busy while the batch ran, in which case some of the queued
+ * accesses were dropped and *next_address (arg1, post-incremented by every
+ * command that did execute) tells where the target stopped.
+ */
+static int abstract_batch_finish(struct target *target, bool *busy,
+		target_addr_t *next_address)
+{
+	RISCV013_INFO(info);
+	uint32_t abstractcs;
+	bool dmi_busy_encountered;
+
+	if (dmi_op(target, &abstractcs, &dmi_busy_encountered, DMI_OP_READ,
+			DM_ABSTRACTCS, 0, false, true) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(abstractcs, DM_ABSTRACTCS_BUSY) &&
+			wait_for_idle(target, &abstractcs) != ERROR_OK)
+		return ERROR_FAIL;
+
+	*busy = dmi_busy_encountered;
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	switch (info->cmderr) {
+		case CMDERR_NONE:
+			break;
+		case CMDERR_BUSY:
+			increase_ac_busy_delay(target);
+			riscv013_clear_abstract_error(target);
+			if (!dmi_busy_encountered)
+				riscv_batch_adapt(target, true);
+			*busy = true;
+			break;
+		default:
+			LOG_DEBUG("abstract memory access failed; abstractcs=0x%x", abstractcs);
+			riscv013_clear_abstract_error(target);
+			return ERROR_FAIL;
+	}
+
+	if (*busy)
+		*next_address = read_abstract_arg(target, 1, riscv_xlen(target));
+
+	return ERROR_OK;
+}
+
+/*
+ * Number of commands from a batch starting at @a start that the target
+ * executed, as determined from the post-incremented arg1.
+ */
+static int abstract_batch_executed(target_addr_t start, target_addr_t next_address,
+		uint32_t size, uint32_t elements, uint32_t *executed)
+{
+	if (next_address < start || (next_address - start) % size ||
+			(next_address - start) / size > elements) {
+		LOG_ERROR("Unexpected arg1=0x%" TARGET_PRIxADDR " after abstract memory "
+				"access starting at 0x%" TARGET_PRIxADDR " - buggy aampostincrement?",
+				next_address, start);
+		return ERROR_FAIL;
+	}
+	*executed = (next_address - start) / size;
+	return ERROR_OK;
+}
+
+/*
+ * Read memory through abstract commands once aampostincrement is known to
+ * work. Each element costs a command write plus one or two data reads, and
+ * many elements are shifted out in a single riscv_batch. If the target
+ * reports busy, the elements that completed are kept and the rest of the
+ * batch is reissued with a larger delay and a smaller batch.
+ */
+static int read_memory_abstract_batch(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+	uint32_t command = access_memory_command(target, false, size << 3, true, false);
+	unsigned int attempt = 0;
+	uint32_t index = 0;
+
+	while (index < count) {
+		if (attempt++ > 100) {
+			LOG_ERROR("Abstract command interface keeps being busy while reading memory at "
+					TARGET_ADDR_FMT, address + index * size);
+			return ERROR_FAIL;
+		}
+
+		target_addr_t start = address + index * size;
+		if (write_abstract_arg(target, 1, start, riscv_xlen(target)) != ERROR_OK)
+			return ERROR_FAIL;
+
+		unsigned int scans_per_element = size > 4 ? 3 : 2;
+		uint32_t elements = MIN(count - index,
+				MAX(riscv_batch_preferred_scans(target) / scans_per_element, 1));
+		struct riscv_batch *batch = riscv_batch_alloc(target,
+				elements * scans_per_element,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch)
+			return ERROR_FAIL;
+
+		for (uint32_t i = 0; i < elements; i++) {
+			riscv_batch_add_dmi_write(batch, DM_COMMAND, command);
+			if (size > 4)
+				riscv_batch_add_dmi_read(batch, DM_DATA1);
+			riscv_batch_add_dmi_read(batch, DM_DATA0);
+		}
+
+		bool busy = false;
+		target_addr_t next_address = start + elements * size;
+		if (batch_run(target, batch) != ERROR_OK ||
+				abstract_batch_finish(target, &busy, &next_address) != ERROR_OK) {
+			riscv_batch_free(batch);
+			return ERROR_FAIL;
+		}
+
+		uint32_t executed;
+		if (abstract_batch_executed(start, next_address, size, elements,
+				&executed) != ERROR_OK) {
+			riscv_batch_free(batch);
+			return ERROR_FAIL;
+		}
+
+		/* After a busy response, the read issued right after the last
+		 * executed command may have raced it. Its value is still in the data
+		 * registers, so it is fetched from there below. */
+		uint32_t trusted = busy ? (executed ? executed - 1 : 0) : executed;
+		uint32_t good = 0;
+		size_t key = 0;
+		for (; good < trusted; good++) {
+			uint64_t value = 0;
+			bool ok = true;
+			if (size > 4) {
+				ok = riscv_batch_get_dmi_read_op(batch, key) == DMI_STATUS_SUCCESS;
+				value = ((uint64_t)riscv_batch_get_dmi_read_data(batch, key)) << 32;
+				key++;
+			}
+			ok = ok && riscv_batch_get_dmi_read_op(batch, key) == DMI_STATUS_SUCCESS;
+			value |= riscv_batch_get_dmi_read_data(batch, key);
+			key++;
+			if (!ok)
+				break;
+			buf_set_u64(buffer + (index + good) * size, 0, 8 * size, value);
+			log_memory_access(start + good * size, value, size, true);
+		}
+		riscv_batch_free(batch);
+
+		if (busy && executed > 0 && good == executed - 1) {
+			riscv_reg_t value = read_abstract_arg(target, 0, size > 4 ? 64 : 32);
+			buf_set_u64(buffer + (index + good) * size, 0, 8 * size, value);
+			log_memory_access(start + good * size, value, size, true);
+			good++;
+		}
+
+		if (good > 0)
+			attempt = 0;
+		index += good;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Write counterpart of read_memory_abstract_batch(). Commands and data
+ * writes issued while the target is busy are dropped by the DM, so arg1
+ * tells exactly where to resume.
+ */
+static int write_memory_abstract_batch(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+	uint32_t command = access_memory_command(target, false, size << 3, true, true);
+	unsigned int attempt = 0;
+	uint32_t index = 0;
+
+	while (index < count) {
+		if (attempt++ > 100) {
+			LOG_ERROR("Abstract command interface keeps being busy while writing memory at "
+					TARGET_ADDR_FMT, address + index * size);
+			return ERROR_FAIL;
+		}
+
+		target_addr_t start = address + index * size;
+		if (write_abstract_arg(target, 1, start, riscv_xlen(target)) != ERROR_OK)
+			return ERROR_FAIL;
+
+		unsigned int scans_per_element = size > 4 ? 3 : 2;
+		uint32_t elements = MIN(count - index,
+				MAX(riscv_batch_preferred_scans(target) / scans_per_element, 1));
+		struct riscv_batch *batch = riscv_batch_alloc(target,
+				elements * scans_per_element,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch)
+			return ERROR_FAIL;
+
+		for (uint32_t i = 0; i < elements; i++) {
+			uint64_t value = buf_get_u64(buffer + (index + i) * size, 0, 8 * size);
+			if (size > 4)
+				riscv_batch_add_dmi_write(batch, DM_DATA1, value >> 32);
+			riscv_batch_add_dmi_write(batch, DM_DATA0, (uint32_t)value);
+			riscv_batch_add_dmi_write(batch, DM_COMMAND, command);
+			log_memory_access(start + i * size, value, size, false);
+		}
+
+		bool busy = false;
+		target_addr_t next_address = start + elements * size;
+		int result = batch_run(target, batch);
+		riscv_batch_free(batch);
+		if (result != ERROR_OK ||
+				abstract_batch_finish(target, &busy, &next_address) != ERROR_OK)
+			return ERROR_FAIL;
+
+		uint32_t executed;
+		if (abstract_batch_executed(start, next_address, size, elements,
+				&executed) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (executed > 0)
+			attempt = 0;
+		index += executed;
+	}
+
+	return ERROR_OK;
+}
+
 /*
  * Performs a memory read using memory access abstract commands. The read sizes
  * supported are 1, 2, and 4 bytes despite the spec's support of 8 and 16 byte
@@ -2961,6 +3284,9 @@ static int read_memory_abstract(struct target *target, target_addr_t address,
 	LOG_DEBUG("reading %d words of %d bytes from 0x%" TARGET_PRIxADDR, count,
 			  size, address);
 
+	if (info->has_aampostincrement == YNM_YES)
+		return read_memory_abstract_batch(target, address, size, count, buffer);
+
 	memset(buffer, 0, count * size);
 
 	/* Convert the size (bytes) to width (bits) */
@@ -3039,6 +3365,9 @@ static int write_memory_abstract(struct target *target, target_addr_t address,
 	LOG_DEBUG("writing %d words of %d bytes from 0x%" TARGET_PRIxADDR, count,
 			  size, address);
 
+	if (info->has_aampostincrement == YNM_YES)
+		return write_memory_abstract_batch(target, address, size, count, buffer);
+
 	/* Convert the size (bytes) to width (bits) */
 	unsigned width = size << 3;
 
@@ -3162,7 +3491,8 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
+		struct riscv_batch *batch = riscv_batch_alloc(target,
+				riscv_batch_preferred_scans(target),
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3546,15 +3876,18 @@ static int read_memory(struct target *target, target_addr_t address,
 	}
 
 	int ret = ERROR_FAIL;
-	RISCV_INFO(r);
 	RISCV013_INFO(info);
 
 	char *progbuf_result = "disabled";
 	char *sysbus_result = "disabled";
 	char *abstract_result = "disabled";
 
+	int methods[RISCV_NUM_MEM_ACCESS_METHODS];
+	mem_access_order(target, true, methods);
+
 	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
-		int method = r->mem_access_methods[i];
+		int method = methods[i];
+		int64_t start = timeval_ms();
 
 		if (method == RISCV_MEM_ACCESS_PROGBUF) {
 			if (mem_should_skip_progbuf(target, address, size, true, &progbuf_result))
@@ -3588,6 +3921,7 @@ static int read_memory(struct target *target, target_addr_t address,
 			break;
 
 		log_mem_access_result(target, ret == ERROR_OK, method, true);
+		account_mem_access(target, method, true, ret == ERROR_OK, (uint64_t)size * count, start);
 
 		if (ret == ERROR_OK)
 			return ret;
@@ -3671,7 +4005,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				riscv_batch_preferred_scans(target),
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3866,7 +4200,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				riscv_batch_preferred_scans(target),
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			goto error;
@@ -3992,15 +4326,18 @@ static int write_memory(struct target *target, target_addr_t address,
 	}
 
 	int ret = ERROR_FAIL;
-	RISCV_INFO(r);
 	RISCV013_INFO(info);
 
 	char *progbuf_result = "disabled";
 	char *sysbus_result = "disabled";
 	char *abstract_result = "disabled";
 
+	int methods[RISCV_NUM_MEM_ACCESS_METHODS];
+	mem_access_order(target, false, methods);
+
 	for (unsigned int i = 0; i < RISCV_NUM_MEM_ACCESS_METHODS; i++) {
-		int method = r->mem_access_methods[i];
+		int method = methods[i];
+		int64_t start = timeval_ms();
 
 		if (method == RISCV_MEM_ACCESS_PROGBUF) {
 			if (mem_should_skip_progbuf(target, address, size, false, &progbuf_result))
@@ -4034,6 +4371,7 @@ static int write_memory(struct target *target, target_addr_t address,
 			break;
 
 		log_mem_access_result(target, ret == ERROR_OK, method, false);
+		account_mem_access(target, method, false, ret == ERROR_OK, (uint64_t)size * count, start);
 
 		if (ret == ERROR_OK)
 			return ret;
@@ -18,6 +18,7 @@
 #include "target/register.h"
 #include "target/breakpoints.h"
 #include "riscv.h"
+#include "batch.h"
 #include "gdb_regs.h"
 #include "rtos/rtos.h"
 #include "debug_defines.h"
@@ -512,10 +513,14 @@ static void riscv_deinit_target(struct target *target)
 		free(entry);
 	}
 
+	free(info->sample_buf.buf);
+	free(info->sample_stream.port);
 	free(info->reg_names);
 	free(target->arch_info);
 
 	target->arch_info = NULL;
+
+	riscv_batch_pool_free();
 }
 
 static void trigger_from_breakpoint(struct trigger *trigger,
@@ -2147,13 +2152,13 @@ static int sample_memory(struct target *target)
 	int result = ERROR_OK;
 	if (r->sample_memory) {
 		result = r->sample_memory(target, &r->sample_buf, &r->sample_config,
-									  start + TARGET_DEFAULT_POLLING_INTERVAL);
+									  start + r->sample_config.budget_ms);
 		if (result != ERROR_NOT_IMPLEMENTED)
 			goto exit;
 	}
 
 	/* Default slow path. */
-	while (timeval_ms() - start < TARGET_DEFAULT_POLLING_INTERVAL) {
+	while (timeval_ms() - start < r->sample_config.budget_ms) {
 		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
 			if (r->sample_config.bucket[i].enabled &&
 					r->sample_buf.used + 1 + r->sample_config.bucket[i].size_bytes < r->sample_buf.size) {
@@ -2173,6 +2178,7 @@ static int sample_memory(struct target *target)
 
 exit:
 	riscv_sample_buf_maybe_add_timestamp(target, false);
+	riscv_sample_stream_flush(target);
 	if (result != ERROR_OK) {
 		LOG_INFO("Turning off memory sampling because it failed.");
 		r->sample_config.enabled = false;
@@ -2450,6 +2456,19 @@ COMMAND_HANDLER(riscv_set_mem_access)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_set_mem_access_auto)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC != 1) {
+		LOG_ERROR("Command takes exactly 1 parameter");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], r->mem_access_auto);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(riscv_set_enable_virtual)
 {
 	if (CMD_ARGC != 1) {
@@ -2792,6 +2811,160 @@ COMMAND_HANDLER(riscv_reset_delays)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_batch_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+	struct riscv_batch_stats *stats = &r->batch_stats;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "runs              %" PRIu64, stats->runs);
+	command_print(CMD, "scans             %" PRIu64, stats->scans);
+	command_print(CMD, "scans_per_run     %" PRIu64,
+			stats->runs ? stats->scans / stats->runs : 0);
+	command_print(CMD, "nops              %" PRIu64, stats->nops);
+	command_print(CMD, "busy_runs         %" PRIu64, stats->busy_runs);
+	command_print(CMD, "pool_reused       %" PRIu64, stats->reused);
+	command_print(CMD, "pool_allocated    %" PRIu64, stats->allocated);
+	command_print(CMD, "preferred_scans   %zu", r->batch_scans);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "Memory sample configuration for %s:", target_name(target));
+		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
+			if (r->sample_config.bucket[i].enabled) {
+				command_print(CMD, "bucket %d; address=0x%" TARGET_PRIxADDR "; size=%d", i,
+							  r->sample_config.bucket[i].address,
+							  r->sample_config.bucket[i].size_bytes);
+			} else {
+				command_print(CMD, "bucket %d; unused", i);
+			}
+		}
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC < 2) {
+		LOG_ERROR("Command requires at least bucket and address arguments.");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	uint32_t bucket;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], bucket);
+	if (bucket >= ARRAY_SIZE(r->sample_config.bucket)) {
+		LOG_ERROR("Max bucket number is %d.", (unsigned int)ARRAY_SIZE(r->sample_config.bucket) - 1);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (!strcmp(CMD_ARGV[1], "clear")) {
+		r->sample_config.bucket[bucket].enabled = false;
+	} else {
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], r->sample_config.bucket[bucket].address);
+
+		if (CMD_ARGC > 2) {
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], r->sample_config.bucket[bucket].size_bytes);
+			if (r->sample_config.bucket[bucket].size_bytes != 4 &&
+					r->sample_config.bucket[bucket].size_bytes != 8) {
+				LOG_ERROR("Only 4-byte and 8-byte sizes are supported.");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		} else {
+			r->sample_config.bucket[bucket].size_bytes = 4;
+		}
+
+		r->sample_config.bucket[bucket].enabled = true;
+	}
+
+	if (!r->sample_buf.buf) {
+		r->sample_buf.size = 1024 * 1024;
+		r->sample_buf.buf = malloc(r->sample_buf.size);
+		if (!r->sample_buf.buf) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* Clear the buffer when the configuration is changed. */
+	r->sample_buf.used = 0;
+
+	r->sample_config.enabled = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memory_sample_budget_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned int budget;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], budget);
+		if (budget == 0)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		r->sample_config.budget_ms = budget;
+	}
+
+	command_print(CMD, "%u", r->sample_config.budget_ms);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_dump_sample_buf_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int i = 0;
+	while (i < r->sample_buf.used) {
+		uint8_t command = r->sample_buf.buf[i++];
+		if (command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ||
+				command == RISCV_SAMPLE_BUF_TIMESTAMP_AFTER) {
+			uint32_t timestamp = le_to_h_u32(r->sample_buf.buf + i);
+			i += 4;
+			command_print(CMD, "timestamp %s: %u",
+					command == RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE ? "before" : "after",
+					timestamp);
+		} else if (command < ARRAY_SIZE(r->sample_config.bucket)) {
+			unsigned int size = r->sample_config.bucket[command].size_bytes;
+			uint64_t value = buf_get_u64(r->sample_buf.buf + i, 0, 8 * size);
+			i += size;
+			command_print(CMD, "0x%" TARGET_PRIxADDR ": 0x%" PRIx64,
+					r->sample_config.bucket[command].address, value);
+		} else {
+			LOG_ERROR("Found invalid command byte 0x%x in sample buffer at offset %u.",
+					command, i - 1);
+			return ERROR_FAIL;
+		}
+	}
+
+	/* Clear the sample buffer. */
+	r->sample_buf.used = 0;
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(riscv_set_ir)
 {
 	if (CMD_ARGC != 2) {
@@ -2964,6 +3137,15 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.help = "Set which memory access methods shall be used and in which order "
 			"of priority. Method can be one of: 'progbuf', 'sysbus' or 'abstract'."
 	},
+	{
+		.name = "set_mem_access_auto",
+		.handler = riscv_set_mem_access_auto,
+		.mode = COMMAND_ANY,
+		.usage = "on|off",
+		.help = "When on, try the memory access methods set with set_mem_access "
+			"fastest first, by the throughput measured so far. "
+			"When off (default), try them in the order given."
+	},
 	{
 		.name = "set_enable_virtual",
 		.handler = riscv_set_enable_virtual,
@@ -3053,6 +3235,44 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 			"supported. Normal order is from lowest hart index to highest. "
 			"Reversed order is from highest hart index to lowest."
 	},
+	{
+		.name = "memory_sample",
+		.handler = handle_memory_sample_command,
+		.mode = COMMAND_ANY,
+		.usage = "bucket address|clear [size=4]",
+		.help = "Causes OpenOCD to frequently read size bytes at the given "
+			"address while the hart is running."
+	},
+	{
+		.name = "memory_sample_budget",
+		.handler = handle_memory_sample_budget_command,
+		.mode = COMMAND_ANY,
+		.usage = "[ms]",
+		.help = "Set (or display) how long each poll of a running hart may "
+			"spend sampling memory."
+	},
+	{
+		.name = "dump_sample_buf",
+		.handler = handle_dump_sample_buf_command,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Print the contents of the sample buffer, and clear the buffer."
+	},
+	{
+		.name = "sample_stream",
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Stream memory samples over TCP.",
+		.chain = riscv_sample_stream_command_handlers
+	},
+	{
+		.name = "batch_stats",
+		.handler = riscv_batch_stats,
+		.mode = COMMAND_EXEC,
+		.usage = "[reset]",
+		.help = "Display (or reset) statistics about the batched DMI scans "
+			"used for block transfers."
+	},
 	{
 		.name = "set_ir",
 		.handler = riscv_set_ir,
@@ -3225,6 +3445,11 @@ static void riscv_info_init(struct target *target, struct riscv_info *r)
 	r->mem_access_sysbus_warn = true;
 	r->mem_access_abstract_warn = true;
 
+	r->batch_scans = RISCV_BATCH_DEFAULT_SCANS;
+
+	r->sample_config.budget_ms = 10;
+	INIT_LIST_HEAD(&r->sample_stream.clients);
+
 	INIT_LIST_HEAD(&r->expose_csr);
 	INIT_LIST_HEAD(&r->expose_custom);
 }
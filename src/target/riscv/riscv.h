@@ -72,8 +72,15 @@ struct riscv_sample_buf {
 	unsigned int size;
 };
 
+/* Only in the stream sent by `riscv sample_stream`: the bucket
+ * configuration, followed by the count of enabled buckets and for each of
+ * them its index, its size in bytes and its 64-bit little-endian address. */
+#define RISCV_SAMPLE_BUF_CONFIG				0x82
+
 typedef struct {
 	bool enabled;
+	/* How long a single poll may spend sampling, in ms. */
+	unsigned int budget_ms;
 	struct {
 		bool enabled;
 		target_addr_t address;
@@ -81,6 +88,35 @@ typedef struct {
 	} bucket[16];
 } riscv_sample_config_t;
 
+struct riscv_sample_stream {
+	/* Port the streaming service listens on, NULL while it is stopped. */
+	char *port;
+	/* Connected consumers, see riscv_sample_stream.c. */
+	struct list_head clients;
+	/* Chunks (the samples gathered by one poll) sent to, or dropped for, a
+	 * consumer. Chunks are dropped while a consumer still has not taken
+	 * the previous one. */
+	uint64_t chunks_sent;
+	uint64_t bytes_sent;
+	uint64_t chunks_dropped;
+	uint64_t bytes_dropped;
+};
+
+/* Counters kept by batch.c, shown by `riscv batch_stats`. */
+struct riscv_batch_stats {
+	/* Batches executed and the scans they shifted. */
+	uint64_t runs;
+	uint64_t scans;
+	/* NOP scans added, mostly to shift out the result of a final read. */
+	uint64_t nops;
+	/* Batches during which the DTM reported busy. Their callers redo at
+	 * least part of the work. */
+	uint64_t busy_runs;
+	/* Batches taken from the pool vs. newly allocated. */
+	uint64_t reused;
+	uint64_t allocated;
+};
+
 typedef struct {
 	struct list_head list;
 	uint16_t low, high;
@@ -212,6 +248,8 @@ struct riscv_info {
 
 	/* Memory access methods to use, ordered by priority, highest to lowest. */
 	int mem_access_methods[RISCV_NUM_MEM_ACCESS_METHODS];
+	/* Try the methods above in the order of their measured throughput. */
+	bool mem_access_auto;
 
 	/* Different memory regions may need different methods but single configuration is applied
 	 * for all. Following flags are used to warn only once about failing memory access method. */
@@ -229,11 +267,20 @@ struct riscv_info {
 
 	riscv_sample_config_t sample_config;
 	struct riscv_sample_buf sample_buf;
+	struct riscv_sample_stream sample_stream;
+
+	/* Preferred number of scans per riscv_batch, see
+	 * riscv_batch_preferred_scans(). */
+	size_t batch_scans;
+	struct riscv_batch_stats batch_stats;
 };
 
 COMMAND_HELPER(riscv_print_info_line, const char *section, const char *key,
 			   unsigned int value);
 
+extern const struct command_registration riscv_sample_stream_command_handlers[];
+void riscv_sample_stream_flush(struct target *target);
+
 typedef struct {
 	uint8_t tunneled_dr_width;
 	struct scan_field tunneled_dr[4];
@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Streaming of RISC-V memory samples over TCP.
+ *
+ * While the hart runs, every poll fills the sample buffer (see
+ * `riscv memory_sample`). With the streaming service started, the content
+ * of the buffer is sent to every connected consumer at the end of the poll,
+ * instead of accumulating until `riscv dump_sample_buf` is run.
+ *
+ * Each poll produces one chunk made of a RISCV_SAMPLE_BUF_CONFIG record
+ * followed by the records of the sample buffer, unchanged:
+ *  - RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE, 32-bit little-endian time in ms
+ *  - bucket index, followed by size_bytes bytes of little-endian data
+ *  - RISCV_SAMPLE_BUF_TIMESTAMP_AFTER, 32-bit little-endian time in ms
+ *
+ * Consumer sockets are non-blocking, so a slow consumer never stalls the
+ * poll. A chunk that cannot be sent completely is kept and finished at the
+ * next poll; chunks produced in the meantime are dropped for that consumer
+ * and counted.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <server/server.h>
+
+#include "target/target.h"
+#include "riscv.h"
+
+struct sample_stream_client {
+	struct list_head list;
+	struct connection *connection;
+	/* Unsent tail of the last chunk. */
+	uint8_t *pending;
+	size_t pending_len;
+};
+
+/* The service owns (and frees) its private data, so it only refers to the
+ * target. The stream state itself lives in struct riscv_info. */
+struct sample_stream_service {
+	struct target *target;
+};
+
+static bool sample_stream_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/**
+ * Write as much of @a data as the socket takes without blocking.
+ * @returns the number of bytes written, or -1 on a socket error.
+ */
+static int sample_stream_write(struct connection *connection, const uint8_t *data,
+		size_t len)
+{
+	int written = connection_write(connection, data, len);
+	if (written < 0)
+		return sample_stream_would_block() ? 0 : -1;
+	return written;
+}
+
+static int sample_stream_new_connection(struct connection *connection)
+{
+	struct sample_stream_service *service = connection->service->priv;
+	struct riscv_info *r = riscv_info(service->target);
+
+	struct sample_stream_client *client = calloc(1, sizeof(*client));
+	if (!client) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	socket_nonblock(connection->fd);
+	client->connection = connection;
+	connection->priv = client;
+	list_add_tail(&client->list, &r->sample_stream.clients);
+
+	LOG_INFO("New memory sample stream connection for %s",
+			target_name(service->target));
+	return ERROR_OK;
+}
+
+static int sample_stream_input(struct connection *connection)
+{
+	uint8_t buffer[64];
+
+	/* Consumers have nothing to say, only notice when they go away. */
+	int bytes_read = connection_read(connection, buffer, sizeof(buffer));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	if (bytes_read < 0 && !sample_stream_would_block()) {
+		log_socket_error("sample stream");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int sample_stream_connection_closed(struct connection *connection)
+{
+	struct sample_stream_client *client = connection->priv;
+
+	list_del(&client->list);
+	free(client->pending);
+	free(client);
+	connection->priv = NULL;
+
+	LOG_INFO("Memory sample stream connection closed");
+	return ERROR_OK;
+}
+
+static const struct service_driver sample_stream_service_driver = {
+	.name = "riscv_sample_stream",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = sample_stream_new_connection,
+	.input_handler = sample_stream_input,
+	.connection_closed_handler = sample_stream_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+/* Try to finish sending a chunk. Returns true if nothing is left. */
+static bool sample_stream_send_pending(struct sample_stream_client *client)
+{
+	if (!client->pending_len)
+		return true;
+
+	int written = sample_stream_write(client->connection, client->pending,
+			client->pending_len);
+	if (written < 0) {
+		/* The connection is gone; the server notices on its next read. */
+		return false;
+	}
+
+	client->pending_len -= written;
+	memmove(client->pending, client->pending + written, client->pending_len);
+	return client->pending_len == 0;
+}
+
+static size_t sample_stream_config_record(const riscv_sample_config_t *config,
+		uint8_t *out)
+{
+	size_t len = 2;
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(config->bucket); i++) {
+		if (!config->bucket[i].enabled)
+			continue;
+		out[len] = i;
+		out[len + 1] = config->bucket[i].size_bytes;
+		h_u64_to_le(out + len + 2, config->bucket[i].address);
+		len += 10;
+		count++;
+	}
+	out[0] = RISCV_SAMPLE_BUF_CONFIG;
+	out[1] = count;
+
+	return len;
+}
+
+/**
+ * Send the samples gathered by the last poll to all consumers, and empty
+ * the sample buffer. Does nothing unless the streaming service runs.
+ */
+void riscv_sample_stream_flush(struct target *target)
+{
+	RISCV_INFO(r);
+	struct riscv_sample_stream *stream = &r->sample_stream;
+
+	if (!stream->port || !r->sample_buf.used)
+		return;
+
+	if (list_empty(&stream->clients)) {
+		r->sample_buf.used = 0;
+		return;
+	}
+
+	uint8_t config[2 + 10 * ARRAY_SIZE(r->sample_config.bucket)];
+	size_t config_len = sample_stream_config_record(&r->sample_config, config);
+	size_t len = config_len + r->sample_buf.used;
+	uint8_t *chunk = malloc(len);
+	if (!chunk) {
+		LOG_ERROR("Out of memory");
+		return;
+	}
+	memcpy(chunk, config, config_len);
+	memcpy(chunk + config_len, r->sample_buf.buf, r->sample_buf.used);
+	r->sample_buf.used = 0;
+
+	struct sample_stream_client *client;
+	list_for_each_entry(client, &stream->clients, list) {
+		if (!sample_stream_send_pending(client)) {
+			stream->chunks_dropped++;
+			stream->bytes_dropped += len;
+			continue;
+		}
+
+		int written = sample_stream_write(client->connection, chunk, len);
+		if (written < 0) {
+			stream->chunks_dropped++;
+			stream->bytes_dropped += len;
+			continue;
+		}
+
+		if ((size_t)written < len) {
+			uint8_t *pending = realloc(client->pending, len - written);
+			if (!pending) {
+				/* Can't keep the tail; the consumer will see a torn chunk. */
+				LOG_ERROR("Out of memory");
+				continue;
+			}
+			client->pending = pending;
+			client->pending_len = len - written;
+			memcpy(client->pending, chunk + written, client->pending_len);
+		}
+
+		stream->chunks_sent++;
+		stream->bytes_sent += len;
+	}
+
+	free(chunk);
+}
+
+COMMAND_HANDLER(handle_sample_stream_start)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (r->sample_stream.port) {
+		command_print(CMD, "memory sample stream already running on port %s",
+				r->sample_stream.port);
+		return ERROR_FAIL;
+	}
+
+	struct sample_stream_service *service = malloc(sizeof(*service));
+	if (!service) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	service->target = target;
+
+	int retval = add_service(&sample_stream_service_driver, CMD_ARGV[0],
+			CONNECTION_LIMIT_UNLIMITED, service);
+	if (retval != ERROR_OK) {
+		free(service);
+		return retval;
+	}
+
+	r->sample_stream.port = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sample_stream_stop)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (!r->sample_stream.port)
+		return ERROR_OK;
+
+	remove_service(sample_stream_service_driver.name, r->sample_stream.port);
+	free(r->sample_stream.port);
+	r->sample_stream.port = NULL;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sample_stream_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+	struct riscv_sample_stream *stream = &r->sample_stream;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		stream->chunks_sent = 0;
+		stream->bytes_sent = 0;
+		stream->chunks_dropped = 0;
+		stream->bytes_dropped = 0;
+		return ERROR_OK;
+	}
+
+	unsigned int clients = 0;
+	struct sample_stream_client *client;
+	list_for_each_entry(client, &stream->clients, list)
+		clients++;
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "port              %s", stream->port ? stream->port : "disabled");
+	command_print(CMD, "clients           %u", clients);
+	command_print(CMD, "chunks_sent       %" PRIu64, stream->chunks_sent);
+	command_print(CMD, "bytes_sent        %" PRIu64, stream->bytes_sent);
+	command_print(CMD, "chunks_dropped    %" PRIu64, stream->chunks_dropped);
+	command_print(CMD, "bytes_dropped     %" PRIu64, stream->bytes_dropped);
+
+	return ERROR_OK;
+}
+
+const struct command_registration riscv_sample_stream_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_sample_stream_start,
+		.mode = COMMAND_ANY,
+		.usage = "port",
+		.help = "Stream the memory samples of the current target to TCP "
+			"clients connecting to port."
+	},
+	{
+		.name = "stop",
+		.handler = handle_sample_stream_stop,
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "Stop streaming memory samples."
+	},
+	{
+		.name = "stats",
+		.handler = handle_sample_stream_stats,
+		.mode = COMMAND_ANY,
+		.usage = "[reset]",
+		.help = "Display (or reset) the memory sample stream counters."
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -409,6 +409,10 @@ int target_rtt_read_callback(struct target *target,
 			return ret;
 		}
 
+		/* the target is active, it may as well halt soon */
+		if (length)
+			target_poll_activity(target);
+
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
 			sink->read(i, buffer, length, sink->user_data);
 	}
@@ -36,11 +36,18 @@
 #include "target.h"
 #include "target_type.h"
 #include "semihosting_common.h"
+#include "semihosting_ring.h"
 
 #include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <sys/stat.h>
 
+/* size of the write-behind and readahead buffers */
+#define SEMIHOSTING_IO_BUF_SIZE		(64 * 1024)
+/* buffered writes reach the host file at most this late */
+#define SEMIHOSTING_FLUSH_INTERVAL_MS	50
+
 /**
  * It is not possible to use O_... flags defined in sys/stat.h because they
  * are not guaranteed to match the values defined by the GDB Remote Protocol.
@@ -139,6 +146,10 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
 	semihosting->basedir = NULL;
+	memset(&semihosting->io, 0, sizeof(semihosting->io));
+	semihosting->io.wb_fd = -1;
+	semihosting->io.ra_fd = -1;
+	semihosting->ring = NULL;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -254,15 +265,6 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 	return retval;
 }
 
-static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
-{
-	if (semihosting_is_redirected(semihosting, fd))
-		return semihosting_redirect_write(semihosting, &c, 1);
-
-	/* default putchar */
-	return putchar(c);
-}
-
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
 {
 	if (semihosting_is_redirected(semihosting, fd))
@@ -290,24 +292,366 @@ static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 	return getchar();
 }
 
+/* Scratch buffer of at least @a size bytes, kept across calls. */
+static uint8_t *semihosting_io_buffer(struct semihosting *semihosting, size_t size)
+{
+	struct semihosting_io *io = &semihosting->io;
+
+	if (!io->buf || size > io->buf_size) {
+		size = MAX(size, 64u);
+		uint8_t *buf = realloc(io->buf, size);
+		if (!buf)
+			return NULL;
+		io->buf = buf;
+		io->buf_size = size;
+	}
+
+	return io->buf;
+}
+
+/* Write all of @a buf, as a short write only happens on a host error. */
+static ssize_t semihosting_host_write(int fd, const uint8_t *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size) {
+		ssize_t written = write(fd, buf + done, size - done);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return done ? (ssize_t)done : -1;
+		}
+		done += written;
+	}
+
+	return done;
+}
+
+/**
+ * Write the data gathered by the previous write operations to the host.
+ * A failure is reported by the next SYS_ERRNO.
+ */
+static void semihosting_flush_writes(struct semihosting *semihosting)
+{
+	struct semihosting_io *io = &semihosting->io;
+
+	if (!io->wb_len)
+		return;
+
+	/* keep the order with what OpenOCD itself printed */
+	if (io->wb_fd == fileno(stdout))
+		fflush(stdout);
+
+	ssize_t written = semihosting_host_write(io->wb_fd, io->wb_buf, io->wb_len);
+	io->host_writes++;
+	if (written < 0 || (size_t)written != io->wb_len) {
+		semihosting->sys_errno = errno;
+		LOG_ERROR("semihosting: failed to write %zu bytes to file %d: %s",
+				io->wb_len, io->wb_fd, strerror(errno));
+	}
+	io->wb_len = 0;
+}
+
+static int semihosting_flush_timer(void *priv)
+{
+	semihosting_flush_writes(priv);
+	return ERROR_OK;
+}
+
+/**
+ * Room for @a len more bytes to write to host file @a fd, after the data
+ * already gathered for it. @returns NULL if the data can't be buffered and
+ * has to be written right away.
+ */
+static uint8_t *semihosting_write_space(struct semihosting *semihosting, int fd, size_t len)
+{
+	struct semihosting_io *io = &semihosting->io;
+
+	if (io->wb_len && (io->wb_fd != fd || io->wb_len + len > SEMIHOSTING_IO_BUF_SIZE))
+		semihosting_flush_writes(semihosting);
+
+	if (len > SEMIHOSTING_IO_BUF_SIZE)
+		return NULL;
+
+	/* only buffer for files that exist, so that errors are not hidden */
+	if (!io->wb_len) {
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+			return NULL;
+	}
+
+	if (!io->wb_buf) {
+		io->wb_buf = malloc(SEMIHOSTING_IO_BUF_SIZE);
+		if (!io->wb_buf)
+			return NULL;
+	}
+
+	io->wb_fd = fd;
+	return io->wb_buf + io->wb_len;
+}
+
+/* Account @a len bytes stored at the pointer from semihosting_write_space() */
+static void semihosting_write_commit(struct semihosting *semihosting, size_t len)
+{
+	struct semihosting_io *io = &semihosting->io;
+
+	io->wb_len += len;
+
+	if (!io->flush_timer) {
+		target_register_timer_callback(semihosting_flush_timer,
+				SEMIHOSTING_FLUSH_INTERVAL_MS, TARGET_TIMER_TYPE_PERIODIC, semihosting);
+		io->flush_timer = true;
+	}
+}
+
+/* Write the debug channel output in @a buf to stdout, or its redirection. */
+static void semihosting_debug_write(struct semihosting *semihosting,
+		const uint8_t *buf, size_t len)
+{
+	int fd = fileno(stdout);
+
+	if (semihosting_is_redirected(semihosting, semihosting->stdout_fd)) {
+		semihosting_redirect_write(semihosting, (void *)buf, len);
+		return;
+	}
+
+	uint8_t *space = semihosting_write_space(semihosting, fd, len);
+	if (!space) {
+		semihosting_host_write(fd, buf, len);
+		semihosting->io.host_writes++;
+		return;
+	}
+	memcpy(space, buf, len);
+	semihosting_write_commit(semihosting, len);
+}
+
+/* Give back to the host file the data read ahead and not used. */
+static void semihosting_drop_readahead(struct semihosting *semihosting)
+{
+	struct semihosting_io *io = &semihosting->io;
+
+	if (io->ra_pos < io->ra_len)
+		lseek(io->ra_fd, -(off_t)(io->ra_len - io->ra_pos), SEEK_CUR);
+	io->ra_pos = 0;
+	io->ra_len = 0;
+	io->ra_fd = -1;
+}
+
+/**
+ * Read up to @a len bytes of host file @a fd, of which the caller wants
+ * @a want, into the target at @a addr. Small reads of regular files are
+ * served from a block read ahead.
+ * @returns the number of bytes read, or -1 with sys_errno set.
+ */
+static int semihosting_read_to_target(struct target *target, int fd,
+		target_addr_t addr, size_t len, int64_t *result)
+{
+	struct semihosting *semihosting = target->semihosting;
+	struct semihosting_io *io = &semihosting->io;
+	size_t done = 0;
+
+	if (!len) {
+		*result = 0;
+		return ERROR_OK;
+	}
+
+	if (io->ra_fd != fd)
+		semihosting_drop_readahead(semihosting);
+
+	/* fully served by the data read ahead, send it from there */
+	if (io->ra_len - io->ra_pos >= len) {
+		io->readahead_hits++;
+		*result = len;
+		int retval = target_write_buffer(target, addr, len, io->ra_buf + io->ra_pos);
+		io->ra_pos += len;
+		return retval;
+	}
+
+	uint8_t *buf = semihosting_io_buffer(semihosting, len);
+	if (!buf) {
+		semihosting->sys_errno = ENOMEM;
+		*result = -1;
+		return ERROR_OK;
+	}
+
+	done = io->ra_len - io->ra_pos;
+	memcpy(buf, io->ra_buf + io->ra_pos, done);
+	io->ra_pos = 0;
+	io->ra_len = 0;
+	io->ra_fd = -1;
+
+	struct stat st;
+	bool readahead = len - done < SEMIHOSTING_IO_BUF_SIZE &&
+		!semihosting_is_redirected(semihosting, fd) &&
+		fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+	if (readahead && !io->ra_buf) {
+		io->ra_buf = malloc(SEMIHOSTING_IO_BUF_SIZE);
+		readahead = io->ra_buf;
+	}
+
+	ssize_t got;
+	if (readahead) {
+		got = read(fd, io->ra_buf, SEMIHOSTING_IO_BUF_SIZE);
+		semihosting->sys_errno = errno;
+		io->host_reads++;
+		if (got > 0) {
+			size_t used = MIN((size_t)got, len - done);
+			memcpy(buf + done, io->ra_buf, used);
+			io->ra_fd = fd;
+			io->ra_len = got;
+			io->ra_pos = used;
+			got = used;
+		}
+	} else {
+		got = semihosting_read(semihosting, fd, buf + done, len - done);
+		io->host_reads++;
+	}
+
+	if (got < 0 && !done) {
+		*result = got;
+		return ERROR_OK;
+	}
+	if (got > 0)
+		done += got;
+
+	*result = done;
+	return target_write_buffer(target, addr, done, buf);
+}
+
+/**
+ * Find the length of the string at @a addr in the target, reading it in
+ * small aligned blocks rather than byte by byte. If @a output is set, it is
+ * given the string as it is read.
+ */
+static int semihosting_strlen(struct target *target, target_addr_t addr,
+		void (*output)(struct semihosting *semihosting, const uint8_t *buf, size_t len),
+		size_t *count)
+{
+	uint8_t block[64];
+
+	*count = 0;
+	for (;;) {
+		/* don't read past the block holding the end of the string */
+		size_t size = sizeof(block) - (addr % sizeof(block));
+		int retval = target_read_buffer(target, addr, size, block);
+		if (retval != ERROR_OK)
+			return retval;
+
+		uint8_t *end = memchr(block, 0, size);
+		size_t len = end ? (size_t)(end - block) : size;
+		if (output && len)
+			output(target->semihosting, block, len);
+		*count += len;
+		if (end)
+			return ERROR_OK;
+		addr += size;
+	}
+}
+
 /**
  * User operation parameter string storage buffer. Contains valid data when the
  * TARGET_EVENT_SEMIHOSTING_USER_CMD_xxxxx event callbacks are running.
  */
 static char *semihosting_user_op_params;
 
+static int semihosting_common_op(struct target *target, bool post_result);
+
+static enum semihosting_op_class semihosting_op_class(int op)
+{
+	switch (op) {
+	case SEMIHOSTING_SYS_READ:
+		return SEMIHOSTING_OP_CLASS_READ;
+	case SEMIHOSTING_SYS_WRITE:
+		return SEMIHOSTING_OP_CLASS_WRITE;
+	case SEMIHOSTING_SYS_WRITEC:
+		return SEMIHOSTING_OP_CLASS_WRITEC;
+	case SEMIHOSTING_SYS_WRITE0:
+		return SEMIHOSTING_OP_CLASS_WRITE0;
+	default:
+		return SEMIHOSTING_OP_CLASS_OTHER;
+	}
+}
+
+static int semihosting_execute(struct target *target, bool post_result)
+{
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		/* Silently ignore if the semihosting field was not set. */
+		return ERROR_OK;
+	}
+
+	enum semihosting_op_class op_class = semihosting_op_class(semihosting->op);
+	struct semihosting_op_stats *stats = &semihosting->io.stats[op_class];
+	struct duration duration;
+
+	/*
+	 * Buffered writes must reach the host before anything else is done
+	 * with its files, data read ahead must go back before a file is used
+	 * otherwise than by a read.
+	 */
+	if (op_class != SEMIHOSTING_OP_CLASS_WRITE && op_class != SEMIHOSTING_OP_CLASS_WRITEC &&
+			op_class != SEMIHOSTING_OP_CLASS_WRITE0)
+		semihosting_flush_writes(semihosting);
+	if (op_class != SEMIHOSTING_OP_CLASS_READ)
+		semihosting_drop_readahead(semihosting);
+
+	duration_start(&duration);
+	int retval = semihosting_common_op(target, post_result);
+	duration_measure(&duration);
+
+	double elapsed = duration_elapsed(&duration);
+	stats->count++;
+	stats->total_s += elapsed;
+	if (elapsed > stats->max_s)
+		stats->max_s = elapsed;
+
+	return retval;
+}
+
 /**
  * Portable implementation of ARM semihosting calls.
  * Performs the currently pending semihosting operation
  * encoded in target->semihosting.
  */
 int semihosting_common(struct target *target)
+{
+	return semihosting_execute(target, true);
+}
+
+/**
+ * Perform the semihosting operation encoded in target->semihosting, like
+ * semihosting_common(), but leave its result there instead of returning
+ * it to the target registers.
+ */
+int semihosting_common_execute(struct target *target)
+{
+	return semihosting_execute(target, false);
+}
+
+/**
+ * Write the buffered output and release the I/O buffers of the
+ * semihosting of @a target.
+ */
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting)
+		return;
+
+	semihosting_ring_stop(target);
+	semihosting_flush_writes(semihosting);
+	semihosting_drop_readahead(semihosting);
+	if (semihosting->io.flush_timer)
+		target_unregister_timer_callback(semihosting_flush_timer, semihosting);
+
+	free(semihosting->io.buf);
+	free(semihosting->io.wb_buf);
+	free(semihosting->io.ra_buf);
+}
+
+static int semihosting_common_op(struct target *target, bool post_result)
 {
 	struct semihosting *semihosting = target->semihosting;
-	if (!semihosting) {
-		/* Silently ignore if the semihosting field was not set. */
-		return ERROR_OK;
-	}
 
 	struct gdb_fileio_info *fileio_info = target->fileio_info;
 
@@ -980,30 +1324,21 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
-					if (!buf) {
-						semihosting->result = -1;
-						semihosting->sys_errno = ENOMEM;
-					} else {
-						semihosting->result = semihosting_read(semihosting, fd, buf, len);
-						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
-							fd,
-							addr,
-							len,
-							semihosting->result);
-						if (semihosting->result >= 0) {
-							retval = target_write_buffer(target, addr,
-									semihosting->result,
-									buf);
-							if (retval != ERROR_OK) {
-								free(buf);
-								return retval;
-							}
-							/* the number of bytes NOT filled in */
-							semihosting->result = len -
-								semihosting->result;
-						}
-						free(buf);
+					retval = semihosting_read_to_target(target, fd, addr, len,
+							&semihosting->result);
+					if (retval != ERROR_OK)
+						return retval;
+					LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
+						fd,
+						addr,
+						len,
+						semihosting->result);
+					if (semihosting->result >= 0) {
+						semihosting->io.stats[SEMIHOSTING_OP_CLASS_READ].bytes +=
+							semihosting->result;
+						/* the number of bytes NOT filled in */
+						semihosting->result = len -
+							semihosting->result;
 					}
 				}
 			}
@@ -1312,31 +1647,42 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
-					if (!buf) {
-						semihosting->result = -1;
-						semihosting->sys_errno = ENOMEM;
+					uint8_t *space = NULL;
+					if (!semihosting_is_redirected(semihosting, fd))
+						space = semihosting_write_space(semihosting, fd, len);
+					if (space) {
+						/* straight into the data gathered for the host file */
+						retval = target_read_buffer(target, addr, len, space);
+						if (retval != ERROR_OK)
+							return retval;
+						semihosting_write_commit(semihosting, len);
+						semihosting->result = len;
 					} else {
+						uint8_t *buf = semihosting_io_buffer(semihosting, len);
+						if (!buf) {
+							semihosting->result = -1;
+							semihosting->sys_errno = ENOMEM;
+							break;
+						}
 						retval = target_read_buffer(target, addr, len, buf);
-						if (retval != ERROR_OK) {
-							free(buf);
+						if (retval != ERROR_OK)
 							return retval;
-						}
 						semihosting->result = semihosting_write(semihosting, fd, buf, len);
 						semihosting->sys_errno = errno;
-						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
-							fd,
-							addr,
-							len,
-							semihosting->result);
-						if (semihosting->result >= 0) {
-							/* The number of bytes that are NOT written.
-							 * */
-							semihosting->result = len -
-								semihosting->result;
-						}
-
-						free(buf);
+						semihosting->io.host_writes++;
+					}
+					LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
+						fd,
+						addr,
+						len,
+						semihosting->result);
+					if (semihosting->result >= 0) {
+						semihosting->io.stats[SEMIHOSTING_OP_CLASS_WRITE].bytes +=
+							semihosting->result;
+						/* The number of bytes that are NOT written.
+						 * */
+						semihosting->result = len -
+							semihosting->result;
 					}
 				}
 			}
@@ -1367,7 +1713,8 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+				semihosting_debug_write(semihosting, &c, 1);
+				semihosting->io.stats[SEMIHOSTING_OP_CLASS_WRITEC].bytes++;
 				semihosting->result = 0;
 			}
 			break;
@@ -1386,33 +1733,22 @@ int semihosting_common(struct target *target)
 			 * None. The RETURN REGISTER is corrupted.
 			 */
 			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
-				}
+				size_t count;
+				retval = semihosting_strlen(target, semihosting->param, NULL, &count);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
 				fileio_info->param_1 = 1;
 				fileio_info->param_2 = semihosting->param;
 				fileio_info->param_3 = count;
 			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
+				size_t count;
+				retval = semihosting_strlen(target, semihosting->param,
+						semihosting_debug_write, &count);
+				if (retval != ERROR_OK)
+					return retval;
+				semihosting->io.stats[SEMIHOSTING_OP_CLASS_WRITE0].bytes += count;
 				semihosting->result = 0;
 			}
 			break;
@@ -1566,7 +1902,7 @@ int semihosting_common(struct target *target)
 			semihosting->sys_errno = ENOTSUP;
 	}
 
-	if (!semihosting->hit_fileio) {
+	if (post_result && !semihosting->hit_fileio) {
 		retval = semihosting->post_result(target);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Failed to post semihosting result");
@@ -2038,6 +2374,59 @@ COMMAND_HANDLER(handle_common_semihosting_basedir_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	static const char * const class_name[SEMIHOSTING_OP_NUM_CLASSES] = {
+		[SEMIHOSTING_OP_CLASS_READ] = "read",
+		[SEMIHOSTING_OP_CLASS_WRITE] = "write",
+		[SEMIHOSTING_OP_CLASS_WRITEC] = "writec",
+		[SEMIHOSTING_OP_CLASS_WRITE0] = "write0",
+		[SEMIHOSTING_OP_CLASS_OTHER] = "other",
+	};
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+	struct semihosting_io *io = &semihosting->io;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(io->stats, 0, sizeof(io->stats));
+		io->host_writes = 0;
+		io->host_reads = 0;
+		io->readahead_hits = 0;
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	for (unsigned int i = 0; i < SEMIHOSTING_OP_NUM_CLASSES; i++) {
+		const struct semihosting_op_stats *stats = &io->stats[i];
+		double avg_us = stats->count ? stats->total_s * 1e6 / stats->count : 0;
+
+		command_print(CMD, "%s.count %" PRIu64, class_name[i], stats->count);
+		command_print(CMD, "%s.bytes %" PRIu64, class_name[i], stats->bytes);
+		command_print(CMD, "%s.avg_us %.0f", class_name[i], avg_us);
+		command_print(CMD, "%s.max_us %.0f", class_name[i], stats->max_s * 1e6);
+	}
+	command_print(CMD, "host_writes %" PRIu64, io->host_writes);
+	command_print(CMD, "host_reads %" PRIu64, io->host_reads);
+	command_print(CMD, "readahead_hits %" PRIu64, io->readahead_hits);
+
+	return ERROR_OK;
+}
+
 const struct command_registration semihosting_common_handlers[] = {
 	{
 		.name = "semihosting",
@@ -2088,5 +2477,19 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "[dir]",
 		.help = "set the base directory for semihosting I/O operations",
 	},
+	{
+		.name = "semihosting_ring",
+		.mode = COMMAND_ANY,
+		.usage = "",
+		.help = "semihosting requests queued in target memory",
+		.chain = semihosting_ring_command_handlers,
+	},
+	{
+		.name = "semihosting_stats",
+		.handler = handle_common_semihosting_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "display (or reset) the semihosting call statistics",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -100,6 +100,57 @@ enum semihosting_result {
 };
 
 struct target;
+struct semihosting_ring;
+
+/* Classes of semihosting operations with separate latency statistics. */
+enum semihosting_op_class {
+	SEMIHOSTING_OP_CLASS_READ,
+	SEMIHOSTING_OP_CLASS_WRITE,
+	SEMIHOSTING_OP_CLASS_WRITEC,
+	SEMIHOSTING_OP_CLASS_WRITE0,
+	SEMIHOSTING_OP_CLASS_OTHER,
+	SEMIHOSTING_OP_NUM_CLASSES,
+};
+
+struct semihosting_op_stats {
+	uint64_t count;
+	/* bytes moved between target and host */
+	uint64_t bytes;
+	double total_s;
+	double max_s;
+};
+
+/*
+ * Host side buffering of the semihosting file I/O.
+ *
+ * Writes (SYS_WRITE, SYS_WRITEC, SYS_WRITE0) to the same host file are
+ * gathered in wb_buf and issued as one host write when another file or
+ * another operation comes, when the buffer is full, or from a timer shortly
+ * after the target resumed. Reads of regular files fetch a larger block
+ * into ra_buf and serve the following SYS_READ from it.
+ */
+struct semihosting_io {
+	/* scratch buffer for the transfers that are not buffered */
+	uint8_t *buf;
+	size_t buf_size;
+
+	uint8_t *wb_buf;
+	size_t wb_len;
+	int wb_fd;
+
+	uint8_t *ra_buf;
+	size_t ra_pos;
+	size_t ra_len;
+	int ra_fd;
+
+	/* the timer flushing wb_buf is registered */
+	bool flush_timer;
+
+	struct semihosting_op_stats stats[SEMIHOSTING_OP_NUM_CLASSES];
+	uint64_t host_writes;
+	uint64_t host_reads;
+	uint64_t readahead_hits;
+};
 
 /*
  * A pointer to this structure was added to the target structure.
@@ -175,6 +226,12 @@ struct semihosting {
 	/** Base directory for semihosting I/O operations. */
 	char *basedir;
 
+	/** Buffers and statistics of the host file I/O. */
+	struct semihosting_io io;
+
+	/** Requests queued in target memory, when started. */
+	struct semihosting_ring *ring;
+
 	/**
 	 * Target's extension of semihosting user commands.
 	 * @returns ERROR_NOT_IMPLEMENTED when user command is not handled, otherwise
@@ -189,6 +246,8 @@ struct semihosting {
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+int semihosting_common_execute(struct target *target);
+void semihosting_common_free(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
 int semihosting_read_fields(struct target *target, size_t number,
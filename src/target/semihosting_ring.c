@@ -0,0 +1,392 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Semihosting requests queued by the target in a ring in its RAM and
+ * serviced from the timer loop, without halting the core.
+ *
+ * The ring is described by a control block, found by its identifier like
+ * the RTT one. All fields are in target endianness:
+ *
+ *   offset  size
+ *     0      16   identifier "SEMIHOST RING", NUL padded
+ *    16       4   number of entries
+ *    20       4   target word size, 4 or 8, for the parameter blocks
+ *    24       4   head, incremented by the target for each new request
+ *    28       4   tail, incremented by OpenOCD for each serviced request
+ *    32           entries, 32 bytes each:
+ *                   0  4  operation number, as in R0 of a classic call
+ *                   4  4  errno after the operation
+ *                   8  8  parameter, as in R1 of a classic call
+ *                  16  8  result, as returned in R0 by a classic call
+ *                  24  8  reserved
+ *
+ * Request n is in entry n modulo the number of entries. The target fills
+ * the operation and parameter, then increments head; once tail is beyond
+ * the request, its result and errno are valid.
+ *
+ * The operations ending the program (SYS_EXIT, SYS_EXIT_EXTENDED) and the
+ * ones forwarded to GDB with 'semihosting_fileio' enabled need the core to
+ * halt: they fail with ENOTSUP and must use the classic call.
+ *
+ * See contrib/semihosting_ring for the target side.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <helper/log.h>
+
+#include "target.h"
+#include "semihosting_common.h"
+#include "semihosting_ring.h"
+
+#define SEMIHOSTING_RING_ID		"SEMIHOST RING"
+#define SEMIHOSTING_RING_NUM_ENTRIES	16
+#define SEMIHOSTING_RING_WORD_SIZE	20
+#define SEMIHOSTING_RING_HEAD		24
+#define SEMIHOSTING_RING_TAIL		28
+#define SEMIHOSTING_RING_ENTRIES	32
+
+#define SEMIHOSTING_RING_ENTRY_SIZE	32
+#define SEMIHOSTING_RING_ENTRY_OP	0
+#define SEMIHOSTING_RING_ENTRY_ERRNO	4
+#define SEMIHOSTING_RING_ENTRY_PARAM	8
+#define SEMIHOSTING_RING_ENTRY_RESULT	16
+
+/* entries read and written back at once */
+#define SEMIHOSTING_RING_MAX_BATCH	32
+
+#define SEMIHOSTING_RING_DEFAULT_INTERVAL_MS	10
+
+struct semihosting_ring {
+	target_addr_t address;
+	uint32_t num_entries;
+	size_t word_size_bytes;
+	unsigned int interval_ms;
+
+	uint64_t requests;
+	uint64_t batches;
+	uint32_t max_batch;
+	uint64_t errors;
+};
+
+static bool semihosting_ring_needs_halt(struct semihosting *semihosting, int op)
+{
+	return semihosting->is_fileio || op == SEMIHOSTING_SYS_EXIT ||
+		op == SEMIHOSTING_SYS_EXIT_EXTENDED;
+}
+
+/* Service the @a count requests in @a entries, filling their result. */
+static void semihosting_ring_service(struct target *target, uint8_t *entries,
+		uint32_t count)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t *entry = entries + i * SEMIHOSTING_RING_ENTRY_SIZE;
+		int op = target_buffer_get_u32(target, entry + SEMIHOSTING_RING_ENTRY_OP);
+		int64_t result = -1;
+		int sys_errno = ENOTSUP;
+
+		if (!semihosting_ring_needs_halt(semihosting, op)) {
+			semihosting->op = op;
+			semihosting->param = target_buffer_get_u64(target,
+					entry + SEMIHOSTING_RING_ENTRY_PARAM);
+			semihosting->sys_errno = 0;
+
+			if (semihosting_common_execute(target) == ERROR_OK) {
+				result = semihosting->result;
+				sys_errno = semihosting->sys_errno;
+			} else {
+				sys_errno = EIO;
+			}
+		}
+
+		target_buffer_set_u32(target, entry + SEMIHOSTING_RING_ENTRY_ERRNO, sys_errno);
+		target_buffer_set_u64(target, entry + SEMIHOSTING_RING_ENTRY_RESULT, result);
+	}
+}
+
+static int semihosting_ring_poll(void *priv)
+{
+	struct target *target = priv;
+	struct semihosting *semihosting = target->semihosting;
+	struct semihosting_ring *ring = semihosting->ring;
+	uint8_t entries[SEMIHOSTING_RING_MAX_BATCH * SEMIHOSTING_RING_ENTRY_SIZE];
+	uint8_t indices[8];
+	int retval;
+
+	/* a classic call waits for GDB, its state must be kept */
+	if (semihosting->hit_fileio || !target_was_examined(target))
+		return ERROR_OK;
+
+	retval = target_read_buffer(target, ring->address + SEMIHOSTING_RING_HEAD,
+			sizeof(indices), indices);
+	if (retval != ERROR_OK) {
+		ring->errors++;
+		return ERROR_OK;
+	}
+
+	uint32_t head = target_buffer_get_u32(target, indices);
+	uint32_t tail = target_buffer_get_u32(target, indices + 4);
+	uint32_t pending = head - tail;
+	if (!pending)
+		return ERROR_OK;
+
+	if (pending > ring->num_entries) {
+		LOG_TARGET_ERROR(target, "semihosting ring: head %" PRIu32 " and tail %" PRIu32
+				" are inconsistent, stopping", head, tail);
+		semihosting_ring_stop(target);
+		return ERROR_OK;
+	}
+
+	/* the classic call in progress, if any, must not see the ring ones */
+	size_t word_size_bytes = semihosting->word_size_bytes;
+	int sys_errno = semihosting->sys_errno;
+	int op = semihosting->op;
+	uint64_t param = semihosting->param;
+	int64_t result = semihosting->result;
+	bool is_resumable = semihosting->is_resumable;
+
+	semihosting->word_size_bytes = ring->word_size_bytes;
+
+	while (pending) {
+		uint32_t slot = tail % ring->num_entries;
+		uint32_t count = MIN(pending, ring->num_entries - slot);
+		count = MIN(count, (uint32_t)SEMIHOSTING_RING_MAX_BATCH);
+		target_addr_t address = ring->address + SEMIHOSTING_RING_ENTRIES +
+			(target_addr_t)slot * SEMIHOSTING_RING_ENTRY_SIZE;
+		uint32_t size = count * SEMIHOSTING_RING_ENTRY_SIZE;
+
+		retval = target_read_buffer(target, address, size, entries);
+		if (retval != ERROR_OK)
+			break;
+
+		semihosting_ring_service(target, entries, count);
+
+		retval = target_write_buffer(target, address, size, entries);
+		if (retval != ERROR_OK)
+			break;
+
+		tail += count;
+		uint8_t buf[4];
+		target_buffer_set_u32(target, buf, tail);
+		retval = target_write_buffer(target, ring->address + SEMIHOSTING_RING_TAIL,
+				sizeof(buf), buf);
+		if (retval != ERROR_OK)
+			break;
+
+		pending -= count;
+		ring->requests += count;
+		ring->batches++;
+		ring->max_batch = MAX(ring->max_batch, count);
+	}
+
+	if (retval != ERROR_OK)
+		ring->errors++;
+
+	semihosting->word_size_bytes = word_size_bytes;
+	semihosting->sys_errno = sys_errno;
+	semihosting->op = op;
+	semihosting->param = param;
+	semihosting->result = result;
+	semihosting->is_resumable = is_resumable;
+
+	return ERROR_OK;
+}
+
+/* Look for the control block in [address, address + size). */
+static int semihosting_ring_find(struct target *target, target_addr_t address,
+		uint32_t size, bool *found, target_addr_t *cb_address)
+{
+	const size_t id_len = strlen(SEMIHOSTING_RING_ID);
+	uint8_t buf[1024];
+
+	*found = false;
+	if (size < SEMIHOSTING_RING_ENTRIES)
+		return ERROR_OK;
+
+	/* consecutive blocks overlap, not to miss an identifier across two */
+	for (uint32_t offset = 0; offset + id_len <= size; offset += sizeof(buf) - id_len) {
+		uint32_t len = MIN((uint32_t)sizeof(buf), size - offset);
+		int retval = target_read_buffer(target, address + offset, len, buf);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (uint32_t i = 0; i + id_len <= len; i++) {
+			if (!memcmp(buf + i, SEMIHOSTING_RING_ID, id_len)) {
+				*found = true;
+				*cb_address = address + offset + i;
+				return ERROR_OK;
+			}
+		}
+
+		if (len < sizeof(buf))
+			break;
+	}
+
+	return ERROR_OK;
+}
+
+void semihosting_ring_stop(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting || !semihosting->ring)
+		return;
+
+	target_unregister_timer_callback(semihosting_ring_poll, target);
+	free(semihosting->ring);
+	semihosting->ring = NULL;
+}
+
+static struct semihosting *semihosting_ring_get(struct command_invocation *cmd,
+		struct target *target)
+{
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return NULL;
+	}
+
+	if (!target->semihosting)
+		command_print(CMD, "semihosting not supported for current target");
+	return target->semihosting;
+}
+
+COMMAND_HANDLER(handle_semihosting_ring_start)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	unsigned int interval_ms = SEMIHOSTING_RING_DEFAULT_INTERVAL_MS;
+	target_addr_t address, cb_address;
+	uint32_t size;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], interval_ms);
+		if (!interval_ms)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct semihosting *semihosting = semihosting_ring_get(CMD, target);
+	if (!semihosting)
+		return ERROR_FAIL;
+
+	semihosting_ring_stop(target);
+
+	bool found;
+	int retval = semihosting_ring_find(target, address, size, &found, &cb_address);
+	if (retval != ERROR_OK)
+		return retval;
+	if (!found) {
+		command_print(CMD, "semihosting ring control block not found");
+		return ERROR_FAIL;
+	}
+
+	uint8_t cb[SEMIHOSTING_RING_ENTRIES];
+	retval = target_read_buffer(target, cb_address, sizeof(cb), cb);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t num_entries = target_buffer_get_u32(target, cb + SEMIHOSTING_RING_NUM_ENTRIES);
+	uint32_t word_size = target_buffer_get_u32(target, cb + SEMIHOSTING_RING_WORD_SIZE);
+	if (!num_entries || (word_size != 4 && word_size != 8)) {
+		command_print(CMD, "invalid semihosting ring control block at " TARGET_ADDR_FMT,
+				cb_address);
+		return ERROR_FAIL;
+	}
+
+	struct semihosting_ring *ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	ring->address = cb_address;
+	ring->num_entries = num_entries;
+	ring->word_size_bytes = word_size;
+	ring->interval_ms = interval_ms;
+	semihosting->ring = ring;
+
+	target_register_timer_callback(semihosting_ring_poll, interval_ms,
+			TARGET_TIMER_TYPE_PERIODIC, target);
+
+	command_print(CMD, "semihosting ring with %" PRIu32 " entries at " TARGET_ADDR_FMT,
+			num_entries, cb_address);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_semihosting_ring_stop)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!semihosting_ring_get(CMD, target))
+		return ERROR_FAIL;
+
+	semihosting_ring_stop(target);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_semihosting_ring_status)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct semihosting *semihosting = semihosting_ring_get(CMD, target);
+	if (!semihosting)
+		return ERROR_FAIL;
+
+	struct semihosting_ring *ring = semihosting->ring;
+	if (!ring) {
+		command_print(CMD, "state     stopped");
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "state     running");
+	command_print(CMD, "address   " TARGET_ADDR_FMT, ring->address);
+	command_print(CMD, "entries   %" PRIu32, ring->num_entries);
+	command_print(CMD, "interval  %u", ring->interval_ms);
+	command_print(CMD, "requests  %" PRIu64, ring->requests);
+	command_print(CMD, "batches   %" PRIu64, ring->batches);
+	command_print(CMD, "max_batch %" PRIu32, ring->max_batch);
+	command_print(CMD, "errors    %" PRIu64, ring->errors);
+
+	return ERROR_OK;
+}
+
+const struct command_registration semihosting_ring_command_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_semihosting_ring_start,
+		.mode = COMMAND_EXEC,
+		.usage = "address size [interval_ms]",
+		.help = "find the semihosting ring control block in the given "
+			"memory range and service its requests while the target runs",
+	},
+	{
+		.name = "stop",
+		.handler = handle_semihosting_ring_stop,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "stop servicing the semihosting ring",
+	},
+	{
+		.name = "status",
+		.handler = handle_semihosting_ring_status,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "display the semihosting ring counters",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_SEMIHOSTING_RING_H
+#define OPENOCD_TARGET_SEMIHOSTING_RING_H
+
+#include <helper/command.h>
+
+struct target;
+
+void semihosting_ring_stop(struct target *target);
+
+extern const struct command_registration semihosting_ring_command_handlers[];
+
+#endif /* OPENOCD_TARGET_SEMIHOSTING_RING_H */
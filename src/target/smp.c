@@ -94,6 +94,89 @@ int gdb_write_smp_packet(struct connection *connection,
 	return retval;
 }
 
+static const char * const smp_phase_name[SMP_NUM_PHASES] = {
+	[SMP_PHASE_HALT_REQUEST] = "halt_request",
+	[SMP_PHASE_HALT_WAIT] = "halt_wait",
+	[SMP_PHASE_DEBUG_ENTRY] = "debug_entry",
+	[SMP_PHASE_RESUME_PREPARE] = "resume_prepare",
+	[SMP_PHASE_RESUME_WAIT] = "resume_wait",
+};
+
+/**
+ * Timing record of the SMP group of @a target. There is one per group,
+ * kept by the first target of the group so that any member finds it.
+ * @returns NULL if the target is not in a group or on allocation failure.
+ */
+struct smp_stats *smp_group_stats(struct target *target)
+{
+	if (list_empty(target->smp_targets))
+		return NULL;
+
+	struct target *first = list_first_entry(target->smp_targets,
+			struct target_list, lh)->target;
+	if (!first->smp_stats)
+		first->smp_stats = calloc(1, sizeof(*first->smp_stats));
+
+	return first->smp_stats;
+}
+
+/** Stop timing @a phase of an SMP stop or restart, started at @a duration. */
+void smp_phase_done(struct target *target, enum smp_phase phase,
+		struct duration *duration)
+{
+	duration_measure(duration);
+
+	struct smp_stats *stats = smp_group_stats(target);
+	if (!stats)
+		return;
+
+	struct smp_phase_stats *ps = &stats->phase[phase];
+	float ms = duration_elapsed(duration) * 1000.0;
+
+	ps->count++;
+	ps->last_ms = ms;
+	ps->total_ms += ms;
+	if (ms > ps->max_ms)
+		ps->max_ms = ms;
+
+	LOG_DEBUG("%s: SMP %s took %.3f ms", target_name(target),
+			smp_phase_name[phase], ms);
+}
+
+COMMAND_HANDLER(handle_smp_timing_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct smp_stats *stats = smp_group_stats(target);
+	if (!stats) {
+		command_print(CMD, "target %s is not part of an SMP group", target_name(target));
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	for (unsigned int i = 0; i < SMP_NUM_PHASES; i++) {
+		const struct smp_phase_stats *ps = &stats->phase[i];
+
+		command_print(CMD, "%-16s { count %u last_ms %.3f max_ms %.3f avg_ms %.3f }",
+				smp_phase_name[i], ps->count, ps->last_ms, ps->max_ms,
+				ps->count ? ps->total_ms / ps->count : 0);
+	}
+	command_print(CMD, "%-16s %" PRIu64, "regs_deferred", stats->regs_deferred);
+	command_print(CMD, "%-16s %" PRIu64, "regs_filled", stats->regs_filled);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(default_handle_smp_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -162,5 +245,13 @@ const struct command_registration smp_command_handlers[] = {
 		.help = "display/fix current core played to gdb",
 		.usage = "",
 	},
+	{
+		.name = "smp_timing",
+		.handler = handle_smp_timing_command,
+		.mode = COMMAND_EXEC,
+		.help = "display (or reset) the time taken by each phase of "
+			"halting and resuming the SMP group",
+		.usage = "['reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -10,6 +10,7 @@
 #define OPENOCD_TARGET_SMP_H
 
 #include <helper/list.h>
+#include <helper/time_support.h>
 #include "server/server.h"
 
 #define foreach_smp_target(pos, head) \
@@ -18,6 +19,35 @@
 #define foreach_smp_target_direction(forward, pos, head) \
 	list_for_each_entry_direction(forward, pos, head, lh)
 
+/* Phases of an SMP group stop and restart, timed by smp_phase_done() */
+enum smp_phase {
+	SMP_PHASE_HALT_REQUEST,		/* request the halt of all PEs */
+	SMP_PHASE_HALT_WAIT,		/* wait until all PEs are halted */
+	SMP_PHASE_DEBUG_ENTRY,		/* debug entry of the other PEs */
+	SMP_PHASE_RESUME_PREPARE,	/* restore context of the other PEs */
+	SMP_PHASE_RESUME_WAIT,		/* wait until all PEs are running */
+	SMP_NUM_PHASES,
+};
+
+struct smp_phase_stats {
+	unsigned int count;
+	float last_ms;
+	float max_ms;
+	float total_ms;
+};
+
+/* Timing of the run control of an SMP group, kept by its first target */
+struct smp_stats {
+	struct smp_phase_stats phase[SMP_NUM_PHASES];
+	/* register cache fills put off at debug entry, and done later on */
+	uint64_t regs_deferred;
+	uint64_t regs_filled;
+};
+
+struct smp_stats *smp_group_stats(struct target *target);
+void smp_phase_done(struct target *target, enum smp_phase phase,
+		struct duration *duration);
+
 extern const struct command_registration smp_command_handlers[];
 
 /* DEPRECATED */
@@ -64,6 +64,10 @@ static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
+static void target_forget_resident_working_areas(struct target *target);
+static void target_flush_working_areas(struct target *target, bool restore);
+static void target_access_working_areas(struct target *target,
+		target_addr_t address, uint32_t size, bool write);
 
 /* targets */
 extern struct target_type arm7tdmi_target;
@@ -158,6 +162,9 @@ static int64_t target_timer_next_event_value;
 static LIST_HEAD(target_reset_callback_list);
 static LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = TARGET_DEFAULT_POLLING_INTERVAL;
+/* bounds of the background polling interval, see handle_target() */
+static unsigned int poll_interval_min = TARGET_DEFAULT_POLLING_INTERVAL / 10;
+static unsigned int poll_interval_max = TARGET_DEFAULT_POLLING_INTERVAL;
 static LIST_HEAD(empty_smp_targets);
 
 static const struct jim_nvp nvp_assert[] = {
@@ -598,6 +605,9 @@ int target_halt(struct target *target)
 	target->halt_issued = true;
 	target->halt_issued_time = timeval_ms();
 
+	/* report the halt, e.g. to a gdb Ctrl-C, as soon as it happens */
+	target_poll_soon(target);
+
 	return ERROR_OK;
 }
 
@@ -656,6 +666,10 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	 * Disable polling during resume() to guarantee the execution of handlers
 	 * in the correct order.
 	 */
+	/* the application must find its RAM as it left it */
+	if (!debug_execution)
+		target_flush_working_areas(target, true);
+
 	bool save_poll_mask = jtag_poll_mask();
 	retval = target->type->resume(target, current, address, handle_breakpoints, debug_execution);
 	jtag_poll_unmask(save_poll_mask);
@@ -680,8 +694,12 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	}
 
 	struct target *target;
-	for (target = all_targets; target; target = target->next)
+	for (target = all_targets; target; target = target->next) {
+		/* write back what the working areas hold, memory content is not
+		 * trusted across a reset */
+		target_flush_working_areas(target, target->state == TARGET_HALTED);
 		target_call_reset_callbacks(target, reset_mode);
+	}
 
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
@@ -868,6 +886,10 @@ int target_run_algorithm(struct target *target,
 			entry_point, exit_point, timeout_ms, arch_info);
 	target->running_alg = false;
 
+	/* the algorithm may have overwritten the code left resident */
+	if (retval != ERROR_OK)
+		target_forget_resident_working_areas(target);
+
 done:
 	return retval;
 }
@@ -952,6 +974,8 @@ int target_wait_algorithm(struct target *target,
 			exit_point, timeout_ms, arch_info);
 	if (retval != ERROR_TARGET_TIMEOUT)
 		target->running_alg = false;
+	if (retval != ERROR_OK && retval != ERROR_TARGET_TIMEOUT)
+		target_forget_resident_working_areas(target);
 
 done:
 	return retval;
@@ -1314,6 +1338,7 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_access_working_areas(target, address, size * count, false);
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1328,6 +1353,7 @@ int target_read_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_access_working_areas(target, address, size * count, false);
 	return target->type->read_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1342,6 +1368,8 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_access_working_areas(target, address, size * count, true);
+	rtos_snapshot_memory_written(target);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1356,6 +1384,8 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_access_working_areas(target, address, size * count, true);
+	rtos_snapshot_memory_written(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1483,6 +1513,9 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	/* the application must find its RAM as it left it */
+	target_flush_working_areas(target, true);
+
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1844,6 +1877,12 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 			target_event_name(event),
 			target_name(target));
 
+	if (event == TARGET_EVENT_RESUMED || event == TARGET_EVENT_DEBUG_RESUMED
+			|| event == TARGET_EVENT_RESET_END) {
+		/* the target runs again, poll it closely for a while */
+		target_poll_soon(target);
+	}
+
 	target_handle_event(target, event);
 
 	while (callback) {
@@ -1960,19 +1999,94 @@ int64_t target_timer_next_event(void)
 	return target_timer_next_event_value;
 }
 
+/* Earliest time a target is due for a background poll */
+static int64_t target_poll_next_due(void)
+{
+	int64_t when = timeval_ms() + poll_interval_max;
+
+	if (!is_jtag_poll_safe())
+		return when;
+
+	for (struct target *target = all_targets; target; target = target->next) {
+		if (target_was_examined(target) && target->tap->enabled)
+			when = MIN(when, target->poll_next);
+	}
+
+	return when;
+}
+
+/* Set the next call of handle_target(), and its period from then on */
+static void target_poll_timer_set(int64_t when)
+{
+	int64_t now = timeval_ms();
+
+	for (struct target_timer_callback *cb = target_timer_callbacks; cb; cb = cb->next) {
+		if (cb->callback != handle_target || cb->removed)
+			continue;
+
+		cb->time_ms = when > now ? when - now : 0;
+		cb->when = when;
+		target_timer_next_event_value = MIN(target_timer_next_event_value, when);
+	}
+}
+
+static void target_poll_forward(struct target *target, bool restart)
+{
+	struct target *first = target ? target : all_targets;
+	int64_t when = INT64_MAX;
+
+	for (struct target *t = first; t; t = target ? NULL : t->next) {
+		if (restart)
+			t->poll_interval = poll_interval_min;
+
+		int64_t earliest = t->poll_last + MAX(t->poll_interval / 2, poll_interval_min);
+		if (earliest < t->poll_next) {
+			t->poll_next = earliest;
+			t->poll_requested = true;
+		}
+		when = MIN(when, t->poll_next);
+	}
+
+	/* only bring the timer forward, it may be due earlier for another target */
+	for (struct target_timer_callback *cb = target_timer_callbacks; cb; cb = cb->next) {
+		if (cb->callback == handle_target && !cb->removed && when < cb->when) {
+			cb->when = when;
+			target_timer_next_event_value = MIN(target_timer_next_event_value, when);
+		}
+	}
+}
+
+void target_poll_soon(struct target *target)
+{
+	target_poll_forward(target, true);
+}
+
+void target_poll_activity(struct target *target)
+{
+	target_poll_forward(target, false);
+}
+
 /* Prints the working area layout for debug purposes */
 static void print_wa_layout(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 
 	while (c) {
-		LOG_DEBUG("%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+		LOG_DEBUG("%c%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
+			c->restore_pending ? 'b' : ' ', c->resident ? 'r' : ' ', c->free ? ' ' : '*',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
 }
 
+/* Forget the code left in the area */
+static void target_drop_resident_code(struct working_area *area)
+{
+	area->resident = false;
+	free(area->code);
+	area->code = NULL;
+}
+
 /* Reduce area to size bytes, create a new free area from the remaining bytes, if any. */
 static void target_split_working_area(struct working_area *area, uint32_t size)
 {
@@ -1992,14 +2106,32 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
+		new_wa->resident = false;
+		new_wa->code = NULL;
+		new_wa->restore_pending = false;
+
+		if (area->restore_pending) {
+			/* The original content not restored yet moves with the new area */
+			new_wa->backup = malloc(new_wa->size);
+			if (!new_wa->backup) {
+				free(new_wa);
+				return;
+			}
+			memcpy(new_wa->backup, area->backup + size, new_wa->size);
+			new_wa->restore_pending = true;
+
+			uint8_t *backup = realloc(area->backup, size);
+			if (backup)
+				area->backup = backup;
+		} else {
+			/* If backup memory was allocated to this area, it has the wrong size
+			 * now so free it and it will be reallocated if/when needed */
+			free(area->backup);
+			area->backup = NULL;
+		}
 
 		area->next = new_wa;
 		area->size = size;
-
-		/* If backup memory was allocated to this area, it has the wrong size
-		 * now so free it and it will be reallocated if/when needed */
-		free(area->backup);
-		area->backup = NULL;
 	}
 }
 
@@ -2011,8 +2143,28 @@ static void target_merge_working_areas(struct target *target)
 	while (c && c->next) {
 		assert(c->next->address == c->address + c->size); /* This is an invariant */
 
-		/* Find two adjacent free areas */
-		if (c->free && c->next->free) {
+		/* Find two adjacent free areas, not holding resident code, whose
+		 * original content is either restored in both or pending in both */
+		bool merge = c->free && c->next->free && !c->resident && !c->next->resident &&
+			c->restore_pending == c->next->restore_pending;
+
+		if (merge && c->restore_pending) {
+			/* Keep the original content of both */
+			uint8_t *backup = realloc(c->backup, c->size + c->next->size);
+			if (backup) {
+				memcpy(backup + c->size, c->next->backup, c->next->size);
+				c->backup = backup;
+			} else {
+				merge = false;
+			}
+		} else if (merge) {
+			/* If backup memory was allocated to the remaining area, it's has
+			 * the wrong size now */
+			free(c->backup);
+			c->backup = NULL;
+		}
+
+		if (merge) {
 			/* Merge the last into the first */
 			c->size += c->next->size;
 
@@ -2020,18 +2172,87 @@ static void target_merge_working_areas(struct target *target)
 			struct working_area *to_be_freed = c->next;
 			c->next = c->next->next;
 			free(to_be_freed->backup);
+			free(to_be_freed->code);
 			free(to_be_freed);
-
-			/* If backup memory was allocated to the remaining area, it's has
-			 * the wrong size now */
-			free(c->backup);
-			c->backup = NULL;
 		} else {
 			c = c->next;
 		}
 	}
 }
 
+/* Write back the original content of the area, if still pending. The code
+ * left in the area is lost. */
+static int target_restore_working_area(struct target *target, struct working_area *area)
+{
+	int retval = ERROR_OK;
+
+	if (!area->restore_pending)
+		return ERROR_OK;
+
+	/* clear first, the write must not find the area pending */
+	area->restore_pending = false;
+	target_drop_resident_code(area);
+
+	retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
+				area->size, area->address);
+	else
+		target->working_area_stats.bytes_restored += area->size;
+
+	return retval;
+}
+
+/* Forget the code left in the free areas, and merge them back. */
+static void target_forget_resident_working_areas(struct target *target)
+{
+	for (struct working_area *c = target->working_areas; c; c = c->next)
+		target_drop_resident_code(c);
+
+	target_merge_working_areas(target);
+}
+
+/* Restore the original content of the free areas, or drop it, forget the
+ * code left in them, and merge them back. */
+static void target_flush_working_areas(struct target *target, bool restore)
+{
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->free)
+			continue;
+		if (restore)
+			target_restore_working_area(target, c);
+		c->restore_pending = false;
+		target_drop_resident_code(c);
+	}
+
+	target_merge_working_areas(target);
+}
+
+/* Memory behind free working areas is about to be accessed by someone else,
+ * e.g. GDB, a memory command or another target sharing the RAM: write back
+ * the original content still pending first, and forget the code that is
+ * going to be overwritten. */
+static void target_access_working_areas(struct target *target,
+		target_addr_t address, uint32_t size, bool write)
+{
+	for (struct target *owner = all_targets; owner; owner = owner->next) {
+		for (struct working_area *c = owner->working_areas; c; c = c->next) {
+			if (!c->free || (!c->restore_pending && !c->resident))
+				continue;
+
+			bool overlap = address >= c->address ? address - c->address < c->size
+				: c->address - address < size;
+			if (!overlap)
+				continue;
+
+			if (c->restore_pending)
+				target_restore_working_area(owner, c);
+			else if (write)
+				target_drop_resident_code(c);
+		}
+	}
+}
+
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -2076,6 +2297,9 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
+			new_wa->resident = false;
+			new_wa->code = NULL;
+			new_wa->restore_pending = false;
 		}
 
 		target->working_areas = new_wa;
@@ -2084,17 +2308,28 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	/* only allocate multiples of 4 byte */
 	size = ALIGN_UP(size, 4);
 
-	struct working_area *c = target->working_areas;
+	/* Find the smallest large enough working area, the resident code is
+	 * left alone as long as possible */
+	struct working_area *c = NULL;
+	bool flush = false;
+	for (struct working_area *i = target->working_areas; i; i = i->next) {
+		if (!i->free)
+			continue;
+		flush |= i->resident || i->restore_pending;
+		if (!i->resident && i->size >= size && (!c || i->size < c->size))
+			c = i;
+	}
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
+	/* The free areas kept apart may fit once merged */
+	if (!c && flush) {
+		target_flush_working_areas(target, true);
+		return target_alloc_working_area_try(target, size, area);
 	}
 
-	if (!c)
+	if (!c) {
+		target->working_area_stats.failures++;
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
 
 	/* Split the working area into the requested size */
 	target_split_working_area(c, size);
@@ -2103,15 +2338,22 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			  size, c->address);
 
 	if (target->backup_working_area) {
-		if (!c->backup) {
-			c->backup = malloc(c->size);
-			if (!c->backup)
-				return ERROR_FAIL;
-		}
+		if (c->restore_pending) {
+			/* The backup still holds the original content */
+			target->working_area_stats.bytes_backup_avoided += c->size;
+		} else {
+			if (!c->backup) {
+				c->backup = malloc(c->size);
+				if (!c->backup)
+					return ERROR_FAIL;
+			}
 
-		int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
-		if (retval != ERROR_OK)
-			return retval;
+			int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
+			if (retval != ERROR_OK)
+				return retval;
+			c->restore_pending = true;
+			target->working_area_stats.bytes_backed_up += c->size;
+		}
 	}
 
 	/* mark as used, and return the new (reused) area */
@@ -2121,6 +2363,8 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	/* user pointer */
 	c->user = area;
 
+	target->working_area_stats.allocations++;
+
 	print_wa_layout(target);
 
 	return ERROR_OK;
@@ -2137,32 +2381,62 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
-static int target_restore_working_area(struct target *target, struct working_area *area)
+int target_alloc_resident_working_area(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area)
 {
-	int retval = ERROR_OK;
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->free && c->resident && c->size == ALIGN_UP(size, 4) &&
+				!memcmp(c->code, code, size)) {
+			LOG_DEBUG("reusing %" PRIu32 " bytes of code loaded at address " TARGET_ADDR_FMT,
+					size, c->address);
+			c->free = false;
+			c->user = area;
+			*area = c;
+			target->working_area_stats.allocations++;
+			target->working_area_stats.uploads_avoided++;
+			print_wa_layout(target);
+			return ERROR_OK;
+		}
+	}
 
-	if (target->backup_working_area && area->backup) {
-		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
-		if (retval != ERROR_OK)
-			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
-					area->size, area->address);
+	int retval = target_alloc_working_area(target, size, area);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, (*area)->address, size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, *area);
+		return retval;
 	}
 
-	return retval;
+	target->working_area_stats.uploads++;
+	target->working_area_stats.bytes_uploaded += size;
+
+	/* keep a copy to recognize the code, an area of another size or content
+	 * is never reused */
+	uint8_t *copy = malloc((*area)->size);
+	if (copy) {
+		memset(copy, 0, (*area)->size);
+		memcpy(copy, code, size);
+		(*area)->code = copy;
+		(*area)->resident = true;
+	}
+
+	return ERROR_OK;
 }
 
-/* Restore the area's backup memory, if any, and return the area to the allocation pool */
+/* Return the area to the allocation pool. Its backup memory, if any, is
+ * restored later on, or dropped if restore is not set. */
 static int target_free_working_area_restore(struct target *target, struct working_area *area, int restore)
 {
 	if (!area || area->free)
 		return ERROR_OK;
 
-	int retval = ERROR_OK;
-	if (restore) {
-		retval = target_restore_working_area(target, area);
-		/* REVISIT: Perhaps the area should be freed even if restoring fails. */
-		if (retval != ERROR_OK)
-			return retval;
+	if (!restore) {
+		area->restore_pending = false;
+		target_drop_resident_code(area);
+	} else if (area->restore_pending) {
+		target->working_area_stats.restores_deferred++;
 	}
 
 	area->free = true;
@@ -2181,7 +2455,7 @@ static int target_free_working_area_restore(struct target *target, struct workin
 
 	print_wa_layout(target);
 
-	return retval;
+	return ERROR_OK;
 }
 
 int target_free_working_area(struct target *target, struct working_area *area)
@@ -2198,15 +2472,18 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 
 	LOG_DEBUG("freeing all working areas");
 
-	/* Loop through all areas, restoring the allocated ones and marking them as free */
+	/* Loop through all areas, marking the allocated ones as free and
+	 * restoring the original content of all */
 	while (c) {
 		if (!c->free) {
-			if (restore)
-				target_restore_working_area(target, c);
 			c->free = true;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
 		}
+		if (restore)
+			target_restore_working_area(target, c);
+		c->restore_pending = false;
+		target_drop_resident_code(c);
 		c = c->next;
 	}
 
@@ -2216,19 +2493,25 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 	print_wa_layout(target);
 }
 
-void target_free_all_working_areas(struct target *target)
+static void target_release_working_areas(struct target *target, int restore)
 {
-	target_free_all_working_areas_restore(target, 1);
+	target_free_all_working_areas_restore(target, restore);
 
 	/* Now we have none or only one working area marked as free */
 	if (target->working_areas) {
 		/* Free the last one to allow on-the-fly moving and resizing */
 		free(target->working_areas->backup);
+		free(target->working_areas->code);
 		free(target->working_areas);
 		target->working_areas = NULL;
 	}
 }
 
+void target_free_all_working_areas(struct target *target)
+{
+	target_release_working_areas(target, 1);
+}
+
 /* Find the largest number of bytes that can be allocated */
 uint32_t target_get_working_area_avail(struct target *target)
 {
@@ -2253,8 +2536,10 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
+	if (target->semihosting) {
+		semihosting_common_free(target);
 		free(target->semihosting->basedir);
+	}
 	free(target->semihosting);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
@@ -2267,7 +2552,8 @@ static void target_destroy(struct target *target)
 		teap = next;
 	}
 
-	target_free_all_working_areas(target);
+	/* target_quit() wrote the backups back, the target type is gone by now */
+	target_release_working_areas(target, 0);
 
 	/* release the targets SMP list */
 	if (target->smp) {
@@ -2285,6 +2571,7 @@ static void target_destroy(struct target *target)
 
 	rtos_destroy(target);
 
+	free(target->smp_stats);
 	free(target->gdb_port_override);
 	free(target->type);
 	free(target->trace_info);
@@ -2311,6 +2598,12 @@ void target_quit(void)
 	}
 	target_timer_callbacks = NULL;
 
+	/* Free areas may still wait for their original content to be written
+	 * back. Do it while all the targets and the adapter are still there:
+	 * target_destroy() tears the target types down first. */
+	for (struct target *target = all_targets; target; target = target->next)
+		target_free_all_working_areas_restore(target, target->state == TARGET_HALTED);
+
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
 
@@ -2426,6 +2719,9 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_access_working_areas(target, address, size, true);
+	rtos_snapshot_memory_written(target);
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2491,6 +2787,8 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	target_access_working_areas(target, address, size, false);
+
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
@@ -2530,12 +2828,45 @@ static int target_read_buffer_default(struct target *target, target_addr_t addre
 	return ERROR_OK;
 }
 
-int target_checksum_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t *crc)
+/* Checksum computed on the host, after reading the memory back */
+static int target_checksum_memory_readback(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t *checksum)
 {
 	uint8_t *buffer;
 	int retval;
 	uint32_t i;
+
+	buffer = malloc(size);
+	if (!buffer) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", size);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	retval = target_read_buffer(target, address, size, buffer);
+	if (retval != ERROR_OK) {
+		free(buffer);
+		return retval;
+	}
+
+	/* convert to target endianness */
+	for (i = 0; i < (size/sizeof(uint32_t)); i++) {
+		uint32_t target_data;
+		target_data = target_buffer_get_u32(target, &buffer[i*sizeof(uint32_t)]);
+		target_buffer_set_u32(target, &buffer[i*sizeof(uint32_t)], target_data);
+	}
+
+	retval = image_calculate_checksum(buffer, size, checksum);
+	free(buffer);
+
+	return retval;
+}
+
+int target_checksum_memory(struct target *target, target_addr_t address, uint32_t size, uint32_t *crc)
+{
+	int retval;
 	uint32_t checksum = 0;
+	struct duration bench;
+	const char *method = "on target";
+
 	if (!target_was_examined(target)) {
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
@@ -2545,30 +2876,20 @@ int target_checksum_memory(struct target *target, target_addr_t address, uint32_
 		return ERROR_FAIL;
 	}
 
+	/* the algorithm reads the memory behind the working areas too */
+	target_access_working_areas(target, address, size, false);
+
+	duration_start(&bench);
 	retval = target->type->checksum_memory(target, address, size, &checksum);
 	if (retval != ERROR_OK) {
-		buffer = malloc(size);
-		if (!buffer) {
-			LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)", size);
-			return ERROR_COMMAND_SYNTAX_ERROR;
-		}
-		retval = target_read_buffer(target, address, size, buffer);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			return retval;
-		}
-
-		/* convert to target endianness */
-		for (i = 0; i < (size/sizeof(uint32_t)); i++) {
-			uint32_t target_data;
-			target_data = target_buffer_get_u32(target, &buffer[i*sizeof(uint32_t)]);
-			target_buffer_set_u32(target, &buffer[i*sizeof(uint32_t)], target_data);
-		}
-
-		retval = image_calculate_checksum(buffer, size, &checksum);
-		free(buffer);
+		method = "read back";
+		retval = target_checksum_memory_readback(target, address, size, &checksum);
 	}
 
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK)
+		LOG_DEBUG("checksum of %" PRIu32 " bytes at " TARGET_ADDR_FMT " %s in %fs (%0.3f KiB/s)",
+			size, address, method, duration_elapsed(&bench), duration_kbps(&bench, size));
+
 	*crc = checksum;
 
 	return retval;
@@ -2980,6 +3301,7 @@ static int handle_target(void *priv)
 
 	if (!is_jtag_poll_safe()) {
 		/* polling is disabled currently */
+		target_poll_timer_set(target_poll_next_due());
 		return ERROR_OK;
 	}
 
@@ -3027,8 +3349,10 @@ static int handle_target(void *priv)
 		recursive = 0;
 	}
 
+	int64_t now = timeval_ms();
+
 	/* Poll targets for state changes unless that's globally disabled.
-	 * Skip targets that are currently disabled.
+	 * Skip targets that are currently disabled, or not due yet.
 	 */
 	for (struct target *target = all_targets;
 			is_jtag_poll_safe() && target;
@@ -3040,48 +3364,77 @@ static int handle_target(void *priv)
 		if (!target->tap->enabled)
 			continue;
 
-		if (target->backoff.times > target->backoff.count) {
-			/* do not poll this time as we failed previously */
-			target->backoff.count++;
+		if (now < target->poll_next)
 			continue;
-		}
-		target->backoff.count = 0;
 
 		/* only poll target if we've got power and srst isn't asserted */
-		if (!power_dropout && !srst_asserted) {
-			/* polling may fail silently until the target has been examined */
-			retval = target_poll(target);
-			if (retval != ERROR_OK) {
-				/* 100ms polling interval. Increase interval between polling up to 5000ms */
-				if (target->backoff.times * polling_interval < 5000) {
-					target->backoff.times *= 2;
-					target->backoff.times++;
-				}
+		if (power_dropout || srst_asserted) {
+			target->poll_next = now + poll_interval_max;
+			continue;
+		}
 
-				/* Tell GDB to halt the debugger. This allows the user to
-				 * run monitor commands to handle the situation.
-				 */
-				target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
+		enum target_state prev_state = target->state;
+
+		target->poll_last = now;
+		target->poll_stats.polls++;
+		if (target->poll_requested) {
+			target->poll_stats.polls_requested++;
+			target->poll_requested = false;
+		}
+
+		/* polling may fail silently until the target has been examined */
+		retval = target_poll(target);
+		if (retval != ERROR_OK) {
+			target->poll_stats.failures++;
+
+			/* 100ms polling interval. Increase interval between polling up to 5000ms */
+			if (target->backoff.times * polling_interval < 5000) {
+				target->backoff.times *= 2;
+				target->backoff.times++;
 			}
-			if (target->backoff.times > 0) {
-				LOG_USER("Polling target %s failed, trying to reexamine", target_name(target));
-				target_reset_examined(target);
-				retval = target_examine_one(target);
-				/* Target examination could have failed due to unstable connection,
-				 * but we set the examined flag anyway to repoll it later */
-				if (retval != ERROR_OK) {
-					target_set_examined(target);
-					LOG_USER("Examination failed, GDB will be halted. Polling again in %dms",
-						 target->backoff.times * polling_interval);
-					return retval;
-				}
+			/* do not poll again before the back off time */
+			target->poll_next = now + (target->backoff.times + 1) * polling_interval;
+
+			/* Tell GDB to halt the debugger. This allows the user to
+			 * run monitor commands to handle the situation.
+			 */
+			target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
+		}
+		if (target->backoff.times > 0) {
+			LOG_USER("Polling target %s failed, trying to reexamine", target_name(target));
+			target_reset_examined(target);
+			retval = target_examine_one(target);
+			/* Target examination could have failed due to unstable connection,
+			 * but we set the examined flag anyway to repoll it later */
+			if (retval != ERROR_OK) {
+				target_set_examined(target);
+				LOG_USER("Examination failed, GDB will be halted. Polling again in %dms",
+					 target->backoff.times * polling_interval);
+				break;
 			}
+		}
 
-			/* Since we succeeded, we reset backoff count */
-			target->backoff.times = 0;
+		/* Since we succeeded, we reset backoff count */
+		target->backoff.times = 0;
+
+		/* poll quickly what just started running, then back off while it
+		 * keeps running; a halted target only changes on our request */
+		if (target->state != prev_state)
+			target->poll_stats.state_changes++;
+		if (target->state == TARGET_RUNNING || target->state == TARGET_DEBUG_RUNNING) {
+			if (target->state != prev_state)
+				target->poll_interval = poll_interval_min;
+			else
+				target->poll_interval = MIN(MAX(target->poll_interval * 2, poll_interval_min),
+						poll_interval_max);
+		} else {
+			target->poll_interval = poll_interval_max;
 		}
+		target->poll_next = now + target->poll_interval;
 	}
 
+	target_poll_timer_set(target_poll_next_due());
+
 	return retval;
 }
 
@@ -3245,6 +3598,54 @@ COMMAND_HANDLER(handle_poll_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_poll_interval_command)
+{
+	if (CMD_ARGC == 2) {
+		unsigned int min, max;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], min);
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], max);
+		if (min == 0 || max < min) {
+			command_print(CMD, "need 0 < min_ms <= max_ms");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		poll_interval_min = min;
+		poll_interval_max = max;
+		target_poll_soon(NULL);
+	} else if (CMD_ARGC != 0) {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	command_print(CMD, "background polling every %u to %u ms",
+			poll_interval_min, poll_interval_max);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_poll_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_poll_stats *stats = &target->poll_stats;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "polls            %" PRIu64, stats->polls);
+	command_print(CMD, "polls_requested  %" PRIu64, stats->polls_requested);
+	command_print(CMD, "failures         %" PRIu64, stats->failures);
+	command_print(CMD, "state_changes    %" PRIu64, stats->state_changes);
+	command_print(CMD, "interval_ms      %u", target->poll_interval);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_wait_halt_command)
 {
 	if (CMD_ARGC > 1)
@@ -3740,13 +4141,18 @@ COMMAND_HANDLER(handle_load_image_command)
 
 }
 
+/* Transfer size of dump_image and of the binary compare of verify_image;
+ * large enough for the adapter to queue many accesses per round trip */
+#define TARGET_IMAGE_CHUNK_SIZE	(64 * 1024)
+
 COMMAND_HANDLER(handle_dump_image_command)
 {
 	struct fileio *fileio;
 	uint8_t *buffer;
 	int retval, retvaltemp;
 	target_addr_t address, size;
-	struct duration bench;
+	struct duration bench, phase;
+	float read_s = 0, write_s = 0;
 	struct target *target = get_current_target(CMD_CTX);
 
 	if (CMD_ARGC != 3)
@@ -3755,7 +4161,7 @@ COMMAND_HANDLER(handle_dump_image_command)
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	uint32_t buf_size = (size > TARGET_IMAGE_CHUNK_SIZE) ? TARGET_IMAGE_CHUNK_SIZE : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3771,16 +4177,24 @@ COMMAND_HANDLER(handle_dump_image_command)
 	while (size > 0) {
 		size_t size_written;
 		uint32_t this_run_size = (size > buf_size) ? buf_size : size;
+
+		duration_start(&phase);
 		retval = target_read_buffer(target, address, this_run_size, buffer);
+		duration_measure(&phase);
+		read_s += duration_elapsed(&phase);
 		if (retval != ERROR_OK)
 			break;
 
+		duration_start(&phase);
 		retval = fileio_write(fileio, this_run_size, buffer, &size_written);
+		duration_measure(&phase);
+		write_s += duration_elapsed(&phase);
 		if (retval != ERROR_OK)
 			break;
 
 		size -= this_run_size;
 		address += this_run_size;
+		keep_alive();
 	}
 
 	free(buffer);
@@ -3793,6 +4207,7 @@ COMMAND_HANDLER(handle_dump_image_command)
 		command_print(CMD,
 				"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
 				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+		command_print(CMD, "target read %fs, file write %fs", read_s, write_s);
 	}
 
 	retvaltemp = fileio_close(fileio);
@@ -3808,14 +4223,77 @@ enum verify_mode {
 	IMAGE_CHECKSUM_ONLY = 2
 };
 
+struct verify_section {
+	uint32_t size;
+	uint32_t checksum;
+	uint32_t mem_checksum;
+};
+
+/* Compare a section of the image with the target memory byte by byte,
+ * after a checksum mismatch. */
+static COMMAND_HELPER(verify_image_compare_section, struct target *target,
+		struct image *image, unsigned int section, uint32_t size, int *diffs)
+{
+	target_addr_t base = image->sections[section].base_address;
+	size_t buf_cnt;
+	uint8_t *buffer = malloc(size);
+	uint8_t *data = malloc(MIN(size, TARGET_IMAGE_CHUNK_SIZE));
+
+	if (!buffer || !data) {
+		command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)", size);
+		free(buffer);
+		free(data);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, 0x0, size, buffer, &buf_cnt);
+
+	for (size_t offset = 0; retval == ERROR_OK && offset < buf_cnt; ) {
+		uint32_t chunk = MIN(buf_cnt - offset, TARGET_IMAGE_CHUNK_SIZE);
+
+		retval = target_read_buffer(target, base + offset, chunk, data);
+		if (retval != ERROR_OK)
+			break;
+
+		for (uint32_t t = 0; t < chunk; t++) {
+			if (data[t] != buffer[offset + t]) {
+				command_print(CMD,
+							  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
+							  *diffs,
+							  (unsigned)(offset + t + base),
+							  data[t],
+							  buffer[offset + t]);
+				if ((*diffs)++ >= 127) {
+					command_print(CMD, "More than 128 errors, the rest are not printed.");
+					free(data);
+					free(buffer);
+					return ERROR_FAIL;
+				}
+			}
+		}
+		offset += chunk;
+		keep_alive();
+	}
+
+	free(data);
+	free(buffer);
+	return retval;
+}
+
+/* The image is handled in phases rather than section by section: all the
+ * sections are read and their checksums computed on the host first, then
+ * the target checksums are computed back to back, which lets the target
+ * keep its checksum algorithm loaded, and only the sections that differ
+ * are read back for a binary compare. */
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
 	int retval;
-	uint32_t checksum = 0;
-	uint32_t mem_checksum = 0;
+	struct verify_section *sections;
+	struct duration phase;
+	float image_s = 0, host_crc_s = 0, target_crc_s = 0, compare_s = 0;
 
 	struct image image;
 
@@ -3851,71 +4329,45 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	image_size = 0x0;
 	int diffs = 0;
 	retval = ERROR_OK;
+
+	sections = calloc(image.num_sections, sizeof(*sections));
+	if (image.num_sections && !sections) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	/* phase 1: image sections and their checksums */
 	for (unsigned int i = 0; i < image.num_sections; i++) {
 		buffer = malloc(image.sections[i].size);
 		if (!buffer) {
 			command_print(CMD,
 					"error allocating buffer for section (%" PRIu32 " bytes)",
 					image.sections[i].size);
-			break;
+			retval = ERROR_FAIL;
+			goto done;
 		}
+
+		duration_start(&phase);
 		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
+		duration_measure(&phase);
+		image_s += duration_elapsed(&phase);
 		if (retval != ERROR_OK) {
 			free(buffer);
-			break;
+			goto done;
 		}
+		sections[i].size = buf_cnt;
 
 		if (verify >= IMAGE_VERIFY) {
 			/* calculate checksum of image */
-			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
+			duration_start(&phase);
+			retval = image_calculate_checksum(buffer, buf_cnt, &sections[i].checksum);
+			duration_measure(&phase);
+			host_crc_s += duration_elapsed(&phase);
 			if (retval != ERROR_OK) {
 				free(buffer);
-				break;
-			}
-
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
-			}
-			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
-				LOG_ERROR("checksum mismatch");
-				free(buffer);
-				retval = ERROR_FAIL;
 				goto done;
 			}
-			if (checksum != mem_checksum) {
-				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
-
-				if (diffs == 0)
-					LOG_ERROR("checksum mismatch - attempting binary compare");
-
-				data = malloc(buf_cnt);
-
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
-				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
-						}
-						keep_alive();
-					}
-				}
-				free(data);
-			}
 		} else {
 			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
 						  image.sections[i].base_address,
@@ -3925,15 +4377,60 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 		free(buffer);
 		image_size += buf_cnt;
 	}
-	if (diffs > 0)
+
+	if (verify < IMAGE_VERIFY)
+		goto done;
+
+	/* phase 2: target checksums, back to back */
+	duration_start(&phase);
+	for (unsigned int i = 0; i < image.num_sections; i++) {
+		retval = target_checksum_memory(target, image.sections[i].base_address,
+				sections[i].size, &sections[i].mem_checksum);
+		if (retval != ERROR_OK)
+			break;
+	}
+	duration_measure(&phase);
+	target_crc_s = duration_elapsed(&phase);
+	if (retval != ERROR_OK)
+		goto done;
+
+	/* phase 3: binary compare of the sections that differ */
+	duration_start(&phase);
+	for (unsigned int i = 0; i < image.num_sections; i++) {
+		if (sections[i].checksum == sections[i].mem_checksum)
+			continue;
+
+		if (verify == IMAGE_CHECKSUM_ONLY) {
+			LOG_ERROR("checksum mismatch");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		/* failed crc checksum, fall back to a binary compare */
+		if (diffs == 0)
+			LOG_ERROR("checksum mismatch - attempting binary compare");
+
+		retval = CALL_COMMAND_HANDLER(verify_image_compare_section, target, &image, i,
+				sections[i].size, &diffs);
+		if (retval != ERROR_OK)
+			break;
+	}
+	duration_measure(&phase);
+	compare_s = duration_elapsed(&phase);
+
+	if (diffs > 0 && diffs < 128)
 		command_print(CMD, "No more differences found.");
 done:
+	free(sections);
 	if (diffs > 0)
 		retval = ERROR_FAIL;
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "verified %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
+		if (verify >= IMAGE_VERIFY)
+			command_print(CMD, "image read %fs, host checksum %fs, target checksum %fs, "
+					"compare %fs", image_s, host_crc_s, target_crc_s, compare_s);
 	}
 
 	image_close(&image);
@@ -3956,6 +4453,107 @@ COMMAND_HANDLER(handle_test_image_command)
 	return CALL_COMMAND_HANDLER(handle_verify_image_command_internal, IMAGE_TEST);
 }
 
+COMMAND_HANDLER(handle_checksum_memory_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	target_addr_t address;
+	uint32_t size, checksum;
+	bool readback = false;
+	struct duration bench;
+	int retval;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (CMD_ARGC == 3) {
+		if (strcmp(CMD_ARGV[2], "readback"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		readback = true;
+	}
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	duration_start(&bench);
+	if (readback)
+		retval = target_checksum_memory_readback(target, address, size, &checksum);
+	else
+		retval = target_checksum_memory(target, address, size, &checksum);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (duration_measure(&bench) == ERROR_OK)
+		command_print(CMD, "checksum 0x%08" PRIx32 " of %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				checksum, size, duration_elapsed(&bench), duration_kbps(&bench, size));
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_working_area_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct working_area_stats *stats = &target->working_area_stats;
+	uint32_t free_areas = 0, free_bytes = 0, largest_free = 0;
+	uint32_t resident_areas = 0, resident_bytes = 0, pending_bytes = 0;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+		return ERROR_OK;
+	}
+
+	if (!target->working_areas && target->working_area_size >= 4) {
+		free_areas = 1;
+		free_bytes = ALIGN_DOWN(target->working_area_size, 4);
+		largest_free = free_bytes;
+	}
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->restore_pending)
+			pending_bytes += c->size;
+		if (c->resident) {
+			resident_areas++;
+			resident_bytes += c->size;
+		} else if (c->free) {
+			free_areas++;
+			free_bytes += c->size;
+			largest_free = MAX(largest_free, c->size);
+		}
+	}
+
+	/* share of the free memory out of reach of the largest allocation */
+	unsigned int fragmentation = free_bytes ? 100 - (uint64_t)largest_free * 100 / free_bytes : 0;
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "size                  %" PRIu32, target->working_area_size);
+	command_print(CMD, "free_areas            %" PRIu32, free_areas);
+	command_print(CMD, "free_bytes            %" PRIu32, free_bytes);
+	command_print(CMD, "largest_free          %" PRIu32, largest_free);
+	command_print(CMD, "fragmentation_pct     %u", fragmentation);
+	command_print(CMD, "resident_areas        %" PRIu32, resident_areas);
+	command_print(CMD, "resident_bytes        %" PRIu32, resident_bytes);
+	command_print(CMD, "restore_pending_bytes %" PRIu32, pending_bytes);
+	command_print(CMD, "allocations           %" PRIu64, stats->allocations);
+	command_print(CMD, "failures              %" PRIu64, stats->failures);
+	command_print(CMD, "uploads               %" PRIu64, stats->uploads);
+	command_print(CMD, "uploads_avoided       %" PRIu64, stats->uploads_avoided);
+	command_print(CMD, "bytes_uploaded        %" PRIu64, stats->bytes_uploaded);
+	command_print(CMD, "bytes_backed_up       %" PRIu64, stats->bytes_backed_up);
+	command_print(CMD, "bytes_backup_avoided  %" PRIu64, stats->bytes_backup_avoided);
+	command_print(CMD, "bytes_restored        %" PRIu64, stats->bytes_restored);
+	command_print(CMD, "restores_deferred     %" PRIu64, stats->restores_deferred);
+
+	return ERROR_OK;
+}
+
 static int handle_bp_command_list(struct command_invocation *cmd)
 {
 	struct target *target = get_current_target(cmd->ctx);
@@ -4598,6 +5196,213 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 	return e;
 }
 
+/* Leading options of read_memory and write_memory: "-binary" moves the
+ * memory content as a single byte string, "-file <name>" streams it from
+ * or to a file. Either way the elements are not limited in number. */
+struct target_jim_memory_opts {
+	bool binary;
+	const char *filename;
+};
+
+/* Chunk read or written at once by the bulk variants */
+#define TARGET_BULK_CHUNK_SIZE	(64 * 1024)
+
+static int target_jim_memory_options(Jim_Interp *interp, int argc, Jim_Obj * const *argv,
+		struct target_jim_memory_opts *opts)
+{
+	int i = 1;
+
+	memset(opts, 0, sizeof(*opts));
+	while (i < argc) {
+		const char *opt = Jim_GetString(argv[i], NULL);
+
+		if (!strcmp(opt, "-binary")) {
+			opts->binary = true;
+			i++;
+		} else if (!strcmp(opt, "-file") && i + 1 < argc) {
+			opts->filename = Jim_GetString(argv[i + 1], NULL);
+			i += 2;
+		} else {
+			break;
+		}
+	}
+
+	if (opts->binary && opts->filename) {
+		Jim_SetResultString(interp, "options -binary and -file are exclusive", -1);
+		return -1;
+	}
+
+	/* number of arguments consumed */
+	return i - 1;
+}
+
+static int target_jim_read_memory_bulk(Jim_Interp *interp, struct target *target,
+		target_addr_t addr, unsigned int width, size_t count, bool is_phys,
+		const char *filename)
+{
+	struct fileio *fileio = NULL;
+	const size_t size = count * width;
+	size_t chunk_size = size;
+
+	if (count > SIZE_MAX / width || (!filename && size > INT_MAX - 1)) {
+		Jim_SetResultString(interp, "read_memory: too large binary read request, use -file", -1);
+		return JIM_ERR;
+	}
+
+	if (filename) {
+		chunk_size = MIN(size, TARGET_BULK_CHUNK_SIZE);
+		if (fileio_open(&fileio, filename, FILEIO_WRITE, FILEIO_BINARY) != ERROR_OK) {
+			Jim_SetResultFormatted(interp, "read_memory: cannot open file '%s'", filename);
+			return JIM_ERR;
+		}
+	}
+
+	/* one more byte for the string terminator */
+	uint8_t *buffer = malloc(chunk_size + 1);
+	if (!buffer) {
+		LOG_ERROR("Failed to allocate memory");
+		if (fileio)
+			fileio_close(fileio);
+		return JIM_ERR;
+	}
+
+	int e = JIM_OK;
+	for (size_t done = 0; done < size; ) {
+		const size_t chunk_len = MIN(size - done, TARGET_BULK_CHUNK_SIZE) / width;
+		uint8_t *chunk = fileio ? buffer : buffer + done;
+		int retval;
+
+		if (is_phys)
+			retval = target_read_phys_memory(target, addr, width, chunk_len, chunk);
+		else
+			retval = target_read_memory(target, addr, width, chunk_len, chunk);
+
+		if (retval != ERROR_OK) {
+			LOG_ERROR("read_memory: read at " TARGET_ADDR_FMT " with width=%u and count=%zu failed",
+				addr, width * 8, chunk_len);
+			Jim_SetResultString(interp, "read_memory: failed to read memory", -1);
+			e = JIM_ERR;
+			break;
+		}
+
+		if (fileio) {
+			size_t written;
+			retval = fileio_write(fileio, chunk_len * width, chunk, &written);
+			if (retval != ERROR_OK || written != chunk_len * width) {
+				Jim_SetResultFormatted(interp, "read_memory: cannot write file '%s'", filename);
+				e = JIM_ERR;
+				break;
+			}
+		}
+
+		done += chunk_len * width;
+		addr += chunk_len * width;
+		keep_alive();
+	}
+
+	if (fileio) {
+		fileio_close(fileio);
+		free(buffer);
+		if (e == JIM_OK)
+			Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+		return e;
+	}
+
+	if (e != JIM_OK) {
+		free(buffer);
+		return e;
+	}
+
+	/* the string object takes the buffer over */
+	buffer[size] = 0;
+	Jim_SetResult(interp, Jim_NewStringObjNoAlloc(interp, (char *)buffer, size));
+	return JIM_OK;
+}
+
+static int target_jim_write_memory_bulk(Jim_Interp *interp, struct target *target,
+		target_addr_t addr, unsigned int width, Jim_Obj *data, bool is_phys,
+		const char *filename)
+{
+	struct fileio *fileio = NULL;
+	const uint8_t *bytes = NULL;
+	uint8_t *buffer = NULL;
+	size_t size;
+
+	if (filename) {
+		if (fileio_open(&fileio, filename, FILEIO_READ, FILEIO_BINARY) != ERROR_OK) {
+			Jim_SetResultFormatted(interp, "write_memory: cannot open file '%s'", filename);
+			return JIM_ERR;
+		}
+		if (fileio_size(fileio, &size) != ERROR_OK) {
+			fileio_close(fileio);
+			Jim_SetResultFormatted(interp, "write_memory: cannot read file '%s'", filename);
+			return JIM_ERR;
+		}
+		buffer = malloc(MIN(size, TARGET_BULK_CHUNK_SIZE));
+		if (!buffer) {
+			LOG_ERROR("Failed to allocate memory");
+			fileio_close(fileio);
+			return JIM_ERR;
+		}
+	} else {
+		int len;
+		bytes = (const uint8_t *)Jim_GetString(data, &len);
+		size = len;
+	}
+
+	int e = JIM_OK;
+	if (size % width) {
+		Jim_SetResultFormatted(interp, "write_memory: data size %zu is not a multiple of %u bytes",
+			size, width);
+		e = JIM_ERR;
+	} else if (addr + size < addr) {
+		Jim_SetResultString(interp, "write_memory: addr + len wraps to zero", -1);
+		e = JIM_ERR;
+	}
+
+	for (size_t done = 0; e == JIM_OK && done < size; ) {
+		const size_t chunk_len = MIN(size - done, TARGET_BULK_CHUNK_SIZE) / width;
+		const uint8_t *chunk = bytes + done;
+		int retval;
+
+		if (fileio) {
+			size_t read;
+			retval = fileio_read(fileio, chunk_len * width, buffer, &read);
+			if (retval != ERROR_OK || read != chunk_len * width) {
+				Jim_SetResultFormatted(interp, "write_memory: cannot read file '%s'", filename);
+				e = JIM_ERR;
+				break;
+			}
+			chunk = buffer;
+		}
+
+		if (is_phys)
+			retval = target_write_phys_memory(target, addr, width, chunk_len, chunk);
+		else
+			retval = target_write_memory(target, addr, width, chunk_len, chunk);
+
+		if (retval != ERROR_OK) {
+			LOG_ERROR("write_memory: write at " TARGET_ADDR_FMT " with width=%u and count=%zu failed",
+				addr, width * 8, chunk_len);
+			Jim_SetResultString(interp, "write_memory: failed to write memory", -1);
+			e = JIM_ERR;
+			break;
+		}
+
+		done += chunk_len * width;
+		addr += chunk_len * width;
+		keep_alive();
+	}
+
+	if (fileio)
+		fileio_close(fileio);
+	free(buffer);
+
+	if (e == JIM_OK)
+		Jim_SetResult(interp, Jim_NewEmptyStringObj(interp));
+	return e;
+}
+
 static int target_jim_read_memory(Jim_Interp *interp, int argc,
 		Jim_Obj * const *argv)
 {
@@ -4608,11 +5413,20 @@ static int target_jim_read_memory(Jim_Interp *interp, int argc,
 	 * argv[4] = optional "phys"
 	 */
 
-	if (argc < 4 || argc > 5) {
-		Jim_WrongNumArgs(interp, 1, argv, "address width count ['phys']");
+	struct target_jim_memory_opts opts;
+	int shift = target_jim_memory_options(interp, argc, argv, &opts);
+	if (shift < 0)
+		return JIM_ERR;
+
+	if (argc - shift < 4 || argc - shift > 5) {
+		Jim_WrongNumArgs(interp, 1, argv, "['-binary'|'-file' filename] address width count ['phys']");
 		return JIM_ERR;
 	}
 
+	/* skip the options, the command name is not needed any more */
+	argc -= shift;
+	argv += shift;
+
 	/* Arg 1: Memory address. */
 	jim_wide wide_addr;
 	int e;
@@ -4672,15 +5486,19 @@ static int target_jim_read_memory(Jim_Interp *interp, int argc,
 		return JIM_ERR;
 	}
 
+	struct command_context *cmd_ctx = current_command_context(interp);
+	assert(cmd_ctx != NULL);
+	struct target *target = get_current_target(cmd_ctx);
+
+	if (opts.binary || opts.filename)
+		return target_jim_read_memory_bulk(interp, target, addr, width, count, is_phys,
+			opts.filename);
+
 	if (count > 65536) {
 		Jim_SetResultString(interp, "read_memory: too large read request, exeeds 64K elements", -1);
 		return JIM_ERR;
 	}
 
-	struct command_context *cmd_ctx = current_command_context(interp);
-	assert(cmd_ctx != NULL);
-	struct target *target = get_current_target(cmd_ctx);
-
 	const size_t buffersize = 4096;
 	uint8_t *buffer = malloc(buffersize);
 
@@ -4954,15 +5772,28 @@ static int target_jim_write_memory(Jim_Interp *interp, int argc,
 	/*
 	 * argv[1] = memory address
 	 * argv[2] = desired element width in bits
-	 * argv[3] = list of data to write
+	 * argv[3] = list of data to write, omitted with -file
 	 * argv[4] = optional "phys"
 	 */
 
-	if (argc < 4 || argc > 5) {
-		Jim_WrongNumArgs(interp, 1, argv, "address width data ['phys']");
+	struct target_jim_memory_opts opts;
+	int shift = target_jim_memory_options(interp, argc, argv, &opts);
+	if (shift < 0)
+		return JIM_ERR;
+
+	/* with -file, the data comes from the file */
+	const int phys_arg = opts.filename ? 3 : 4;
+
+	if (argc - shift < phys_arg || argc - shift > phys_arg + 1) {
+		Jim_WrongNumArgs(interp, 1, argv, "['-binary'] address width data ['phys'] | "
+			"'-file' filename address width ['phys']");
 		return JIM_ERR;
 	}
 
+	/* skip the options, the command name is not needed any more */
+	argc -= shift;
+	argv += shift;
+
 	/* Arg 1: Memory address. */
 	int e;
 	jim_wide wide_addr;
@@ -4981,13 +5812,12 @@ static int target_jim_write_memory(Jim_Interp *interp, int argc,
 		return e;
 
 	const unsigned int width_bits = l;
-	size_t count = Jim_ListLength(interp, argv[3]);
 
 	/* Arg 4: Optional 'phys'. */
 	bool is_phys = false;
 
-	if (argc > 4) {
-		const char *phys = Jim_GetString(argv[4], NULL);
+	if (argc > phys_arg) {
+		const char *phys = Jim_GetString(argv[phys_arg], NULL);
 
 		if (strcmp(phys, "phys")) {
 			Jim_SetResultFormatted(interp, "invalid argument '%s', must be 'phys'", phys);
@@ -5010,6 +5840,16 @@ static int target_jim_write_memory(Jim_Interp *interp, int argc,
 
 	const unsigned int width = width_bits / 8;
 
+	struct command_context *cmd_ctx = current_command_context(interp);
+	assert(cmd_ctx != NULL);
+	struct target *target = get_current_target(cmd_ctx);
+
+	if (opts.binary || opts.filename)
+		return target_jim_write_memory_bulk(interp, target, addr, width,
+			opts.filename ? NULL : argv[3], is_phys, opts.filename);
+
+	size_t count = Jim_ListLength(interp, argv[3]);
+
 	if ((addr + (count * width)) < addr) {
 		Jim_SetResultString(interp, "write_memory: addr + len wraps to zero", -1);
 		return JIM_ERR;
@@ -5020,10 +5860,6 @@ static int target_jim_write_memory(Jim_Interp *interp, int argc,
 		return JIM_ERR;
 	}
 
-	struct command_context *cmd_ctx = current_command_context(interp);
-	assert(cmd_ctx != NULL);
-	struct target *target = get_current_target(cmd_ctx);
-
 	const size_t buffersize = 4096;
 	uint8_t *buffer = malloc(buffersize);
 
@@ -5853,7 +6689,9 @@ static int jim_target_reset(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 
 	/* determine if we should halt or not. */
 	target->reset_halt = (a != 0);
-	/* When this happens - all workareas are invalid. */
+	/* When this happens - all workareas are invalid. The content of the
+	 * free ones may still wait to be restored. */
+	target_flush_working_areas(target, target->state == TARGET_HALTED);
 	target_free_all_working_areas_restore(target, 0);
 
 	/* do the assert */
@@ -6081,15 +6919,24 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.name = "read_memory",
 		.mode = COMMAND_EXEC,
 		.jim_handler = target_jim_read_memory,
-		.help = "Read Tcl list of 8/16/32/64 bit numbers from target memory",
-		.usage = "address width count ['phys']",
+		.help = "Read Tcl list of 8/16/32/64 bit numbers from target memory, "
+			"or its raw content as a byte string or into a file",
+		.usage = "['-binary'|'-file' filename] address width count ['phys']",
 	},
 	{
 		.name = "write_memory",
 		.mode = COMMAND_EXEC,
 		.jim_handler = target_jim_write_memory,
-		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory",
-		.usage = "address width data ['phys']",
+		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory, "
+			"or raw content from a byte string or a file",
+		.usage = "['-binary'] address width data ['phys'] | '-file' filename address width ['phys']",
+	},
+	{
+		.name = "poll_stats",
+		.handler = handle_poll_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or reset the background polling counters of this target",
+		.usage = "['reset']",
 	},
 	{
 		.name = "eventlist",
@@ -6744,6 +7591,13 @@ static const struct command_registration target_command_handlers[] = {
 			"or prints table of all targets (no parameters)",
 		.usage = "[target]",
 	},
+	{
+		.name = "poll_interval",
+		.handler = handle_poll_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "show or set the bounds of the background polling interval",
+		.usage = "[min_ms max_ms]",
+	},
 	{
 		.name = "target",
 		.mode = COMMAND_CONFIG,
@@ -6984,6 +7838,18 @@ nextw:
 	return retval;
 }
 
+static const struct command_registration working_area_command_handlers[] = {
+	{
+		.name = "stats",
+		.handler = handle_working_area_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Display (or reset) the working area layout and counters "
+			"of the current target",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_exec_command_handlers[] = {
 	{
 		.name = "fast_load_image",
@@ -7174,6 +8040,21 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.mode = COMMAND_EXEC,
 		.usage = "filename address size",
 	},
+	{
+		.name = "checksum_memory",
+		.handler = handle_checksum_memory_command,
+		.mode = COMMAND_EXEC,
+		.help = "compute the CRC32 of target memory, on the target when "
+			"supported or by reading the memory back",
+		.usage = "address size ['readback']",
+	},
+	{
+		.name = "working_area",
+		.mode = COMMAND_EXEC,
+		.help = "working area commands",
+		.chain = working_area_command_handlers,
+		.usage = "",
+	},
 	{
 		.name = "verify_image_checksum",
 		.handler = handle_verify_image_checksum_command,
@@ -7210,15 +8091,17 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "read_memory",
 		.mode = COMMAND_EXEC,
 		.jim_handler = target_jim_read_memory,
-		.help = "Read Tcl list of 8/16/32/64 bit numbers from target memory",
-		.usage = "address width count ['phys']",
+		.help = "Read Tcl list of 8/16/32/64 bit numbers from target memory, "
+			"or its raw content as a byte string or into a file",
+		.usage = "['-binary'|'-file' filename] address width count ['phys']",
 	},
 	{
 		.name = "write_memory",
 		.mode = COMMAND_EXEC,
 		.jim_handler = target_jim_write_memory,
-		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory",
-		.usage = "address width data ['phys']",
+		.help = "Write Tcl list of 8/16/32/64 bit numbers to target memory, "
+			"or raw content from a byte string or a file",
+		.usage = "['-binary'] address width data ['phys'] | '-file' filename address width ['phys']",
 	},
 	{
 		.name = "reset_nag",
@@ -35,6 +35,7 @@ struct mem_param;
 struct reg_param;
 struct target_list;
 struct gdb_fileio_info;
+struct smp_stats;
 
 /*
  * TARGET_UNKNOWN = 0: we don't know anything about the target yet
@@ -93,6 +94,21 @@ struct working_area {
 	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
+	bool resident;			/* algorithm still loaded, see target_alloc_resident_working_area() */
+	uint8_t *code;			/* copy of the resident code */
+	bool restore_pending;	/* backup holds the original content, not written back yet */
+};
+
+struct working_area_stats {
+	uint64_t allocations;
+	uint64_t failures;
+	uint64_t uploads;
+	uint64_t uploads_avoided;
+	uint64_t bytes_uploaded;
+	uint64_t bytes_backed_up;
+	uint64_t bytes_backup_avoided;
+	uint64_t bytes_restored;
+	uint64_t restores_deferred;
 };
 
 struct gdb_service {
@@ -107,7 +123,14 @@ struct gdb_service {
 /* target back off timer */
 struct backoff_timer {
 	int times;
-	int count;
+};
+
+/* counters of the background polling of a target */
+struct target_poll_stats {
+	uint64_t polls;
+	uint64_t polls_requested;	/* brought forward by target_poll_soon() or _activity() */
+	uint64_t failures;
+	uint64_t state_changes;
 };
 
 /* split target registers into multiple class */
@@ -156,6 +179,7 @@ struct target {
 	uint32_t working_area_size;			/* size in bytes */
 	uint32_t backup_working_area;		/* whether the content of the working area has to be preserved */
 	struct working_area *working_areas;/* list of allocated working areas */
+	struct working_area_stats working_area_stats;
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
 	/* also see: target_state_name() */
@@ -189,6 +213,11 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	unsigned int poll_interval;			/* ms between background polls, adapted to the state */
+	int64_t poll_last;					/* timeval_ms() of the last background poll */
+	int64_t poll_next;					/* timeval_ms() of the next background poll */
+	bool poll_requested;				/* next poll brought forward on request */
+	struct target_poll_stats poll_stats;
 	int smp;							/* Unique non-zero number for each SMP group */
 	struct list_head *smp_targets;		/* list all targets in this smp group/cluster
 										 * The head of the list is shared between the
@@ -199,6 +228,9 @@ struct target {
 	 * gdb_service->target pointer */
 	struct gdb_service *gdb_service;
 
+	/* run control timing of the SMP group, allocated on first use (smp.h) */
+	struct smp_stats *smp_stats;
+
 	/* file-I/O information for host to do syscall */
 	struct gdb_fileio_info *fileio_info;
 
@@ -390,6 +422,21 @@ int target_poll(struct target *target);
 int target_resume(struct target *target, int current, target_addr_t address,
 		int handle_breakpoints, int debug_execution);
 int target_halt(struct target *target);
+/**
+ * Ask for a background poll of @a target, or of all the targets if NULL,
+ * as soon as the minimal polling interval allows, and restart the
+ * back-off of its polling interval. Used whenever its state may change:
+ * resume, halt request.
+ */
+void target_poll_soon(struct target *target);
+/**
+ * Bring the next background poll of @a target, or of all the targets if
+ * NULL, forward to half of its current polling interval, without
+ * restarting the back-off. Used when data is received from a running
+ * target, so a steady stream of it can't keep the polling at its minimal
+ * interval.
+ */
+void target_poll_activity(struct target *target);
 int target_call_event_callbacks(struct target *target, enum target_event event);
 int target_call_reset_callbacks(struct target *target, enum target_reset_mode reset_mode);
 int target_call_trace_callbacks(struct target *target, size_t len, uint8_t *data);
@@ -726,9 +773,20 @@ int target_alloc_working_area(struct target *target,
  */
 int target_alloc_working_area_try(struct target *target,
 		uint32_t size, struct working_area **area);
+/**
+ * Allocate a working area holding @a code, like target_alloc_working_area()
+ * followed by target_write_buffer(). Once freed, the area keeps the code
+ * for the next call with the same code, compared byte for byte with a copy,
+ * until the target resumes, steps or is reset, an algorithm fails, the memory is
+ * written by someone else or the room is needed by another allocation.
+ */
+int target_alloc_resident_working_area(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area);
 /**
  * Free a working area.
- * Restore target data if area backup is configured.
+ * If area backup is configured, the target data is restored when the
+ * target resumes or is reset, the memory is accessed, or the room is
+ * needed for another allocation, so that reusing the area costs nothing.
  * @param target
  * @param area Pointer to the area to be freed or NULL
  * @returns ERROR_OK if successful; error code if restore failed
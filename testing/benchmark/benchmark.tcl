@@ -0,0 +1,86 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+#
+# Adapter benchmark suite, on top of the "adapter benchmark" command.
+#
+# Load it after the adapter configuration and call benchmark_suite once the
+# adapter is initialized, e.g.:
+#   openocd -f interface/dummy.cfg -f testing/benchmark/benchmark.tcl \
+#           -c "init; benchmark_suite dummy.json; shutdown"
+#
+# The results are written as JSON, one object per workload run, to keep
+# track of regressions between builds; run.sh in this directory runs the
+# suite against all the stand-in adapters.
+#
+
+gdb_port disabled
+tcl_port disabled
+telnet_port disabled
+
+# Fields of "adapter benchmark" that are not numbers
+set _BENCHMARK_STRINGS {workload adapter transport}
+
+proc benchmark_json_string {s} {
+	return "\"[string map {\\ \\\\ \" \\\" \n \\n \t \\t} $s]\""
+}
+
+# Convert the "array set" output of one run into a JSON object
+proc benchmark_json_object {result indent} {
+	global _BENCHMARK_STRINGS
+	array set r $result
+
+	set fields {}
+	foreach key [lsort [array names r]] {
+		if {[lsearch -exact $_BENCHMARK_STRINGS $key] >= 0} {
+			set value [benchmark_json_string $r($key)]
+		} else {
+			set value $r($key)
+		}
+		lappend fields "$indent  [benchmark_json_string $key]: $value"
+	}
+	return "$indent\{\n[join $fields ",\n"]\n$indent\}"
+}
+
+# Run each workload `repeat` times with its default parameters, or with
+# {name count size batch} lists in `workloads`, print a summary and write
+# the JSON report to `output` if given.
+proc benchmark_suite {{output ""} {workloads {scan_storm long_dr dap_burst flash_stream}} {repeat 3}} {
+	set transport [transport select]
+	set runs {}
+
+	foreach workload $workloads {
+		set name [lindex $workload 0]
+		if {$transport eq "swd" && $name ne "dap_burst"} {
+			echo "skipping $name, it needs the jtag transport"
+			continue
+		}
+
+		for {set i 0} {$i < $repeat} {incr i} {
+			set result [adapter benchmark {*}$workload]
+			array set r $result
+			echo [format "%-14s %-16s queue %9.3f ms  flush %9.3f ms  %10.0f B/s  %6d allocs" \
+				$name $r(adapter) $r(queue_ms) $r(flush_ms) $r(bytes_per_sec) $r(queue_allocs)]
+			lappend runs [concat $result [list run $i]]
+		}
+	}
+
+	if {$output eq ""} {
+		return
+	}
+
+	set objects {}
+	foreach run $runs {
+		lappend objects [benchmark_json_object $run "    "]
+	}
+
+	set fd [open $output w]
+	puts $fd "\{"
+	puts $fd "  \"version\": [benchmark_json_string [version]],"
+	puts $fd "  \"timestamp\": [clock seconds],"
+	puts $fd "  \"results\": \["
+	puts $fd [join $objects ",\n"]
+	puts $fd "  \]"
+	puts $fd "\}"
+	close $fd
+	echo "results written to $output"
+}
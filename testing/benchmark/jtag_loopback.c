@@ -0,0 +1,394 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  Loopback stand-in for the simulator side of the OpenOCD remote_bitbang,
+  jtag_vpi and jtag_dpi drivers, for the adapter benchmarks in this
+  directory.
+
+  There is no TAP behind it: TDO returns what was shifted in on TDI, so
+  every scan completes and the benchmark measures the driver, the socket
+  and the protocol alone. Use the -l option to add the latency of a real
+  simulator to each reply.
+
+  To compile run:
+  gcc -Wall -O2 -std=gnu99 -o jtag_loopback jtag_loopback.c
+
+  Usage example:
+  ./jtag_loopback -t remote_bitbang -p 3335
+  ./jtag_loopback -t jtag_vpi -p 5555
+  ./jtag_loopback -t jtag_dpi -p 5555
+
+  Options:
+  -t protocol  remote_bitbang, jtag_vpi or jtag_dpi
+  -p port      listen on TCP port (default 3335, 5555 for jtag_vpi/jtag_dpi)
+  -l usec      latency added before each reply
+  -1           jtag_vpi: ignore version queries, like servers that only
+               know the fixed size commands
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+enum protocol {
+	PROTO_REMOTE_BITBANG,
+	PROTO_JTAG_VPI,
+	PROTO_JTAG_DPI,
+};
+
+/* jtag_vpi commands, see src/jtag/drivers/jtag_vpi.c */
+#define VPI_XFERT_MAX_SIZE	512
+#define VPI_CMD_RESET		0
+#define VPI_CMD_TMS_SEQ		1
+#define VPI_CMD_SCAN_CHAIN	2
+#define VPI_CMD_SCAN_CHAIN_FLIP_TMS	3
+#define VPI_CMD_STOP_SIMU	4
+#define VPI_CMD_GET_VERSION	5
+#define VPI_CMD_BATCH		6
+#define VPI_CMD_SIZE		(4 + 2 * VPI_XFERT_MAX_SIZE + 4 + 4)
+#define VPI_BATCH_MAX_SIZE	(1024 * 1024)
+#define VPI_RECORD_CAPTURE	0x01
+
+static unsigned int latency_us;
+static bool vpi_legacy;
+
+struct loopback_stats {
+	unsigned long long requests;
+	unsigned long long replies;
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+};
+
+static struct loopback_stats stats;
+
+static uint32_t le_to_h_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void h_u32_to_le(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t n = read(fd, buf + done, len - done);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	stats.bytes_in += len;
+	return 0;
+}
+
+static int send_all(int fd, const uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	if (latency_us)
+		usleep(latency_us);
+
+	while (done < len) {
+		ssize_t n = write(fd, buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += n;
+	}
+
+	stats.replies++;
+	stats.bytes_out += len;
+	return 0;
+}
+
+/* One character per command; only 'R' expects a reply, the TDI level. */
+static bool serve_remote_bitbang(int fd)
+{
+	uint8_t in[4096], out[4096];
+	bool tdi = false;
+
+	for (;;) {
+		ssize_t n = read(fd, in, sizeof(in));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return true;
+		stats.bytes_in += n;
+
+		size_t replies = 0;
+		for (ssize_t i = 0; i < n; i++) {
+			char c = in[i];
+
+			stats.requests++;
+			if (c >= '0' && c <= '7')
+				tdi = (c - '0') & 1;
+			else if (c == 'R')
+				out[replies++] = tdi ? '1' : '0';
+			else if (c == 'Q')
+				return true;
+		}
+
+		if (replies && send_all(fd, out, replies) < 0)
+			return true;
+	}
+}
+
+/* A batch of records, answered with the TDI bytes of the records to
+ * capture, see protocol version 2 in src/jtag/drivers/jtag_vpi.c */
+static bool serve_jtag_vpi_batch(int fd)
+{
+	static uint8_t msg[VPI_BATCH_MAX_SIZE];
+	static uint8_t reply[8 + VPI_BATCH_MAX_SIZE];
+	uint8_t header[8];
+
+	if (recv_all(fd, header, sizeof(header)) < 0)
+		return false;
+
+	uint32_t len = le_to_h_u32(header);
+	uint32_t records = le_to_h_u32(header + 4);
+	if (len > sizeof(msg) - 12) {
+		fprintf(stderr, "batch of %u bytes is too long\n", len);
+		return false;
+	}
+	if (recv_all(fd, msg, len) < 0)
+		return false;
+
+	size_t pos = 0, out = 8;
+	for (uint32_t i = 0; i < records; i++) {
+		if (pos + 8 > len)
+			return false;
+		uint8_t flags = msg[pos + 1];
+		uint32_t bytes = (le_to_h_u32(msg + pos + 4) + 7) / 8;
+		pos += 8;
+		if (pos + bytes > len)
+			return false;
+		if (flags & VPI_RECORD_CAPTURE) {
+			memcpy(reply + out, msg + pos, bytes);
+			out += bytes;
+		}
+		pos += bytes;
+		stats.requests++;
+	}
+
+	h_u32_to_le(reply, VPI_CMD_BATCH);
+	h_u32_to_le(reply + 4, out - 8);
+	return send_all(fd, reply, out) == 0;
+}
+
+/* Fixed size commands; scans are answered with the whole command, the
+ * bits shifted out copied to the input buffer. */
+static bool serve_jtag_vpi(int fd)
+{
+	uint8_t cmd[VPI_CMD_SIZE];
+
+	while (recv_all(fd, cmd, 4) == 0) {
+		uint32_t op = le_to_h_u32(cmd);
+
+		if (op == VPI_CMD_BATCH && !vpi_legacy) {
+			if (!serve_jtag_vpi_batch(fd))
+				return true;
+			continue;
+		}
+
+		if (recv_all(fd, cmd + 4, sizeof(cmd) - 4) < 0)
+			return true;
+
+		stats.requests++;
+		switch (op) {
+		case VPI_CMD_SCAN_CHAIN:
+		case VPI_CMD_SCAN_CHAIN_FLIP_TMS:
+			memcpy(cmd + 4 + VPI_XFERT_MAX_SIZE, cmd + 4, VPI_XFERT_MAX_SIZE);
+			if (send_all(fd, cmd, sizeof(cmd)) < 0)
+				return true;
+			break;
+		case VPI_CMD_GET_VERSION:
+			if (vpi_legacy)
+				break;
+			/* version in length, largest batch in nb_bits */
+			h_u32_to_le(cmd + 4 + 2 * VPI_XFERT_MAX_SIZE, 2);
+			h_u32_to_le(cmd + 4 + 2 * VPI_XFERT_MAX_SIZE + 4, VPI_BATCH_MAX_SIZE);
+			if (send_all(fd, cmd, sizeof(cmd)) < 0)
+				return true;
+			break;
+		case VPI_CMD_STOP_SIMU:
+			return false;
+		default:
+			break;
+		}
+	}
+
+	return true;
+}
+
+static int recv_line(int fd, char *line, size_t size)
+{
+	size_t len = 0;
+
+	while (len < size - 1) {
+		if (recv_all(fd, (uint8_t *)line + len, 1) < 0)
+			return -1;
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = 0;
+
+	return 0;
+}
+
+/* "ib <bits>" or "db <bits>" followed by the data, answered with as many
+ * bytes; "reset" has no answer. */
+static bool serve_jtag_dpi(int fd)
+{
+	static uint8_t data[1024 * 1024];
+	char line[64];
+
+	while (recv_line(fd, line, sizeof(line)) == 0) {
+		unsigned int bits;
+
+		stats.requests++;
+		if (!strcmp(line, "reset"))
+			continue;
+		if (sscanf(line, "%*[id]b %u", &bits) != 1) {
+			fprintf(stderr, "unknown command '%s'\n", line);
+			return true;
+		}
+
+		size_t bytes = (bits + 7) / 8;
+		if (bytes > sizeof(data)) {
+			fprintf(stderr, "scan of %u bits is too long\n", bits);
+			return true;
+		}
+		if (recv_all(fd, data, bytes) < 0 || send_all(fd, data, bytes) < 0)
+			return true;
+	}
+
+	return true;
+}
+
+static int listen_socket(int port)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int one = 1;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		return -1;
+	if (listen(fd, 1) < 0)
+		return -1;
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
+{
+	enum protocol protocol = PROTO_REMOTE_BITBANG;
+	int port = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:p:l:1")) != -1) {
+		switch (opt) {
+		case 't':
+			if (!strcmp(optarg, "remote_bitbang")) {
+				protocol = PROTO_REMOTE_BITBANG;
+			} else if (!strcmp(optarg, "jtag_vpi")) {
+				protocol = PROTO_JTAG_VPI;
+			} else if (!strcmp(optarg, "jtag_dpi")) {
+				protocol = PROTO_JTAG_DPI;
+			} else {
+				fprintf(stderr, "unknown protocol '%s'\n", optarg);
+				return 1;
+			}
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case '1':
+			vpi_legacy = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t remote_bitbang|jtag_vpi|jtag_dpi] "
+				"[-p port] [-l latency_us] [-1]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!port)
+		port = protocol == PROTO_REMOTE_BITBANG ? 3335 : 5555;
+
+	int server = listen_socket(port);
+	if (server < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	printf("listening on port %d, latency %u us\n", port, latency_us);
+	fflush(stdout);
+
+	for (bool more = true; more; ) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		memset(&stats, 0, sizeof(stats));
+		switch (protocol) {
+		case PROTO_REMOTE_BITBANG:
+			more = serve_remote_bitbang(fd);
+			break;
+		case PROTO_JTAG_VPI:
+			more = serve_jtag_vpi(fd);
+			break;
+		case PROTO_JTAG_DPI:
+			more = serve_jtag_dpi(fd);
+			break;
+		}
+		close(fd);
+
+		printf("connection closed: %llu requests, %llu replies, %llu bytes in, %llu bytes out\n",
+			stats.requests, stats.replies, stats.bytes_in, stats.bytes_out);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Run the adapter benchmark suite against the dummy driver, the loopback
+# stand-ins of remote_bitbang, jtag_vpi and jtag_dpi (text protocol), the
+# reference DPI server in contrib (binary protocol), and against
+# the software CMSIS-DAP responder for SWD when its sources are around.
+#
+# Usage: run.sh [output_dir] [latency_us]
+#
+# OPENOCD selects the binary to test, the default is "openocd" from PATH.
+# One JSON report per adapter is written to output_dir (default
+# ./benchmark-results). The exit status is non-zero when any suite failed.
+#
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+TOP=$(cd "$HERE/../.." && pwd)
+OPENOCD=${OPENOCD:-openocd}
+OUT=${1:-benchmark-results}
+LATENCY=${2:-0}
+BUILD=$(mktemp -d)
+trap 'kill $STANDIN 2>/dev/null; rm -rf "$BUILD"' EXIT
+
+mkdir -p "$OUT"
+${CC:-cc} -Wall -O2 -std=gnu99 -o "$BUILD/jtag_loopback" "$HERE/jtag_loopback.c"
+
+STANDIN=
+FAILED=
+start_standin() {
+	"$@" > "$BUILD/standin.log" 2>&1 &
+	STANDIN=$!
+	sleep 1
+}
+
+stop_standin() {
+	kill $STANDIN 2>/dev/null || true
+	wait $STANDIN 2>/dev/null || true
+	STANDIN=
+}
+
+run_suite() {
+	name=$1
+	shift
+	echo "=== $name"
+	"$OPENOCD" -s "$TOP/tcl" "$@" -f "$HERE/benchmark.tcl" \
+		-c "init; benchmark_suite {$OUT/$name.json}; shutdown" ||
+		{ echo "$name: benchmark failed"; FAILED="$FAILED $name"; }
+}
+
+run_suite dummy -f interface/dummy.cfg
+
+start_standin "$BUILD/jtag_loopback" -t remote_bitbang -p 3335 -l "$LATENCY"
+run_suite remote_bitbang -c "adapter driver remote_bitbang" \
+	-c "remote_bitbang host localhost" -c "remote_bitbang port 3335"
+stop_standin
+
+start_standin "$BUILD/jtag_loopback" -t jtag_vpi -p 5555 -l "$LATENCY"
+run_suite jtag_vpi -f interface/jtag_vpi.cfg
+stop_standin
+
+start_standin "$BUILD/jtag_loopback" -t jtag_dpi -p 5555 -l "$LATENCY"
+run_suite jtag_dpi_text -f interface/jtag_dpi.cfg -c "jtag_dpi mode text"
+stop_standin
+
+${CC:-cc} -Wall -O2 -std=gnu99 -o "$BUILD/jtag_dpi_server" "$TOP/contrib/jtag_dpi/jtag_dpi_server.c"
+start_standin "$BUILD/jtag_dpi_server" -p 5555 -l "$LATENCY"
+run_suite jtag_dpi -f interface/jtag_dpi.cfg -c "jtag_dpi mode binary"
+stop_standin
+
+SIM="$TOP/contrib/cmsis_dap_sim"
+if [ -f "$SIM/cmsis_dap_sim.c" ]; then
+	${CC:-cc} -Wall -O2 -std=gnu99 -o "$BUILD/cmsis_dap_sim" "$SIM/cmsis_dap_sim.c"
+	start_standin "$BUILD/cmsis_dap_sim" -p 4441 -l "$LATENCY"
+	run_suite cmsis_dap_swd -f "$SIM/cmsis_dap_sim.cfg" -c "cmsis_dap_tcp port 4441"
+	stop_standin
+fi
+
+if [ -n "$FAILED" ]; then
+	echo "failed suites:$FAILED"
+	exit 1
+fi